@@ -0,0 +1,30 @@
+// Shared by path_raygen.rgen and vk_composite.frag, so the RT targets can be packed into RG16 snorm / RGBA8
+
+vec2 octWrap(vec2 v) {
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit vector to [-1, 1]^2 octahedral coordinates
+vec2 octEncode(vec3 n) {
+    n /= max(abs(n.x) + abs(n.y) + abs(n.z), 1e-6);
+    n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+    return n.xy;
+}
+
+vec3 octDecode(vec2 f) {
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// Storage writes to sRGB formats aren't supported, so base color is encoded by hand into a UNORM target
+vec3 linearToSrgb(vec3 color) {
+    color = clamp(color, 0.0, 1.0);
+    return mix(color * 12.92, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, step(vec3(0.0031308), color));
+}
+
+vec3 srgbToLinear(vec3 color) {
+    return mix(color / 12.92, pow((color + 0.055) / 1.055, vec3(2.4)), step(vec3(0.04045), color));
+}
\ No newline at end of file
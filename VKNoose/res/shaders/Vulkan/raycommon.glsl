@@ -11,6 +11,9 @@ struct CameraData {
 	int frameIndex;
 	int inventoryOpen;
 	int wallpaperALBIndex;
+	int sampleCount;
+	int denoiseEnabled;
+	vec2 renderScale;
 };
 
 #define HIT_TYPE_UNDEFINED      0
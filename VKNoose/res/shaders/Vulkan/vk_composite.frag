@@ -6,10 +6,13 @@
 
 #include "vk_raycommon.glsl"
 #include "constants.glsl"
+#include "gbuffer_packing.glsl"
 
 layout (location = 0) out vec4 outFragColor;
 layout (location = 0) in vec2 texCoords;
 
+layout(set = 0, binding = 1) uniform CameraData_ { CameraData data; } cam;
+
 layout(set = 2, binding = 0) uniform sampler2D firstHitColorTexture;
 layout(set = 2, binding = 1) uniform sampler2D firstHitNormalsTexture;
 layout(set = 2, binding = 2) uniform sampler2D firstHitBaseColorTexture;
@@ -42,16 +45,21 @@ float filmic(float x) {
 
 void main() 
 {
-    vec3 firstHitColor = texture(firstHitColorTexture,vec2(texCoords.x, 1-texCoords.y)).xyz;    
-    vec3 firstHitNormals = texture(firstHitNormalsTexture,vec2(texCoords.x, 1-texCoords.y)).xyz;
-    vec3 secondHitColorTexture = texture(secondHitColorTexture,vec2(texCoords.x, 1-texCoords.y)).xyz;
-    vec3 firstHitBaseColor = texture(firstHitBaseColorTexture,vec2(texCoords.x, 1-texCoords.y)).xyz;
-    vec3 denoiseA = texture(denoiseATexture,vec2(texCoords.x, 1-texCoords.y)).xyz;
-    vec3 denoiseB = texture(denoiseBTexture,vec2(texCoords.x, 1-texCoords.y)).xyz;
-    vec3 denoiseC = texture(denoiseCTexture,vec2(texCoords.x, 1-texCoords.y)).xyz;
-
 	vec2 uv = vec2(texCoords.x, 1-texCoords.y);
 
+	// Dynamic resolution only traces the top left of the RT targets. Clamp half a texel in so the
+	// bilinear upsample never pulls in stale texels from outside the traced region.
+	vec2 halfTexel = 0.5 / vec2(textureSize(firstHitColorTexture, 0));
+	vec2 rtUV = min(uv * cam.data.renderScale, cam.data.renderScale - halfTexel);
+
+    vec3 firstHitColor = texture(firstHitColorTexture, rtUV).xyz;    
+    vec3 firstHitNormals = octDecode(texture(firstHitNormalsTexture, rtUV).xy);
+    vec3 secondHitColorTexture = texture(secondHitColorTexture, rtUV).xyz;
+    vec3 firstHitBaseColor = srgbToLinear(texture(firstHitBaseColorTexture, rtUV).xyz);
+    vec3 denoiseA = texture(denoiseATexture, rtUV).xyz;
+    vec3 denoiseB = texture(denoiseBTexture, rtUV).xyz;
+    vec3 denoiseC = texture(denoiseCTexture, rtUV).xyz;
+
 	//firstHitColor     = texture(sampler2D(g_textures[RT_IDX_FIRST_HIT_COLOR],   g_samplers[0]), uv).xyz;
 
 	//vec3 firstHitColor     = texture(sampler2D(g_textures[RT_IDX_FIRST_HIT_COLOR],   g_samplers[0]), uv).xyz;
@@ -62,6 +70,11 @@ void main()
 
 	vec3 finalColor = mix(firstHitColor, secondHitColorTexture * firstHitBaseColor, 0.8);;
 
+	// CPU denoised version of the above, see VulkanDenoiseManager
+	if (cam.data.denoiseEnabled == 1) {
+		finalColor = denoiseA;
+	}
+
     // Tonemap
 	finalColor = pow(finalColor, vec3(1.0/2.2)); 
 	finalColor = Tonemap_ACES(finalColor);
@@ -13,7 +13,7 @@ layout (location = 7) in flat int yClipMax;
 layout (location = 0) out vec4 outFragColor;
 
 layout(set = 1, binding = 0) uniform sampler samp;
-layout(set = 1, binding = 1) uniform texture2D textures[91];
+layout(set = 1, binding = 1) uniform texture2D textures[256];
 
 void main() {
     outFragColor = texture(sampler2D(textures[textureIndex], samp), texCoord).rgba;
@@ -24,6 +24,7 @@ struct ObjectData2D{
 	int yClipMax;
 	int dummy0;
 	int dummy2;
+	vec4 uvRect;
 } objectData;
 
 //all object matrices
@@ -41,5 +42,6 @@ void main()
 	yClipMin = int(objectBuffer.objects[gl_InstanceIndex].yClipMin);
 	yClipMax = int(objectBuffer.objects[gl_InstanceIndex].yClipMax);
 	gl_Position = modelMatrix * vec4(vPosition, 1.0);
-	texCoord = vTexCoord;
+	vec4 uvRect = objectBuffer.objects[gl_InstanceIndex].uvRect;
+	texCoord = mix(uvRect.xy, uvRect.zw, vTexCoord);
 }
@@ -11,6 +11,7 @@ namespace VulkanCommandManager {
     struct CommandData {
         VkCommandPool graphicsPool;
         VkCommandBuffer graphicsBuffer;
+        VkCommandPool secondaryPools[MAX_RECORDING_THREADS];
     };
 
     CommandData g_frames[FRAME_OVERLAP];
@@ -34,6 +35,14 @@ namespace VulkanCommandManager {
             if (vkAllocateCommandBuffers(device, &cmdAllocInfo, &g_frames[i].graphicsBuffer) != VK_SUCCESS) {
                 return false;
             }
+
+            // Secondary buffers are allocated on demand and freed in bulk by ResetSecondaryCommandPools
+            VkCommandPoolCreateInfo secondaryPoolInfo = vkinit::command_pool_create_info(graphicsFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+            for (uint32_t j = 0; j < MAX_RECORDING_THREADS; j++) {
+                if (vkCreateCommandPool(device, &secondaryPoolInfo, nullptr, &g_frames[i].secondaryPools[j]) != VK_SUCCESS) {
+                    return false;
+                }
+            }
         }
 
         // Create upload context pool and buffer
@@ -56,6 +65,9 @@ namespace VulkanCommandManager {
 
         for (int i = 0; i < FRAME_OVERLAP; i++) {
             vkDestroyCommandPool(device, g_frames[i].graphicsPool, nullptr);
+            for (uint32_t j = 0; j < MAX_RECORDING_THREADS; j++) {
+                vkDestroyCommandPool(device, g_frames[i].secondaryPools[j], nullptr);
+            }
         }
         vkDestroyCommandPool(device, g_uploadPool, nullptr);
     }
@@ -68,6 +80,34 @@ namespace VulkanCommandManager {
         return g_frames[frameIndex].graphicsBuffer;
     }
 
+    void ResetSecondaryCommandPools(uint32_t frameIndex) {
+        VkDevice device = VulkanDeviceManager::GetDevice();
+        for (uint32_t j = 0; j < MAX_RECORDING_THREADS; j++) {
+            vkResetCommandPool(device, g_frames[frameIndex].secondaryPools[j], VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+        }
+    }
+
+    VkCommandBuffer BeginSecondaryCommandBuffer(uint32_t frameIndex, uint32_t threadIndex, uint32_t colorAttachmentCount, const VkFormat* colorFormats) {
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+
+        VkCommandBufferAllocateInfo allocInfo = vkinit::command_buffer_allocate_info(g_frames[frameIndex].secondaryPools[threadIndex], 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        VK_CHECK(vkAllocateCommandBuffers(VulkanDeviceManager::GetDevice(), &allocInfo, &cmd));
+
+        VkCommandBufferInheritanceRenderingInfo renderingInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO };
+        renderingInfo.colorAttachmentCount = colorAttachmentCount;
+        renderingInfo.pColorAttachmentFormats = colorFormats;
+        renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+        inheritanceInfo.pNext = &renderingInfo;
+
+        VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+        VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+        return cmd;
+    }
+
     VkCommandPool GetUploadCommandPool() {
         return g_uploadPool;
     }
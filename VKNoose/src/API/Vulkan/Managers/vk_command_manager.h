@@ -3,12 +3,21 @@
 #include <functional>
 
 namespace VulkanCommandManager {
+    // Each recording thread owns one secondary pool per frame in flight, pools are never shared between threads
+    constexpr uint32_t MAX_RECORDING_THREADS = 4;
+
     bool Init();
     void Cleanup();
 
     VkCommandPool GetGraphicsCommandPool(uint32_t frameIndex);
     VkCommandBuffer GetGraphicsCommandBuffer(uint32_t frameIndex);
 
+    // Resets every secondary pool of the frame slot, only call once its render fence has signalled
+    void ResetSecondaryCommandPools(uint32_t frameIndex);
+
+    // Allocates and begins a secondary buffer that continues a dynamic rendering pass with the given color formats
+    VkCommandBuffer BeginSecondaryCommandBuffer(uint32_t frameIndex, uint32_t threadIndex, uint32_t colorAttachmentCount, const VkFormat* colorFormats);
+
     VkCommandPool GetUploadCommandPool();
     VkCommandBuffer GetUploadCommandBuffer();
 
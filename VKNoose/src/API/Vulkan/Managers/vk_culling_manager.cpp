@@ -0,0 +1,201 @@
+#include "vk_culling_manager.h"
+#include "vk_device_manager.h"
+#include "vk_pipeline_manager.h"
+#include "vk_resource_manager.h"
+#include "API/Vulkan/Renderer/vk_renderer.h"
+#include "API/Vulkan/Types/vk_buffer.h"
+#include "AssetManagement/AssetManager.h"
+
+#include "Hell/Constants.h"
+#include "Hell/Core/Logging.h"
+#include "Common.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+namespace VulkanCullingManager {
+    // Draw buffers start with the draw count, the commands follow at DRAW_COMMANDS_OFFSET
+    constexpr VkDeviceSize DRAW_COMMANDS_OFFSET = 16;
+    constexpr uint32_t MAX_DRAWS = 8192;
+    constexpr uint32_t WORKGROUP_SIZE = 64;
+
+    VulkanBuffer g_drawBuffers[FRAME_OVERLAP];
+    VulkanBuffer g_meshInfoBuffer;
+    uint32_t g_maxDrawCount[FRAME_OVERLAP] = {};
+
+    // CPU fallback
+    std::vector<GPUMeshInfo> g_meshInfo;
+    std::vector<VkDrawIndexedIndirectCommand> g_cpuDraws[FRAME_OVERLAP];
+
+    void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4* planes);
+    void RecordCpuCulling(uint32_t frameIndex, std::span<const MeshInstance> instances, const glm::mat4& viewProjection);
+
+    bool Init() {
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        VkDeviceSize size = DRAW_COMMANDS_OFFSET + sizeof(VkDrawIndexedIndirectCommand) * MAX_DRAWS;
+
+        for (VulkanBuffer& drawBuffer : g_drawBuffers) {
+            drawBuffer = VulkanBuffer(size, usage, VMA_MEMORY_USAGE_GPU_ONLY);
+            if (drawBuffer.GetBuffer() == VK_NULL_HANDLE) {
+                Logging::Error() << "VulkanCullingManager::Init() failed to create draw buffer\n";
+                return false;
+            }
+        }
+
+        std::cout << "VulkanCullingManager::Init()\n";
+        return true;
+    }
+
+    void Cleanup() {
+        for (VulkanBuffer& drawBuffer : g_drawBuffers) {
+            drawBuffer.Cleanup();
+        }
+        g_meshInfoBuffer.Cleanup();
+        g_meshInfo.clear();
+        for (std::vector<VkDrawIndexedIndirectCommand>& draws : g_cpuDraws) {
+            draws.clear();
+        }
+    }
+
+    void UpdateMeshInfo() {
+        std::vector<MeshOLD>& meshes = AssetManager::GetMeshList();
+        if (meshes.empty()) return;
+
+        std::vector<GPUMeshInfo> meshInfo(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            meshInfo[i].indexCount = meshes[i].m_indexCount;
+            meshInfo[i].firstIndex = meshes[i].m_indexOffset;
+            meshInfo[i].vertexOffset = (int32_t)meshes[i].m_vertexOffset;
+            meshInfo[i].aabbMin = glm::vec4(meshes[i].m_aabbMin, 0.0f);
+            meshInfo[i].aabbMax = glm::vec4(meshes[i].m_aabbMax, 0.0f);
+        }
+
+        // Last frame's cull may still be reading the old one
+        if (g_meshInfoBuffer.GetBuffer() != VK_NULL_HANDLE) {
+            std::shared_ptr<VulkanBuffer> retired = std::make_shared<VulkanBuffer>(std::move(g_meshInfoBuffer));
+            VulkanRenderer::DeferDestroy([retired]() { retired->Cleanup(); });
+        }
+
+        VkDeviceSize size = sizeof(GPUMeshInfo) * meshInfo.size();
+        g_meshInfoBuffer = VulkanBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+        g_meshInfoBuffer.UploadData(meshInfo.data(), size);
+        g_meshInfo = std::move(meshInfo);
+    }
+
+    void RecordCulling(VkCommandBuffer cmd, uint64_t instanceBufferId, std::span<const MeshInstance> instances, const glm::mat4& viewProjection) {
+        uint32_t frameIndex = VulkanRenderer::GetCurrentFrameIndex();
+        if (!VulkanDeviceManager::IsDrawIndirectCountSupported()) {
+            RecordCpuCulling(frameIndex, instances, viewProjection);
+            return;
+        }
+
+        uint32_t instanceCount = (uint32_t)instances.size();
+        VulkanBuffer& drawBuffer = g_drawBuffers[frameIndex];
+        VulkanBuffer* instanceBuffer = VulkanResourceManager::GetBuffer(instanceBufferId);
+        VulkanPipeline* pipeline = VulkanPipelineManager::GetPipeline("GBufferCull");
+
+        if (!instanceBuffer || !pipeline || g_meshInfoBuffer.GetBuffer() == VK_NULL_HANDLE) {
+            instanceCount = 0;
+        }
+        else {
+            instanceCount = std::min({ instanceCount, MAX_DRAWS, (uint32_t)(instanceBuffer->GetSize() / sizeof(MeshInstance)) });
+        }
+        g_maxDrawCount[frameIndex] = instanceCount;
+
+        // Previous draws from this slot finished with the fence, only the reset has to land before the shader appends
+        vkCmdFillBuffer(cmd, drawBuffer.GetBuffer(), 0, sizeof(uint32_t), 0);
+
+        VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        if (instanceCount > 0) {
+            CullPushConstants pushConstants;
+            ExtractFrustumPlanes(viewProjection, pushConstants.frustumPlanes);
+            pushConstants.instanceBufferAddress = instanceBuffer->GetDeviceAddress();
+            pushConstants.meshInfoBufferAddress = g_meshInfoBuffer.GetDeviceAddress();
+            pushConstants.drawBufferAddress = drawBuffer.GetDeviceAddress();
+            pushConstants.instanceCount = instanceCount;
+            pushConstants.meshInfoCount = (uint32_t)g_meshInfo.size();
+
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetHandle());
+            vkCmdPushConstants(cmd, pipeline->GetLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+            vkCmdDispatch(cmd, (instanceCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        }
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void RecordDraws(VkCommandBuffer cmd) {
+        uint32_t frameIndex = VulkanRenderer::GetCurrentFrameIndex();
+        if (!VulkanDeviceManager::IsDrawIndirectCountSupported()) {
+            for (const VkDrawIndexedIndirectCommand& draw : g_cpuDraws[frameIndex]) {
+                vkCmdDrawIndexed(cmd, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+            }
+            return;
+        }
+        if (g_maxDrawCount[frameIndex] == 0) return;
+
+        VkBuffer drawBuffer = g_drawBuffers[frameIndex].GetBuffer();
+        vkCmdDrawIndexedIndirectCount(cmd, drawBuffer, DRAW_COMMANDS_OFFSET, drawBuffer, 0, g_maxDrawCount[frameIndex], sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    // Same test as vk_gbuffer_cull.comp
+    void RecordCpuCulling(uint32_t frameIndex, std::span<const MeshInstance> instances, const glm::mat4& viewProjection) {
+        std::vector<VkDrawIndexedIndirectCommand>& draws = g_cpuDraws[frameIndex];
+        draws.clear();
+
+        glm::vec4 planes[6];
+        ExtractFrustumPlanes(viewProjection, planes);
+
+        for (size_t i = 0; i < instances.size(); i++) {
+            const MeshInstance& instance = instances[i];
+            if (instance.meshIndex < 0 || instance.meshIndex >= (int)g_meshInfo.size()) continue;
+
+            const GPUMeshInfo& mesh = g_meshInfo[instance.meshIndex];
+            if (mesh.indexCount == 0) continue;
+
+            glm::vec3 localCenter = glm::vec3(mesh.aabbMin + mesh.aabbMax) * 0.5f;
+            glm::vec3 localExtents = glm::vec3(mesh.aabbMax - mesh.aabbMin) * 0.5f;
+            glm::vec3 center = glm::vec3(instance.worldMatrix * glm::vec4(localCenter, 1.0f));
+            glm::mat3 absMatrix = glm::mat3(glm::abs(glm::vec3(instance.worldMatrix[0])), glm::abs(glm::vec3(instance.worldMatrix[1])), glm::abs(glm::vec3(instance.worldMatrix[2])));
+            glm::vec3 extents = absMatrix * localExtents;
+
+            bool visible = true;
+            for (const glm::vec4& plane : planes) {
+                float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+                if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                    visible = false;
+                    break;
+                }
+            }
+            if (!visible) continue;
+
+            VkDrawIndexedIndirectCommand& draw = draws.emplace_back();
+            draw.indexCount = mesh.indexCount;
+            draw.instanceCount = 1;
+            draw.firstIndex = mesh.firstIndex;
+            draw.vertexOffset = mesh.vertexOffset;
+            draw.firstInstance = (uint32_t)i;
+        }
+    }
+
+    void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4* planes) {
+        // Gribb/Hartmann, planes point inwards. The near plane uses the -w..w depth range, which is the
+        // conservative choice if the projection actually maps to 0..w.
+        glm::mat4 m = glm::transpose(viewProjection);
+        planes[0] = m[3] + m[0]; // Left
+        planes[1] = m[3] - m[0]; // Right
+        planes[2] = m[3] + m[1]; // Bottom
+        planes[3] = m[3] - m[1]; // Top
+        planes[4] = m[3] + m[2]; // Near
+        planes[5] = m[3] - m[2]; // Far
+        for (int i = 0; i < 6; i++) {
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include "API/Vulkan/vk_common.h"
+#include <glm/glm.hpp>
+#include <span>
+
+struct MeshInstance;
+
+// GPU frustum culling for the GBuffer raster path. A compute pass tests every MeshInstance against the
+// camera frustum and appends the survivors to a per frame indirect draw buffer, which is then drawn with a
+// single vkCmdDrawIndexedIndirectCount. The CPU cost is the same however many instances the scene holds.
+// Devices without multiDrawIndirect, drawIndirectFirstInstance or drawIndirectCount get the same test on the CPU and one draw per survivor.
+namespace VulkanCullingManager {
+    // Matches the push constant block in vk_gbuffer_cull.comp
+    struct CullPushConstants {
+        glm::vec4 frustumPlanes[6];
+        uint64_t instanceBufferAddress = 0;
+        uint64_t meshInfoBufferAddress = 0;
+        uint64_t drawBufferAddress = 0;
+        uint32_t instanceCount = 0;
+        uint32_t meshInfoCount = 0;
+    };
+
+    // Per MeshOLD, indexed by MeshInstance::meshIndex
+    struct GPUMeshInfo {
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t vertexOffset = 0;
+        uint32_t padding = 0;
+        glm::vec4 aabbMin = glm::vec4(0);
+        glm::vec4 aabbMax = glm::vec4(0);
+    };
+
+    bool Init();
+    void Cleanup();
+
+    // Rebuilds the mesh info buffer from AssetManager::GetMeshList(), call whenever meshes have been added
+    void UpdateMeshInfo();
+
+    // Both record into the current frame slot's draw buffer. RecordDraws() expects the GBuffer pipeline
+    // and the global geometry buffers to be bound, instances are drawn with gl_InstanceIndex as their index.
+    // 'instances' is the CPU copy of the instance buffer, only read by the CPU fallback.
+    void RecordCulling(VkCommandBuffer cmd, uint64_t instanceBufferId, std::span<const MeshInstance> instances, const glm::mat4& viewProjection);
+    void RecordDraws(VkCommandBuffer cmd);
+}
\ No newline at end of file
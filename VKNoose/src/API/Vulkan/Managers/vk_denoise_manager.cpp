@@ -0,0 +1,345 @@
+#include "vk_denoise_manager.h"
+#include "vk_dynamic_resolution_manager.h"
+#include "vk_readback_manager.h"
+#include "vk_resource_manager.h"
+#include "API/Vulkan/Renderer/vk_renderer.h"
+#include "API/Vulkan/Types/vk_buffer.h"
+
+#include "Hell/Constants.h"
+#include "Hell/Core/Logging.h"
+#include "Profiler.h"
+
+#include <OpenImageDenoise/oidn.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace VulkanDenoiseManager {
+    enum DenoiseInput {
+        FIRST_HIT_COLOR = 0,
+        SECOND_HIT_COLOR,
+        FIRST_HIT_NORMALS,
+        FIRST_HIT_BASE_COLOR,
+        DENOISE_INPUT_COUNT
+    };
+
+    // Readbacks arrive once their frame slot's fence has been waited on, FRAME_OVERLAP frames after they were recorded.
+    // The filter gets one more frame on top of that, an older result would smear under camera motion and isn't shown.
+    constexpr uint64_t MAX_RESULT_AGE_FRAMES = FRAME_OVERLAP + 1;
+
+    const char* g_inputImageNames[DENOISE_INPUT_COUNT] = { "RT_FirstHit_Color", "RT_SecondHit_Color", "RT_FirstHit_Normals", "RT_FirstHit_BaseColor" };
+
+    // Only the traced top left region of the RT targets is read back, width and height are the render extent at readback
+    struct DenoiseJob {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint64_t frameNumber = 0;       // Frame the inputs were traced in
+        VkFormat formats[DENOISE_INPUT_COUNT] = {};
+        std::vector<uint8_t> inputs[DENOISE_INPUT_COUNT];
+        uint32_t receivedCount = 0;
+        std::vector<uint16_t> result;   // RGBA16F, matches "Denoise_A"
+        float denoiseTime = 0.0f;
+        bool succeeded = false;
+    };
+
+    oidn::DeviceRef g_device;
+    oidn::FilterRef g_filter;
+    std::mutex g_filterMutex;
+
+    DenoiseJob g_job;
+    std::future<void> g_jobResult;
+    bool g_readbacksPending = false;
+    bool g_enabled = false;
+    bool g_hasResult = false;
+    VkExtent2D g_resultExtent = { 0, 0 };
+    uint64_t g_resultFrameNumber = 0;
+
+    VulkanBuffer g_uploadBuffers[FRAME_OVERLAP];
+
+    void OnReadbackReceived(DenoiseInput input, const void* data, VkDeviceSize size);
+    void RunJob(DenoiseJob& job);
+    glm::vec4 ReadTexel(const uint8_t* data, VkFormat format, size_t index);
+    glm::vec3 OctDecode(glm::vec2 f);
+    glm::vec3 SrgbToLinear(glm::vec3 color);
+
+    bool Init() {
+        AllocatedImage* denoiseImage = VulkanResourceManager::GetAllocatedImage("Denoise_A");
+        if (!denoiseImage) {
+            Logging::Error() << "VulkanDenoiseManager::Init() failed, 'Denoise_A' render target does not exist\n";
+            return false;
+        }
+
+        g_device = oidn::newDevice(oidn::DeviceType::CPU);
+        g_device.commit();
+
+        const char* errorMessage = nullptr;
+        if (g_device.getError(errorMessage) != oidn::Error::None) {
+            Logging::Error() << "VulkanDenoiseManager::Init() failed to create OIDN device: " << errorMessage << "\n";
+            g_device = nullptr;
+            return false;
+        }
+
+        VkDeviceSize uploadSize = (VkDeviceSize)denoiseImage->GetWidth() * denoiseImage->GetHeight() * 4 * sizeof(uint16_t);
+        for (VulkanBuffer& buffer : g_uploadBuffers) {
+            buffer = VulkanBuffer(uploadSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        }
+
+        std::cout << "VulkanDenoiseManager::Init()\n";
+        return true;
+    }
+
+    void Cleanup() {
+        // Expects the device to be idle
+        if (g_jobResult.valid()) {
+            g_jobResult.wait();
+        }
+        g_job = DenoiseJob();
+        g_readbacksPending = false;
+        g_hasResult = false;
+
+        for (VulkanBuffer& buffer : g_uploadBuffers) {
+            buffer.Cleanup();
+        }
+
+        std::lock_guard<std::mutex> lock(g_filterMutex);
+        g_filter = nullptr;
+        g_device = nullptr;
+    }
+
+    void SetEnabled(bool enabled) {
+        if (enabled && !g_device) {
+            Logging::Warning() << "VulkanDenoiseManager: CPU denoising is unavailable, Init() failed\n";
+        }
+        g_enabled = enabled && g_device;
+        if (!g_enabled) {
+            g_hasResult = false;
+        }
+    }
+
+    void Toggle() {
+        SetEnabled(!g_enabled);
+    }
+
+    bool IsEnabled() {
+        return g_enabled;
+    }
+
+    bool HasResult() {
+        // The composite samples Denoise_A with the current render scale, a result traced at another scale would be misplaced
+        VkExtent2D renderExtent = VulkanDynamicResolutionManager::GetRenderExtent();
+        return g_enabled && g_hasResult && g_resultExtent.width == renderExtent.width && g_resultExtent.height == renderExtent.height &&
+            VulkanRenderer::GetFrameNumber() - g_resultFrameNumber <= MAX_RESULT_AGE_FRAMES;
+    }
+
+    void RecordUploads(VkCommandBuffer cmd) {
+        if (!g_jobResult.valid()) return;
+        if (g_jobResult.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+        g_jobResult.get();
+
+        DenoiseJob job = std::move(g_job);
+        g_job = DenoiseJob();
+
+        if (!g_enabled || !job.succeeded) return;
+
+        Profiler::AddRecordTime("Denoise (CPU)", job.denoiseTime);
+
+        // Dropped if the render scale moved while the job ran, the next readback picks up the new extent
+        VkExtent2D renderExtent = VulkanDynamicResolutionManager::GetRenderExtent();
+        if (job.width != renderExtent.width || job.height != renderExtent.height) return;
+
+        AllocatedImage* denoiseImage = VulkanResourceManager::GetAllocatedImage("Denoise_A");
+        if (!denoiseImage || (uint32_t)denoiseImage->GetWidth() < job.width || (uint32_t)denoiseImage->GetHeight() < job.height) return;
+
+        // The slot's previous copy has retired, its render fence was waited on before recording began
+        VulkanBuffer& uploadBuffer = g_uploadBuffers[VulkanRenderer::GetCurrentFrameIndex()];
+        uploadBuffer.UpdateData(job.result.data(), job.result.size() * sizeof(uint16_t));
+
+        denoiseImage->TransitionLayout(cmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkBufferImageCopy region{};
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { job.width, job.height, 1 };
+        vkCmdCopyBufferToImage(cmd, uploadBuffer.GetBuffer(), denoiseImage->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        denoiseImage->TransitionLayout(cmd, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        g_hasResult = true;
+        g_resultExtent = { job.width, job.height };
+        g_resultFrameNumber = job.frameNumber;
+    }
+
+    void RecordReadbacks(VkCommandBuffer cmd) {
+        if (!g_enabled || g_readbacksPending || g_jobResult.valid()) return;
+
+        AllocatedImage* images[DENOISE_INPUT_COUNT];
+        for (int i = 0; i < DENOISE_INPUT_COUNT; i++) {
+            images[i] = VulkanResourceManager::GetAllocatedImage(g_inputImageNames[i]);
+            if (!images[i]) return;
+        }
+
+        VkExtent2D renderExtent = VulkanDynamicResolutionManager::GetRenderExtent();
+        for (AllocatedImage* image : images) {
+            renderExtent.width = std::min(renderExtent.width, (uint32_t)image->GetWidth());
+            renderExtent.height = std::min(renderExtent.height, (uint32_t)image->GetHeight());
+        }
+        if (renderExtent.width == 0 || renderExtent.height == 0) return;
+
+        g_job = DenoiseJob();
+        g_job.width = renderExtent.width;
+        g_job.height = renderExtent.height;
+        g_job.frameNumber = VulkanRenderer::GetFrameNumber();
+        g_readbacksPending = true;
+
+        for (int i = 0; i < DENOISE_INPUT_COUNT; i++) {
+            DenoiseInput input = (DenoiseInput)i;
+            g_job.formats[i] = images[i]->GetFormat();
+            VulkanReadbackManager::RequestImageRegionReadback(cmd, g_inputImageNames[i], *images[i], renderExtent, [input](const void* data, VkDeviceSize size, uint64_t frameNumber) {
+                OnReadbackReceived(input, data, size);
+            });
+
+            // The composite samples these in GENERAL
+            images[i]->TransitionLayout(cmd, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+    }
+
+    void OnReadbackReceived(DenoiseInput input, const void* data, VkDeviceSize size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        g_job.inputs[input].assign(bytes, bytes + size);
+
+        if (++g_job.receivedCount < DENOISE_INPUT_COUNT) return;
+
+        g_readbacksPending = false;
+        g_jobResult = std::async(std::launch::async, [] { RunJob(g_job); });
+    }
+
+    void RunJob(DenoiseJob& job) {
+        Profiler::SetThreadName("Denoise");
+        PROFILE_SCOPE("Denoise");
+        auto startTime = std::chrono::steady_clock::now();
+
+        size_t pixelCount = (size_t)job.width * job.height;
+        std::vector<float> color(pixelCount * 3);
+        std::vector<float> albedo(pixelCount * 3);
+        std::vector<float> normal(pixelCount * 3);
+
+        for (size_t i = 0; i < pixelCount; i++) {
+            glm::vec3 firstHitColor = glm::vec3(ReadTexel(job.inputs[FIRST_HIT_COLOR].data(), job.formats[FIRST_HIT_COLOR], i));
+            glm::vec3 secondHitColor = glm::vec3(ReadTexel(job.inputs[SECOND_HIT_COLOR].data(), job.formats[SECOND_HIT_COLOR], i));
+            glm::vec3 baseColor = SrgbToLinear(glm::vec3(ReadTexel(job.inputs[FIRST_HIT_BASE_COLOR].data(), job.formats[FIRST_HIT_BASE_COLOR], i)));
+            glm::vec3 firstHitNormal = OctDecode(glm::vec2(ReadTexel(job.inputs[FIRST_HIT_NORMALS].data(), job.formats[FIRST_HIT_NORMALS], i)));
+
+            // Same combine as vk_composite.frag, so the filter sees the image that would otherwise be shown
+            glm::vec3 beauty = glm::mix(firstHitColor, secondHitColor * baseColor, 0.8f);
+
+            memcpy(&color[i * 3], &beauty, sizeof(glm::vec3));
+            memcpy(&albedo[i * 3], &baseColor, sizeof(glm::vec3));
+            memcpy(&normal[i * 3], &firstHitNormal, sizeof(glm::vec3));
+        }
+
+        job.succeeded = DenoiseImage(color.data(), albedo.data(), normal.data(), job.width, job.height, true);
+        if (!job.succeeded) return;
+
+        job.result.resize(pixelCount * 4);
+        for (size_t i = 0; i < pixelCount; i++) {
+            job.result[i * 4 + 0] = glm::packHalf1x16(color[i * 3 + 0]);
+            job.result[i * 4 + 1] = glm::packHalf1x16(color[i * 3 + 1]);
+            job.result[i * 4 + 2] = glm::packHalf1x16(color[i * 3 + 2]);
+            job.result[i * 4 + 3] = glm::packHalf1x16(1.0f);
+        }
+
+        std::chrono::duration<float> duration = std::chrono::steady_clock::now() - startTime;
+        job.denoiseTime = duration.count() * 1000.0f;
+    }
+
+    bool DenoiseImage(float* color, const float* albedo, const float* normal, uint32_t width, uint32_t height, bool hdr) {
+        std::lock_guard<std::mutex> lock(g_filterMutex);
+        if (!g_device) return false;
+
+        if (!g_filter) {
+            g_filter = g_device.newFilter("RT");
+        }
+
+        // The filter only re-initializes when the image dimensions or inputs change, pointers are cheap to swap
+        g_filter.setImage("color", color, oidn::Format::Float3, width, height);
+        g_filter.setImage("output", color, oidn::Format::Float3, width, height);
+        if (albedo) {
+            g_filter.setImage("albedo", const_cast<float*>(albedo), oidn::Format::Float3, width, height);
+        }
+        else {
+            g_filter.unsetImage("albedo");
+        }
+        if (normal) {
+            g_filter.setImage("normal", const_cast<float*>(normal), oidn::Format::Float3, width, height);
+        }
+        else {
+            g_filter.unsetImage("normal");
+        }
+        g_filter.set("hdr", hdr);
+        g_filter.commit();
+        g_filter.execute();
+
+        const char* errorMessage = nullptr;
+        if (g_device.getError(errorMessage) != oidn::Error::None) {
+            Logging::Error() << "VulkanDenoiseManager::DenoiseImage() failed: " << errorMessage << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    glm::vec4 ReadTexel(const uint8_t* data, VkFormat format, size_t index) {
+        switch (format) {
+            case VK_FORMAT_R32G32B32A32_SFLOAT: {
+                glm::vec4 texel;
+                memcpy(&texel, data + index * 16, sizeof(glm::vec4));
+                return texel;
+            }
+            case VK_FORMAT_R16G16B16A16_SFLOAT: {
+                uint16_t halves[4];
+                memcpy(halves, data + index * 8, sizeof(halves));
+                return glm::vec4(glm::unpackHalf1x16(halves[0]), glm::unpackHalf1x16(halves[1]), glm::unpackHalf1x16(halves[2]), glm::unpackHalf1x16(halves[3]));
+            }
+            case VK_FORMAT_B10G11R11_UFLOAT_PACK32: {
+                uint32_t packed;
+                memcpy(&packed, data + index * 4, sizeof(packed));
+                return glm::vec4(glm::unpackF2x11_1x10(packed), 1.0f);
+            }
+            case VK_FORMAT_R16G16_SNORM: {
+                uint32_t packed;
+                memcpy(&packed, data + index * 4, sizeof(packed));
+                return glm::vec4(glm::unpackSnorm2x16(packed), 0.0f, 0.0f);
+            }
+            case VK_FORMAT_R8G8B8A8_UNORM: {
+                uint32_t packed;
+                memcpy(&packed, data + index * 4, sizeof(packed));
+                return glm::unpackUnorm4x8(packed);
+            }
+            default:
+                return glm::vec4(0.0f);
+        }
+    }
+
+    // C++ mirror of octDecode() in gbuffer_packing.glsl
+    glm::vec3 OctDecode(glm::vec2 f) {
+        glm::vec3 n(f.x, f.y, 1.0f - std::abs(f.x) - std::abs(f.y));
+        float t = glm::clamp(-n.z, 0.0f, 1.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        float length = glm::length(n);
+        return (length > 0.0f) ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+
+    glm::vec3 SrgbToLinear(glm::vec3 color) {
+        glm::vec3 result;
+        for (int i = 0; i < 3; i++) {
+            result[i] = (color[i] <= 0.04045f) ? color[i] / 12.92f : std::pow((color[i] + 0.055f) / 1.055f, 2.4f);
+        }
+        return result;
+    }
+}
\ No newline at end of file
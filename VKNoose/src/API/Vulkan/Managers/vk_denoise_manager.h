@@ -0,0 +1,25 @@
+#pragma once
+#include "API/Vulkan/vk_common.h"
+
+namespace VulkanDenoiseManager {
+    bool Init();
+    void Cleanup();
+
+    void SetEnabled(bool enabled);
+    void Toggle();
+    bool IsEnabled();
+
+    // True once a denoised frame has been uploaded to "Denoise_A" since denoising was enabled, and only while
+    // the render scale matches the one that frame was traced at and it is at most one frame older than the readback
+    // latency. When the CPU filter can't keep up the composite shows the noisy image instead of a stale one.
+    bool HasResult();
+
+    // Both are recorded after the path trace and before the composite, uploads first. Readbacks are only
+    // issued while no denoise is in flight.
+    void RecordUploads(VkCommandBuffer cmd);
+    void RecordReadbacks(VkCommandBuffer cmd);
+
+    // Synchronous OIDN "RT" filter over tightly packed float3 images, denoises 'color' in place.
+    // albedo and normal may be nullptr. Usable from any thread once Init() has succeeded.
+    bool DenoiseImage(float* color, const float* albedo, const float* normal, uint32_t width, uint32_t height, bool hdr);
+}
\ No newline at end of file
@@ -29,6 +29,11 @@ namespace VulkanDeviceManager {
     VkPhysicalDeviceRayTracingPipelineFeaturesKHR g_rayTracingPipelineFeatures = {};
     VkPhysicalDeviceAccelerationStructureFeaturesKHR g_accelerationStructureFeatures = {};
 
+    bool g_memoryBudgetSupported = false;
+    bool g_drawIndirectCountSupported = false;
+
+    bool IsExtensionAvailable(const std::vector<VkExtensionProperties>& available, const char* name);
+
     bool Init() {
         VkInstance instance = VulkanInstanceManager::GetInstance();
         VkSurfaceKHR surface = VulkanInstanceManager::GetSurface();
@@ -54,8 +59,18 @@ namespace VulkanDeviceManager {
             VK_KHR_SPIRV_1_4_EXTENSION_NAME,
             VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME,
             VK_NV_DEVICE_DIAGNOSTIC_CHECKPOINTS_EXTENSION_NAME,
-            VK_NV_DEVICE_DIAGNOSTICS_CONFIG_EXTENSION_NAME,
-            VK_KHR_SWAPCHAIN_EXTENSION_NAME
+            VK_NV_DEVICE_DIAGNOSTICS_CONFIG_EXTENSION_NAME
+        };
+
+        // Without a surface there is nothing to present to
+        bool headless = (surface == VK_NULL_HANDLE);
+        if (!headless) {
+            requiredExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
+
+        // Enabled when the device exposes them, the engine runs without
+        std::vector<const char*> optionalExtensions = {
+            VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
         };
 
         // Select first suitable device
@@ -68,11 +83,7 @@ namespace VulkanDeviceManager {
 
             bool allFound = true;
             for (auto req : requiredExtensions) {
-                bool found = false;
-                for (auto& av : available) {
-                    if (strcmp(req, av.extensionName) == 0) { found = true; break; }
-                }
-                if (!found) { allFound = false; break; }
+                if (!IsExtensionAvailable(available, req)) { allFound = false; break; }
             }
             if (!allFound) continue;
 
@@ -86,20 +97,55 @@ namespace VulkanDeviceManager {
             for (uint32_t i = 0; i < qCount; ++i) {
                 if (qProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) graphicsFam = i;
                 VkBool32 presentSupport = VK_FALSE;
-                vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+                if (headless) {
+                    presentSupport = (qProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+                }
+                else {
+                    vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+                }
                 if (presentSupport) presentFam = i;
                 if (graphicsFam != -1 && presentFam != -1) break;
             }
             if (graphicsFam == -1 || presentFam == -1) continue;
 
+            // Check features
+            VkPhysicalDeviceVulkan12Features supportedFeatures12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+            VkPhysicalDeviceFeatures2 supportedFeatures2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+            supportedFeatures2.pNext = &supportedFeatures12;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+
+            // The packed RT targets are written as storage images declared without a format
+            if (!supportedFeatures2.features.shaderStorageImageWriteWithoutFormat) {
+                VkPhysicalDeviceProperties deviceProperties;
+                vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+                std::cout << "VulkanDeviceManager::Init() skipping " << deviceProperties.deviceName << ", shaderStorageImageWriteWithoutFormat is not supported\n";
+                continue;
+            }
+
             // This device is usable
             g_physicalDevice = physicalDevice;
             g_graphicsQueueFamily = graphicsFam;
 
+            std::vector<const char*> enabledExtensions = requiredExtensions;
+            for (const char* ext : optionalExtensions) {
+                if (IsExtensionAvailable(available, ext)) enabledExtensions.push_back(ext);
+            }
+            g_memoryBudgetSupported = IsExtensionAvailable(available, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+            // Optional, the GBuffer falls back to culling and drawing from the CPU without them. The cull shader
+            // writes the instance index into firstInstance, which needs drawIndirectFirstInstance.
+            g_drawIndirectCountSupported = supportedFeatures2.features.multiDrawIndirect && supportedFeatures2.features.drawIndirectFirstInstance && supportedFeatures12.drawIndirectCount;
+            if (!g_drawIndirectCountSupported) {
+                std::cout << "VulkanDeviceManager::Init() multiDrawIndirect, drawIndirectFirstInstance or drawIndirectCount not supported, GBuffer culling runs on the CPU\n";
+            }
+
             // Enable features
             VkPhysicalDeviceFeatures features{};
             features.samplerAnisotropy = VK_TRUE;
             features.shaderInt64 = VK_TRUE;
+            features.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+            features.multiDrawIndirect = g_drawIndirectCountSupported;
+            features.drawIndirectFirstInstance = g_drawIndirectCountSupported;
 
             VkPhysicalDeviceVulkan12Features features12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
             features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
@@ -109,6 +155,7 @@ namespace VulkanDeviceManager {
             features12.descriptorIndexing = VK_TRUE;
             features12.bufferDeviceAddress = VK_TRUE;
             features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            features12.drawIndirectCount = g_drawIndirectCountSupported;
 
             VkPhysicalDeviceRayTracingPipelineFeaturesKHR rtPipeline{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR };
             rtPipeline.rayTracingPipeline = VK_TRUE;
@@ -141,8 +188,8 @@ namespace VulkanDeviceManager {
             VkDeviceCreateInfo dci{ VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
             dci.queueCreateInfoCount = (uint32_t)qInfos.size();
             dci.pQueueCreateInfos = qInfos.data();
-            dci.enabledExtensionCount = (uint32_t)requiredExtensions.size();
-            dci.ppEnabledExtensionNames = requiredExtensions.data();
+            dci.enabledExtensionCount = (uint32_t)enabledExtensions.size();
+            dci.ppEnabledExtensionNames = enabledExtensions.data();
             dci.pNext = &features2;
 
             // Properties
@@ -215,6 +262,13 @@ namespace VulkanDeviceManager {
         vkGetPhysicalDeviceFeatures2(g_physicalDevice, &g_features2);
     }
 
+    bool IsExtensionAvailable(const std::vector<VkExtensionProperties>& available, const char* name) {
+        for (const VkExtensionProperties& extension : available) {
+            if (strcmp(name, extension.extensionName) == 0) return true;
+        }
+        return false;
+    }
+
     void Cleanup() {
         if (g_device != VK_NULL_HANDLE) {
             vkDestroyDevice(g_device, nullptr);
@@ -244,4 +298,6 @@ namespace VulkanDeviceManager {
     const VkPhysicalDeviceRayTracingPipelinePropertiesKHR& GetRayTracingPipelineProperties() { return g_rayTracingPipelineProperties; }
     const VkPhysicalDeviceAccelerationStructureFeaturesKHR& GetAccelerationStructureFeatures() { return g_accelerationStructureFeatures; }
     const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() { return g_memoryProperties; }
+    bool IsMemoryBudgetSupported() { return g_memoryBudgetSupported; }
+    bool IsDrawIndirectCountSupported() { return g_drawIndirectCountSupported; }
 }
@@ -15,4 +15,6 @@ namespace VulkanDeviceManager {
     const VkPhysicalDeviceRayTracingPipelinePropertiesKHR& GetRayTracingPipelineProperties();
     const VkPhysicalDeviceAccelerationStructureFeaturesKHR& GetAccelerationStructureFeatures();
     const VkPhysicalDeviceMemoryProperties& GetMemoryProperties();
+    bool IsMemoryBudgetSupported();
+    bool IsDrawIndirectCountSupported(); // multiDrawIndirect, drawIndirectFirstInstance and drawIndirectCount
 }
@@ -0,0 +1,126 @@
+#include "vk_dynamic_resolution_manager.h"
+#include "vk_resource_manager.h"
+#include "vk_timestamp_manager.h"
+
+#include "Hell/Core/Logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace VulkanDynamicResolutionManager {
+    constexpr float MIN_RENDER_SCALE = 0.5f;
+    constexpr float MAX_RENDER_SCALE = 1.0f;
+    constexpr float MAX_SCALE_STEP = 0.1f;          // Largest change per adjustment, keeps a single spike from halving the resolution
+    constexpr float OVER_BUDGET_THRESHOLD = 1.0f;   // Shrink once the smoothed GPU time exceeds the target
+    constexpr float UNDER_BUDGET_THRESHOLD = 0.85f; // Grow only once there is clear headroom, the gap between the two is the hysteresis
+    constexpr float SMOOTHING = 0.1f;
+    constexpr uint32_t ADJUSTMENT_COOLDOWN_FRAMES = 8; // Timestamps lag by FRAME_OVERLAP, wait until a change has been measured
+    constexpr uint32_t EXTENT_ALIGNMENT = 8;
+
+    // Passes whose cost follows the traced pixel count, everything else is treated as a fixed cost
+    const char* g_scaledScopes[] = { "Path Trace", "Inventory Trace" };
+    const char* g_fixedScopes[] = { "GBuffer Cull", "GBuffer", "Laptop Background", "Laptop Display", "Denoise", "Composite", "Composite Blit", "UI", "Present Blit", "Present Readback" };
+
+    VkExtent2D g_maxExtent = { 0, 0 };
+    VkExtent2D g_renderExtent = { 0, 0 };
+    float g_renderScale = MAX_RENDER_SCALE;
+    float g_targetFrameTime = 1000.0f / 60.0f;
+    float g_smoothedScaledTime = 0.0f;
+    float g_smoothedFixedTime = 0.0f;
+    uint32_t g_framesSinceAdjustment = 0;
+    bool g_enabled = true;
+
+    void ApplyRenderScale(float scale);
+
+    bool Init() {
+        AllocatedImage* rtImage = VulkanResourceManager::GetAllocatedImage("RT_FirstHit_Color");
+        if (!rtImage) {
+            Logging::Error() << "VulkanDynamicResolutionManager::Init() failed, 'RT_FirstHit_Color' render target does not exist\n";
+            return false;
+        }
+
+        g_maxExtent = { (uint32_t)rtImage->GetWidth(), (uint32_t)rtImage->GetHeight() };
+        ApplyRenderScale(MAX_RENDER_SCALE);
+
+        std::cout << "VulkanDynamicResolutionManager::Init()\n";
+        return true;
+    }
+
+    void Update() {
+        g_framesSinceAdjustment++;
+
+        if (!g_enabled || !VulkanTimestampManager::IsSupported()) {
+            if (g_renderScale != MAX_RENDER_SCALE) ApplyRenderScale(MAX_RENDER_SCALE);
+            return;
+        }
+
+        float scaledTime = 0.0f;
+        float fixedTime = 0.0f;
+        for (const char* scope : g_scaledScopes) scaledTime += VulkanTimestampManager::GetLastFrameTime(scope);
+        for (const char* scope : g_fixedScopes) fixedTime += VulkanTimestampManager::GetLastFrameTime(scope);
+        if (scaledTime <= 0.0f) return;
+
+        g_smoothedScaledTime = (g_smoothedScaledTime == 0.0f) ? scaledTime : glm::mix(g_smoothedScaledTime, scaledTime, SMOOTHING);
+        g_smoothedFixedTime = (g_smoothedFixedTime == 0.0f) ? fixedTime : glm::mix(g_smoothedFixedTime, fixedTime, SMOOTHING);
+
+        if (g_framesSinceAdjustment < ADJUSTMENT_COOLDOWN_FRAMES) return;
+
+        float totalTime = g_smoothedScaledTime + g_smoothedFixedTime;
+        bool overBudget = totalTime > g_targetFrameTime * OVER_BUDGET_THRESHOLD;
+        bool underBudget = totalTime < g_targetFrameTime * UNDER_BUDGET_THRESHOLD;
+        if (!overBudget && !(underBudget && g_renderScale < MAX_RENDER_SCALE)) return;
+
+        // Trace cost scales with pixel count, so the scale per axis goes with the square root of the time ratio.
+        // Aim for the middle of the dead band so the next measurement doesn't immediately bounce back.
+        float budget = g_targetFrameTime * (OVER_BUDGET_THRESHOLD + UNDER_BUDGET_THRESHOLD) * 0.5f - g_smoothedFixedTime;
+        float desiredScale = g_renderScale * std::sqrt(std::max(budget, 0.0f) / g_smoothedScaledTime);
+        desiredScale = std::clamp(desiredScale, g_renderScale - MAX_SCALE_STEP, g_renderScale + MAX_SCALE_STEP);
+        desiredScale = std::clamp(desiredScale, MIN_RENDER_SCALE, MAX_RENDER_SCALE);
+
+        VkExtent2D previousExtent = g_renderExtent;
+        ApplyRenderScale(desiredScale);
+        if (g_renderExtent.width != previousExtent.width || g_renderExtent.height != previousExtent.height) {
+            // Old measurements describe the previous resolution
+            g_smoothedScaledTime *= (float)(g_renderExtent.width * g_renderExtent.height) / (float)(previousExtent.width * previousExtent.height);
+            g_framesSinceAdjustment = 0;
+        }
+    }
+
+    void SetEnabled(bool enabled) {
+        g_enabled = enabled;
+    }
+
+    bool IsEnabled() {
+        return g_enabled;
+    }
+
+    void SetTargetFrameTime(float milliseconds) {
+        g_targetFrameTime = std::max(milliseconds, 1.0f);
+    }
+
+    glm::vec2 GetRenderScale() {
+        if (g_maxExtent.width == 0 || g_maxExtent.height == 0) return glm::vec2(1.0f);
+        return glm::vec2((float)g_renderExtent.width / g_maxExtent.width, (float)g_renderExtent.height / g_maxExtent.height);
+    }
+
+    VkExtent2D GetRenderExtent() {
+        return g_renderExtent;
+    }
+
+    VkExtent2D GetMaxRenderExtent() {
+        return g_maxExtent;
+    }
+
+    void ApplyRenderScale(float scale) {
+        g_renderScale = scale;
+
+        auto alignedDimension = [](uint32_t maxDimension, float scale) {
+            uint32_t dimension = (uint32_t)(maxDimension * scale + 0.5f);
+            dimension = (dimension + EXTENT_ALIGNMENT - 1) / EXTENT_ALIGNMENT * EXTENT_ALIGNMENT;
+            return std::clamp(dimension, std::min(EXTENT_ALIGNMENT, maxDimension), maxDimension);
+        };
+        g_renderExtent.width = alignedDimension(g_maxExtent.width, scale);
+        g_renderExtent.height = alignedDimension(g_maxExtent.height, scale);
+    }
+}
\ No newline at end of file
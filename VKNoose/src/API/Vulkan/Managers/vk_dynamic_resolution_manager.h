@@ -0,0 +1,21 @@
+#pragma once
+#include "API/Vulkan/vk_common.h"
+#include <glm/glm.hpp>
+
+namespace VulkanDynamicResolutionManager {
+    bool Init();
+
+    // Adjusts the render scale from the latest GPU timestamps. Call once per frame before the camera data is uploaded.
+    void Update();
+
+    void SetEnabled(bool enabled);
+    bool IsEnabled();
+    void SetTargetFrameTime(float milliseconds);
+
+    // Fraction of the full RT target size currently traced, per axis
+    glm::vec2 GetRenderScale();
+
+    // Trace dimensions, the top left corner of the RT targets is written and the rest is stale
+    VkExtent2D GetRenderExtent();
+    VkExtent2D GetMaxRenderExtent();
+}
\ No newline at end of file
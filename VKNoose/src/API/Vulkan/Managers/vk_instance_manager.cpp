@@ -28,13 +28,14 @@ namespace VulkanInstanceManager {
             return false;
         }
 
-        // Gather required extensions from GLFW
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
+        // Gather required extensions from GLFW, headless runs have no surface so need none
         std::vector<const char*> instanceExtensions;
-        for (uint32_t i = 0; i < glfwExtensionCount; ++i) {
-            instanceExtensions.push_back(glfwExtensions[i]);
+        if (!GLFWIntegration::IsHeadless()) {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            for (uint32_t i = 0; i < glfwExtensionCount; ++i) {
+                instanceExtensions.push_back(glfwExtensions[i]);
+            }
         }
 
         if (g_validationEnabled) {
@@ -106,6 +107,10 @@ namespace VulkanInstanceManager {
             }
         }
 
+        if (GLFWIntegration::IsHeadless()) {
+            return true;
+        }
+
         GLFWwindow* window = static_cast<GLFWwindow*>(GLFWIntegration::GetWindowPointer());
         if (glfwCreateWindowSurface(g_instance, window, nullptr, &g_surface) != VK_SUCCESS) {
             return false;
@@ -4,23 +4,60 @@
 #include "vk_memory_manager.h"
 #include "vk_device_manager.h"
 #include "vk_instance_manager.h"
+#include "vk_command_manager.h"
+
+#include "Hell/Core/Logging.h"
 
 #include <vector>
 #include <set>
 #include <cstring>
 #include <stdexcept>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <iomanip>
+#include <unordered_map>
+#include <algorithm>
 
 namespace VulkanMemoryManager {
+    constexpr VkDeviceSize MB = 1024 * 1024;
+
+    // Keep each pass short enough to hide behind a loading frame
+    constexpr VkDeviceSize DEFRAG_MAX_BYTES_PER_PASS = 32 * MB;
+    constexpr uint32_t DEFRAG_MAX_ALLOCATIONS_PER_PASS = 16;
+
+    struct TrackedAllocation {
+        MemoryCategory category = MemoryCategory::OTHER;
+        VkDeviceSize size = 0;
+    };
+
+    struct CategoryState {
+        VkDeviceSize usage = 0;
+        VkDeviceSize budget = 0;
+        bool overBudget = false;
+        DefragmentationHandler defragHandler;
+    };
+
     VmaAllocator g_allocator = VK_NULL_HANDLE;
     VkDescriptorPool g_descriptorPool = VK_NULL_HANDLE;
 
+    std::mutex g_trackingMutex;
+    std::unordered_map<VmaAllocation, TrackedAllocation> g_trackedAllocations;
+    CategoryState g_categories[(int)MemoryCategory::COUNT];
+    bool g_heapOverBudget[VK_MAX_MEMORY_HEAPS] = {};
+
+    uint32_t g_defragmentedAllocationCount = 0;
+    VkDeviceSize g_defragmentedBytes = 0;
+
     bool CreateAllocator();
     bool CreateDescriptorPool();
+    void SetDefaultCategoryBudgets();
+    std::string ToMegabytes(VkDeviceSize bytes);
 
     bool Init() {
         if (!CreateAllocator())      return false;
         if (!CreateDescriptorPool()) return false;
+        SetDefaultCategoryBudgets();
         return true;
     }
 
@@ -38,8 +75,13 @@ namespace VulkanMemoryManager {
         allocatorInfo.physicalDevice = physicalDevice;
         allocatorInfo.device = device;
         allocatorInfo.pVulkanFunctions = &vulkanFunctions;
+        allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
         allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
 
+        if (VulkanDeviceManager::IsMemoryBudgetSupported()) {
+            allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+        }
+
         VkResult result = vmaCreateAllocator(&allocatorInfo, &g_allocator);
         return result == VK_SUCCESS;
     }
@@ -96,9 +138,228 @@ namespace VulkanMemoryManager {
         return true;
     }
 
+    void SetDefaultCategoryBudgets() {
+        SetCategoryBudget(MemoryCategory::GEOMETRY, 512 * MB);
+        SetCategoryBudget(MemoryCategory::TEXTURES, 1024 * MB);
+        SetCategoryBudget(MemoryCategory::ACCELERATION_STRUCTURES, 512 * MB);
+        SetCategoryBudget(MemoryCategory::RENDER_TARGETS, 768 * MB);
+        SetCategoryBudget(MemoryCategory::STAGING, 256 * MB);
+        SetCategoryBudget(MemoryCategory::OTHER, 256 * MB);
+    }
+
+    void BeginFrame(uint64_t frameNumber) {
+        if (g_allocator == VK_NULL_HANDLE) return;
+
+        vmaSetCurrentFrameIndex(g_allocator, (uint32_t)frameNumber);
+
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+        vmaGetHeapBudgets(g_allocator, budgets);
+
+        const VkPhysicalDeviceMemoryProperties& memoryProperties = VulkanDeviceManager::GetMemoryProperties();
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+            bool overBudget = budgets[i].budget > 0 && budgets[i].usage > budgets[i].budget;
+            if (overBudget && !g_heapOverBudget[i]) {
+                Logging::Warning() << "VulkanMemoryManager: heap " << i << " is over budget, " << ToMegabytes(budgets[i].usage) << " of " << ToMegabytes(budgets[i].budget) << "\n";
+            }
+            g_heapOverBudget[i] = overBudget;
+        }
+    }
+
+    void TrackAllocation(VmaAllocation allocation, MemoryCategory category) {
+        if (allocation == VK_NULL_HANDLE) return;
+
+        VmaAllocationInfo allocationInfo;
+        vmaGetAllocationInfo(g_allocator, allocation, &allocationInfo);
+
+        std::lock_guard<std::mutex> lock(g_trackingMutex);
+        TrackedAllocation& trackedAllocation = g_trackedAllocations[allocation];
+        trackedAllocation.category = category;
+        trackedAllocation.size = allocationInfo.size;
+
+        CategoryState& state = g_categories[(int)category];
+        state.usage += allocationInfo.size;
+
+        // Warn once on the way over, re-arm when usage drops back under
+        if (state.budget > 0 && state.usage > state.budget && !state.overBudget) {
+            Logging::Warning() << "VulkanMemoryManager: " << GetCategoryName(category) << " over budget, " << ToMegabytes(state.usage) << " of " << ToMegabytes(state.budget) << "\n";
+            state.overBudget = true;
+        }
+    }
+
+    void UntrackAllocation(VmaAllocation allocation) {
+        if (allocation == VK_NULL_HANDLE) return;
+
+        std::lock_guard<std::mutex> lock(g_trackingMutex);
+        auto it = g_trackedAllocations.find(allocation);
+        if (it == g_trackedAllocations.end()) return;
+
+        CategoryState& state = g_categories[(int)it->second.category];
+        state.usage -= it->second.size;
+        if (state.usage <= state.budget) {
+            state.overBudget = false;
+        }
+        g_trackedAllocations.erase(it);
+    }
+
+    void SetCategoryBudget(MemoryCategory category, VkDeviceSize budget) {
+        std::lock_guard<std::mutex> lock(g_trackingMutex);
+        g_categories[(int)category].budget = budget;
+    }
+
+    VkDeviceSize GetCategoryUsage(MemoryCategory category) {
+        std::lock_guard<std::mutex> lock(g_trackingMutex);
+        return g_categories[(int)category].usage;
+    }
+
+    VkDeviceSize GetCategoryBudget(MemoryCategory category) {
+        std::lock_guard<std::mutex> lock(g_trackingMutex);
+        return g_categories[(int)category].budget;
+    }
+
+    const char* GetCategoryName(MemoryCategory category) {
+        switch (category) {
+            case MemoryCategory::GEOMETRY:                return "Geometry";
+            case MemoryCategory::TEXTURES:                return "Textures";
+            case MemoryCategory::ACCELERATION_STRUCTURES: return "Acceleration structures";
+            case MemoryCategory::RENDER_TARGETS:          return "Render targets";
+            case MemoryCategory::STAGING:                 return "Staging";
+            default:                                      return "Other";
+        }
+    }
+
+    void SetDefragmentationHandler(MemoryCategory category, DefragmentationHandler handler) {
+        g_categories[(int)category].defragHandler = std::move(handler);
+    }
+
+    bool StepDefragmentation() {
+        VmaDefragmentationInfo defragInfo{};
+        defragInfo.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_FAST_BIT;
+        defragInfo.maxBytesPerPass = DEFRAG_MAX_BYTES_PER_PASS;
+        defragInfo.maxAllocationsPerPass = DEFRAG_MAX_ALLOCATIONS_PER_PASS;
+
+        VmaDefragmentationContext context = VK_NULL_HANDLE;
+        if (vmaBeginDefragmentation(g_allocator, &defragInfo, &context) != VK_SUCCESS) return false;
+
+        VmaDefragmentationPassMoveInfo pass{};
+        if (vmaBeginDefragmentationPass(g_allocator, context, &pass) == VK_SUCCESS) {
+            // Nothing left to move
+            vmaEndDefragmentation(g_allocator, context, nullptr);
+            return false;
+        }
+
+        // Only allocations whose owner registered a handler can move, the rest stay put.
+        // Resolve the handlers up front so the callbacks are free to track new allocations.
+        std::vector<DefragmentationHandler*> handlers(pass.moveCount, nullptr);
+        {
+            std::lock_guard<std::mutex> lock(g_trackingMutex);
+            for (uint32_t i = 0; i < pass.moveCount; i++) {
+                auto it = g_trackedAllocations.find(pass.pMoves[i].srcAllocation);
+                if (it == g_trackedAllocations.end()) continue;
+
+                DefragmentationHandler& handler = g_categories[(int)it->second.category].defragHandler;
+                if (handler.beginMove && handler.endMove) {
+                    handlers[i] = &handler;
+                }
+            }
+        }
+
+        uint32_t movedCount = 0;
+        VkDeviceSize movedBytes = 0;
+
+        VulkanCommandManager::SubmitImmediate([&](VkCommandBuffer cmd) {
+            for (uint32_t i = 0; i < pass.moveCount; i++) {
+                VmaDefragmentationMove& move = pass.pMoves[i];
+                if (!handlers[i] || !handlers[i]->beginMove(move.srcAllocation, move.dstTmpAllocation, cmd)) {
+                    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                    handlers[i] = nullptr;
+                }
+            }
+        });
+
+        // Frames still in flight may reference the old resources
+        if (std::any_of(handlers.begin(), handlers.end(), [](DefragmentationHandler* handler) { return handler != nullptr; })) {
+            vkDeviceWaitIdle(VulkanDeviceManager::GetDevice());
+        }
+
+        for (uint32_t i = 0; i < pass.moveCount; i++) {
+            if (!handlers[i]) continue;
+
+            handlers[i]->endMove(pass.pMoves[i].srcAllocation);
+
+            VmaAllocationInfo allocationInfo;
+            vmaGetAllocationInfo(g_allocator, pass.pMoves[i].srcAllocation, &allocationInfo);
+            movedCount++;
+            movedBytes += allocationInfo.size;
+        }
+
+        vmaEndDefragmentationPass(g_allocator, context, &pass);
+        vmaEndDefragmentation(g_allocator, context, nullptr);
+
+        g_defragmentedAllocationCount += movedCount;
+        g_defragmentedBytes += movedBytes;
+        return movedCount > 0;
+    }
+
+    std::vector<std::string> GetStatisticsText() {
+        std::vector<std::string> lines;
+        if (g_allocator == VK_NULL_HANDLE) return lines;
+
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+        vmaGetHeapBudgets(g_allocator, budgets);
+
+        VmaTotalStatistics stats;
+        vmaCalculateStatistics(g_allocator, &stats);
+
+        lines.push_back(VulkanDeviceManager::IsMemoryBudgetSupported() ? "Memory budget: VK_EXT_memory_budget" : "Memory budget: estimated, VK_EXT_memory_budget not supported");
+
+        const VkPhysicalDeviceMemoryProperties& memoryProperties = VulkanDeviceManager::GetMemoryProperties();
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+            const VmaDetailedStatistics& heapStats = stats.memoryHeap[i];
+            if (heapStats.statistics.blockCount == 0 && budgets[i].usage == 0) continue;
+
+            bool deviceLocal = memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+            std::string line = "Heap " + std::to_string(i) + (deviceLocal ? " (device): " : " (host): ");
+            line += ToMegabytes(budgets[i].usage) + " / " + ToMegabytes(budgets[i].budget);
+            line += "  " + std::to_string(heapStats.statistics.blockCount) + " blocks, " + std::to_string(heapStats.statistics.allocationCount) + " allocs";
+            lines.push_back(line);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(g_trackingMutex);
+            for (int i = 0; i < (int)MemoryCategory::COUNT; i++) {
+                const CategoryState& state = g_categories[i];
+                std::string line = std::string(GetCategoryName((MemoryCategory)i)) + ": " + ToMegabytes(state.usage) + " / " + ToMegabytes(state.budget);
+                if (state.overBudget) line += "  OVER BUDGET";
+                lines.push_back(line);
+            }
+        }
+
+        const VmaDetailedStatistics& total = stats.total;
+        VkDeviceSize unusedBytes = total.statistics.blockBytes - total.statistics.allocationBytes;
+        VkDeviceSize largestUnusedRange = (total.unusedRangeCount > 0) ? total.unusedRangeSizeMax : 0;
+        lines.push_back("Unused in blocks: " + ToMegabytes(unusedBytes) + " in " + std::to_string(total.unusedRangeCount) + " ranges, largest " + ToMegabytes(largestUnusedRange));
+        lines.push_back("Defragmented: " + std::to_string(g_defragmentedAllocationCount) + " allocs, " + ToMegabytes(g_defragmentedBytes));
+
+        return lines;
+    }
+
+    std::string ToMegabytes(VkDeviceSize bytes) {
+        std::ostringstream stream;
+        stream << std::fixed << std::setprecision(1) << (double)bytes / (double)MB << "MB";
+        return stream.str();
+    }
+
     void Cleanup() {
         VkDevice device = VulkanDeviceManager::GetDevice();
 
+        {
+            std::lock_guard<std::mutex> lock(g_trackingMutex);
+            g_trackedAllocations.clear();
+            for (CategoryState& state : g_categories) {
+                state = CategoryState();
+            }
+        }
+
         if (g_allocator != VK_NULL_HANDLE) {
             vmaDestroyAllocator(g_allocator);
             g_allocator = VK_NULL_HANDLE;
@@ -1,10 +1,47 @@
 #pragma once
 #include "API/Vulkan/vk_common.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class MemoryCategory {
+    GEOMETRY,
+    TEXTURES,
+    ACCELERATION_STRUCTURES,
+    RENDER_TARGETS,
+    STAGING,
+    OTHER,
+    COUNT
+};
 
 namespace VulkanMemoryManager {
+    // Called while a defragmentation pass is open. beginMove creates the replacement resource bound to
+    // 'dstAllocation' and records the copy, returning false leaves the allocation where it is.
+    // endMove runs once the copy has completed and the device is idle, it destroys the old resource.
+    struct DefragmentationHandler {
+        std::function<bool(VmaAllocation srcAllocation, VmaAllocation dstAllocation, VkCommandBuffer cmd)> beginMove = nullptr;
+        std::function<void(VmaAllocation srcAllocation)> endMove = nullptr;
+    };
+
     bool Init();
     void Cleanup();
 
+    // Refreshes the VK_EXT_memory_budget numbers and warns when a heap goes over budget
+    void BeginFrame(uint64_t frameNumber);
+
+    void TrackAllocation(VmaAllocation allocation, MemoryCategory category);
+    void UntrackAllocation(VmaAllocation allocation);
+    void SetCategoryBudget(MemoryCategory category, VkDeviceSize budget);
+    VkDeviceSize GetCategoryUsage(MemoryCategory category);
+    VkDeviceSize GetCategoryBudget(MemoryCategory category);
+    const char* GetCategoryName(MemoryCategory category);
+
+    // Runs one incremental pass over the default pools, returns true if anything moved
+    void SetDefragmentationHandler(MemoryCategory category, DefragmentationHandler handler);
+    bool StepDefragmentation();
+
+    std::vector<std::string> GetStatisticsText();
+
     VkDescriptorPool GetDescriptorPool();
     VmaAllocator GetAllocator();
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "vk_pipeline_cache_manager.h"
+#include "vk_device_manager.h"
+#include "xxhash.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace VulkanPipelineCacheManager {
+    constexpr uint32_t CACHE_FILE_MAGIC = 0x4348434E; // "NCHC"
+    constexpr uint32_t CACHE_FILE_VERSION = 1;
+    const std::string CACHE_PATH = "res/shaders/cache/pipeline_cache.bin";
+
+    // Our own header in front of the driver blob. The driver header has no driver version,
+    // and a blob from an older driver is legal to load but just as useless as a foreign one.
+    struct CacheFileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    VkPipelineCache g_pipelineCache = VK_NULL_HANDLE;
+    VkPipelineCreationFeedback g_pipelineFeedback = {};
+    VkPipelineCreationFeedbackCreateInfo g_feedbackCreateInfo = {};
+    uint32_t g_pipelinesCreated = 0;
+    uint32_t g_pipelineCacheHits = 0;
+
+    CacheFileHeader CreateHeader(uint64_t dataSize, uint64_t dataHash);
+    std::vector<char> LoadCacheData();
+
+    bool Init() {
+        std::vector<char> initialData = LoadCacheData();
+
+        VkPipelineCacheCreateInfo createInfo{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+        createInfo.initialDataSize = initialData.size();
+        createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+        if (vkCreatePipelineCache(VulkanDeviceManager::GetDevice(), &createInfo, nullptr, &g_pipelineCache) != VK_SUCCESS) {
+            // A rejected blob shouldn't cost us the cache entirely
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData = nullptr;
+            if (vkCreatePipelineCache(VulkanDeviceManager::GetDevice(), &createInfo, nullptr, &g_pipelineCache) != VK_SUCCESS) {
+                std::cerr << "[Pipeline Cache] Failed to create pipeline cache\n";
+                return false;
+            }
+        }
+
+        std::cout << "VulkanPipelineCacheManager::Init() loaded " << initialData.size() << " bytes\n";
+        return true;
+    }
+
+    void Cleanup() {
+        if (g_pipelineCache == VK_NULL_HANDLE) return;
+
+        Save();
+        vkDestroyPipelineCache(VulkanDeviceManager::GetDevice(), g_pipelineCache, nullptr);
+        g_pipelineCache = VK_NULL_HANDLE;
+    }
+
+    VkPipelineCache GetPipelineCache() {
+        return g_pipelineCache;
+    }
+
+    void Save() {
+        if (g_pipelineCache == VK_NULL_HANDLE) return;
+
+        VkDevice device = VulkanDeviceManager::GetDevice();
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(device, g_pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) return;
+
+        std::vector<char> data(dataSize);
+        if (vkGetPipelineCacheData(device, g_pipelineCache, &dataSize, data.data()) != VK_SUCCESS) return;
+
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(CACHE_PATH).parent_path(), error);
+
+        CacheFileHeader header = CreateHeader(dataSize, XXH64(data.data(), dataSize, 0));
+        std::string tempPath = CACHE_PATH + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cerr << "[Pipeline Cache] Could not write " << tempPath << "\n";
+                return;
+            }
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(data.data(), dataSize);
+        }
+        std::filesystem::rename(tempPath, CACHE_PATH, error);
+
+        std::cout << "[Pipeline Cache] Saved " << dataSize << " bytes, " << g_pipelineCacheHits << "/" << g_pipelinesCreated << " pipelines hit the cache this run\n";
+    }
+
+    VkPipelineCreationFeedbackCreateInfo* BeginPipelineCreation(const void* pNext) {
+        g_pipelineFeedback = {};
+        g_feedbackCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO };
+        g_feedbackCreateInfo.pNext = pNext;
+        g_feedbackCreateInfo.pPipelineCreationFeedback = &g_pipelineFeedback;
+        return &g_feedbackCreateInfo;
+    }
+
+    void LogPipelineCreation(const std::string& name, float milliseconds) {
+        g_pipelinesCreated++;
+
+        std::string result = "no feedback";
+        if (g_pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT) {
+            bool hit = g_pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT;
+            if (hit) g_pipelineCacheHits++;
+            result = hit ? "cache hit" : "cache miss";
+        }
+        std::cout << "[Pipeline Cache] " << name << " created in " << milliseconds << "ms (" << result << ")\n";
+    }
+
+    CacheFileHeader CreateHeader(uint64_t dataSize, uint64_t dataHash) {
+        const VkPhysicalDeviceProperties& properties = VulkanDeviceManager::GetProperties();
+
+        CacheFileHeader header = {};
+        header.magic = CACHE_FILE_MAGIC;
+        header.version = CACHE_FILE_VERSION;
+        header.vendorID = properties.vendorID;
+        header.deviceID = properties.deviceID;
+        header.driverVersion = properties.driverVersion;
+        memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+        header.dataSize = dataSize;
+        header.dataHash = dataHash;
+        return header;
+    }
+
+    std::vector<char> LoadCacheData() {
+        std::ifstream file(CACHE_PATH, std::ios::binary);
+        if (!file.is_open()) return {};
+
+        CacheFileHeader header = {};
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return {};
+
+        CacheFileHeader expected = CreateHeader(header.dataSize, header.dataHash);
+        if (header.magic != expected.magic ||
+            header.version != expected.version ||
+            header.vendorID != expected.vendorID ||
+            header.deviceID != expected.deviceID ||
+            header.driverVersion != expected.driverVersion ||
+            memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            std::cout << "[Pipeline Cache] Ignoring " << CACHE_PATH << ", it was created by a different device or driver\n";
+            return {};
+        }
+
+        std::vector<char> data(header.dataSize);
+        if (!file.read(data.data(), header.dataSize) || XXH64(data.data(), data.size(), 0) != header.dataHash) {
+            std::cout << "[Pipeline Cache] Ignoring " << CACHE_PATH << ", it is corrupt\n";
+            return {};
+        }
+        return data;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+#include "API/Vulkan/vk_common.h"
+#include <string>
+
+namespace VulkanPipelineCacheManager {
+    bool Init();
+    void Cleanup();
+
+    VkPipelineCache GetPipelineCache();
+    void Save();
+
+    // Chain the returned struct into a pipeline create info's pNext, then pass it back to LogPipelineCreation
+    VkPipelineCreationFeedbackCreateInfo* BeginPipelineCreation(const void* pNext);
+    void LogPipelineCreation(const std::string& name, float milliseconds);
+}
\ No newline at end of file
@@ -1,16 +1,29 @@
 #include "vk_pipeline_manager.h"
+#include "API/Vulkan/Managers/vk_culling_manager.h"
 #include "API/Vulkan/Managers/vk_resource_manager.h"
 #include "API/Vulkan/Managers/vk_descriptor_manager.h"
 #include "API/Vulkan/Managers/vk_device_manager.h"
 #include "API/Vulkan/Renderer/vk_renderer.h"
 #include "Hell/Types.h"
 
+#include <algorithm>
 #include <iostream>
 
 namespace VulkanPipelineManager {
 
     std::unordered_map<std::string, VulkanPipeline> g_pipelines;
 
+    void RetirePipeline(VulkanPipeline& pipeline) {
+        // Frames in flight may still be using the old pipeline, so it's destroyed once they've retired
+        if (pipeline.GetHandle() != VK_NULL_HANDLE) {
+            VkDevice device = VulkanDeviceManager::GetDevice();
+            VulkanRenderer::DeferDestroy([device, oldPipeline = pipeline]() mutable {
+                oldPipeline.Cleanup(device);
+            });
+        }
+        pipeline = VulkanPipeline();
+    }
+
     void CreateTextBlitterPipeline() {
         VkDevice device = VulkanDeviceManager::GetDevice();
         VulkanShader* shader = VulkanResourceManager::GetShader("TextBlitter");
@@ -21,7 +34,8 @@ namespace VulkanPipelineManager {
         }
 
         VulkanPipeline& pipeline = g_pipelines["TextBlitter"];
-        pipeline.Cleanup(device);
+        RetirePipeline(pipeline);
+        pipeline.SetName("TextBlitter");
 
         pipeline.PushDescriptorSetLayout(VulkanDescriptorManager::GetDynamicSetLayout());
         pipeline.PushDescriptorSetLayout(VulkanDescriptorManager::GetStaticSetLayout());
@@ -47,7 +61,8 @@ namespace VulkanPipelineManager {
         }
 
         VulkanPipeline& pipeline = g_pipelines["Lines"];
-        pipeline.Cleanup(device);
+        RetirePipeline(pipeline);
+        pipeline.SetName("Lines");
 
         pipeline.PushDescriptorSetLayout(VulkanDescriptorManager::GetDynamicSetLayout());
         pipeline.PushDescriptorSetLayout(VulkanDescriptorManager::GetStaticSetLayout());
@@ -70,7 +85,8 @@ namespace VulkanPipelineManager {
         if (!shader) return;
 
         VulkanPipeline& pipeline = g_pipelines["Composite"];
-        pipeline.Cleanup(device);
+        RetirePipeline(pipeline);
+        pipeline.SetName("Composite");
 
         pipeline.PushDescriptorSetLayout(VulkanDescriptorManager::GetDynamicSetLayout());
         pipeline.PushDescriptorSetLayout(VulkanDescriptorManager::GetStaticSetLayout());
@@ -89,10 +105,62 @@ namespace VulkanPipelineManager {
         pipeline.Build(device, shader->GetVertexShader(), shader->GetFragmentShader(), 1, VK_FORMAT_R8G8B8A8_UNORM);
     }
 
+    void CreateGBufferPipeline() {
+        VkDevice device = VulkanDeviceManager::GetDevice();
+        VulkanShader* shader = VulkanResourceManager::GetShader("GBuffer");
+        if (!shader) return;
+
+        VulkanPipeline& pipeline = g_pipelines["GBuffer"];
+        RetirePipeline(pipeline);
+        pipeline.SetName("GBuffer");
+
+        pipeline.PushDescriptorSetLayout(VulkanDescriptorManager::GetDynamicSetLayout());
+        pipeline.PushDescriptorSetLayout(VulkanDescriptorManager::GetStaticSetLayout());
+
+        pipeline.SetVertexDescription<Vertex>();
+        pipeline.SetTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        pipeline.SetCullMode(VK_CULL_MODE_NONE);
+        pipeline.SetFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE);
+        pipeline.SetColorBlending(false);
+        pipeline.SetDepthTest(true);
+        pipeline.SetDepthFormat(VK_FORMAT_D32_SFLOAT);
+
+        // BaseColor, Normal and RMA
+        pipeline.Build(device, shader->GetVertexShader(), shader->GetFragmentShader(), 3, VK_FORMAT_R8G8B8A8_UNORM);
+    }
+
+    void CreateGBufferCullPipeline() {
+        VkDevice device = VulkanDeviceManager::GetDevice();
+        VulkanShader* shader = VulkanResourceManager::GetShader("GBufferCull");
+        if (!shader) return;
+
+        VulkanPipeline& pipeline = g_pipelines["GBufferCull"];
+        RetirePipeline(pipeline);
+        pipeline.SetName("GBufferCull");
+
+        // Buffers are all passed by device address
+        pipeline.SetPushConstant(sizeof(VulkanCullingManager::CullPushConstants), VK_SHADER_STAGE_COMPUTE_BIT);
+
+        pipeline.BuildCompute(device, shader->GetComputeShader());
+    }
+
+    struct PipelineCreateInfo {
+        std::string shaderName;
+        void (*createFunction)();
+    };
+
+    const std::vector<PipelineCreateInfo> g_pipelineCreateInfos = {
+        { "TextBlitter", CreateTextBlitterPipeline },
+        { "SolidColor", CreateLinesPipeline },
+        { "Composite", CreateCompositePipeline },
+        { "GBuffer", CreateGBufferPipeline },
+        { "GBufferCull", CreateGBufferCullPipeline }
+    };
+
     bool Init() {
-        CreateTextBlitterPipeline();
-        CreateLinesPipeline();
-        CreateCompositePipeline();
+        for (const PipelineCreateInfo& createInfo : g_pipelineCreateInfos) {
+            createInfo.createFunction();
+        }
         std::cout << "[Pipeline Manager] Initialized\n";
 
         return true;
@@ -119,4 +187,12 @@ namespace VulkanPipelineManager {
         std::cout << "[Pipeline Manager] Reloading all pipelines...\n";
         Init();
     }
+
+    void ReloadPipelinesUsingShaders(const std::vector<std::string>& shaderNames) {
+        for (const PipelineCreateInfo& createInfo : g_pipelineCreateInfos) {
+            if (std::find(shaderNames.begin(), shaderNames.end(), createInfo.shaderName) != shaderNames.end()) {
+                createInfo.createFunction();
+            }
+        }
+    }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace VulkanPipelineManager {
     bool Init();
@@ -12,4 +13,5 @@ namespace VulkanPipelineManager {
     VulkanPipeline* GetPipeline(const std::string& name);
 
     void ReloadAll();
+    void ReloadPipelinesUsingShaders(const std::vector<std::string>& shaderNames);
 }
\ No newline at end of file
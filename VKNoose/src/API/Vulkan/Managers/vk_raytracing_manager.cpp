@@ -20,7 +20,7 @@ namespace VulkanRaytracingManager {
         accelerationStructure.m_buffer = VulkanBuffer(buildSizeInfo.accelerationStructureSize, usage, VMA_MEMORY_USAGE_AUTO);
     }
 
-    void CreateTopLevelAS(uint64_t id, const std::vector<VkAccelerationStructureInstanceKHR>& instances) {
+    void CreateTopLevelAS(uint64_t id, std::span<const VkAccelerationStructureInstanceKHR> instances) {
         VulkanAccelerationStructure* accelerationStructure = VulkanResourceManager::GetAccelerationStructure(id);
         if (!accelerationStructure) return;
 
@@ -86,20 +86,20 @@ namespace VulkanRaytracingManager {
         scratchBuffer.Cleanup();
     }
 
-    void CreateBottomLevelAS(uint64_t id, MeshOLD* mesh) {
+    void CreateBottomLevelAS(uint64_t id, MeshOLD* mesh, VkDeviceAddress vertexBufferAddress, VkDeviceAddress indexBufferAddress, VkDeviceAddress transformBufferAddress) {
         VulkanAccelerationStructure* accelerationStructure = VulkanResourceManager::GetAccelerationStructure(id);
         if (!accelerationStructure) return;
 
         VkDevice device = VulkanDeviceManager::GetDevice();
 
+        // Addresses are the base of the shared geometry buffers, the mesh's range is selected through the build range below
         VkDeviceOrHostAddressConstKHR vertexBufferDeviceAddress{};
         VkDeviceOrHostAddressConstKHR indexBufferDeviceAddress{};
         VkDeviceOrHostAddressConstKHR transformBufferDeviceAddress{};
-    
-        // Using your VulkanUtils helper to get addresses from the raw VkBuffer handles
-        vertexBufferDeviceAddress.deviceAddress = VulkanUtils::GetBufferDeviceAddress(device, mesh->m_vertexBufferOLD.m_buffer);
-        indexBufferDeviceAddress.deviceAddress = VulkanUtils::GetBufferDeviceAddress(device, mesh->m_indexBufferOLD.m_buffer);
-        transformBufferDeviceAddress.deviceAddress = VulkanUtils::GetBufferDeviceAddress(device, mesh->m_transformBufferOLD.m_buffer);
+        vertexBufferDeviceAddress.deviceAddress = vertexBufferAddress;
+        indexBufferDeviceAddress.deviceAddress = indexBufferAddress;
+        transformBufferDeviceAddress.deviceAddress = transformBufferAddress;
+        const bool indexed = mesh->m_indexCount > 0;
     
         // Standard geometry setup for triangles
         VkAccelerationStructureGeometryKHR geometry{ VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR };
@@ -110,8 +110,8 @@ namespace VulkanRaytracingManager {
         geometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
         geometry.geometry.triangles.maxVertex = mesh->m_vertexCount;
         geometry.geometry.triangles.vertexStride = sizeof(Vertex);
-        geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
-        geometry.geometry.triangles.indexData = indexBufferDeviceAddress;
+        geometry.geometry.triangles.indexType = indexed ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_NONE_KHR;
+        geometry.geometry.triangles.indexData = indexed ? indexBufferDeviceAddress : VkDeviceOrHostAddressConstKHR{};
         geometry.geometry.triangles.transformData = transformBufferDeviceAddress;
     
         VkAccelerationStructureBuildGeometryInfoKHR buildInfo{ VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR };
@@ -120,7 +120,7 @@ namespace VulkanRaytracingManager {
         buildInfo.geometryCount = 1;
         buildInfo.pGeometries = &geometry;
     
-        const uint32_t numTriangles = mesh->m_indexCount / 3;
+        const uint32_t numTriangles = indexed ? mesh->m_indexCount / 3 : mesh->m_vertexCount / 3;
         VkAccelerationStructureBuildSizesInfoKHR sizeInfo{ VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR };
         vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, &numTriangles, &sizeInfo);
     
@@ -141,7 +141,12 @@ namespace VulkanRaytracingManager {
         buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
         buildInfo.scratchData.deviceAddress = scratchBuffer.GetDeviceAddress();
     
-        VkAccelerationStructureBuildRangeInfoKHR rangeInfo{ numTriangles, 0, 0, 0 };
+        // Indices are local to the mesh, so firstVertex rebases them onto the mesh's vertices
+        VkAccelerationStructureBuildRangeInfoKHR rangeInfo{};
+        rangeInfo.primitiveCount = numTriangles;
+        rangeInfo.primitiveOffset = indexed ? mesh->m_indexOffset * sizeof(uint32_t) : mesh->m_vertexOffset * sizeof(Vertex);
+        rangeInfo.firstVertex = indexed ? mesh->m_vertexOffset : 0;
+        rangeInfo.transformOffset = 0;
         std::vector<VkAccelerationStructureBuildRangeInfoKHR*> pRangeInfos = { &rangeInfo };
     
         VulkanCommandManager::SubmitImmediate([&](VkCommandBuffer cmd) {
@@ -4,13 +4,14 @@
 #include "API/Vulkan/Types/vk_acceleration_structure.h"
 #include "API/Vulkan/Types/vk_buffer.h"
 #include "Types/Mesh.h" // use me when u can
+#include <span>
 
 // Forward declaration to avoid including the full mesh header here
 struct MeshOLD;
 
 namespace VulkanRaytracingManager {
-    void CreateTopLevelAS(uint64_t id, const std::vector<VkAccelerationStructureInstanceKHR>& instances);
-    void CreateBottomLevelAS(uint64_t id, MeshOLD* mesh);
+    void CreateTopLevelAS(uint64_t id, std::span<const VkAccelerationStructureInstanceKHR> instances);
+    void CreateBottomLevelAS(uint64_t id, MeshOLD* mesh, VkDeviceAddress vertexBufferAddress, VkDeviceAddress indexBufferAddress, VkDeviceAddress transformBufferAddress);
 
     // Helpers now return the new VulkanBuffer class
     VulkanBuffer CreateScratchBuffer(VkDeviceSize size);
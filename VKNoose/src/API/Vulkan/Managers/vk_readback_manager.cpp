@@ -0,0 +1,247 @@
+#include "vk_readback_manager.h"
+#include "API/Vulkan/Renderer/vk_renderer.h"
+#include "API/Vulkan/Types/vk_buffer.h"
+#include "API/Vulkan/vk_utils.h"
+
+#include "Hell/Constants.h"
+#include "Hell/Core/Logging.h"
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <iostream>
+
+namespace VulkanReadbackManager {
+    // Small readbacks (queries, small buffers) share a persistently mapped buffer per frame slot,
+    // anything that doesn't fit (screenshots, denoise inputs) borrows a buffer from a pool that is
+    // handed back once the callback has fired. Pooled buffers nobody has asked for in a while are freed.
+    constexpr VkDeviceSize SLOT_STAGING_SIZE = 64 * 1024;
+    constexpr VkDeviceSize SLOT_ALIGNMENT = 16;
+    constexpr uint64_t POOLED_BUFFER_IDLE_FRAMES = 300;
+
+    struct PooledBuffer {
+        VulkanBuffer buffer;
+        uint64_t lastUsedFrame = 0;
+        bool inUse = false;
+    };
+
+    struct PendingReadback {
+        std::string name;
+        ReadbackCallback callback = nullptr;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        PooledBuffer* pooledBuffer = nullptr;
+        bool retainResult = false;
+    };
+
+    struct ReadbackSlot {
+        VulkanBuffer stagingBuffer;
+        VkDeviceSize stagingOffset = 0;
+        uint64_t frameNumber = 0;
+        std::vector<PendingReadback> pending;
+    };
+
+    ReadbackSlot g_slots[FRAME_OVERLAP];
+    std::vector<std::unique_ptr<PooledBuffer>> g_bufferPool;
+    std::unordered_map<std::string, ReadbackResult> g_latestResults;
+    uint64_t g_lastCompletedFrameNumber = 0;
+
+    PendingReadback& AllocatePendingReadback(const std::string& name, VkDeviceSize size, ReadbackCallback callback, bool retainResult, VkBuffer& dstBuffer);
+    PooledBuffer* AcquirePooledBuffer(VkDeviceSize size);
+    void ReleaseIdlePooledBuffers();
+    void InsertHostReadBarrier(VkCommandBuffer cmd);
+
+    bool Init() {
+        for (ReadbackSlot& slot : g_slots) {
+            slot.stagingBuffer = VulkanBuffer(SLOT_STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+            if (slot.stagingBuffer.GetBuffer() == VK_NULL_HANDLE) {
+                Logging::Error() << "VulkanReadbackManager::Init() failed to create staging buffer\n";
+                return false;
+            }
+        }
+
+        std::cout << "VulkanReadbackManager::Init()\n";
+        return true;
+    }
+
+    void Cleanup() {
+        // Expects the device to be idle. Callbacks still pending are dropped.
+        for (ReadbackSlot& slot : g_slots) {
+            slot.pending.clear();
+            slot.stagingBuffer.Cleanup();
+            slot.stagingOffset = 0;
+        }
+        for (std::unique_ptr<PooledBuffer>& pooledBuffer : g_bufferPool) {
+            pooledBuffer->buffer.Cleanup();
+        }
+        g_bufferPool.clear();
+        g_latestResults.clear();
+    }
+
+    void RequestBufferReadback(VkCommandBuffer cmd, const std::string& name, VkBuffer srcBuffer, VkDeviceSize srcOffset, VkDeviceSize size, ReadbackCallback callback, bool retainResult) {
+        if (srcBuffer == VK_NULL_HANDLE || size == 0) return;
+
+        VkBuffer dstBuffer = VK_NULL_HANDLE;
+        PendingReadback& readback = AllocatePendingReadback(name, size, std::move(callback), retainResult, dstBuffer);
+
+        // Shader or transfer writes to the source must land before the copy reads it
+        VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        VkBufferCopy region = { srcOffset, readback.offset, size };
+        vkCmdCopyBuffer(cmd, srcBuffer, dstBuffer, 1, &region);
+
+        InsertHostReadBarrier(cmd);
+    }
+
+    void RequestImageReadback(VkCommandBuffer cmd, const std::string& name, AllocatedImage& image, ReadbackCallback callback, bool retainResult) {
+        VkExtent2D extent = { (uint32_t)image.GetWidth(), (uint32_t)image.GetHeight() };
+        RequestImageRegionReadback(cmd, name, image, extent, std::move(callback), retainResult);
+    }
+
+    void RequestImageRegionReadback(VkCommandBuffer cmd, const std::string& name, AllocatedImage& image, VkExtent2D extent, ReadbackCallback callback, bool retainResult) {
+        extent.width = std::min(extent.width, (uint32_t)image.GetWidth());
+        extent.height = std::min(extent.height, (uint32_t)image.GetHeight());
+        if (extent.width == 0 || extent.height == 0) return;
+
+        uint32_t bytesPerPixel = VulkanUtils::GetBytesPerPixel(image.GetFormat());
+        if (bytesPerPixel == 0) {
+            Logging::Error() << "VulkanReadbackManager::RequestImageReadback() unsupported format for '" << name << "'\n";
+            return;
+        }
+
+        VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * bytesPerPixel;
+
+        VkBuffer dstBuffer = VK_NULL_HANDLE;
+        PendingReadback& readback = AllocatePendingReadback(name, size, std::move(callback), retainResult, dstBuffer);
+
+        image.TransitionLayout(cmd, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = readback.offset;
+        region.imageSubresource = { VulkanUtils::GetImageAspectFlagsFromFormat(image.GetFormat()), 0, 0, 1 };
+        region.imageExtent = { extent.width, extent.height, 1 };
+        vkCmdCopyImageToBuffer(cmd, image.GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstBuffer, 1, &region);
+
+        InsertHostReadBarrier(cmd);
+    }
+
+    void ProcessCompletedFrame(uint32_t frameIndex) {
+        ReadbackSlot& slot = g_slots[frameIndex];
+
+        for (PendingReadback& readback : slot.pending) {
+            VulkanBuffer& buffer = readback.pooledBuffer ? readback.pooledBuffer->buffer : slot.stagingBuffer;
+
+            void* mappedData = nullptr;
+            buffer.Map(&mappedData);
+            buffer.Invalidate(readback.offset, readback.size);
+            const uint8_t* data = static_cast<const uint8_t*>(mappedData) + readback.offset;
+
+            if (readback.retainResult) {
+                ReadbackResult& result = g_latestResults[readback.name];
+                result.data.assign(data, data + readback.size);
+                result.frameNumber = slot.frameNumber;
+            }
+            if (readback.callback) {
+                readback.callback(data, readback.size, slot.frameNumber);
+            }
+            if (readback.pooledBuffer) {
+                readback.pooledBuffer->inUse = false;
+            }
+        }
+
+        if (!slot.pending.empty() && slot.frameNumber > g_lastCompletedFrameNumber) {
+            g_lastCompletedFrameNumber = slot.frameNumber;
+        }
+
+        slot.pending.clear();
+        slot.stagingOffset = 0;
+
+        ReleaseIdlePooledBuffers();
+    }
+
+    const ReadbackResult* GetLatestResult(const std::string& name) {
+        auto it = g_latestResults.find(name);
+        return (it != g_latestResults.end()) ? &it->second : nullptr;
+    }
+
+    bool GetResultAsOfFrame(const std::string& name, uint64_t frameNumber, ReadbackResult& result) {
+        const ReadbackResult* latest = GetLatestResult(name);
+        if (!latest || latest->frameNumber < frameNumber) return false;
+
+        result = *latest;
+        return true;
+    }
+
+    uint64_t GetLastCompletedFrameNumber() {
+        return g_lastCompletedFrameNumber;
+    }
+
+    PendingReadback& AllocatePendingReadback(const std::string& name, VkDeviceSize size, ReadbackCallback callback, bool retainResult, VkBuffer& dstBuffer) {
+        ReadbackSlot& slot = g_slots[VulkanRenderer::GetCurrentFrameIndex()];
+        slot.frameNumber = VulkanRenderer::GetFrameNumber();
+
+        PendingReadback& readback = slot.pending.emplace_back();
+        readback.name = name;
+        readback.callback = std::move(callback);
+        readback.size = size;
+        readback.retainResult = retainResult;
+
+        VkDeviceSize alignedOffset = (slot.stagingOffset + SLOT_ALIGNMENT - 1) & ~(SLOT_ALIGNMENT - 1);
+
+        if (alignedOffset + size <= slot.stagingBuffer.GetSize()) {
+            readback.offset = alignedOffset;
+            slot.stagingOffset = alignedOffset + size;
+            dstBuffer = slot.stagingBuffer.GetBuffer();
+        }
+        else {
+            readback.offset = 0;
+            readback.pooledBuffer = AcquirePooledBuffer(size);
+            dstBuffer = readback.pooledBuffer->buffer.GetBuffer();
+        }
+
+        return readback;
+    }
+
+    PooledBuffer* AcquirePooledBuffer(VkDeviceSize size) {
+        // Smallest free buffer that fits, readback sizes repeat from frame to frame so this is nearly always an exact match
+        PooledBuffer* bestFit = nullptr;
+        for (std::unique_ptr<PooledBuffer>& pooledBuffer : g_bufferPool) {
+            if (pooledBuffer->inUse || pooledBuffer->buffer.GetSize() < size) continue;
+            if (!bestFit || pooledBuffer->buffer.GetSize() < bestFit->buffer.GetSize()) {
+                bestFit = pooledBuffer.get();
+            }
+        }
+        if (!bestFit) {
+            bestFit = g_bufferPool.emplace_back(std::make_unique<PooledBuffer>()).get();
+            bestFit->buffer = VulkanBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        }
+        bestFit->inUse = true;
+        bestFit->lastUsedFrame = VulkanRenderer::GetFrameNumber();
+        return bestFit;
+    }
+
+    void ReleaseIdlePooledBuffers() {
+        uint64_t frameNumber = VulkanRenderer::GetFrameNumber();
+        for (size_t i = 0; i < g_bufferPool.size();) {
+            PooledBuffer& pooledBuffer = *g_bufferPool[i];
+            if (!pooledBuffer.inUse && frameNumber - pooledBuffer.lastUsedFrame > POOLED_BUFFER_IDLE_FRAMES) {
+                pooledBuffer.buffer.Cleanup();
+                g_bufferPool[i] = std::move(g_bufferPool.back());
+                g_bufferPool.pop_back();
+            }
+            else {
+                i++;
+            }
+        }
+    }
+
+    void InsertHostReadBarrier(VkCommandBuffer cmd) {
+        VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "API/Vulkan/vk_common.h"
+#include "API/Vulkan/Types/vk_allocated_image.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace VulkanReadbackManager {
+    struct ReadbackResult {
+        std::vector<uint8_t> data;
+        uint64_t frameNumber = 0;
+    };
+
+    // Invoked once the fence of the frame that recorded the copy has been observed as signalled.
+    // 'data' is only valid for the duration of the call.
+    typedef std::function<void(const void* data, VkDeviceSize size, uint64_t frameNumber)> ReadbackCallback;
+
+    bool Init();
+    void Cleanup();
+
+    // Record a GPU->host copy into the current frame's command buffer. Only readbacks with retainResult set keep a copy
+    // of their data for GetLatestResult(), everything else is handed to the callback and dropped.
+    void RequestBufferReadback(VkCommandBuffer cmd, const std::string& name, VkBuffer srcBuffer, VkDeviceSize srcOffset, VkDeviceSize size, ReadbackCallback callback = nullptr, bool retainResult = false);
+    void RequestImageReadback(VkCommandBuffer cmd, const std::string& name, AllocatedImage& image, ReadbackCallback callback = nullptr, bool retainResult = false);
+
+    // Reads back only the top left 'extent' texels of the image, tightly packed
+    void RequestImageRegionReadback(VkCommandBuffer cmd, const std::string& name, AllocatedImage& image, VkExtent2D extent, ReadbackCallback callback = nullptr, bool retainResult = false);
+
+    // Call right after the render fence for this frame slot has been waited on
+    void ProcessCompletedFrame(uint32_t frameIndex);
+
+    const ReadbackResult* GetLatestResult(const std::string& name);
+    bool GetResultAsOfFrame(const std::string& name, uint64_t frameNumber, ReadbackResult& result);
+    uint64_t GetLastCompletedFrameNumber();
+}
@@ -57,7 +57,7 @@ namespace VulkanResourceManager {
         return g_accelerationStructures.get(id);
     }
 
-    AllocatedImage& CreateAllocatedImage(const std::string& name, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage) {
+    AllocatedImage& CreateAllocatedImage(const std::string& name, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, bool transient) {
         if (width == 0 || height == 0) {
             std::cerr << "VulkanResourceManager Error: Zero dimension image '" << name << "' requested.\n";
             __debugbreak();
@@ -72,7 +72,8 @@ namespace VulkanResourceManager {
                 format,
                 VkExtent3D{ width, height, 1 },
                 usage,
-                name
+                name,
+                transient
             )
         );
         return g_allocatedImages.at(name);
@@ -90,6 +91,10 @@ namespace VulkanResourceManager {
         return g_allocatedImages.find(name) != g_allocatedImages.end();
     }
 
+    std::unordered_map<std::string, AllocatedImage>& GetAllocatedImages() {
+        return g_allocatedImages;
+    }
+
     uint64_t CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags vmaFlags) {
         const uint64_t id = UniqueID::GetNextObjectId(ObjectType::VK_BUFFER);
         g_buffers.emplace_with_id(id, size, usage, memoryUsage, vmaFlags);
@@ -166,4 +171,8 @@ namespace VulkanResourceManager {
     bool ShaderExists(const std::string& name) {
         return g_shaders.find(name) != g_shaders.end();
     }
+
+    std::unordered_map<std::string, VulkanShader>& GetShaders() {
+        return g_shaders;
+    }
 }
\ No newline at end of file
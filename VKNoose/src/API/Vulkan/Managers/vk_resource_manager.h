@@ -17,9 +17,11 @@ namespace VulkanResourceManager {
     VulkanAccelerationStructure* GetAccelerationStructure(uint64_t id);
 
     // Allocated Images
-    AllocatedImage& CreateAllocatedImage(const std::string& name, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage);
+    // Transient images get their memory from VulkanRenderGraph::Compile(), aliased with transient images whose passes don't overlap
+    AllocatedImage& CreateAllocatedImage(const std::string& name, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, bool transient = false);
     AllocatedImage* GetAllocatedImage(const std::string& name);
     bool AllocatedImageExists(const std::string& name);
+    std::unordered_map<std::string, AllocatedImage>& GetAllocatedImages();
 
     // Buffers
     uint64_t CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags vmaFlags = 0);
@@ -39,4 +41,5 @@ namespace VulkanResourceManager {
     VulkanShader& CreateShader(const std::string& name, const std::vector<std::string>& paths);
     VulkanShader* GetShader(const std::string& name);
     bool ShaderExists(const std::string& name);
+    std::unordered_map<std::string, VulkanShader>& GetShaders();
 }
\ No newline at end of file
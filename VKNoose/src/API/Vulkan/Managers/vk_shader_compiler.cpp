@@ -0,0 +1,312 @@
+#include "vk_shader_compiler.h"
+#include "shaderc/shaderc.hpp"
+#include "xxhash.h"
+#include "Profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace VulkanShaderCompiler {
+    // Bump this if the way shaders are preprocessed or compiled changes in a way the key can't see
+    constexpr uint32_t CACHE_VERSION = 1;
+    const std::string SHADER_DIRECTORY = "res/shaders/Vulkan/";
+    const std::string CACHE_DIRECTORY = "res/shaders/cache/";
+
+    std::unordered_map<std::string, std::string> g_fileCache;
+    std::unordered_map<std::string, std::filesystem::file_time_type> g_fileTimestamps;
+    std::unordered_map<std::string, std::vector<std::string>> g_includeGraph;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> g_spirvCache;
+    std::mutex g_fileCacheMutex;
+    std::mutex g_spirvCacheMutex;
+
+    std::string ReadFile(const std::string& path);
+    std::string ExpandIncludes(const std::string& path);
+    uint64_t GetCacheKey(const std::string& source, VkShaderStageFlagBits stage);
+    std::string GetCachePath(uint64_t key);
+    bool LoadFromDisk(const std::string& cachePath, std::vector<uint32_t>& spirv);
+    void SaveToDisk(const std::string& cachePath, const std::vector<uint32_t>& spirv);
+    std::vector<uint32_t> CompileGLSL(shaderc::Compiler& compiler, const std::string& source, const std::string& path, VkShaderStageFlagBits stage);
+
+    void Init() {
+        std::error_code error;
+        std::filesystem::create_directories(CACHE_DIRECTORY, error);
+        if (error) {
+            std::cerr << "[Shader Compiler] Could not create cache directory " << CACHE_DIRECTORY << ": " << error.message() << "\n";
+        }
+    }
+
+    void Cleanup() {
+        std::scoped_lock lock(g_fileCacheMutex, g_spirvCacheMutex);
+        g_fileCache.clear();
+        g_fileTimestamps.clear();
+        g_includeGraph.clear();
+        g_spirvCache.clear();
+    }
+
+    std::vector<uint32_t> Compile(const std::string& path, VkShaderStageFlagBits stage) {
+        // One compiler per thread, shaderc::Compiler is not safe to share between threads
+        thread_local shaderc::Compiler compiler;
+
+        std::string source = ReadShaderFileWithIncludes(path);
+        if (source.empty()) return {};
+
+        uint64_t key = GetCacheKey(source, stage);
+        {
+            std::lock_guard<std::mutex> lock(g_spirvCacheMutex);
+            auto it = g_spirvCache.find(key);
+            if (it != g_spirvCache.end()) return it->second;
+        }
+
+        std::vector<uint32_t> spirv;
+        std::string cachePath = GetCachePath(key);
+        if (!LoadFromDisk(cachePath, spirv)) {
+            spirv = CompileGLSL(compiler, source, path, stage);
+            if (spirv.empty()) return {};
+            SaveToDisk(cachePath, spirv);
+        }
+
+        std::lock_guard<std::mutex> lock(g_spirvCacheMutex);
+        g_spirvCache[key] = spirv;
+        return spirv;
+    }
+
+    std::vector<bool> CompileBatch(const std::vector<CompileRequest>& requests) {
+        auto startTime = std::chrono::steady_clock::now();
+
+        uint32_t workerCount = std::max(1u, std::min(std::thread::hardware_concurrency(), (uint32_t)requests.size()));
+        std::atomic<size_t> nextRequest = 0;
+        std::vector<uint8_t> compiled(requests.size(), 0);
+
+        std::vector<std::thread> workers;
+        for (uint32_t i = 0; i < workerCount; i++) {
+            workers.emplace_back([&]() {
+                Profiler::SetThreadName("Shader Compiler");
+                PROFILE_SCOPE("Compile Shaders");
+                for (size_t index = nextRequest++; index < requests.size(); index = nextRequest++) {
+                    compiled[index] = !Compile(requests[index].path, requests[index].stage).empty();
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        std::chrono::duration<float> duration = std::chrono::steady_clock::now() - startTime;
+        std::cout << "[Shader Compiler] Prepared " << requests.size() << " shaders on " << workerCount << " threads in " << duration.count() * 1000.0f << "ms\n";
+
+        return std::vector<bool>(compiled.begin(), compiled.end());
+    }
+
+    std::string ReadShaderFileWithIncludes(const std::string& path) {
+        return ExpandIncludes(path);
+    }
+
+    std::vector<std::string> GetDependencies(const std::string& path) {
+        std::lock_guard<std::mutex> lock(g_fileCacheMutex);
+
+        std::vector<std::string> dependencies;
+        std::unordered_set<std::string> visited = { path };
+        std::vector<std::string> stack = { path };
+
+        while (!stack.empty()) {
+            std::string current = stack.back();
+            stack.pop_back();
+
+            auto it = g_includeGraph.find(current);
+            if (it == g_includeGraph.end()) continue;
+
+            for (const std::string& include : it->second) {
+                if (visited.insert(include).second) {
+                    dependencies.push_back(include);
+                    stack.push_back(include);
+                }
+            }
+        }
+        return dependencies;
+    }
+
+    std::vector<std::string> PollChangedFiles() {
+        std::lock_guard<std::mutex> lock(g_fileCacheMutex);
+
+        std::vector<std::string> changedFiles;
+        for (const auto& [path, timestamp] : g_fileTimestamps) {
+            std::error_code error;
+            std::filesystem::file_time_type currentTimestamp = std::filesystem::last_write_time(path, error);
+
+            // Editors often delete and recreate on save, so a missing file is treated as unchanged until it's back
+            if (!error && currentTimestamp != timestamp) {
+                changedFiles.push_back(path);
+            }
+        }
+        for (const std::string& path : changedFiles) {
+            g_fileCache.erase(path);
+            g_fileTimestamps.erase(path);
+            g_includeGraph.erase(path);
+        }
+        return changedFiles;
+    }
+
+    void InvalidateFileCache() {
+        std::lock_guard<std::mutex> lock(g_fileCacheMutex);
+        g_fileCache.clear();
+        g_fileTimestamps.clear();
+        g_includeGraph.clear();
+    }
+
+    VkShaderStageFlagBits GetStageFromFilename(const std::string& filename) {
+        static const std::unordered_map<std::string, VkShaderStageFlagBits> shaderTypeMap = {
+            {".vert", VK_SHADER_STAGE_VERTEX_BIT},
+            {".frag", VK_SHADER_STAGE_FRAGMENT_BIT},
+            {".comp", VK_SHADER_STAGE_COMPUTE_BIT},
+            {".rgen", VK_SHADER_STAGE_RAYGEN_BIT_KHR},
+            {".rmiss", VK_SHADER_STAGE_MISS_BIT_KHR},
+            {".rchit", VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR}
+        };
+        std::string extension = std::filesystem::path(filename).extension().string();
+        auto it = shaderTypeMap.find(extension);
+        return (it != shaderTypeMap.end()) ? it->second : VK_SHADER_STAGE_ALL;
+    }
+
+    std::string ReadFile(const std::string& path) {
+        {
+            std::lock_guard<std::mutex> lock(g_fileCacheMutex);
+            auto it = g_fileCache.find(path);
+            if (it != g_fileCache.end()) return it->second;
+        }
+
+        std::error_code error;
+        std::filesystem::file_time_type timestamp = std::filesystem::last_write_time(path, error);
+
+        std::ifstream stream(path);
+        if (!stream.is_open()) {
+            std::cerr << "Could not open shader file: " << path << "\n";
+            return "";
+        }
+        std::stringstream ss;
+        ss << stream.rdbuf();
+
+        std::lock_guard<std::mutex> lock(g_fileCacheMutex);
+        g_fileTimestamps[path] = timestamp;
+        return g_fileCache[path] = ss.str();
+    }
+
+    std::string ExpandIncludes(const std::string& path) {
+        std::string contents = ReadFile(path);
+        if (contents.empty()) return "";
+
+        std::istringstream stream(contents);
+        std::stringstream ss;
+        std::string line;
+        std::vector<std::string> includes;
+
+        while (getline(stream, line)) {
+            if (line.length() >= 8 && line.substr(0, 8) == "#include") {
+                size_t firstQuote = line.find('"');
+                size_t lastQuote = line.rfind('"');
+
+                if (firstQuote != std::string::npos && lastQuote != std::string::npos && firstQuote != lastQuote) {
+                    std::string filename = line.substr(firstQuote + 1, lastQuote - firstQuote - 1);
+                    includes.push_back(SHADER_DIRECTORY + filename);
+                    ss << ExpandIncludes(includes.back()) << "\n";
+                }
+            }
+            else {
+                ss << line << "\n";
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(g_fileCacheMutex);
+        g_includeGraph[path] = std::move(includes);
+        return ss.str();
+    }
+
+    uint64_t GetCacheKey(const std::string& source, VkShaderStageFlagBits stage) {
+        // Everything that affects the output goes into the key alongside the preprocessed source
+        std::string options = "v" + std::to_string(CACHE_VERSION) + "|spv1.6|vk1.3|perf|stage" + std::to_string((uint32_t)stage) + "|";
+        uint64_t seed = XXH64(options.data(), options.size(), 0);
+        return XXH64(source.data(), source.size(), seed);
+    }
+
+    std::string GetCachePath(uint64_t key) {
+        std::stringstream ss;
+        ss << CACHE_DIRECTORY << std::hex << key << ".spv";
+        return ss.str();
+    }
+
+    bool LoadFromDisk(const std::string& cachePath, std::vector<uint32_t>& spirv) {
+        std::ifstream file(cachePath, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return false;
+
+        std::streamsize size = file.tellg();
+        if (size <= 0 || size % sizeof(uint32_t) != 0) return false;
+
+        spirv.resize(size / sizeof(uint32_t));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(spirv.data()), size)) {
+            spirv.clear();
+            return false;
+        }
+
+        // SPIR-V magic number, anything else is a truncated or foreign file
+        if (spirv[0] != 0x07230203) {
+            spirv.clear();
+            return false;
+        }
+        return true;
+    }
+
+    void SaveToDisk(const std::string& cachePath, const std::vector<uint32_t>& spirv) {
+        // Write to a temporary file and rename so a crash or a parallel run never leaves a partial entry behind
+        std::stringstream tempPath;
+        tempPath << cachePath << "." << std::this_thread::get_id() << ".tmp";
+        {
+            std::ofstream file(tempPath.str(), std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return;
+            file.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+        }
+        std::error_code error;
+        std::filesystem::rename(tempPath.str(), cachePath, error);
+        if (error) {
+            std::filesystem::remove(tempPath.str(), error);
+        }
+    }
+
+    static shaderc_shader_kind GetShadercKind(VkShaderStageFlagBits stage) {
+        switch (stage) {
+        case VK_SHADER_STAGE_VERTEX_BIT:                  return shaderc_vertex_shader;
+        case VK_SHADER_STAGE_FRAGMENT_BIT:                return shaderc_fragment_shader;
+        case VK_SHADER_STAGE_COMPUTE_BIT:                 return shaderc_compute_shader;
+        case VK_SHADER_STAGE_GEOMETRY_BIT:                return shaderc_geometry_shader;
+        case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:    return shaderc_tess_control_shader;
+        case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT: return shaderc_tess_evaluation_shader;
+        case VK_SHADER_STAGE_RAYGEN_BIT_KHR:              return shaderc_raygen_shader;
+        case VK_SHADER_STAGE_MISS_BIT_KHR:                return shaderc_miss_shader;
+        case VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR:         return shaderc_closesthit_shader;
+        default: return shaderc_glsl_infer_from_source;
+        }
+    }
+
+    std::vector<uint32_t> CompileGLSL(shaderc::Compiler& compiler, const std::string& source, const std::string& path, VkShaderStageFlagBits stage) {
+        shaderc::CompileOptions options;
+        options.SetTargetSpirv(shaderc_spirv_version_1_6);
+        options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+        options.SetOptimizationLevel(shaderc_optimization_level_performance);
+
+        shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, GetShadercKind(stage), path.c_str(), options);
+
+        if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+            std::cerr << "ERROR IN: " << path << "\n" << result.GetErrorMessage();
+            return {};
+        }
+
+        return { result.cbegin(), result.cend() };
+    }
+}
\ No newline at end of file
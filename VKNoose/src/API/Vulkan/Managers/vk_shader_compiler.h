@@ -0,0 +1,31 @@
+#pragma once
+#include "API/Vulkan/vk_common.h"
+#include <string>
+#include <vector>
+
+namespace VulkanShaderCompiler {
+    struct CompileRequest {
+        std::string path;
+        VkShaderStageFlagBits stage;
+    };
+
+    void Init();
+    void Cleanup();
+
+    // Returns SPIR-V for the shader, from the in-memory cache, the on-disk cache or a fresh compile
+    std::vector<uint32_t> Compile(const std::string& path, VkShaderStageFlagBits stage);
+
+    // Compiles cache misses across a pool of workers (one shaderc compiler each) so that the
+    // following Compile() calls for the same shaders are in-memory hits. Returns whether each request compiled.
+    std::vector<bool> CompileBatch(const std::vector<CompileRequest>& requests);
+
+    std::string ReadShaderFileWithIncludes(const std::string& path);
+
+    // Every file the shader pulls in through #include, directly or transitively
+    std::vector<std::string> GetDependencies(const std::string& path);
+
+    // Checks the timestamps of every file read so far and drops changed ones from the file cache
+    std::vector<std::string> PollChangedFiles();
+    void InvalidateFileCache();
+    VkShaderStageFlagBits GetStageFromFilename(const std::string& filename);
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "vk_shader_hotload_manager.h"
+#include "vk_device_manager.h"
+#include "vk_pipeline_cache_manager.h"
+#include "vk_pipeline_manager.h"
+#include "vk_resource_manager.h"
+#include "vk_shader_compiler.h"
+#include "API/Vulkan/vk_backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+
+namespace VulkanShaderHotloadManager {
+    constexpr std::chrono::milliseconds POLL_INTERVAL(500);
+    constexpr VkShaderStageFlags RAYTRACING_STAGES = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+
+    struct CompileJob {
+        std::vector<std::string> shaderNames;
+        std::vector<VulkanShaderCompiler::CompileRequest> requests;
+        std::vector<size_t> firstRequestIndex;  // Per shader, its modules are contiguous in 'requests'
+        std::future<std::vector<bool>> result;
+    };
+
+    CompileJob g_compileJob;
+    std::chrono::steady_clock::time_point g_lastPollTime;
+    bool g_reloadAllRequested = false;
+
+    std::vector<std::string> FindAffectedShaders(const std::vector<std::string>& changedFiles);
+    void StartCompileJob(const std::vector<std::string>& shaderNames);
+    void ApplyCompileJob();
+
+    void Init() {
+        g_lastPollTime = std::chrono::steady_clock::now();
+    }
+
+    void Cleanup() {
+        if (g_compileJob.result.valid()) {
+            g_compileJob.result.wait();
+        }
+        g_compileJob = CompileJob();
+    }
+
+    void Update() {
+        if (g_compileJob.result.valid()) {
+            if (g_compileJob.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+            ApplyCompileJob();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (!g_reloadAllRequested && now - g_lastPollTime < POLL_INTERVAL) return;
+        g_lastPollTime = now;
+
+        std::vector<std::string> shaderNames;
+        if (g_reloadAllRequested) {
+            VulkanShaderCompiler::InvalidateFileCache();
+            for (auto& [name, shader] : VulkanResourceManager::GetShaders()) {
+                shaderNames.push_back(name);
+            }
+            g_reloadAllRequested = false;
+        }
+        else {
+            shaderNames = FindAffectedShaders(VulkanShaderCompiler::PollChangedFiles());
+        }
+
+        if (!shaderNames.empty()) {
+            StartCompileJob(shaderNames);
+        }
+    }
+
+    void RequestReloadAll() {
+        g_reloadAllRequested = true;
+    }
+
+    std::vector<std::string> FindAffectedShaders(const std::vector<std::string>& changedFiles) {
+        std::vector<std::string> shaderNames;
+        if (changedFiles.empty()) return shaderNames;
+
+        auto isChanged = [&](const std::string& path) {
+            return std::find(changedFiles.begin(), changedFiles.end(), path) != changedFiles.end();
+        };
+
+        for (auto& [name, shader] : VulkanResourceManager::GetShaders()) {
+            for (const VulkanShaderModule& module : shader.GetModules()) {
+                std::vector<std::string> dependencies = VulkanShaderCompiler::GetDependencies(module.GetPath());
+                if (isChanged(module.GetPath()) || std::any_of(dependencies.begin(), dependencies.end(), isChanged)) {
+                    shaderNames.push_back(name);
+                    break;
+                }
+            }
+        }
+        return shaderNames;
+    }
+
+    void StartCompileJob(const std::vector<std::string>& shaderNames) {
+        g_compileJob = CompileJob();
+        g_compileJob.shaderNames = shaderNames;
+
+        for (const std::string& name : shaderNames) {
+            g_compileJob.firstRequestIndex.push_back(g_compileJob.requests.size());
+            for (const VulkanShaderModule& module : VulkanResourceManager::GetShader(name)->GetModules()) {
+                g_compileJob.requests.push_back({ module.GetPath(), module.GetStage() });
+            }
+        }
+
+        std::cout << "[Shader Hotload] Recompiling " << shaderNames.size() << " shaders in the background\n";
+
+        g_compileJob.result = std::async(std::launch::async, [requests = g_compileJob.requests]() {
+            return VulkanShaderCompiler::CompileBatch(requests);
+        });
+    }
+
+    void ApplyCompileJob() {
+        std::vector<bool> compiled = g_compileJob.result.get();
+        VkDevice device = VulkanDeviceManager::GetDevice();
+
+        std::vector<std::string> reloadedShaders;
+        bool raytracingShaderReloaded = false;
+
+        for (size_t i = 0; i < g_compileJob.shaderNames.size(); i++) {
+            size_t first = g_compileJob.firstRequestIndex[i];
+            size_t last = (i + 1 < g_compileJob.shaderNames.size()) ? g_compileJob.firstRequestIndex[i + 1] : g_compileJob.requests.size();
+
+            // Keep the old modules of a shader with a broken stage, so a typo doesn't take the pipeline down
+            if (!std::all_of(compiled.begin() + first, compiled.begin() + last, [](bool success) { return success; })) continue;
+
+            VulkanShader* shader = VulkanResourceManager::GetShader(g_compileJob.shaderNames[i]);
+            if (!shader) continue;
+
+            // The SPIR-V is in the compiler's memory cache by now, so this only creates the modules
+            shader->Hotload(device);
+            reloadedShaders.push_back(g_compileJob.shaderNames[i]);
+
+            for (const VulkanShaderModule& module : shader->GetModules()) {
+                raytracingShaderReloaded |= (module.GetStage() & RAYTRACING_STAGES) != 0;
+            }
+        }
+
+        if (!reloadedShaders.empty()) {
+            VulkanPipelineManager::ReloadPipelinesUsingShaders(reloadedShaders);
+            if (raytracingShaderReloaded) {
+                VulkanBackEnd::ReloadRaytracingPipelines();
+            }
+            VulkanPipelineCacheManager::Save();
+        }
+
+        std::cout << "[Shader Hotload] Reloaded " << reloadedShaders.size() << "/" << g_compileJob.shaderNames.size() << " shaders\n";
+        g_compileJob = CompileJob();
+    }
+}
\ No newline at end of file
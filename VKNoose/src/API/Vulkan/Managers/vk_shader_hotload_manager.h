@@ -0,0 +1,14 @@
+#pragma once
+#include "API/Vulkan/vk_common.h"
+
+namespace VulkanShaderHotloadManager {
+    void Init();
+    void Cleanup();
+
+    // Call once per frame after the render fence wait. Polls shader files for changes, kicks off
+    // background compiles for the shaders they affect and swaps in the new pipelines once those finish.
+    void Update();
+
+    // Recompile every shader on the next Update(), whether or not its files changed
+    void RequestReloadAll();
+}
\ No newline at end of file
@@ -13,6 +13,10 @@ std::vector<VkImage> g_swapchainImages;
 std::vector<VkImageView> g_swapchainImageViews;
 
 bool Init() {
+	if (GLFWIntegration::IsHeadless()) {
+		std::cout << "VulkanSwapchainManager::Init() skipped, running headless\n";
+		return true;
+	}
 	CreateSwapchain();
 	std::cout << "VulkanSwapchainManager::Init()\n";
 	return true;
@@ -115,7 +119,13 @@ void RecreateSwapchain() {
         for (auto imageView : g_swapchainImageViews) {
             vkDestroyImageView(VulkanDeviceManager::GetDevice(), imageView, nullptr);
         }
-        vkDestroySwapchainKHR(VulkanDeviceManager::GetDevice(), g_swapchain, nullptr);
+        g_swapchainImageViews.clear();
+        g_swapchainImages.clear();
+
+        if (g_swapchain != VK_NULL_HANDLE) {
+            vkDestroySwapchainKHR(VulkanDeviceManager::GetDevice(), g_swapchain, nullptr);
+            g_swapchain = VK_NULL_HANDLE;
+        }
     }
 
     VkSwapchainKHR GetSwapchain() { return g_swapchain; }
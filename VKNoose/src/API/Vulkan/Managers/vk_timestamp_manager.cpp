@@ -0,0 +1,214 @@
+#include "vk_timestamp_manager.h"
+#include "vk_device_manager.h"
+#include "API/Vulkan/Renderer/vk_renderer.h"
+
+#include "Hell/Constants.h"
+#include "Hell/Core/Logging.h"
+#include "Profiler.h"
+
+#include <vector>
+#include <iostream>
+
+namespace VulkanTimestampManager {
+    constexpr uint32_t MAX_SCOPES_PER_FRAME = 32;
+    constexpr uint32_t QUERIES_PER_FRAME = MAX_SCOPES_PER_FRAME * 2;
+
+    constexpr uint32_t INVALID_SCOPE_NAME = UINT32_MAX;
+
+    struct ScopeName {
+        std::string name;
+        std::string recordName;
+        float lastFrameTime = 0.0f;
+    };
+
+    struct Scope {
+        uint32_t nameIndex = INVALID_SCOPE_NAME;
+        bool ended = false;
+    };
+
+    struct FrameQueries {
+        std::vector<Scope> scopes;
+        uint64_t cpuBeginTime = 0;
+        bool submitted = false;
+    };
+
+    VkQueryPool g_queryPool = VK_NULL_HANDLE;
+    FrameQueries g_frames[FRAME_OVERLAP];
+    uint32_t g_recordingFrameIndex = 0;
+    float g_timestampPeriod = 1.0f;
+    uint64_t g_timestampMask = ~0ull;
+    bool g_supported = false;
+    std::vector<ScopeName> g_scopeNames; // A frame's worth of passes, so a linear search beats hashing the name
+
+    void ReadResults(uint32_t frameIndex);
+    uint32_t FindScopeName(std::string_view name);
+
+    bool Init() {
+        const VkPhysicalDeviceProperties& properties = VulkanDeviceManager::GetProperties();
+        if (!properties.limits.timestampComputeAndGraphics) {
+            Logging::Warning() << "VulkanTimestampManager::Init() device does not support timestamps on graphics queues, GPU timings disabled\n";
+            return true;
+        }
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(VulkanDeviceManager::GetPhysicalDevice(), &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(VulkanDeviceManager::GetPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+        uint32_t validBits = queueFamilies[VulkanDeviceManager::GetGraphicsQueueFamily()].timestampValidBits;
+        if (validBits == 0) {
+            Logging::Warning() << "VulkanTimestampManager::Init() graphics queue has no valid timestamp bits, GPU timings disabled\n";
+            return true;
+        }
+        g_timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+        g_timestampPeriod = properties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo createInfo{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        createInfo.queryCount = QUERIES_PER_FRAME * FRAME_OVERLAP;
+
+        if (vkCreateQueryPool(VulkanDeviceManager::GetDevice(), &createInfo, nullptr, &g_queryPool) != VK_SUCCESS) {
+            Logging::Error() << "VulkanTimestampManager::Init() failed to create query pool\n";
+            return false;
+        }
+
+        for (FrameQueries& frame : g_frames) {
+            frame.scopes.reserve(MAX_SCOPES_PER_FRAME);
+        }
+
+        g_supported = true;
+        std::cout << "VulkanTimestampManager::Init()\n";
+        return true;
+    }
+
+    void Cleanup() {
+        if (g_queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(VulkanDeviceManager::GetDevice(), g_queryPool, nullptr);
+            g_queryPool = VK_NULL_HANDLE;
+        }
+        for (FrameQueries& frame : g_frames) {
+            frame.scopes.clear();
+            frame.submitted = false;
+        }
+        g_scopeNames.clear();
+        g_supported = false;
+    }
+
+    void BeginFrame(VkCommandBuffer cmd, uint32_t frameIndex) {
+        if (!g_supported) return;
+
+        // The fence for this slot has been waited on, so this never blocks
+        ReadResults(frameIndex);
+
+        FrameQueries& frame = g_frames[frameIndex];
+        frame.scopes.clear();
+        frame.cpuBeginTime = Profiler::GetTimeNanoseconds();
+        frame.submitted = true;
+        g_recordingFrameIndex = frameIndex;
+
+        vkCmdResetQueryPool(cmd, g_queryPool, frameIndex * QUERIES_PER_FRAME, QUERIES_PER_FRAME);
+    }
+
+    void BeginScope(VkCommandBuffer cmd, std::string_view name) {
+        if (!g_supported) return;
+
+        FrameQueries& frame = g_frames[g_recordingFrameIndex];
+        if (frame.scopes.size() >= MAX_SCOPES_PER_FRAME) {
+            Logging::Warning() << "VulkanTimestampManager::BeginScope() exceeded " << MAX_SCOPES_PER_FRAME << " scopes, ignoring '" << name << "'\n";
+            return;
+        }
+
+        uint32_t nameIndex = FindScopeName(name);
+        if (nameIndex == INVALID_SCOPE_NAME) {
+            nameIndex = (uint32_t)g_scopeNames.size();
+            ScopeName& scopeName = g_scopeNames.emplace_back();
+            scopeName.name = name;
+            FrameString recordName = GetRecordName(name);
+            scopeName.recordName.assign(recordName.data(), recordName.size());
+        }
+
+        uint32_t query = g_recordingFrameIndex * QUERIES_PER_FRAME + (uint32_t)frame.scopes.size() * 2;
+        frame.scopes.push_back({ nameIndex, false });
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, g_queryPool, query);
+    }
+
+    void EndScope(VkCommandBuffer cmd, std::string_view name) {
+        if (!g_supported) return;
+
+        // Scopes may nest, so close the most recent open scope with this name
+        FrameQueries& frame = g_frames[g_recordingFrameIndex];
+        uint32_t nameIndex = FindScopeName(name);
+        for (int i = (int)frame.scopes.size() - 1; i >= 0 && nameIndex != INVALID_SCOPE_NAME; i--) {
+            Scope& scope = frame.scopes[i];
+            if (scope.nameIndex == nameIndex && !scope.ended) {
+                uint32_t query = g_recordingFrameIndex * QUERIES_PER_FRAME + (uint32_t)i * 2 + 1;
+                vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, g_queryPool, query);
+                scope.ended = true;
+                return;
+            }
+        }
+        Logging::Warning() << "VulkanTimestampManager::EndScope() no open scope named '" << name << "'\n";
+    }
+
+    void ReadResults(uint32_t frameIndex) {
+        FrameQueries& frame = g_frames[frameIndex];
+        if (!frame.submitted || frame.scopes.empty()) return;
+
+        for (ScopeName& scopeName : g_scopeNames) {
+            scopeName.lastFrameTime = 0.0f;
+        }
+
+        uint32_t queryCount = (uint32_t)frame.scopes.size() * 2;
+        FrameVector<uint64_t> results(queryCount * 2); // value + availability pairs
+
+        vkGetQueryPoolResults(VulkanDeviceManager::GetDevice(), g_queryPool, frameIndex * QUERIES_PER_FRAME, queryCount, results.size() * sizeof(uint64_t), results.data(), sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+        // GPU and CPU clocks aren't calibrated against each other, so trace lanes start the frame's first scope
+        // where the CPU began recording it. Durations are exact, the offset between the lanes is not.
+        bool addTraceEvents = Profiler::IsCapturingGpuTrace() && results[1];
+        uint64_t firstBegin = results[0];
+
+        for (size_t i = 0; i < frame.scopes.size(); i++) {
+            const Scope& scope = frame.scopes[i];
+            if (!scope.ended) continue;
+            ScopeName& scopeName = g_scopeNames[scope.nameIndex];
+
+            uint64_t begin = results[i * 4 + 0];
+            uint64_t beginAvailable = results[i * 4 + 1];
+            uint64_t end = results[i * 4 + 2];
+            uint64_t endAvailable = results[i * 4 + 3];
+            if (!beginAvailable || !endAvailable) continue;
+
+            uint64_t ticks = (end - begin) & g_timestampMask;
+            float milliseconds = (float)((double)ticks * g_timestampPeriod / 1000000.0);
+            Profiler::AddRecordTime(scopeName.recordName, milliseconds);
+            scopeName.lastFrameTime += milliseconds;
+            if (addTraceEvents) {
+                uint64_t offset = (uint64_t)((double)((begin - firstBegin) & g_timestampMask) * g_timestampPeriod);
+                Profiler::AddGpuTraceEvent(scopeName.name, frame.cpuBeginTime + offset, (uint64_t)((double)ticks * g_timestampPeriod));
+            }
+        }
+    }
+
+    FrameString GetRecordName(std::string_view scopeName) {
+        FrameString recordName = "GPU ";
+        recordName += scopeName;
+        return recordName;
+    }
+
+    float GetLastFrameTime(std::string_view scopeName) {
+        uint32_t nameIndex = FindScopeName(scopeName);
+        return (nameIndex != INVALID_SCOPE_NAME) ? g_scopeNames[nameIndex].lastFrameTime : 0.0f;
+    }
+
+    uint32_t FindScopeName(std::string_view name) {
+        for (uint32_t i = 0; i < (uint32_t)g_scopeNames.size(); i++) {
+            if (g_scopeNames[i].name == name) return i;
+        }
+        return INVALID_SCOPE_NAME;
+    }
+
+    bool IsSupported() {
+        return g_supported;
+    }
+}
\ No newline at end of file
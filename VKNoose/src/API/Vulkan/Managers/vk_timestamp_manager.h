@@ -0,0 +1,25 @@
+#pragma once
+#include "API/Vulkan/vk_common.h"
+#include "Hell/Core/FrameArena.h"
+#include <string>
+#include <string_view>
+
+namespace VulkanTimestampManager {
+    bool Init();
+    void Cleanup();
+
+    // Reads the timings written the last time this frame slot was submitted, then resets its queries.
+    // Record at the start of the frame command buffer, after the render fence for this slot has been waited on.
+    void BeginFrame(VkCommandBuffer cmd, uint32_t frameIndex);
+
+    // Each distinct name is copied once, the first time it is begun, and referred to by index after that
+    void BeginScope(VkCommandBuffer cmd, std::string_view name);
+    void EndScope(VkCommandBuffer cmd, std::string_view name);
+
+    // Results are stored as Profiler records named "GPU <scope name>"
+    FrameString GetRecordName(std::string_view scopeName);
+
+    // Time of the scope in the most recently read frame, 0 if it wasn't recorded in that frame
+    float GetLastFrameTime(std::string_view scopeName);
+    bool IsSupported();
+}
\ No newline at end of file
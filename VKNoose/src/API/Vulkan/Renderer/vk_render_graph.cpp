@@ -0,0 +1,379 @@
+#include "vk_render_graph.h"
+#include "API/Vulkan/Managers/vk_device_manager.h"
+#include "API/Vulkan/Managers/vk_memory_manager.h"
+#include "API/Vulkan/Managers/vk_resource_manager.h"
+#include "API/Vulkan/Managers/vk_timestamp_manager.h"
+#include "API/Vulkan/vk_utils.h"
+
+#include "Hell/Core/Logging.h"
+
+#include <algorithm>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string_view>
+
+namespace VulkanRenderGraph {
+    constexpr VkAccessFlags WRITE_ACCESS_MASK =
+        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    struct ImageLifetime {
+        AllocatedImage* image = nullptr;
+        int firstPass = -1;
+        int lastPass = -1;
+        int aliasSlot = -1;
+        VkDeviceSize size = 0;
+    };
+
+    // One allocation shared by transient images whose lifetimes don't overlap
+    struct AliasSlot {
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VkMemoryRequirements requirements = {};
+        std::vector<std::string> imageNames;
+    };
+
+    // The names point into g_passes, which is only cleared together with the records
+    struct RecordedBarrier {
+        std::string_view passName;
+        std::string_view imageName;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+    };
+
+    // Deque so the references handed out by AddPass() survive later passes being added
+    std::deque<Pass> g_passes;
+    std::map<std::string, ImageLifetime> g_images;
+    std::vector<AliasSlot> g_aliasSlots;
+    std::vector<RecordedBarrier> g_lastBarriers;
+    uint32_t g_lastBarrierBatchCount = 0;
+
+    // Execute() scratch, kept so a frame reuses the previous frame's capacity
+    std::vector<AllocatedImage*> g_touchedImages;
+    std::vector<VkImageMemoryBarrier> g_barriers;
+
+    bool Overlaps(const ImageLifetime& a, const ImageLifetime& b);
+    void AllocateTransientMemory();
+    const char* LayoutToString(VkImageLayout layout);
+
+    Pass& AddAccess(Pass& pass, const std::string& imageName, const ImageUsage& usage, bool write) {
+        for (Pass::ImageAccess& access : pass.accesses) {
+            if (access.imageName != imageName) continue;
+
+            if (access.usage.layout != usage.layout) {
+                Logging::Error() << "VulkanRenderGraph: pass '" << pass.name << "' uses '" << imageName << "' in two different layouts\n";
+            }
+            access.usage.accessMask |= usage.accessMask;
+            access.usage.stageFlags |= usage.stageFlags;
+            access.write |= write;
+            return pass;
+        }
+        pass.accesses.push_back({ imageName, usage, write });
+        return pass;
+    }
+
+    Pass& Pass::Read(const std::string& imageName, const ImageUsage& usage) {
+        return AddAccess(*this, imageName, usage, false);
+    }
+
+    Pass& Pass::Write(const std::string& imageName, const ImageUsage& usage) {
+        return AddAccess(*this, imageName, usage, true);
+    }
+
+    Pass& Pass::SetCondition(PassCondition passCondition) {
+        condition = std::move(passCondition);
+        return *this;
+    }
+
+    Pass& AddPass(const std::string& name, PassFunction function) {
+        Pass& pass = g_passes.emplace_back();
+        pass.name = name;
+        pass.function = std::move(function);
+        return pass;
+    }
+
+    bool Compile() {
+        VkDevice device = VulkanDeviceManager::GetDevice();
+
+        // Alias slots are kept, an image can't be bound to different memory once it has some
+        for (auto& [name, lifetime] : g_images) {
+            lifetime.firstPass = -1;
+            lifetime.lastPass = -1;
+        }
+
+        for (int i = 0; i < (int)g_passes.size(); i++) {
+            for (const Pass::ImageAccess& access : g_passes[i].accesses) {
+                AllocatedImage* image = VulkanResourceManager::GetAllocatedImage(access.imageName);
+                if (!image) {
+                    Logging::Error() << "VulkanRenderGraph::Compile() pass '" << g_passes[i].name << "' uses unknown image '" << access.imageName << "'\n";
+                    return false;
+                }
+
+                ImageLifetime& lifetime = g_images[access.imageName];
+                if (lifetime.firstPass == -1) {
+                    lifetime.firstPass = i;
+                    if (image->IsTransient() && !access.write) {
+                        Logging::Warning() << "VulkanRenderGraph::Compile() transient image '" << access.imageName << "' is read by '" << g_passes[i].name << "' before anything writes it\n";
+                    }
+                }
+                lifetime.lastPass = i;
+                lifetime.image = image;
+            }
+        }
+
+        for (const AliasSlot& slot : g_aliasSlots) {
+            for (size_t a = 0; a < slot.imageNames.size(); a++) {
+                for (size_t b = a + 1; b < slot.imageNames.size(); b++) {
+                    if (Overlaps(g_images[slot.imageNames[a]], g_images[slot.imageNames[b]])) {
+                        Logging::Error() << "VulkanRenderGraph::Compile() '" << slot.imageNames[a] << "' and '" << slot.imageNames[b] << "' share memory but are now alive at the same time\n";
+                        return false;
+                    }
+                }
+            }
+        }
+
+        AllocateTransientMemory();
+
+        for (auto& [name, lifetime] : g_images) {
+            if (lifetime.image) {
+                lifetime.size = lifetime.image->GetMemoryRequirements(device).size;
+            }
+        }
+
+        std::cout << "VulkanRenderGraph::Compile() " << g_passes.size() << " passes, " << g_images.size() << " images, " << g_aliasSlots.size() << " transient allocations\n";
+        return true;
+    }
+
+    void AllocateTransientMemory() {
+        VkDevice device = VulkanDeviceManager::GetDevice();
+        VmaAllocator allocator = VulkanMemoryManager::GetAllocator();
+
+        // Transient images that still need memory, in the order they come alive
+        std::vector<std::string> pending;
+        for (auto& [name, image] : VulkanResourceManager::GetAllocatedImages()) {
+            if (!image.IsTransient() || image.HasMemory()) continue;
+
+            ImageLifetime& lifetime = g_images[name];
+            lifetime.image = &image;
+            if (lifetime.firstPass == -1) {
+                Logging::Warning() << "VulkanRenderGraph: transient image '" << name << "' isn't used by any pass, it gets its own memory\n";
+            }
+            pending.push_back(name);
+        }
+        std::sort(pending.begin(), pending.end(), [](const std::string& a, const std::string& b) {
+            return g_images[a].firstPass < g_images[b].firstPass;
+        });
+
+        // First fit into a slot from this compile where no occupant is alive at the same time as the image
+        size_t firstNewSlot = g_aliasSlots.size();
+        for (const std::string& name : pending) {
+            ImageLifetime& lifetime = g_images[name];
+            VkMemoryRequirements requirements = lifetime.image->GetMemoryRequirements(device);
+
+            int slotIndex = -1;
+            for (size_t i = firstNewSlot; i < g_aliasSlots.size() && lifetime.firstPass != -1; i++) {
+                AliasSlot& slot = g_aliasSlots[i];
+                if ((slot.requirements.memoryTypeBits & requirements.memoryTypeBits) == 0) continue;
+
+                bool free = std::none_of(slot.imageNames.begin(), slot.imageNames.end(), [&](const std::string& other) {
+                    return g_images[other].firstPass == -1 || Overlaps(lifetime, g_images[other]);
+                });
+                if (free) {
+                    slotIndex = (int)i;
+                    break;
+                }
+            }
+
+            if (slotIndex == -1) {
+                slotIndex = (int)g_aliasSlots.size();
+                AliasSlot& slot = g_aliasSlots.emplace_back();
+                slot.requirements = requirements;
+            }
+
+            AliasSlot& slot = g_aliasSlots[slotIndex];
+            slot.requirements.size = std::max(slot.requirements.size, requirements.size);
+            slot.requirements.alignment = std::max(slot.requirements.alignment, requirements.alignment);
+            slot.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+            slot.imageNames.push_back(name);
+            lifetime.aliasSlot = slotIndex;
+        }
+
+        for (size_t i = firstNewSlot; i < g_aliasSlots.size(); i++) {
+            AliasSlot& slot = g_aliasSlots[i];
+
+            VmaAllocationCreateInfo allocInfo = {};
+            allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+            allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+            if (vmaAllocateMemory(allocator, &slot.requirements, &allocInfo, &slot.allocation, nullptr) != VK_SUCCESS) {
+                Logging::Error() << "VulkanRenderGraph: failed to allocate " << slot.requirements.size << " bytes of transient memory\n";
+                continue;
+            }
+            VulkanMemoryManager::TrackAllocation(slot.allocation, MemoryCategory::RENDER_TARGETS);
+            for (const std::string& name : slot.imageNames) {
+                g_images[name].image->BindMemory(device, allocator, slot.allocation);
+            }
+        }
+    }
+
+    void Execute(VkCommandBuffer cmd) {
+        g_lastBarriers.clear();
+        g_lastBarrierBatchCount = 0;
+
+        g_touchedImages.clear();
+
+        // True the first time an image is seen this frame
+        auto firstTouch = [](AllocatedImage* image) {
+            if (std::find(g_touchedImages.begin(), g_touchedImages.end(), image) != g_touchedImages.end()) return false;
+            g_touchedImages.push_back(image);
+            return true;
+        };
+
+        for (Pass& pass : g_passes) {
+            if (pass.condition && !pass.condition()) continue;
+
+            g_barriers.clear();
+            VkPipelineStageFlags srcStageMask = 0;
+            VkPipelineStageFlags dstStageMask = 0;
+
+            for (const Pass::ImageAccess& access : pass.accesses) {
+                ImageLifetime& lifetime = g_images[access.imageName];
+                AllocatedImage* image = lifetime.image;
+
+                VkImageLayout oldLayout = image->GetCurrentLayout();
+                VkAccessFlags srcAccess = image->GetCurrentAccessMask();
+                VkPipelineStageFlags srcStage = image->GetCurrentStageFlags();
+
+                // The first write of the frame to a transient image discards it, and has to wait on
+                // whatever last used the memory, which may have been another image in the same slot
+                bool discard = image->IsTransient() && firstTouch(image) && access.write;
+                if (discard) {
+                    oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                    if (lifetime.aliasSlot != -1) {
+                        for (const std::string& name : g_aliasSlots[lifetime.aliasSlot].imageNames) {
+                            srcAccess |= g_images[name].image->GetCurrentAccessMask();
+                            srcStage |= g_images[name].image->GetCurrentStageFlags();
+                        }
+                    }
+                }
+
+                bool layoutChange = discard || oldLayout != access.usage.layout;
+                bool hazard = (srcAccess & WRITE_ACCESS_MASK) || (access.usage.accessMask & WRITE_ACCESS_MASK);
+                if (!layoutChange && !hazard) {
+                    // Read after read, later writers have to wait on both
+                    image->SetCurrentState(oldLayout, srcAccess | access.usage.accessMask, srcStage | access.usage.stageFlags);
+                    continue;
+                }
+
+                VkImageMemoryBarrier& barrier = g_barriers.emplace_back();
+                barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+                barrier.oldLayout = oldLayout;
+                barrier.newLayout = access.usage.layout;
+                barrier.srcAccessMask = srcAccess;
+                barrier.dstAccessMask = access.usage.accessMask;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = image->GetImage();
+                barrier.subresourceRange = { VulkanUtils::GetImageAspectFlagsFromFormat(image->GetFormat()), 0, 1, 0, 1 };
+
+                srcStageMask |= srcStage;
+                dstStageMask |= access.usage.stageFlags;
+                image->SetCurrentState(access.usage.layout, access.usage.accessMask, access.usage.stageFlags);
+
+                g_lastBarriers.push_back({ pass.name, access.imageName, oldLayout, access.usage.layout });
+            }
+
+            if (!g_barriers.empty()) {
+                if (srcStageMask == 0) srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                vkCmdPipelineBarrier(cmd, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, (uint32_t)g_barriers.size(), g_barriers.data());
+                g_lastBarrierBatchCount++;
+            }
+
+            VulkanTimestampManager::BeginScope(cmd, pass.name);
+            pass.function(cmd);
+            VulkanTimestampManager::EndScope(cmd, pass.name);
+        }
+    }
+
+    std::string Dump() {
+        auto megabytes = [](VkDeviceSize bytes) { return (float)bytes / (1024.0f * 1024.0f); };
+
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(2);
+
+        ss << "Passes\n";
+        for (size_t i = 0; i < g_passes.size(); i++) {
+            const Pass& pass = g_passes[i];
+            ss << "  [" << i << "] " << pass.name << (pass.condition ? " (conditional)" : "") << "\n";
+            for (const Pass::ImageAccess& access : pass.accesses) {
+                ss << "      " << (access.write ? "write " : "read  ") << access.imageName << " " << LayoutToString(access.usage.layout) << "\n";
+            }
+        }
+
+        ss << "\nImages\n";
+        for (const auto& [name, lifetime] : g_images) {
+            ss << "  " << name << " passes " << lifetime.firstPass << "-" << lifetime.lastPass << ", " << megabytes(lifetime.size) << " MB";
+            if (lifetime.aliasSlot != -1) ss << ", transient slot " << lifetime.aliasSlot;
+            ss << "\n";
+        }
+
+        VkDeviceSize requested = 0;
+        VkDeviceSize allocated = 0;
+        ss << "\nTransient memory\n";
+        for (size_t i = 0; i < g_aliasSlots.size(); i++) {
+            const AliasSlot& slot = g_aliasSlots[i];
+            ss << "  slot " << i << " " << megabytes(slot.requirements.size) << " MB:";
+            for (const std::string& name : slot.imageNames) {
+                ss << " " << name;
+                requested += g_images[name].size;
+            }
+            ss << "\n";
+            allocated += slot.requirements.size;
+        }
+        ss << "  " << megabytes(allocated) << " MB allocated for " << megabytes(requested) << " MB of transient images\n";
+
+        ss << "\nLast frame, " << g_lastBarriers.size() << " image barriers in " << g_lastBarrierBatchCount << " batches\n";
+        for (const RecordedBarrier& barrier : g_lastBarriers) {
+            ss << "  " << barrier.passName << ": " << barrier.imageName << " " << LayoutToString(barrier.oldLayout) << " -> " << LayoutToString(barrier.newLayout) << "\n";
+        }
+        return ss.str();
+    }
+
+    void Cleanup() {
+        // Expects the device to be idle and the images bound to these slots to be destroyed already
+        VmaAllocator allocator = VulkanMemoryManager::GetAllocator();
+        for (AliasSlot& slot : g_aliasSlots) {
+            if (slot.allocation != VK_NULL_HANDLE) {
+                VulkanMemoryManager::UntrackAllocation(slot.allocation);
+                vmaFreeMemory(allocator, slot.allocation);
+            }
+        }
+        g_aliasSlots.clear();
+        g_images.clear();
+        g_passes.clear();
+        g_lastBarriers.clear();
+        g_touchedImages.clear();
+        g_barriers.clear();
+    }
+
+    bool Overlaps(const ImageLifetime& a, const ImageLifetime& b) {
+        if (a.firstPass == -1 || b.firstPass == -1) return false;
+        return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+    }
+
+    const char* LayoutToString(VkImageLayout layout) {
+        switch (layout) {
+            case VK_IMAGE_LAYOUT_UNDEFINED:                               return "UNDEFINED";
+            case VK_IMAGE_LAYOUT_GENERAL:                                 return "GENERAL";
+            case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:                return "COLOR_ATTACHMENT";
+            case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:        return "DEPTH_STENCIL_ATTACHMENT";
+            case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:                return "SHADER_READ_ONLY";
+            case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:                    return "TRANSFER_SRC";
+            case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:                    return "TRANSFER_DST";
+            case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:                         return "PRESENT_SRC";
+            default:                                                      return "OTHER";
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include "API/Vulkan/vk_common.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// Frame passes declare the images they read and write, the graph works out the barriers between them
+// and gives transient images (see VulkanResourceManager::CreateAllocatedImage) memory shared with other
+// transient images whose lifetimes don't overlap. Images keep their tracked state across frames, so code
+// outside the graph can still use AllocatedImage::TransitionLayout() on them.
+namespace VulkanRenderGraph {
+    struct ImageUsage {
+        VkImageLayout layout;
+        VkAccessFlags accessMask;
+        VkPipelineStageFlags stageFlags;
+    };
+
+    // Sampled images are bound in GENERAL, see VulkanBackEnd::UpdateStaticDescriptorSet()
+    constexpr ImageUsage RAY_TRACING_STORAGE_WRITE = { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR };
+    constexpr ImageUsage RAY_TRACING_SAMPLED_READ = { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR };
+    constexpr ImageUsage FRAGMENT_SAMPLED_READ = { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
+    constexpr ImageUsage COLOR_ATTACHMENT_WRITE = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    constexpr ImageUsage COLOR_ATTACHMENT_LOAD_WRITE = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    constexpr ImageUsage DEPTH_ATTACHMENT_WRITE = { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT };
+    constexpr ImageUsage TRANSFER_READ = { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT };
+    constexpr ImageUsage TRANSFER_WRITE = { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT };
+
+    typedef std::function<void(VkCommandBuffer cmd)> PassFunction;
+    typedef std::function<bool()> PassCondition;
+
+    struct Pass {
+        struct ImageAccess {
+            std::string imageName;
+            ImageUsage usage;
+            bool write = false;
+        };
+
+        std::string name;
+        PassFunction function = nullptr;
+        PassCondition condition = nullptr;
+        std::vector<ImageAccess> accesses;
+
+        Pass& Read(const std::string& imageName, const ImageUsage& usage);
+        Pass& Write(const std::string& imageName, const ImageUsage& usage);
+
+        // Skipped passes record nothing, not even their barriers. Lifetimes still include them.
+        Pass& SetCondition(PassCondition passCondition);
+    };
+
+    // Passes execute in the order they were added, each inside a GPU timestamp scope of the same name
+    Pass& AddPass(const std::string& name, PassFunction function);
+
+    // Resolves image names, computes lifetimes and binds memory for any transient image that has none yet
+    bool Compile();
+
+    // Records every enabled pass with one batched barrier in front of each
+    void Execute(VkCommandBuffer cmd);
+
+    // Passes, their accesses, image lifetimes, aliasing and the barriers recorded by the last Execute()
+    std::string Dump();
+
+    void Cleanup();
+}
\ No newline at end of file
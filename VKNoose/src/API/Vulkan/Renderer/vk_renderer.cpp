@@ -3,26 +3,37 @@
 #include "API/Vulkan/Managers/vk_device_manager.h"
 #include "API/Vulkan/Managers/vk_memory_manager.h"
 #include "API/Vulkan/Managers/vk_resource_manager.h"
+#include "API/Vulkan/Managers/vk_shader_compiler.h"
 #include "API/Vulkan/Renderer/vk_device_addresses.h"
 #include "API/Vulkan/Renderer/vk_descriptor_indices.h"
 
 #include "AssetManagement/Assetmanager.h"
 
+#include "Hell/Core/FrameArena.h"
 #include "Hell/Core/Logging.h"
 #include "Hell/Constants.h"
 #include "Hell/Types.h"
 
+#include <deque>
+
 namespace VulkanRenderer {
 	void CreateFrameData();
 	void CreatePipelines();
 	void CreateRenderTargets();
 	void CreateSamplers();
+	VkFormat GetSupportedStorageFormat(VkFormat format, VkFormat fallback);
 	void CreateStaticDescriptorSet();
 	void LoadShaders();
 	void UpdateStaticDescriptorSet();
 
+	struct DeferredDestroy {
+		uint64_t frameNumber;
+		std::function<void()> destroyFunction;
+	};
+
 	VulkanFrameData g_frameData[FRAME_OVERLAP];
-	uint32_t g_frameNumber = 0;
+	uint64_t g_frameNumber = 0;
+	std::deque<DeferredDestroy> g_deferredDestroys;
 
 	uint64_t g_staticDescriptorSet = 0;
 
@@ -42,21 +53,32 @@ namespace VulkanRenderer {
 	}
 
 	void LoadShaders() {
-		VulkanResourceManager::CreateShader("TextBlitter", { "vk_text_blitter.vert", "vk_text_blitter.frag" });
-		VulkanResourceManager::CreateShader("SolidColor", { "vk_solid_color.vert", "vk_solid_color.frag" });
-		VulkanResourceManager::CreateShader("GBuffer", { "vk_gbuffer.vert", "vk_gbuffer.frag" });
-		VulkanResourceManager::CreateShader("Composite", { "vk_composite.vert", "vk_composite.frag" });
-
-		// Path Tracer Raytracing Shaders
-		VulkanResourceManager::CreateShader("Path_RayGen", { "path_raygen.rgen" });
-		VulkanResourceManager::CreateShader("Path_Miss", { "path_miss.rmiss" });
-		VulkanResourceManager::CreateShader("Path_Shadow", { "path_shadow.rmiss" });
-		VulkanResourceManager::CreateShader("Path_Hit", { "path_closesthit.rchit" });
-
-		// Mouse Pick Raytracing Shaders
-		VulkanResourceManager::CreateShader("Mouse_RayGen", { "mousepick_raygen.rgen" });
-		VulkanResourceManager::CreateShader("Mouse_Miss", { "mousepick_miss.rmiss" });
-		VulkanResourceManager::CreateShader("Mouse_Hit", { "mousepick_closesthit.rchit" });
+		const std::vector<std::pair<std::string, std::vector<std::string>>> shaders = {
+			{ "TextBlitter", { "vk_text_blitter.vert", "vk_text_blitter.frag" } },
+			{ "SolidColor", { "vk_solid_color.vert", "vk_solid_color.frag" } },
+			{ "GBuffer", { "vk_gbuffer.vert", "vk_gbuffer.frag" } },
+			{ "GBufferCull", { "vk_gbuffer_cull.comp" } },
+			{ "Composite", { "vk_composite.vert", "vk_composite.frag" } },
+
+			// Path Tracer Raytracing Shaders
+			{ "Path_RayGen", { "path_raygen.rgen" } },
+			{ "Path_Miss", { "path_miss.rmiss" } },
+			{ "Path_Shadow", { "path_shadow.rmiss" } },
+			{ "Path_Hit", { "path_closesthit.rchit" } }
+		};
+
+		// Resolve every stage up front in parallel, so creating the modules below only hits the cache
+		std::vector<VulkanShaderCompiler::CompileRequest> requests;
+		for (const auto& [name, filenames] : shaders) {
+			for (const std::string& filename : filenames) {
+				requests.push_back({ "res/shaders/Vulkan/" + filename, VulkanShaderCompiler::GetStageFromFilename(filename) });
+			}
+		}
+		VulkanShaderCompiler::CompileBatch(requests);
+
+		for (const auto& [name, filenames] : shaders) {
+			VulkanResourceManager::CreateShader(name, filenames);
+		}
 	}
 
 	void CreateSamplers() {
@@ -67,6 +89,18 @@ namespace VulkanRenderer {
 		VulkanResourceManager::CreateSampler("Nearest", VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, maxAnisotropy);
 	}
 
+	VkFormat GetSupportedStorageFormat(VkFormat format, VkFormat fallback) {
+		// Storage support for the packed formats is optional, RGBA16F is guaranteed
+		VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(VulkanDeviceManager::GetPhysicalDevice(), format, &properties);
+		if ((properties.optimalTilingFeatures & requiredFeatures) == requiredFeatures) {
+			return format;
+		}
+		Logging::Warning() << "VulkanRenderer: storage images not supported for format " << (int)format << ", falling back to " << (int)fallback << "\n";
+		return fallback;
+	}
+
 	void CreateRenderTargets() {
 		// Present resoltion
 		uint32_t width = PRESENT_WIDTH;
@@ -80,21 +114,39 @@ namespace VulkanRenderer {
 		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		VulkanResourceManager::CreateAllocatedImage("LoadingScreen", 1024, 576, VK_FORMAT_R8G8B8A8_UNORM, usage);
 
-		// Raytracing Storage Images (Using R32G32B32A32_SFLOAT to match shader expectations)
-		VulkanResourceManager::CreateAllocatedImage("RT_FirstHit_Color", rtWidth, rtHeight, VK_FORMAT_R32G32B32A32_SFLOAT, usage);
-		VulkanResourceManager::CreateAllocatedImage("RT_FirstHit_Normals", rtWidth, rtHeight, VK_FORMAT_R32G32B32A32_SFLOAT, usage);
-		VulkanResourceManager::CreateAllocatedImage("RT_FirstHit_BaseColor", rtWidth, rtHeight, VK_FORMAT_R32G32B32A32_SFLOAT, usage);
-		VulkanResourceManager::CreateAllocatedImage("RT_SecondHit_Color", rtWidth, rtHeight, VK_FORMAT_R32G32B32A32_SFLOAT, usage);
+		// Raytracing Storage Images. path_raygen.rgen writes them without a format qualifier and always stores
+		// octahedral normals and sRGB encoded base color, so only the precision changes with RT_TARGET_PACKING.
+		VkImageUsageFlags rtUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VkFormat radianceFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+		VkFormat normalsFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+		VkFormat baseColorFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+#if RT_TARGET_PACKING == RT_PACKING_RGBA16F
+		radianceFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+#elif RT_TARGET_PACKING == RT_PACKING_R11G11B10
+		radianceFormat = GetSupportedStorageFormat(VK_FORMAT_B10G11R11_UFLOAT_PACK32, VK_FORMAT_R16G16B16A16_SFLOAT);
+#endif
+#if RT_TARGET_PACKING != RT_PACKING_FULL
+		normalsFormat = GetSupportedStorageFormat(VK_FORMAT_R16G16_SNORM, VK_FORMAT_R16G16B16A16_SFLOAT);
+		baseColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+#endif
+		// Nothing reads these past the composite, so they are transient and share memory with later targets.
+		VulkanResourceManager::CreateAllocatedImage("RT_FirstHit_Color", rtWidth, rtHeight, radianceFormat, rtUsage, true);
+		VulkanResourceManager::CreateAllocatedImage("RT_FirstHit_Normals", rtWidth, rtHeight, normalsFormat, rtUsage, true);
+		VulkanResourceManager::CreateAllocatedImage("RT_FirstHit_BaseColor", rtWidth, rtHeight, baseColorFormat, rtUsage, true);
+		VulkanResourceManager::CreateAllocatedImage("RT_SecondHit_Color", rtWidth, rtHeight, radianceFormat, rtUsage, true);
+
+		// CPU denoiser output, uploaded by VulkanDenoiseManager
+		VulkanResourceManager::CreateAllocatedImage("Denoise_A", rtWidth, rtHeight, VK_FORMAT_R16G16B16A16_SFLOAT, rtUsage);
 
 		// GBuffer Targets
 		VulkanResourceManager::CreateAllocatedImage("GBuffer_BaseColor", rtWidth, rtHeight, VK_FORMAT_R8G8B8A8_UNORM, usage);
 		VulkanResourceManager::CreateAllocatedImage("GBuffer_Normal", rtWidth, rtHeight, VK_FORMAT_R8G8B8A8_UNORM, usage);
 		VulkanResourceManager::CreateAllocatedImage("GBuffer_RMA", rtWidth, rtHeight, VK_FORMAT_R8G8B8A8_UNORM, usage);
 
-		// UI and Display Targets
+		// UI and Display Targets. The path tracer samples last frame's LaptopDisplay, so it can't be transient.
 		VulkanResourceManager::CreateAllocatedImage("LaptopDisplay", LAPTOP_DISPLAY_WIDTH, LAPTOP_DISPLAY_HEIGHT, VK_FORMAT_R8G8B8A8_UNORM, usage);
-		VulkanResourceManager::CreateAllocatedImage("Composite", rtWidth, rtHeight, VK_FORMAT_R8G8B8A8_UNORM, usage);
-		VulkanResourceManager::CreateAllocatedImage("Present", width, height, VK_FORMAT_R8G8B8A8_UNORM, usage);
+		VulkanResourceManager::CreateAllocatedImage("Composite", rtWidth, rtHeight, VK_FORMAT_R8G8B8A8_UNORM, usage, true);
+		VulkanResourceManager::CreateAllocatedImage("Present", width, height, VK_FORMAT_R8G8B8A8_UNORM, usage, true);
 
 		// Depth Targets
 		VkImageUsageFlags depthUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
@@ -265,11 +317,36 @@ namespace VulkanRenderer {
 	}
 
 	uint32_t GetCurrentFrameIndex() {
-		return g_frameNumber % FRAME_OVERLAP;
+		return (uint32_t)(g_frameNumber % FRAME_OVERLAP);
+	}
+
+	uint64_t GetFrameNumber() {
+		return g_frameNumber;
 	}
 
 	void IncrementFrame() {
 		g_frameNumber++;
+		FrameArena::Reset(GetCurrentFrameIndex());
+	}
+
+	void DeferDestroy(std::function<void()>&& destroyFunction) {
+		g_deferredDestroys.push_back({ g_frameNumber, std::move(destroyFunction) });
+	}
+
+	void ProcessDeferredDestroys() {
+		// Call after the render fence wait, by then every frame older than FRAME_OVERLAP has retired
+		while (!g_deferredDestroys.empty() && g_deferredDestroys.front().frameNumber + FRAME_OVERLAP <= g_frameNumber) {
+			g_deferredDestroys.front().destroyFunction();
+			g_deferredDestroys.pop_front();
+		}
+	}
+
+	void FlushDeferredDestroys() {
+		// Expects the device to be idle
+		for (DeferredDestroy& deferredDestroy : g_deferredDestroys) {
+			deferredDestroy.destroyFunction();
+		}
+		g_deferredDestroys.clear();
 	}
 
 	VulkanDescriptorSet& GetStaticDescriptorSet() {
@@ -2,6 +2,7 @@
 #include "API/Vulkan/Renderer/vk_frame_data.h"
 #include "API/Vulkan/Types/vk_descriptor_set.h"
 #include "API/Vulkan/Types/vk_buffer.h"
+#include <functional>
 
 namespace VulkanRenderer {
     bool Init();
@@ -18,8 +19,14 @@ namespace VulkanRenderer {
     VulkanFrameData& GetCurrentFrameData();
     VulkanFrameData& GetFrameDataByIndex(uint32_t frameIndex);
     uint32_t GetCurrentFrameIndex();
+    uint64_t GetFrameNumber();
     void IncrementFrame();
 
+    // Destruction of objects that frames still in flight may reference, run once FRAME_OVERLAP frames have passed
+    void DeferDestroy(std::function<void()>&& destroyFunction);
+    void ProcessDeferredDestroys();
+    void FlushDeferredDestroys();
+
     // Descriptor sets
     void UpdateDynamicDescriptorSet();
 
@@ -1,10 +1,12 @@
 #include "vk_allocated_image.h"
 #include "API/Vulkan/vk_utils.h"
+#include "API/Vulkan/Managers/vk_memory_manager.h"
 
-AllocatedImage::AllocatedImage(VkDevice device, VmaAllocator allocator, VkFormat imageFormat, VkExtent3D imageExtent, VkImageUsageFlags usage, std::string debugName) {
+AllocatedImage::AllocatedImage(VkDevice device, VmaAllocator allocator, VkFormat imageFormat, VkExtent3D imageExtent, VkImageUsageFlags usage, std::string debugName, bool transient) {
     m_format = imageFormat;
     m_extent = imageExtent;
     m_currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    m_transient = transient;
 
     VkImageCreateInfo imageInfo = {};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -18,24 +20,18 @@ AllocatedImage::AllocatedImage(VkDevice device, VmaAllocator allocator, VkFormat
     imageInfo.usage = usage;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-    VmaAllocationCreateInfo allocInfo = {};
-    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-    allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-
-    vmaCreateImage(allocator, &imageInfo, &allocInfo, &m_image, &m_allocation, nullptr);
-
-    VkImageViewCreateInfo viewInfo = {};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.image = m_image;
-    viewInfo.format = m_format;
-    viewInfo.subresourceRange.aspectMask = VulkanUtils::GetImageAspectFlagsFromFormat(m_format);
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
-
-    vkCreateImageView(device, &viewInfo, nullptr, &m_imageView);
+    if (m_transient) {
+        vkCreateImage(device, &imageInfo, nullptr, &m_image);
+    }
+    else {
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+        vmaCreateImage(allocator, &imageInfo, &allocInfo, &m_image, &m_allocation, nullptr);
+        VulkanMemoryManager::TrackAllocation(m_allocation, MemoryCategory::RENDER_TARGETS);
+        CreateImageView(device);
+    }
 
     VkDebugUtilsObjectNameInfoEXT nameInfo = {};
     nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
@@ -55,6 +51,7 @@ AllocatedImage::AllocatedImage(AllocatedImage&& other) noexcept {
     m_allocation = other.m_allocation;
     m_extent = other.m_extent;
     m_format = other.m_format;
+    m_transient = other.m_transient;
     m_currentLayout = other.m_currentLayout;
     m_currentAccessMask = other.m_currentAccessMask;
     m_currentStageFlags = other.m_currentStageFlags;
@@ -72,6 +69,7 @@ AllocatedImage& AllocatedImage::operator=(AllocatedImage&& other) noexcept {
         m_allocation = other.m_allocation;
         m_extent = other.m_extent;
         m_format = other.m_format;
+        m_transient = other.m_transient;
         m_currentLayout = other.m_currentLayout;
         m_currentAccessMask = other.m_currentAccessMask;
         m_currentStageFlags = other.m_currentStageFlags;
@@ -110,11 +108,44 @@ void AllocatedImage::TransitionLayout(VkCommandBuffer cmd, VkImageLayout newLayo
     m_currentStageFlags = dstStage;
 }
 
+VkMemoryRequirements AllocatedImage::GetMemoryRequirements(VkDevice device) const {
+    VkMemoryRequirements requirements = {};
+    vkGetImageMemoryRequirements(device, m_image, &requirements);
+    return requirements;
+}
+
+void AllocatedImage::BindMemory(VkDevice device, VmaAllocator allocator, VmaAllocation allocation, VkDeviceSize offset) {
+    vmaBindImageMemory2(allocator, allocation, offset, m_image, nullptr);
+    CreateImageView(device);
+}
+
+void AllocatedImage::SetCurrentState(VkImageLayout layout, VkAccessFlags accessMask, VkPipelineStageFlags stageFlags) {
+    m_currentLayout = layout;
+    m_currentAccessMask = accessMask;
+    m_currentStageFlags = stageFlags;
+}
+
+void AllocatedImage::CreateImageView(VkDevice device) {
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.image = m_image;
+    viewInfo.format = m_format;
+    viewInfo.subresourceRange.aspectMask = VulkanUtils::GetImageAspectFlagsFromFormat(m_format);
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    vkCreateImageView(device, &viewInfo, nullptr, &m_imageView);
+}
+
 void AllocatedImage::Cleanup(VkDevice device, VmaAllocator allocator) {
     if (m_imageView != VK_NULL_HANDLE) {
         vkDestroyImageView(device, m_imageView, nullptr);
     }
     if (m_image != VK_NULL_HANDLE) {
+        VulkanMemoryManager::UntrackAllocation(m_allocation);
         vmaDestroyImage(allocator, m_image, m_allocation);
     }
 }
\ No newline at end of file
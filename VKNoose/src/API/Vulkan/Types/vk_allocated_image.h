@@ -5,7 +5,8 @@
 
 struct AllocatedImage {
     AllocatedImage() = default;
-    AllocatedImage(VkDevice device, VmaAllocator allocator, VkFormat imageFormat, VkExtent3D imageExtent, VkImageUsageFlags usage, std::string debugName);
+    // Transient images are created without memory or a view, VulkanRenderGraph binds them into memory shared with other transient images
+    AllocatedImage(VkDevice device, VmaAllocator allocator, VkFormat imageFormat, VkExtent3D imageExtent, VkImageUsageFlags usage, std::string debugName, bool transient = false);
     AllocatedImage(const AllocatedImage&) = delete;
     AllocatedImage& operator=(const AllocatedImage&) = delete;
     AllocatedImage(AllocatedImage&& other) noexcept;
@@ -14,6 +15,12 @@ struct AllocatedImage {
     void TransitionLayout(VkCommandBuffer cmd, VkImageLayout newLayout, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
     void Cleanup(VkDevice device, VmaAllocator allocator);
 
+    VkMemoryRequirements GetMemoryRequirements(VkDevice device) const;
+    void BindMemory(VkDevice device, VmaAllocator allocator, VmaAllocation allocation, VkDeviceSize offset = 0);
+
+    // For code that batches its own barriers, keeps TransitionLayout() in sync with what was recorded
+    void SetCurrentState(VkImageLayout layout, VkAccessFlags accessMask, VkPipelineStageFlags stageFlags);
+
     int32_t GetWidth() const            { return m_extent.width; }
     int32_t GetHeight() const           { return m_extent.height; }
     int32_t GetDepth() const            { return m_extent.depth; }
@@ -22,6 +29,12 @@ struct AllocatedImage {
     VkImage GetImage() const            { return m_image; }
     VkImageView GetImageView() const    { return m_imageView; }
     VmaAllocation GetAllocation() const { return m_allocation; }
+    bool IsTransient() const            { return m_transient; }
+    bool HasMemory() const              { return m_imageView != VK_NULL_HANDLE; }
+
+    VkImageLayout GetCurrentLayout() const              { return m_currentLayout; }
+    VkAccessFlags GetCurrentAccessMask() const          { return m_currentAccessMask; }
+    VkPipelineStageFlags GetCurrentStageFlags() const   { return m_currentStageFlags; }
 
 private:
     VkImage m_image = VK_NULL_HANDLE;
@@ -29,8 +42,11 @@ private:
     VmaAllocation m_allocation = VK_NULL_HANDLE;
     VkExtent3D m_extent = {};
     VkFormat m_format = VK_FORMAT_UNDEFINED;
+    bool m_transient = false;
 
     VkImageLayout m_currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     VkAccessFlags m_currentAccessMask = 0;
     VkPipelineStageFlags m_currentStageFlags = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+    void CreateImageView(VkDevice device);
 };
\ No newline at end of file
@@ -4,6 +4,25 @@
 #include "API/Vulkan/Managers/vk_command_manager.h"
 #include "Hell/Core/Logging.h"
 
+namespace {
+    // Buffers don't say what they're for, so go by the usage flags they were created with
+    MemoryCategory GetMemoryCategory(VkBufferUsageFlags usage, VmaAllocationCreateFlags vmaFlags) {
+        const VkBufferUsageFlags transferOnly = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        const VmaAllocationCreateFlags hostAccess = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+        const VkBufferUsageFlags scratch = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+        if (usage & VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR) return MemoryCategory::ACCELERATION_STRUCTURES;
+        if (usage & VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR) {
+            // Vertex and index data is also read by the hit shaders, instance and transform data only by the build
+            return (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) ? MemoryCategory::GEOMETRY : MemoryCategory::ACCELERATION_STRUCTURES;
+        }
+        if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) return MemoryCategory::GEOMETRY;
+        if (usage == scratch) return MemoryCategory::ACCELERATION_STRUCTURES;
+        if ((vmaFlags & hostAccess) && !(usage & ~transferOnly)) return MemoryCategory::STAGING;
+        return MemoryCategory::OTHER;
+    }
+}
+
 VulkanBuffer::VulkanBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags vmaFlags) {
     m_size = size;
 
@@ -17,6 +36,7 @@ VulkanBuffer::VulkanBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemor
 
     VmaAllocationInfo allocInfo; // Capture this to get the pointer
     vmaCreateBuffer(VulkanMemoryManager::GetAllocator(), &bufferInfo, &vmaAllocInfo, &m_buffer, &m_allocation, &allocInfo);
+    VulkanMemoryManager::TrackAllocation(m_allocation, GetMemoryCategory(usage, vmaFlags));
 
     // If you requested the buffer to be mapped at creation, store the pointer
     if (vmaFlags & VMA_ALLOCATION_CREATE_MAPPED_BIT) {
@@ -46,6 +66,7 @@ VulkanBuffer& VulkanBuffer::operator=(VulkanBuffer&& other) noexcept {
 
 void VulkanBuffer::Cleanup() {
     if (m_buffer != VK_NULL_HANDLE) {
+        VulkanMemoryManager::UntrackAllocation(m_allocation);
         vmaDestroyBuffer(VulkanMemoryManager::GetAllocator(), m_buffer, m_allocation);
         m_buffer = VK_NULL_HANDLE;
         m_allocation = VK_NULL_HANDLE;
@@ -55,11 +76,20 @@ void VulkanBuffer::Cleanup() {
 }
 
 void VulkanBuffer::UpdateData(const void* data, VkDeviceSize size) {
+    UpdateData(data, 0, size);
+}
+
+void VulkanBuffer::UpdateData(const void* data, VkDeviceSize offset, VkDeviceSize size) {
     if (size == 0) return;
 
+    if (offset + size > m_size) {
+        Logging::Error() << "VulkanBuffer::UpdateData(..) failed because " << offset << " + " << size << " bytes is past the end of a " << m_size << " byte buffer\n";
+        return;
+    }
+
     // Use the direct mapping path if the pointer exists
     if (m_mappedPtr) {
-        memcpy(m_mappedPtr, data, size);
+        memcpy((uint8_t*)m_mappedPtr + offset, data, size);
 
         // Ensure changes are visible to the GPU if memory is not coherent
         // Most desktop GPUs are coherent, but this keeps it portable
@@ -70,7 +100,7 @@ void VulkanBuffer::UpdateData(const void* data, VkDeviceSize size) {
         vmaGetMemoryTypeProperties(VulkanMemoryManager::GetAllocator(), allocInfo.memoryType, &memFlags);
 
         if (!(memFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
-            vmaFlushAllocation(VulkanMemoryManager::GetAllocator(), m_allocation, 0, size);
+            vmaFlushAllocation(VulkanMemoryManager::GetAllocator(), m_allocation, offset, size);
         }
     }
     else {
@@ -93,6 +123,7 @@ void VulkanBuffer::UploadData(const void* data, VkDeviceSize size) {
     VmaAllocation stagingAlloc;
     VmaAllocationInfo stagingResult;
     vmaCreateBuffer(VulkanMemoryManager::GetAllocator(), &stagingInfo, &stagingAllocInfo, &stagingBuffer, &stagingAlloc, &stagingResult);
+    VulkanMemoryManager::TrackAllocation(stagingAlloc, MemoryCategory::STAGING);
 
     // Copy to the temporary staging memory
     memcpy(stagingResult.pMappedData, data, size);
@@ -113,6 +144,7 @@ void VulkanBuffer::UploadData(const void* data, VkDeviceSize size) {
         vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
         });
 
+    VulkanMemoryManager::UntrackAllocation(stagingAlloc);
     vmaDestroyBuffer(VulkanMemoryManager::GetAllocator(), stagingBuffer, stagingAlloc);
 }
 
@@ -133,6 +165,19 @@ void VulkanBuffer::Unmap() {
     }
 }
 
+void VulkanBuffer::Invalidate(VkDeviceSize offset, VkDeviceSize size) {
+    // Make GPU writes visible to the host if the memory is not coherent
+    VmaAllocationInfo allocInfo;
+    vmaGetAllocationInfo(VulkanMemoryManager::GetAllocator(), m_allocation, &allocInfo);
+
+    VkMemoryPropertyFlags memFlags;
+    vmaGetMemoryTypeProperties(VulkanMemoryManager::GetAllocator(), allocInfo.memoryType, &memFlags);
+
+    if (!(memFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        vmaInvalidateAllocation(VulkanMemoryManager::GetAllocator(), m_allocation, offset, size);
+    }
+}
+
 uint64_t VulkanBuffer::GetDeviceAddress() const {
     VkBufferDeviceAddressInfo addressInfo{ VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
     addressInfo.buffer = m_buffer;
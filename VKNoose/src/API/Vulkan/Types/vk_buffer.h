@@ -16,9 +16,11 @@ struct VulkanBuffer {
     void Cleanup();
 
     void UpdateData(const void* data, VkDeviceSize size);
+    void UpdateData(const void* data, VkDeviceSize offset, VkDeviceSize size);
     void UploadData(const void* data, VkDeviceSize size);
     void Map(void** data);
     void Unmap();
+    void Invalidate(VkDeviceSize offset, VkDeviceSize size);
 
     uint64_t GetDeviceAddress() const;
     VkDescriptorBufferInfo GetDescriptorInfo() const;
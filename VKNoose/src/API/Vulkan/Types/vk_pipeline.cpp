@@ -1,5 +1,7 @@
 #include "vk_pipeline.h"
+#include "API/Vulkan/Managers/vk_pipeline_cache_manager.h"
 #include <array>
+#include <chrono>
 
 bool VulkanPipeline::CheckResult(VkResult result, const std::string& message) {
     if (result != VK_SUCCESS) {
@@ -9,6 +11,10 @@ bool VulkanPipeline::CheckResult(VkResult result, const std::string& message) {
     return true;
 }
 
+void VulkanPipeline::SetName(const std::string& name) {
+    m_name = name;
+}
+
 void VulkanPipeline::PushDescriptorSetLayout(VkDescriptorSetLayout layout) {
     m_descriptorLayouts.push_back(layout);
 }
@@ -46,8 +52,11 @@ void VulkanPipeline::SetDepthTest(bool enabled, bool writeEnabled) {
     m_depthWrite = writeEnabled;
 }
 
-bool VulkanPipeline::Build(VkDevice device, VkShaderModule vertShader, VkShaderModule fragShader, uint32_t colorAttachmentCount, VkFormat colorFormat) {
-    // Pipeline Layout
+void VulkanPipeline::SetDepthFormat(VkFormat format) {
+    m_depthFormat = format;
+}
+
+bool VulkanPipeline::CreateLayout(VkDevice device) {
     VkPipelineLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     layoutInfo.setLayoutCount = (uint32_t)m_descriptorLayouts.size();
@@ -55,7 +64,12 @@ bool VulkanPipeline::Build(VkDevice device, VkShaderModule vertShader, VkShaderM
     layoutInfo.pushConstantRangeCount = (uint32_t)m_pushConstants.size();
     layoutInfo.pPushConstantRanges = m_pushConstants.data();
 
-    if (!CheckResult(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &m_layout), "Failed to create pipeline layout")) {
+    return CheckResult(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &m_layout), "Failed to create pipeline layout");
+}
+
+bool VulkanPipeline::Build(VkDevice device, VkShaderModule vertShader, VkShaderModule fragShader, uint32_t colorAttachmentCount, VkFormat colorFormat) {
+    // Pipeline Layout
+    if (!CreateLayout(device)) {
         return false;
     }
 
@@ -130,11 +144,13 @@ bool VulkanPipeline::Build(VkDevice device, VkShaderModule vertShader, VkShaderM
         colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
     }
 
+    std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(colorAttachmentCount, colorBlendAttachment);
+
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
+    colorBlending.attachmentCount = colorAttachmentCount;
+    colorBlending.pAttachments = colorBlendAttachments.data();
 
     // Dynamic State
     std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
@@ -144,15 +160,18 @@ bool VulkanPipeline::Build(VkDevice device, VkShaderModule vertShader, VkShaderM
     dynamicStateInfo.pDynamicStates = dynamicStates.data();
 
     // Dynamic Rendering Info
+    std::vector<VkFormat> colorFormats(colorAttachmentCount, colorFormat);
+
     VkPipelineRenderingCreateInfo renderingInfo{};
     renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
     renderingInfo.colorAttachmentCount = colorAttachmentCount;
-    renderingInfo.pColorAttachmentFormats = &colorFormat;
+    renderingInfo.pColorAttachmentFormats = colorFormats.data();
+    renderingInfo.depthAttachmentFormat = m_depthFormat;
 
     // Final Creation
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.pNext = &renderingInfo;
+    pipelineInfo.pNext = VulkanPipelineCacheManager::BeginPipelineCreation(&renderingInfo);
     pipelineInfo.stageCount = 2;
     pipelineInfo.pStages = shaderStages.data();
     pipelineInfo.pVertexInputState = &vertexInputInfo;
@@ -166,7 +185,38 @@ bool VulkanPipeline::Build(VkDevice device, VkShaderModule vertShader, VkShaderM
     pipelineInfo.layout = m_layout;
     pipelineInfo.renderPass = VK_NULL_HANDLE;
 
-    return CheckResult(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_handle), "Failed to create graphics pipeline");
+    auto startTime = std::chrono::steady_clock::now();
+    VkResult result = vkCreateGraphicsPipelines(device, VulkanPipelineCacheManager::GetPipelineCache(), 1, &pipelineInfo, nullptr, &m_handle);
+    float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    if (result == VK_SUCCESS) {
+        VulkanPipelineCacheManager::LogPipelineCreation(m_name, milliseconds);
+    }
+    return CheckResult(result, "Failed to create graphics pipeline");
+}
+
+bool VulkanPipeline::BuildCompute(VkDevice device, VkShaderModule computeShader) {
+    if (!CreateLayout(device)) {
+        return false;
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = VulkanPipelineCacheManager::BeginPipelineCreation(nullptr);
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = computeShader;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_layout;
+
+    auto startTime = std::chrono::steady_clock::now();
+    VkResult result = vkCreateComputePipelines(device, VulkanPipelineCacheManager::GetPipelineCache(), 1, &pipelineInfo, nullptr, &m_handle);
+    float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    if (result == VK_SUCCESS) {
+        VulkanPipelineCacheManager::LogPipelineCreation(m_name, milliseconds);
+    }
+    return CheckResult(result, "Failed to create compute pipeline");
 }
 
 void VulkanPipeline::Cleanup(VkDevice device) {
@@ -24,6 +24,8 @@ struct  VulkanPipeline {
     void SetCullMode(VkCullModeFlags cullMode);
     void SetColorBlending(bool enabled);
     void SetDepthTest(bool enabled, bool writeEnabled = true);
+    void SetDepthFormat(VkFormat format);
+    void SetName(const std::string& name);
 
     template<typename T>
     void SetVertexDescription() {
@@ -31,7 +33,9 @@ struct  VulkanPipeline {
         m_attributeDescriptions = VulkanVertexDescription<T>::GetAttributes();
     }
 
+    // Every color attachment shares colorFormat
     bool Build(VkDevice device, VkShaderModule vertShader, VkShaderModule fragShader, uint32_t colorAttachmentCount, VkFormat colorFormat);
+    bool BuildCompute(VkDevice device, VkShaderModule computeShader);
     void Cleanup(VkDevice device);
 
     VkPipeline GetHandle() const { return m_handle; }
@@ -39,7 +43,9 @@ struct  VulkanPipeline {
 
 private:
     bool CheckResult(VkResult result, const std::string& message);
+    bool CreateLayout(VkDevice device);
 
+    std::string m_name = "Unnamed";
     VkPipeline m_handle = VK_NULL_HANDLE;
     VkPipelineLayout m_layout = VK_NULL_HANDLE;
 
@@ -52,6 +58,7 @@ private:
     bool m_colorBlending = false;
     bool m_depthTest = true;
     bool m_depthWrite = true;
+    VkFormat m_depthFormat = VK_FORMAT_UNDEFINED;
 
     VkVertexInputBindingDescription m_bindingDescription{};
     std::vector<VkVertexInputAttributeDescription> m_attributeDescriptions;
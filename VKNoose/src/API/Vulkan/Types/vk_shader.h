@@ -42,6 +42,7 @@ struct VulkanShader {
     VkShaderModule GetComputeShader();
     VkShaderModule GetTesselationControlShader();
     VkShaderModule GetTesselationEvaluationShader();
+    const std::vector<VulkanShaderModule>& GetModules() const { return m_modules; }
 
 private:
     std::vector<VulkanShaderModule> m_modules;
@@ -1,6 +1,9 @@
 #include "vk_backend.h"
+#include <algorithm>
 #include <chrono> 
+#include <filesystem>
 #include <fstream> 
+#include <future>
 #include "vk_types.h"
 #include "vk_initializers.h"
 #include "vk_textures.h"
@@ -12,19 +15,30 @@
 #include "Game/Laptop.h"
 #include "Renderer/RasterRenderer.h"
 #include "Profiler.h"
+#include "Hell/Core/HeapProfiler.h"
+#include "Hell/Core/JobSystem.h"
 
 #include "API/Vulkan/Managers/vk_command_manager.h"
+#include "API/Vulkan/Managers/vk_culling_manager.h"
 #include "API/Vulkan/Managers/vk_device_manager.h"
 #include "API/Vulkan/Managers/vk_descriptor_manager.h"
+#include "API/Vulkan/Managers/vk_dynamic_resolution_manager.h"
+#include "API/Vulkan/Managers/vk_denoise_manager.h"
 #include "API/Vulkan/Managers/vk_instance_manager.h"
 #include "API/Vulkan/Managers/vk_memory_manager.h"
 #include "API/Vulkan/Managers/vk_raytracing_manager.h"
+#include "API/Vulkan/Managers/vk_pipeline_cache_manager.h"
 #include "API/Vulkan/Managers/vk_pipeline_manager.h"
+#include "API/Vulkan/Managers/vk_readback_manager.h"
 #include "API/Vulkan/Managers/vk_resource_manager.h"
+#include "API/Vulkan/Managers/vk_shader_compiler.h"
+#include "API/Vulkan/Managers/vk_shader_hotload_manager.h"
 #include "API/Vulkan/Managers/vk_swapchain_manager.h"
 #include "API/Vulkan/Managers/vk_sync_manager.h"
+#include "API/Vulkan/Managers/vk_timestamp_manager.h"
 
 #include "API/Vulkan/Renderer/vk_descriptor_indices.h"
+#include "API/Vulkan/Renderer/vk_render_graph.h"
 #include "API/Vulkan/Renderer/vk_renderer.h"
 
 #include "BackEnd/GLFWIntegration.h"
@@ -53,11 +67,120 @@ namespace VulkanBackEnd {
 // Will become VulkanRenderer:
 namespace VulkanBackEnd {
 	void BlitAllocatedImageToSwapchain(VkCommandBuffer cmd, AllocatedImage& srcImage, uint32_t swapchainIndex);
+	void UpdateTextureDescriptors();
+	void UpdateGeometryDescriptors();
 
 	uint64_t g_vertexBuffer = 0;
 	uint64_t g_indexBuffer = 0;
-	uint64_t g_mousePickBufferCPU = 0;
-	uint64_t g_mousePickBufferGPU = 0;
+	bool g_geometryDescriptorsWritten = false;    // Static sets point at g_vertexBuffer/g_indexBuffer, replacing either must rewrite them
+	uint64_t g_transformBuffer = 0;
+	uint32_t g_sceneInstanceCount = 0;
+	std::vector<uint64_t> g_sceneInstanceDirtyBits[FRAME_OVERLAP];    // Slots each frame's copy of the instance buffer hasn't seen yet
+	std::string g_pendingScreenshotPath = "";
+	std::string g_frameDumpDirectory = "";
+	uint32_t g_frameDumpInterval = 0;
+	std::vector<std::future<void>> g_frameDumpJobs;
+
+	// Secondary command buffers recorded on the job system, the jobs and their inputs are reused every frame
+	struct SecondaryRecording {
+		JobSystem::Job job;
+		uint32_t frameIndex = 0;
+		uint32_t threadIndex = 0;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		AllocatedImage* target = nullptr;
+		VulkanPipeline* pipeline = nullptr;
+		VkDescriptorSet descriptorSets[2] = {};
+		RasterRenderer::Destination destination = RasterRenderer::Destination::MAIN_UI;
+		LineShaderPushConstants lineConstants;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		bool submitted = false; // This frame, a finished job from an earlier frame leaves a stale commandBuffer behind
+	};
+
+	// Set by build_rt_command_buffers() each frame for the render graph passes declared in BuildRenderGraph()
+	uint32_t g_swapchainIndex = 0;
+	SecondaryRecording g_laptopUIRecording;
+	SecondaryRecording g_mainUIRecording;
+	SecondaryRecording g_debugLinesRecording;
+
+	void RecordUIDraws(void* userData) {
+		SecondaryRecording& recording = *static_cast<SecondaryRecording*>(userData);
+		VkCommandBuffer cmd = VulkanCommandManager::BeginSecondaryCommandBuffer(recording.frameIndex, recording.threadIndex, 1, &recording.format);
+		cmd_SetViewportSize(cmd, recording.target->GetWidth(), recording.target->GetHeight());
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, recording.pipeline->GetHandle());
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, recording.pipeline->GetLayout(), 0, 2, recording.descriptorSets, 0, nullptr);
+		RasterRenderer::DrawBatches(cmd, recording.destination);
+		VK_CHECK(vkEndCommandBuffer(cmd));
+		recording.commandBuffer = cmd;
+	}
+
+	void RecordDebugLines(void* userData) {
+		SecondaryRecording& recording = *static_cast<SecondaryRecording*>(userData);
+		VkCommandBuffer cmd = VulkanCommandManager::BeginSecondaryCommandBuffer(recording.frameIndex, recording.threadIndex, 1, &recording.format);
+		cmd_SetViewportSize(cmd, recording.target->GetWidth(), recording.target->GetHeight());
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, recording.pipeline->GetHandle());
+		vkCmdPushConstants(cmd, recording.pipeline->GetLayout(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(LineShaderPushConstants), &recording.lineConstants);
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(cmd, 0, 1, &_lineListVertexBuffer.m_buffer, &offset);
+		vkCmdDraw(cmd, _lineListVertexCount, 1, 0, 0);
+		VK_CHECK(vkEndCommandBuffer(cmd));
+		recording.commandBuffer = cmd;
+	}
+
+	VkCommandBuffer GetRecordedCommandBuffer(SecondaryRecording& recording) {
+		JobSystem::Wait(recording.job);
+		return recording.commandBuffer;
+	}
+
+	bool FrameDumpDue() {
+		return g_frameDumpInterval > 0 && VulkanRenderer::GetFrameNumber() % g_frameDumpInterval == 0;
+	}
+
+	// Also called after a defragmentation pass, moved textures come back with new image views.
+	// Sprites waiting to be packed into an atlas page have no view yet, their slots get the first texture that has one.
+	void UpdateTextureDescriptors() {
+		VulkanDescriptorSet& bindlessSet = VulkanRenderer::GetStaticDescriptorSet();
+		HellDescriptorSet& legacySet = VulkanDescriptorManager::GetStaticDescriptorSet();
+
+		VkImageView fallbackView = VK_NULL_HANDLE;
+		for (int i = 0; i < AssetManager::GetNumberOfTextures() && fallbackView == VK_NULL_HANDLE; i++) {
+			fallbackView = AssetManager::GetTextureImageView(i);
+		}
+		if (fallbackView == VK_NULL_HANDLE) return;
+
+		VkDescriptorImageInfo textureImageInfo[TEXTURE_ARRAY_SIZE];
+		for (uint32_t i = 0; i < TEXTURE_ARRAY_SIZE; ++i) {
+			VkImageView imageView = (i < AssetManager::GetNumberOfTextures()) ? AssetManager::GetTextureImageView(i) : VK_NULL_HANDLE;
+			if (imageView == VK_NULL_HANDLE) {
+				imageView = fallbackView;
+			}
+
+			textureImageInfo[i].sampler = nullptr;
+			textureImageInfo[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			textureImageInfo[i].imageView = imageView;
+
+			bindlessSet.WriteImage(1, imageView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, i);
+		}
+
+		bindlessSet.Update();
+		legacySet.Update(GetDevice(), 1, TEXTURE_ARRAY_SIZE, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, textureImageInfo);
+	}
+
+	// Called by upload_geometry() once the static sets exist, the buffers behind the ids have just been swapped.
+	// BLASes need nothing, their builds copied the geometry out of the old buffers.
+	void UpdateGeometryDescriptors() {
+		VulkanBuffer* vertexBuffer = VulkanResourceManager::GetBuffer(g_vertexBuffer);
+		VulkanBuffer* indexBuffer = VulkanResourceManager::GetBuffer(g_indexBuffer);
+		if (!vertexBuffer || !indexBuffer) return;
+
+		VulkanDescriptorSet& bindlessSet = VulkanRenderer::GetStaticDescriptorSet();
+		HellDescriptorSet& legacySet = VulkanDescriptorManager::GetStaticDescriptorSet();
+
+		legacySet.Update(GetDevice(), 2, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vertexBuffer->GetBuffer());
+		legacySet.Update(GetDevice(), 3, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, indexBuffer->GetBuffer());
+		bindlessSet.WriteBuffer(DESC_IDX_VERTICES, vertexBuffer->GetBuffer(), vertexBuffer->GetSize(), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		bindlessSet.WriteBuffer(DESC_IDX_INDICES, indexBuffer->GetBuffer(), indexBuffer->GetSize(), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		bindlessSet.Update();
+	}
 }
 
 namespace VulkanBackEnd {
@@ -70,8 +193,21 @@ namespace VulkanBackEnd {
 		if (!VulkanSyncManager::Init()) return false;
 		if (!VulkanCommandManager::Init()) return false;
 		if (!VulkanDescriptorManager::Init()) return false;
+		VulkanShaderCompiler::Init();
+		if (!VulkanPipelineCacheManager::Init()) return false;
 		if (!VulkanRenderer::Init()) return false;
 		if (!VulkanPipelineManager::Init()) return false;
+		if (!VulkanReadbackManager::Init()) return false;
+		if (!VulkanCullingManager::Init()) return false;
+		if (!VulkanTimestampManager::Init()) return false;
+		VulkanShaderHotloadManager::Init();
+		if (!VulkanDenoiseManager::Init()) {
+			std::cout << "CPU denoising disabled, VulkanDenoiseManager::Init() failed\n";
+		}
+		VulkanDynamicResolutionManager::Init();
+
+		BuildRenderGraph();
+		if (!VulkanRenderGraph::Compile()) return false;
 
 		AssetManager::Init();
 		AssetManager::LoadFont();
@@ -93,19 +229,7 @@ namespace VulkanBackEnd {
 		bindlessSet.WriteImage(0, VK_NULL_HANDLE, linearSampler->GetSampler(), VK_IMAGE_LAYOUT_UNDEFINED, VK_DESCRIPTOR_TYPE_SAMPLER);
 
 		// All textures
-		VkDescriptorImageInfo textureImageInfo[TEXTURE_ARRAY_SIZE];
-		for (uint32_t i = 0; i < TEXTURE_ARRAY_SIZE; ++i) {
-			VkImageView imageView = (i < AssetManager::GetNumberOfTextures()) ? AssetManager::GetTexture(i)->imageView : AssetManager::GetTexture(0)->imageView;
-
-			textureImageInfo[i].sampler = nullptr;
-			textureImageInfo[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			textureImageInfo[i].imageView = imageView;
-		
-			bindlessSet.WriteImage(1, imageView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, i);
-		}
-
-		bindlessSet.Update();
-		legacySet.Update(GetDevice(), 1, TEXTURE_ARRAY_SIZE, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, textureImageInfo);
+		UpdateTextureDescriptors();
 
 		VulkanBackEnd::ToggleFullscreen();
 
@@ -189,7 +313,16 @@ void VulkanBackEnd::Cleanup() {
 
 	vkDeviceWaitIdle(GetDevice());
 
+	for (std::future<void>& job : g_frameDumpJobs) {
+		job.wait();
+	}
+	g_frameDumpJobs.clear();
+	for (SecondaryRecording* recording : { &g_laptopUIRecording, &g_mainUIRecording, &g_debugLinesRecording }) {
+		JobSystem::Reclaim(recording->job);
+	}
+
 	VulkanResourceManager::Cleanup();
+	VulkanRenderGraph::Cleanup();
 
 	// Cleanup textures properly
 	for (int i = 0; i < AssetManager::GetNumberOfTextures(); i++) {
@@ -202,23 +335,23 @@ void VulkanBackEnd::Cleanup() {
 		}
 	}
 
+	VulkanShaderHotloadManager::Cleanup();
+	VulkanDenoiseManager::Cleanup();
+	VulkanRenderer::FlushDeferredDestroys();
 	VulkanPipelineManager::Cleanup();
+	VulkanReadbackManager::Cleanup();
+	VulkanCullingManager::Cleanup();
+	VulkanTimestampManager::Cleanup();
+	VulkanShaderCompiler::Cleanup();
 
 
 	// Cleanup Raytracing
 	cleanup_raytracing();
+	VulkanPipelineCacheManager::Cleanup();
 
-	// Cleanup Mesh Buffers
-	for (MeshOLD& mesh : AssetManager::GetMeshList()) {
-		vmaDestroyBuffer(GetAllocator(), mesh.m_transformBufferOLD.m_buffer, mesh.m_transformBufferOLD.m_allocation);
-		vmaDestroyBuffer(GetAllocator(), mesh.m_vertexBufferOLD.m_buffer, mesh.m_vertexBufferOLD.m_allocation);
-		if (mesh.m_indexCount > 0) {
-			vmaDestroyBuffer(GetAllocator(), mesh.m_indexBufferOLD.m_buffer, mesh.m_indexBufferOLD.m_allocation);
-		}
-
-		//mesh.m_accelerationStructure.Cleanup();
-	}
-	vmaDestroyBuffer(GetAllocator(), _lineListMesh.m_vertexBufferOLD.m_buffer, _lineListMesh.m_vertexBufferOLD.m_allocation);
+	// Mesh geometry lives in the global buffers owned by VulkanResourceManager
+	VulkanMemoryManager::UntrackAllocation(_lineListVertexBuffer.m_allocation);
+	vmaDestroyBuffer(GetAllocator(), _lineListVertexBuffer.m_buffer, _lineListVertexBuffer.m_allocation);
 
 	VulkanDescriptorManager::Cleanup();
 	VulkanCommandManager::Cleanup();
@@ -249,17 +382,13 @@ void VulkanBackEnd::init_raytracing() {
 		bindlessDynamicSet->GetLayout()
 	};
 
-	_raytracerPath.CreatePipeline(GetDevice(), rtDescriptorSetLayouts, 5);
+	_raytracerPath.CreatePipeline(GetDevice(), rtDescriptorSetLayouts, 5, "Path Tracer");
 	_raytracerPath.CreateShaderBindingTable(GetDevice(), GetAllocator(), _rayTracingPipelineProperties);
-
-	_raytracerMousePick.CreatePipeline(GetDevice(), rtDescriptorSetLayouts, 5);
-	_raytracerMousePick.CreateShaderBindingTable(GetDevice(), GetAllocator(), _rayTracingPipelineProperties);
 }
 
 
 void VulkanBackEnd::cleanup_raytracing() {
 	_raytracerPath.Cleanup(GetDevice(), GetAllocator());
-	_raytracerMousePick.Cleanup(GetDevice(), GetAllocator());
 }
 
 void VulkanBackEnd::RecordAssetLoadingRenderCommands(VkCommandBuffer commandBuffer) {
@@ -307,11 +436,7 @@ void VulkanBackEnd::RecordAssetLoadingRenderCommands(VkCommandBuffer commandBuff
 	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, textBlitterPipeline->GetLayout(), 0, 1, &dynamicSet.handle, 0, nullptr);
 	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, textBlitterPipeline->GetLayout(), 1, 1, &staticSet.handle, 0, nullptr);
 
-	for (int i = 0; i < RasterRenderer::instanceCount; i++) {
-		if (RasterRenderer::_UIToRender[i].destination == RasterRenderer::Destination::MAIN_UI) {
-			RasterRenderer::DrawMesh(commandBuffer, i);
-		}
-	}
+	RasterRenderer::DrawBatches(commandBuffer, RasterRenderer::Destination::MAIN_UI);
 	RasterRenderer::ClearQueue();
 
 	vkCmdEndRendering(commandBuffer);
@@ -403,6 +528,14 @@ void VulkanBackEnd::RenderLoadingFrame() {
 
 	// Wait for the GPU to finish the last frame using this FrameData slot
 	VulkanSyncManager::WaitForRenderFence(frameIndex);
+	VulkanReadbackManager::ProcessCompletedFrame(frameIndex);
+	VulkanRenderer::ProcessDeferredDestroys();
+	VulkanMemoryManager::BeginFrame(VulkanRenderer::GetFrameNumber());
+
+	// Compact texture memory while nothing else is going on
+	if (VulkanMemoryManager::StepDefragmentation()) {
+		UpdateTextureDescriptors();
+	}
 
 	// Reset the fence before submitting new work
 	VulkanSyncManager::ResetRenderFence(frameIndex);
@@ -417,13 +550,16 @@ void VulkanBackEnd::RenderLoadingFrame() {
 	dynamicSet.Update(GetDevice(), 3, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, uiMeshInstancesBuffer->GetBuffer());
 
 	// Acquire next image from swapchain
-	uint32_t swapchainImageIndex;
+	bool headless = GLFWIntegration::IsHeadless();
+	uint32_t swapchainImageIndex = 0;
 	VkSemaphore presentSemaphore = VulkanSyncManager::GetPresentSemaphore(frameIndex);
-	VkResult result = vkAcquireNextImageKHR(GetDevice(), GetSwapchain(), UINT64_MAX, presentSemaphore, VK_NULL_HANDLE, &swapchainImageIndex);
+	if (!headless) {
+		VkResult result = vkAcquireNextImageKHR(GetDevice(), GetSwapchain(), UINT64_MAX, presentSemaphore, VK_NULL_HANDLE, &swapchainImageIndex);
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-		VulkanSwapchainManager::RecreateSwapchain();
-		return;
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			VulkanSwapchainManager::RecreateSwapchain();
+			return;
+		}
 	}
 
 	// Record the loading frame commands
@@ -435,11 +571,21 @@ void VulkanBackEnd::RenderLoadingFrame() {
 	RecordAssetLoadingRenderCommands(commandBuffer);
 
 	// Blit the loading target and prepare for present
-	BlitAllocatedImageToSwapchain(commandBuffer, *loadingTarget, swapchainImageIndex);
-	PrepareSwapchainForPresent(commandBuffer, swapchainImageIndex);
+	if (!headless) {
+		BlitAllocatedImageToSwapchain(commandBuffer, *loadingTarget, swapchainImageIndex);
+		PrepareSwapchainForPresent(commandBuffer, swapchainImageIndex);
+	}
 
 	VK_CHECK(vkEndCommandBuffer(commandBuffer));
 
+	// Headless submits only signal the render fence
+	if (headless) {
+		VkSubmitInfo submit = vkinit::submit_info(&commandBuffer);
+		VK_CHECK(vkQueueSubmit(GetGraphicsQueue(), 1, &submit, VulkanSyncManager::GetRenderFence(frameIndex)));
+		VulkanRenderer::IncrementFrame();
+		return;
+	}
+
 	// Submit the command buffer
 	VkSemaphore renderFinishedSemaphore = VulkanSyncManager::GetRenderFinishedSemaphore(frameIndex, swapchainImageIndex);
 	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -466,7 +612,7 @@ void VulkanBackEnd::RenderLoadingFrame() {
 	presentInfo.waitSemaphoreCount = 1;
 	presentInfo.pImageIndices = &swapchainImageIndex;
 
-	result = vkQueuePresentKHR(GetGraphicsQueue(), &presentInfo);
+	VkResult result = vkQueuePresentKHR(GetGraphicsQueue(), &presentInfo);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
 		VulkanSwapchainManager::RecreateSwapchain();
@@ -477,11 +623,15 @@ void VulkanBackEnd::RenderLoadingFrame() {
 
 
 void VulkanBackEnd::RenderGameFrame() {
+	PROFILE_SCOPE("Render Frame");
 	if (ProgramIsMinimized()) return;
 
 	AllocatedImage* presentAllocatedImage = VulkanResourceManager::GetAllocatedImage("Present");
 	if (!presentAllocatedImage) return;
 
+	if (_debugMode == DebugMode::GPU_TIMINGS || _debugMode == DebugMode::MEMORY || _debugMode == DebugMode::HEAP) {
+		AddDebugText();
+	}
 	TextBlitter::Update(GameData::GetDeltaTime(), presentAllocatedImage->GetWidth(), presentAllocatedImage->GetHeight());
 
 	uint32_t frameIndex = VulkanRenderer::GetCurrentFrameIndex();
@@ -491,6 +641,15 @@ void VulkanBackEnd::RenderGameFrame() {
 
 	VulkanSyncManager::WaitForRenderFence(frameIndex);
 
+	// Results of readbacks recorded FRAME_OVERLAP frames ago are now safe to read
+	VulkanReadbackManager::ProcessCompletedFrame(frameIndex);
+	VulkanRenderer::ProcessDeferredDestroys();
+	VulkanMemoryManager::BeginFrame(VulkanRenderer::GetFrameNumber());
+
+	// Frame boundary, nothing for this frame has been recorded yet so reloaded pipelines can be swapped in
+	VulkanShaderHotloadManager::Update();
+	VulkanDynamicResolutionManager::Update();
+
 	{
 		VulkanRaytracingManager::CreateTopLevelAS(frameData.tlas.scene, Scene::GetMeshInstancesForSceneAccelerationStructure());
 		VulkanRaytracingManager::CreateTopLevelAS(frameData.tlas.inventory, Scene::GetMeshInstancesForInventoryAccelerationStructure());
@@ -503,18 +662,29 @@ void VulkanBackEnd::RenderGameFrame() {
 
 	VulkanSyncManager::ResetRenderFence(frameIndex);
 
-	uint32_t swapchainImageIndex;
+	bool headless = GLFWIntegration::IsHeadless();
+	uint32_t swapchainImageIndex = 0;
 	VkSemaphore presentSemaphore = VulkanSyncManager::GetPresentSemaphore(frameIndex);
-	VkResult result = vkAcquireNextImageKHR(GetDevice(), GetSwapchain(), UINT64_MAX, presentSemaphore, VK_NULL_HANDLE, &swapchainImageIndex);
+	if (!headless) {
+		VkResult result = vkAcquireNextImageKHR(GetDevice(), GetSwapchain(), UINT64_MAX, presentSemaphore, VK_NULL_HANDLE, &swapchainImageIndex);
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-		VulkanSwapchainManager::RecreateSwapchain();
-		return;
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			VulkanSwapchainManager::RecreateSwapchain();
+			return;
+		}
 	}
 
 	// This now uses the command buffer from the manager internally
 	build_rt_command_buffers(swapchainImageIndex);
 
+	// Headless frames end in the Present image, there is no acquire to wait on or image to present
+	if (headless) {
+		VkSubmitInfo submit = vkinit::submit_info(&commandBuffer);
+		VK_CHECK(vkQueueSubmit(GetGraphicsQueue(), 1, &submit, VulkanSyncManager::GetRenderFence(frameIndex)));
+		VulkanRenderer::IncrementFrame();
+		return;
+	}
+
 	VkSemaphore renderFinishedSemaphore = VulkanSyncManager::GetRenderFinishedSemaphore(frameIndex, swapchainImageIndex);
 	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
@@ -535,37 +705,55 @@ void VulkanBackEnd::RenderGameFrame() {
 	presentInfo.waitSemaphoreCount = 1;
 	presentInfo.pImageIndices = &swapchainImageIndex;
 
-	result = vkQueuePresentKHR(GetGraphicsQueue(), &presentInfo);
+	VkResult result = vkQueuePresentKHR(GetGraphicsQueue(), &presentInfo);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
 		VulkanSwapchainManager::RecreateSwapchain();
 	}
 
-	if (!GameData::inventoryOpen) {
-		VulkanBuffer* buffer = VulkanResourceManager::GetBuffer(g_mousePickBufferCPU);
-		if (buffer) {
-			uint32_t mousePickResult[2];
-			void* mappedData;
-			buffer->Map(&mappedData);
-			memcpy(mousePickResult, mappedData, sizeof(uint32_t) * 2);
-			Scene::StoreMousePickResult(mousePickResult[0], mousePickResult[1]);
-		}
+	VulkanRenderer::IncrementFrame();
+}
+
+
+void VulkanBackEnd::SaveScreenshot(const std::string& path) {
+	g_pendingScreenshotPath = path;
+}
+
+void VulkanBackEnd::DumpFramesToDisk(const std::string& directory, uint32_t interval) {
+	g_frameDumpDirectory = directory;
+	g_frameDumpInterval = interval;
+	if (interval > 0) {
+		std::filesystem::create_directories(directory);
 	}
-	else {
-		Scene::StoreMousePickResult(-1, -1);
+}
+
+void VulkanBackEnd::LogFrameStatistics() {
+	std::cout << "\nFrame statistics after " << VulkanRenderer::GetFrameNumber() << " frames (last " << Profiler::GetSampleWindow() << " samples)\n";
+	for (const ProfilerRecord& record : Profiler::s_profilerRecords) {
+		float p95 = Profiler::GetPercentileRecordTime(record.m_name.c_str(), 0.95f);
+		std::cout << "  " << record.m_name << ": " << Util::FloatToString(record.m_averageTime, 3) << "ms  p95 " << Util::FloatToString(p95, 3) << "ms\n";
 	}
 
-	VulkanRenderer::IncrementFrame();
+	VmaTotalStatistics stats;
+	vmaCalculateStatistics(GetAllocator(), &stats);
+	const VmaStatistics& total = stats.total.statistics;
+	if (HeapProfiler::IsEnabled()) {
+		HeapProfiler::FrameTotals average = HeapProfiler::GetAverageFrameTotals();
+		HeapProfiler::FrameTotals peak = HeapProfiler::GetPeakFrameTotals();
+		std::cout << "  Heap: " << average.allocations << " allocations, " << average.bytes << " bytes per frame on average, peak " << peak.allocations << " allocations\n";
+	}
+	std::cout << "  GPU memory: " << total.allocationCount << " allocations, " << (total.allocationBytes / (1024 * 1024)) << "MB used of " << (total.blockBytes / (1024 * 1024)) << "MB in " << total.blockCount << " blocks\n";
 }
 
-
 void VulkanBackEnd::ToggleFullscreen() {
+    if (GLFWIntegration::IsHeadless()) return;
     GLFWIntegration::ToggleFullscreen();
     VulkanSwapchainManager::RecreateSwapchain();
 }
 
 
 bool VulkanBackEnd::ProgramIsMinimized() {
+    if (GLFWIntegration::IsHeadless()) return false;
     GLFWwindow* _window = (GLFWwindow*)GLFWIntegration::GetWindowPointer();
 
 	int width, height;
@@ -581,17 +769,22 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
 
 void VulkanBackEnd::hotload_shaders()
 {
+	// Shaders are compiled on a worker, the new pipelines get swapped in at the start of a later frame
 	std::cout << "Hotloading shaders...\n";
+	VulkanShaderHotloadManager::RequestReloadAll();
+}
 
-	vkDeviceWaitIdle(GetDevice());
-
-	_raytracerPath.Cleanup(GetDevice(), GetAllocator());
-	_raytracerMousePick.Cleanup(GetDevice(), GetAllocator());
+void VulkanBackEnd::ReloadRaytracingPipelines()
+{
+	// Frames in flight may still trace with the old pipelines and shader binding tables
+	VkDevice device = GetDevice();
+	VmaAllocator allocator = GetAllocator();
+	VulkanRenderer::DeferDestroy([device, allocator, oldPath = _raytracerPath]() mutable {
+		oldPath.Cleanup(device, allocator);
+	});
+	_raytracerPath = HellRaytracer();
 
 	LoadLegacyShaders();
-
-	VulkanPipelineManager::ReloadAll();
-
 	init_raytracing();
 }
 
@@ -599,161 +792,94 @@ void VulkanBackEnd::hotload_shaders()
 void VulkanBackEnd::LoadLegacyShaders() {
 	// Path Tracer
 	_raytracerPath.SetShaders("Path_RayGen", { "Path_Miss", "Path_Shadow" }, { "Path_Hit" });
-
-	// Mouse Pick Tracer
-	_raytracerMousePick.SetShaders("Mouse_RayGen", {"Mouse_Miss"}, {"Mouse_Hit"});
 }
 
 
 void VulkanBackEnd::upload_meshes() {
-	for (MeshOLD& mesh : AssetManager::GetMeshList()) {
-		if (!mesh.m_uploadedToGPU) {
-			upload_mesh(mesh);
-			mesh.m_vulkanAccelerationStructure = VulkanResourceManager::CreateAccelerationStructure();
-
-			//VulkanAccelerationStructure* accelerationStructure = VulkanResourceManager::GetAccelerationStructure(mesh.m_vulkanAccelerationStructure);
-			//accelerationStructure->CreateBLAS(mesh.m_vertexBuffer)
-
-			VulkanRaytracingManager::CreateBottomLevelAS(mesh.m_vulkanAccelerationStructure , &mesh);
-		}
+	std::vector<MeshOLD>& meshes = AssetManager::GetMeshList();
+	if (std::all_of(meshes.begin(), meshes.end(), [](const MeshOLD& mesh) { return mesh.m_uploadedToGPU; })) {
+		return;
 	}
-    std::cout << "uploaded meshes\n";
-}
 
-void VulkanBackEnd::upload_mesh(MeshOLD& mesh)
-{
-	// Vertices
-	{
-		const size_t bufferSize = mesh.m_vertexCount * sizeof(Vertex);
-		VkBufferCreateInfo stagingBufferInfo = {};
-		stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		stagingBufferInfo.pNext = nullptr;
-		stagingBufferInfo.size = bufferSize;
-		stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	upload_geometry();
 
-		VmaAllocationCreateInfo vmaallocInfo = {};
-		vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	// BLAS inputs are ranges of the global buffers, every mesh shares the one identity transform
+	VkDeviceAddress vertexBufferAddress = VulkanResourceManager::GetBuffer(g_vertexBuffer)->GetDeviceAddress();
+	VkDeviceAddress indexBufferAddress = VulkanResourceManager::GetBuffer(g_indexBuffer)->GetDeviceAddress();
+	VkDeviceAddress transformBufferAddress = VulkanResourceManager::GetBuffer(g_transformBuffer)->GetDeviceAddress();
 
-		AllocatedBufferOLD stagingBuffer;
-		VK_CHECK(vmaCreateBuffer(GetAllocator(), &stagingBufferInfo, &vmaallocInfo, &stagingBuffer.m_buffer, &stagingBuffer.m_allocation, nullptr));
-
-		void* data;
-		vmaMapMemory(GetAllocator(), stagingBuffer.m_allocation, &data);
-		memcpy(data, AssetManager::GetVertexPointer(mesh.m_vertexOffset), mesh.m_vertexCount * sizeof(Vertex));
-		vmaUnmapMemory(GetAllocator(), stagingBuffer.m_allocation);
-
-		VkBufferCreateInfo vertexBufferInfo = {};
-		vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		vertexBufferInfo.pNext = nullptr;
-		vertexBufferInfo.size = bufferSize;
-		vertexBufferInfo.usage =
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-			VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-			VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
-
-		vmaallocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	for (MeshOLD& mesh : meshes) {
+		if (mesh.m_uploadedToGPU) continue;
 
-		VK_CHECK(vmaCreateBuffer(GetAllocator(), &vertexBufferInfo, &vmaallocInfo, &mesh.m_vertexBufferOLD.m_buffer, &mesh.m_vertexBufferOLD.m_allocation, nullptr));
-
-		VulkanCommandManager::SubmitImmediate([&](VkCommandBuffer cmd) {
-			VkBufferCopy copy;
-			copy.dstOffset = 0;
-			copy.srcOffset = 0;
-			copy.size = bufferSize;
-			vkCmdCopyBuffer(cmd, stagingBuffer.m_buffer, mesh.m_vertexBufferOLD.m_buffer, 1, &copy);
-			});
-
-		vmaDestroyBuffer(GetAllocator(), stagingBuffer.m_buffer, stagingBuffer.m_allocation);
+		mesh.m_vulkanAccelerationStructure = VulkanResourceManager::CreateAccelerationStructure();
+		VulkanRaytracingManager::CreateBottomLevelAS(mesh.m_vulkanAccelerationStructure, &mesh, vertexBufferAddress, indexBufferAddress, transformBufferAddress);
+		mesh.m_uploadedToGPU = true;
 	}
 
-	// Indices
-	if (mesh.m_indexCount > 0)
-	{
-		const size_t bufferSize = mesh.m_indexCount * sizeof(uint32_t);
-		VkBufferCreateInfo stagingBufferInfo = {};
-		stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		stagingBufferInfo.pNext = nullptr;
-		stagingBufferInfo.size = bufferSize;
-		stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-
-		VmaAllocationCreateInfo vmaallocInfo = {};
-		vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-
-		AllocatedBufferOLD stagingBuffer;
-		VK_CHECK(vmaCreateBuffer(GetAllocator(), &stagingBufferInfo, &vmaallocInfo, &stagingBuffer.m_buffer, &stagingBuffer.m_allocation, nullptr));
-
-		void* data;
-		vmaMapMemory(GetAllocator(), stagingBuffer.m_allocation, &data);
-
-		memcpy(data, AssetManager::GetIndexPointer(mesh.m_indexOffset), mesh.m_indexCount * sizeof(uint32_t));
-		vmaUnmapMemory(GetAllocator(), stagingBuffer.m_allocation);
+	// Same geometry again on the CPU, for picking and gameplay ray casts
+	AssetManager::CreateMeshBvhs();
+    std::cout << "uploaded meshes\n";
+}
 
-		VkBufferCreateInfo indexBufferInfo = {};
-		indexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		indexBufferInfo.pNext = nullptr;
-		indexBufferInfo.size = bufferSize;
-		indexBufferInfo.usage =
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-			VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-			VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+void VulkanBackEnd::upload_geometry() {
+	// All MeshOLD geometry lives in one vertex and one index buffer, meshes are ranges inside them.
+	// Both are recreated whenever meshes have been added, the previous ones retire through DeferDestroy.
+	std::vector<Vertex>& vertices = AssetManager::GetVertices_TEMPORARY();
+	std::vector<uint32_t>& indices = AssetManager::GetIndices_TEMPORARY();
 
-		vmaallocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	VkBufferUsageFlags geometryUsage =
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
 
-		VK_CHECK(vmaCreateBuffer(GetAllocator(), &indexBufferInfo, &vmaallocInfo, &mesh.m_indexBufferOLD.m_buffer, &mesh.m_indexBufferOLD.m_allocation, nullptr));
+	bool replaced = false;
+	auto replaceBuffer = [geometryUsage, &replaced](uint64_t& id, const void* data, VkDeviceSize size) {
+		if (size == 0) return;
 
-		VulkanCommandManager::SubmitImmediate([&](VkCommandBuffer cmd) {
-			VkBufferCopy copy;
-			copy.dstOffset = 0;
-			copy.srcOffset = 0;
-			copy.size = bufferSize;
-			vkCmdCopyBuffer(cmd, stagingBuffer.m_buffer, mesh.m_indexBufferOLD.m_buffer, 1, &copy);
-			});
+		if (VulkanBuffer* buffer = VulkanResourceManager::GetBuffer(id)) {
+			std::shared_ptr<VulkanBuffer> retired = std::make_shared<VulkanBuffer>(std::move(*buffer));
+			VulkanRenderer::DeferDestroy([retired]() { retired->Cleanup(); });
+			*buffer = VulkanBuffer(size, geometryUsage, VMA_MEMORY_USAGE_GPU_ONLY);
+			replaced = true;
+		}
+		else {
+			id = VulkanResourceManager::CreateBuffer(size, geometryUsage, VMA_MEMORY_USAGE_GPU_ONLY);
+		}
+		VulkanResourceManager::UploadBufferData(id, data, size);
+	};
 
-		vmaDestroyBuffer(GetAllocator(), stagingBuffer.m_buffer, stagingBuffer.m_allocation);
+	replaceBuffer(g_vertexBuffer, vertices.data(), vertices.size() * sizeof(Vertex));
+	replaceBuffer(g_indexBuffer, indices.data(), indices.size() * sizeof(uint32_t));
+	if (replaced && g_geometryDescriptorsWritten) {
+		// The vertex/index bindings aren't update-after-bind, frames in flight must finish before they're rewritten
+		vkDeviceWaitIdle(GetDevice());
+		UpdateGeometryDescriptors();
 	}
-	// Transforms
-	{
-		VkTransformMatrixKHR transformMatrix = {
+	VulkanCullingManager::UpdateMeshInfo();
+
+	if (g_transformBuffer == 0) {
+		VkTransformMatrixKHR identity = {
 			1.0f, 0.0f, 0.0f, 0.0f,
 			0.0f, 1.0f, 0.0f, 0.0f,
 			0.0f, 0.0f, 1.0f, 0.0f
 		};
+		VkBufferUsageFlags transformUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+		g_transformBuffer = VulkanResourceManager::CreateBuffer(sizeof(identity), transformUsage, VMA_MEMORY_USAGE_GPU_ONLY);
+		VulkanResourceManager::UploadBufferData(g_transformBuffer, &identity, sizeof(identity));
+	}
+}
 
-		const size_t bufferSize = sizeof(transformMatrix);
-		VkBufferCreateInfo stagingBufferInfo = {};
-		stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		stagingBufferInfo.pNext = nullptr;
-		stagingBufferInfo.size = bufferSize;
-		stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		VmaAllocationCreateInfo vmaallocInfo = {};
-		vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-		AllocatedBufferOLD stagingBuffer;
-		VK_CHECK(vmaCreateBuffer(GetAllocator(), &stagingBufferInfo, &vmaallocInfo, &stagingBuffer.m_buffer, &stagingBuffer.m_allocation, nullptr));
-		void* data;
-		vmaMapMemory(GetAllocator(), stagingBuffer.m_allocation, &data);
-		memcpy(data, &transformMatrix, bufferSize);
-		vmaUnmapMemory(GetAllocator(), stagingBuffer.m_allocation);
-		VkBufferCreateInfo bufferInfo = {};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.pNext = nullptr;
-		bufferInfo.size = bufferSize;
-		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
-		vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-		VK_CHECK(vmaCreateBuffer(GetAllocator(), &bufferInfo, &vmaallocInfo, &mesh.m_transformBufferOLD.m_buffer, &mesh.m_transformBufferOLD.m_allocation, nullptr));
-
-		VulkanCommandManager::SubmitImmediate([&](VkCommandBuffer cmd) {
-			VkBufferCopy copy;
-			copy.dstOffset = 0;
-			copy.srcOffset = 0;
-			copy.size = bufferSize;
-			vkCmdCopyBuffer(cmd, stagingBuffer.m_buffer, mesh.m_transformBufferOLD.m_buffer, 1, &copy);
-			});
+VkBuffer VulkanBackEnd::GetGeometryVertexBuffer() {
+	VulkanBuffer* buffer = VulkanResourceManager::GetBuffer(g_vertexBuffer);
+	return buffer ? buffer->GetBuffer() : VK_NULL_HANDLE;
+}
 
-		vmaDestroyBuffer(GetAllocator(), stagingBuffer.m_buffer, stagingBuffer.m_allocation);
-	}
-	mesh.m_uploadedToGPU = true;
+VkBuffer VulkanBackEnd::GetGeometryIndexBuffer() {
+	VulkanBuffer* buffer = VulkanResourceManager::GetBuffer(g_indexBuffer);
+	return buffer ? buffer->GetBuffer() : VK_NULL_HANDLE;
 }
 
 AllocatedBufferOLD VulkanBackEnd::create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VkMemoryPropertyFlags requiredFlags)
@@ -780,6 +906,9 @@ AllocatedBufferOLD VulkanBackEnd::create_buffer(size_t allocSize, VkBufferUsageF
 		&newBuffer.m_allocation,
 		nullptr));
 
+	// Only ever used for upload staging, the callers untrack before destroying it
+	VulkanMemoryManager::TrackAllocation(newBuffer.m_allocation, MemoryCategory::STAGING);
+
 	return newBuffer;
 }
 
@@ -803,42 +932,9 @@ void VulkanBackEnd::add_debug_name(VkDescriptorSetLayout descriptorSetLayout, co
 
 
 void VulkanBackEnd::create_rt_buffers() {
-	// Get the raw geometry data from the asset manager
-	std::vector<Vertex>& vertices = AssetManager::GetVertices_TEMPORARY();
-	std::vector<uint32_t>& indices = AssetManager::GetIndices_TEMPORARY();
-
-	const std::vector<Vertex>& vertices2 = AssetManager::GetVertices();
-	const std::vector<uint32_t>& indices2 = AssetManager::GetIndices();
-
-	std::cout << "vertices: " << vertices.size() << " " << vertices2.size() << "\n";
-	std::cout << "indices:  " << indices.size() << " " << indices2.size() << "\n";
-
-	// Define flags for raytracing geometry buffers
-	// These allow the buffer to be used for AS builds and as a storage buffer in shaders
-	VkBufferUsageFlags rtGeometryUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-		VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
-
-	// Create the high-level VulkanBuffer objects via the resource manager
-	// These are GPU_ONLY for optimal traversal performance
-	g_vertexBuffer = VulkanResourceManager::CreateBuffer(vertices.size() * sizeof(Vertex), rtGeometryUsage, VMA_MEMORY_USAGE_GPU_ONLY);
-	g_indexBuffer = VulkanResourceManager::CreateBuffer(indices.size() * sizeof(uint32_t), rtGeometryUsage, VMA_MEMORY_USAGE_GPU_ONLY);
-
-	// Upload the data using the internal staging logic
-	// This handles the creation and destruction of the temporary staging buffer automatically
-	VulkanResourceManager::UploadBufferData(g_vertexBuffer, vertices.data(), vertices.size() * sizeof(Vertex));
-	VulkanResourceManager::UploadBufferData(g_indexBuffer, indices.data(), indices.size() * sizeof(uint32_t));
-
-	// Refactored Mouse Pick Buffers
-	VkDeviceSize pickBufferSize = sizeof(uint32_t) * 2;
-
-	// GPU buffer for the raytracing shader to write into
-	g_mousePickBufferGPU = VulkanResourceManager::CreateBuffer(pickBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO);
-
-	// CPU buffer for the backend to read from
-	// MAPPED and HOST_ACCESS_SEQUENTIAL_WRITE to keep the pointer valid permanently
-	g_mousePickBufferCPU = VulkanResourceManager::CreateBuffer(pickBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+	// The hit shaders read the same global geometry buffers the BLASes were built from,
+	// make sure they hold everything Scene::Init() created before the descriptors get written
+	upload_meshes();
 }
 
 
@@ -847,7 +943,7 @@ void VulkanBackEnd::UpdateBuffers2D() {
 	// Queue all text characters for rendering
 	int quadMeshIndex = AssetManager::GetModel("blitter_quad")->m_meshIndices[0];
 	for (auto& instanceInfo : TextBlitter::_objectData) {
-			RasterRenderer::SubmitUI(quadMeshIndex, instanceInfo.index_basecolor, instanceInfo.index_color, instanceInfo.modelMatrix, RasterRenderer::Destination::MAIN_UI, instanceInfo.xClipMin, instanceInfo.xClipMax, instanceInfo.yClipMin, instanceInfo.yClipMax); // Todo: You are storing color in the normals. Probably not a major deal but could be confusing at some point down the line.
+			RasterRenderer::SubmitUI(quadMeshIndex, instanceInfo.index_basecolor, instanceInfo.index_color, instanceInfo.modelMatrix, RasterRenderer::Destination::MAIN_UI, instanceInfo.xClipMin, instanceInfo.xClipMax, instanceInfo.yClipMin, instanceInfo.yClipMax, instanceInfo.uvRect); // Todo: You are storing color in the normals. Probably not a major deal but could be confusing at some point down the line.
 	}
 
 	if (_loaded) {
@@ -874,9 +970,10 @@ void VulkanBackEnd::UpdateBuffers2D() {
 	VulkanFrameData& frameData = VulkanRenderer::GetCurrentFrameData();
 
 	if (VulkanBuffer* buffer = VulkanResourceManager::GetBuffer(frameData.buffers.uiInstances)) {
+		// Instances are uploaded grouped by destination so each target draws in a handful of instanced calls
+		RasterRenderer::BuildDrawBatches();
 		size_t instanceCount = RasterRenderer::instanceCount;
-		std::vector<MeshInstance> meshInstances = Scene::GetSceneMeshInstances(_debugScene);
-		buffer->UpdateData(RasterRenderer::_instanceData2D, sizeof(GPUObjectData2D) * instanceCount);
+		buffer->UpdateData(RasterRenderer::_sortedInstanceData2D, sizeof(GPUObjectData2D) * instanceCount);
 	}
 }
 
@@ -893,6 +990,9 @@ void VulkanBackEnd::UpdateBuffers() {
 		camData.vertexSize = sizeof(Vertex);
 		camData.frameIndex = _frameIndex;
 		camData.inventoryOpen = (GameData::inventoryOpen) ? 1 : 0;
+		camData.sampleCount = VulkanDenoiseManager::IsEnabled() ? 1 : 4;
+		camData.denoiseEnabled = VulkanDenoiseManager::HasResult() ? 1 : 0;
+		camData.renderScale = VulkanDynamicResolutionManager::GetRenderScale();
 
 		buffer->UpdateData(&camData, sizeof(CameraData));
 	}
@@ -919,29 +1019,58 @@ void VulkanBackEnd::UpdateBuffers() {
 		inventoryCamData.frameIndex = _frameIndex++;
 		inventoryCamData.inventoryOpen = 2; // 2 is actually inventory render
 		inventoryCamData.wallPaperALBIndex = AssetManager::GetTextureIndex("WallPaper_ALB");
+		inventoryCamData.sampleCount = VulkanDenoiseManager::IsEnabled() ? 1 : 4;
+		inventoryCamData.denoiseEnabled = VulkanDenoiseManager::HasResult() ? 1 : 0;
+		inventoryCamData.renderScale = VulkanDynamicResolutionManager::GetRenderScale();
 
 		buffer->UpdateData(&inventoryCamData, sizeof(CameraData));
 	}
 
-	// 3D instance data
+	// 3D instance data, only the slots that changed since this frame's copy of the buffer was last written
 	if (VulkanBuffer* buffer = VulkanResourceManager::GetBuffer(frameData.buffers.sceneInstances)) {
-		std::vector<MeshInstance> meshInstances = Scene::GetSceneMeshInstances(_debugScene);
-		buffer->UpdateData(meshInstances.data(), sizeof(MeshInstance) * meshInstances.size());
+		Scene::UpdateSceneMeshInstances(_debugScene);
+		const std::vector<MeshInstance>& meshInstances = Scene::GetSceneMeshInstanceData();
+		std::vector<uint64_t>& changedSlots = Scene::GetSceneMeshInstanceDirtyBits();
+		for (std::vector<uint64_t>& dirtyBits : g_sceneInstanceDirtyBits) {
+			dirtyBits.resize(changedSlots.size(), 0);
+			for (size_t i = 0; i < changedSlots.size(); i++) {
+				dirtyBits[i] |= changedSlots[i];
+			}
+		}
+		std::fill(changedSlots.begin(), changedSlots.end(), 0);
+
+		// Contiguous runs of dirty slots go up in one copy each
+		std::vector<uint64_t>& dirtyBits = g_sceneInstanceDirtyBits[VulkanRenderer::GetCurrentFrameIndex()];
+		uint32_t slotCount = (uint32_t)meshInstances.size();
+		uint32_t slot = 0;
+		while (slot < slotCount) {
+			if (!(dirtyBits[slot >> 6] & (1ull << (slot & 63)))) {
+				slot = (dirtyBits[slot >> 6] >> (slot & 63)) ? slot + 1 : (slot | 63) + 1;
+				continue;
+			}
+			uint32_t runStart = slot;
+			while (slot < slotCount && (dirtyBits[slot >> 6] & (1ull << (slot & 63)))) {
+				slot++;
+			}
+			buffer->UpdateData(&meshInstances[runStart], sizeof(MeshInstance) * runStart, sizeof(MeshInstance) * (slot - runStart));
+		}
+		std::fill(dirtyBits.begin(), dirtyBits.end(), 0);
+		g_sceneInstanceCount = slotCount;
 	}
 
-	// 3D instance data
-	if (VulkanBuffer* buffer = VulkanResourceManager::GetBuffer(frameData.buffers.inventoryInstances)) {
-		std::vector<MeshInstance> inventoryMeshInstances = Scene::GetInventoryMeshInstances(_debugScene);
+	// 3D instance data, the inventory scene is rebuilt every frame and only rendered while it's open
+	if (VulkanBuffer* buffer = VulkanResourceManager::GetBuffer(frameData.buffers.inventoryInstances); buffer && GameData::inventoryOpen) {
+		FrameVector<MeshInstance> inventoryMeshInstances = Scene::GetInventoryMeshInstances(_debugScene);
 		buffer->UpdateData(inventoryMeshInstances.data(), sizeof(MeshInstance) * inventoryMeshInstances.size());
 	}
 
 	// Light render info
 	if (VulkanBuffer* buffer = VulkanResourceManager::GetBuffer(frameData.buffers.sceneLights)) {
-		std::vector<LightRenderInfo> lightRenderInfo = Scene::GetLightRenderInfo();
+		FrameVector<LightRenderInfo> lightRenderInfo = Scene::GetLightRenderInfo();
 		buffer->UpdateData(lightRenderInfo.data(), sizeof(LightRenderInfo) * lightRenderInfo.size());
 	}
 	if (VulkanBuffer* buffer = VulkanResourceManager::GetBuffer(frameData.buffers.inventoryLights)) {
-		std::vector<LightRenderInfo> lightRenderInfo = Scene::GetLightRenderInfoInventory();
+		FrameVector<LightRenderInfo> lightRenderInfo = Scene::GetLightRenderInfoInventory();
 		buffer->UpdateData(lightRenderInfo.data(), sizeof(LightRenderInfo) * lightRenderInfo.size());
 	}
 }
@@ -956,6 +1085,7 @@ void VulkanBackEnd::update_static_descriptor_set_old() {
 	AllocatedImage* laptopDisplayAllocatedImage = VulkanResourceManager::GetAllocatedImage("LaptopDisplay");
 	AllocatedImage* presentAllocatedImage = VulkanResourceManager::GetAllocatedImage("Present");
 	AllocatedImage* depthGBufferAllocatedImage = VulkanResourceManager::GetAllocatedImage("Depth_GBuffer");
+	AllocatedImage* denoiseAAllocatedImage = VulkanResourceManager::GetAllocatedImage("Denoise_A");
 
 	HellDescriptorSet& samplerSet = VulkanDescriptorManager::GetSamplerDescriptorSet();
 	//VulkanDescriptorSet& bindlessSet = VulkanRenderer::GetStaticDescriptorSet();
@@ -971,7 +1101,7 @@ void VulkanBackEnd::update_static_descriptor_set_old() {
 	// Binding 1: All Textures
 	VkDescriptorImageInfo textureImageInfo[TEXTURE_ARRAY_SIZE];
 	for (uint32_t i = 0; i < TEXTURE_ARRAY_SIZE; ++i) {
-		VkImageView view = (i < AssetManager::GetNumberOfTextures()) ? AssetManager::GetTexture(i)->imageView : AssetManager::GetTexture(0)->imageView;
+		VkImageView view = (i < AssetManager::GetNumberOfTextures()) ? AssetManager::GetTextureImageView(i) : AssetManager::GetTextureImageView(0);
 		textureImageInfo[i].sampler = nullptr;
 		textureImageInfo[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		textureImageInfo[i].imageView = view;
@@ -1006,11 +1136,7 @@ void VulkanBackEnd::update_static_descriptor_set_old() {
 	legacySet.Update(GetDevice(), 4, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &storageImageDescriptor);
 	//bindlessSet.WriteImage(4, rtFirstHitColorAllocatedImage->GetImageView(), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 
-	// Binding 5: Mouse pick buffer
-	if (VulkanBuffer* buffer = VulkanResourceManager::GetBuffer(g_mousePickBufferGPU)) {
-		legacySet.Update(GetDevice(), 5, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer->GetBuffer());
-		//bindlessSet.WriteBuffer(5, buffer->GetBuffer(), buffer->GetSize(), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	}
+	// Binding 5: Unused since mouse picking moved to the CPU BVH
 
 	// Binding 6: RT First Hit Normals
 	storageImageDescriptor.imageView = rtFirstHitNormalsAllocatedImage->GetImageView();
@@ -1036,6 +1162,7 @@ void VulkanBackEnd::update_static_descriptor_set_old() {
 		gBufferNormalAllocatedImage->TransitionLayout(cmd, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
 		gBufferRmaAllocatedImage->TransitionLayout(cmd, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
 		depthGBufferAllocatedImage->TransitionLayout(cmd, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		denoiseAAllocatedImage->TransitionLayout(cmd, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
 		});
 
 	// Update Sampler Sets (Traditional Combined Samplers)
@@ -1054,6 +1181,12 @@ void VulkanBackEnd::update_static_descriptor_set_old() {
 	staticSamplerImageInfo.imageView = rtSecondHitColorAllocatedImage->GetImageView();
 	samplerSet.Update(GetDevice(), 3, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &staticSamplerImageInfo);
 
+	// Denoise B and C are spare slots, they alias A until something writes them
+	staticSamplerImageInfo.imageView = denoiseAAllocatedImage->GetImageView();
+	samplerSet.Update(GetDevice(), 4, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &staticSamplerImageInfo);
+	samplerSet.Update(GetDevice(), 5, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &staticSamplerImageInfo);
+	samplerSet.Update(GetDevice(), 6, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &staticSamplerImageInfo);
+
 	staticSamplerImageInfo.imageView = laptopDisplayAllocatedImage->GetImageView();
 	samplerSet.Update(GetDevice(), 7, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &staticSamplerImageInfo);
 }
@@ -1083,7 +1216,7 @@ void VulkanBackEnd::UpdateStaticDescriptorSet() {
 	// // Textures
 	uint32_t assetTextureCount = AssetManager::GetNumberOfTextures();
 	for (uint32_t i = 0; i < assetTextureCount; ++i) {
-		VkImageView view = AssetManager::GetTexture(i)->imageView;
+		VkImageView view = AssetManager::GetTextureImageView(i);
 		bindlessSet.WriteImage(DESC_IDX_TEXTURES, view, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, i);
 	}
 
@@ -1101,13 +1234,20 @@ void VulkanBackEnd::UpdateStaticDescriptorSet() {
 	// Depth targets use specific depth layout
 	bindlessSet.WriteImage(DESC_IDX_TEXTURES, depthGBuffer->GetImageView(), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, RT_IDX_DEPTH_GBUFFER);
 
-	// Storage Images RGBA32F
-	bindlessSet.WriteImage(DESC_IDX_STORAGE_IMAGES_RGBA32F, rtFirstHitColor->GetImageView(), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, IMG_IDX_RT_FIRST_COLOR);
-	bindlessSet.WriteImage(DESC_IDX_STORAGE_IMAGES_RGBA32F, rtFirstHitNormals->GetImageView(), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, IMG_IDX_RT_FIRST_NORMALS);
-	bindlessSet.WriteImage(DESC_IDX_STORAGE_IMAGES_RGBA32F, rtFirstHitBaseColor->GetImageView(), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, IMG_IDX_RT_FIRST_BASE);
-	bindlessSet.WriteImage(DESC_IDX_STORAGE_IMAGES_RGBA32F, rtSecondHitColor->GetImageView(), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, IMG_IDX_RT_SECOND_COLOR);
-
-	// Storage Images RGBA16F
+	// Storage Images RGBA32F / RGBA16F. The arrays are typed, so path tracer targets packed into
+	// any other format (see RT_TARGET_PACKING) are only reachable through the texture array.
+	auto writeRTStorageImage = [&](AllocatedImage* image, uint32_t index) {
+		if (image->GetFormat() == VK_FORMAT_R32G32B32A32_SFLOAT) {
+			bindlessSet.WriteImage(DESC_IDX_STORAGE_IMAGES_RGBA32F, image->GetImageView(), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, index);
+		}
+		else if (image->GetFormat() == VK_FORMAT_R16G16B16A16_SFLOAT) {
+			bindlessSet.WriteImage(DESC_IDX_STORAGE_IMAGES_RGBA16F, image->GetImageView(), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, index);
+		}
+	};
+	writeRTStorageImage(rtFirstHitColor, IMG_IDX_RT_FIRST_COLOR);
+	writeRTStorageImage(rtFirstHitNormals, IMG_IDX_RT_FIRST_NORMALS);
+	writeRTStorageImage(rtFirstHitBaseColor, IMG_IDX_RT_FIRST_BASE);
+	writeRTStorageImage(rtSecondHitColor, IMG_IDX_RT_SECOND_COLOR);
 
 	// Storage Images RGBA8
 	bindlessSet.WriteImage(DESC_IDX_STORAGE_IMAGES_RGBA8, gBufferBaseColor->GetImageView(), VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, IMG_IDX_GBUFFER_BASE);
@@ -1122,6 +1262,7 @@ void VulkanBackEnd::UpdateStaticDescriptorSet() {
 	if (vertexBuffer && indexBuffer) {
 		bindlessSet.WriteBuffer(DESC_IDX_VERTICES, vertexBuffer->GetBuffer(), vertexBuffer->GetSize(), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		bindlessSet.WriteBuffer(DESC_IDX_INDICES, indexBuffer->GetBuffer(), indexBuffer->GetSize(), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		g_geometryDescriptorsWritten = true;
 	}
 
 	// Finalize all writes
@@ -1171,249 +1312,394 @@ void VulkanBackEnd::UpdateDynamicDescriptorSet() {
 	VulkanRenderer::UpdateDynamicDescriptorSet();
 }
 
-void VulkanBackEnd::build_rt_command_buffers(int swapchainIndex) {
-	uint32_t frameIndex = VulkanRenderer::GetCurrentFrameIndex();
-	VulkanFrameData& frameData = VulkanRenderer::GetCurrentFrameData();
-
-	VkCommandBuffer commandBuffer = VulkanCommandManager::GetGraphicsCommandBuffer(frameIndex);
-
-	AllocatedImage* rtFirstHitColorAllocatedImage = VulkanResourceManager::GetAllocatedImage("RT_FirstHit_Color");
-	AllocatedImage* rtFirstHitNormalsAllocatedImage = VulkanResourceManager::GetAllocatedImage("RT_FirstHit_Normals");
-	AllocatedImage* rtFirstHitBaseColorAllocatedImage = VulkanResourceManager::GetAllocatedImage("RT_FirstHit_BaseColor");
-	AllocatedImage* rtSecondHitColorAllocatedImage = VulkanResourceManager::GetAllocatedImage("RT_SecondHit_Color");
-	AllocatedImage* laptopDisplayAllocatedImage = VulkanResourceManager::GetAllocatedImage("LaptopDisplay");
-	AllocatedImage* compositeAllocatedImage = VulkanResourceManager::GetAllocatedImage("Composite");
-	AllocatedImage* presentAllocatedImage = VulkanResourceManager::GetAllocatedImage("Present");
-
-	VulkanPipeline* compositePipeline = VulkanPipelineManager::GetPipeline("Composite");
-	VulkanPipeline* linesPipeline = VulkanPipelineManager::GetPipeline("Lines");
-	VulkanPipeline* textBlitterPipeline = VulkanPipelineManager::GetPipeline("TextBlitter");
-
-
-	if (!linesPipeline) return;
-	if (!compositePipeline) return;
-
-	uint32_t currentWindowWidth = GLFWIntegration::GetCurrentWindowWidth();
-	uint32_t currentWindowHeight = GLFWIntegration::GetCurrentWindowHeight();
-
-
-	VK_CHECK(vkResetCommandBuffer(commandBuffer, 0));
-	VkCommandBufferBeginInfo cmdBufInfo = vkinit::command_buffer_begin_info();
-	VK_CHECK(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
-
-	HellDescriptorSet& dynamicSet = VulkanDescriptorManager::GetDynamicDescriptorSet(frameIndex);
-	HellDescriptorSet& dynamicSetInventory = VulkanDescriptorManager::GetDynamicInventoryDescriptorSet(frameIndex);
-	HellDescriptorSet& staticSet = VulkanDescriptorManager::GetStaticDescriptorSet();
-	HellDescriptorSet& samplerSet = VulkanDescriptorManager::GetSamplerDescriptorSet();
-
-
-
-	VulkanDescriptorSet& bindlessStaticSet = VulkanRenderer::GetStaticDescriptorSet();
-	VulkanDescriptorSet* dynamicDescriptorSet = VulkanResourceManager::GetDescriptorSet(frameData.dynamicDescriptorSet);
-
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipeline);
-
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipelineLayout, 0, 1, &dynamicSet.handle, 0, nullptr);
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipelineLayout, 1, 1, &staticSet.handle, 0, nullptr);
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipelineLayout, 2, 1, &samplerSet.handle, 0, nullptr);
-
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipelineLayout, 3, 1, bindlessStaticSet.GetHandlePtr(), 0, nullptr);
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipelineLayout, 4, 1, dynamicDescriptorSet->GetHandlePtr(), 0, nullptr);
-
-	// Transition RT images to GENERAL for storage write
-	rtFirstHitColorAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
-	rtFirstHitNormalsAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
-	rtSecondHitColorAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
-	rtFirstHitBaseColorAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
-
-	vkCmdTraceRaysKHR(commandBuffer, &_raytracerPath.raygenShaderSbtEntry, &_raytracerPath.missShaderSbtEntry, &_raytracerPath.hitShaderSbtEntry, &_raytracerPath.callableShaderSbtEntry, rtFirstHitColorAllocatedImage->GetWidth(), rtFirstHitColorAllocatedImage->GetHeight(), 1);
-
-	if (GameData::inventoryOpen) {
-		cmd_BindRayTracingDescriptorSet(commandBuffer, _raytracerPath.pipelineLayout, 0, dynamicSetInventory);
-		vkCmdTraceRaysKHR(commandBuffer, &_raytracerPath.raygenShaderSbtEntry, &_raytracerPath.missShaderSbtEntry, &_raytracerPath.hitShaderSbtEntry, &_raytracerPath.callableShaderSbtEntry, rtFirstHitColorAllocatedImage->GetWidth(), rtFirstHitColorAllocatedImage->GetHeight(), 1);
-	}
-
-
+void VulkanBackEnd::BuildRenderGraph() {
+	using namespace VulkanRenderGraph;
+
+	AddPass("Path Trace", [](VkCommandBuffer cmd) {
+		uint32_t frameIndex = VulkanRenderer::GetCurrentFrameIndex();
+		HellDescriptorSet& dynamicSet = VulkanDescriptorManager::GetDynamicDescriptorSet(frameIndex);
+		HellDescriptorSet& staticSet = VulkanDescriptorManager::GetStaticDescriptorSet();
+		HellDescriptorSet& samplerSet = VulkanDescriptorManager::GetSamplerDescriptorSet();
+		VulkanDescriptorSet& bindlessStaticSet = VulkanRenderer::GetStaticDescriptorSet();
+		VulkanDescriptorSet* dynamicDescriptorSet = VulkanResourceManager::GetDescriptorSet(VulkanRenderer::GetCurrentFrameData().dynamicDescriptorSet);
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipelineLayout, 0, 1, &dynamicSet.handle, 0, nullptr);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipelineLayout, 1, 1, &staticSet.handle, 0, nullptr);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipelineLayout, 2, 1, &samplerSet.handle, 0, nullptr);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipelineLayout, 3, 1, bindlessStaticSet.GetHandlePtr(), 0, nullptr);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, _raytracerPath.pipelineLayout, 4, 1, dynamicDescriptorSet->GetHandlePtr(), 0, nullptr);
+
+		// Dynamic resolution traces into the top left of the targets, the composite rescales it
+		VkExtent2D renderExtent = VulkanDynamicResolutionManager::GetRenderExtent();
+		vkCmdTraceRaysKHR(cmd, &_raytracerPath.raygenShaderSbtEntry, &_raytracerPath.missShaderSbtEntry, &_raytracerPath.hitShaderSbtEntry, &_raytracerPath.callableShaderSbtEntry, renderExtent.width, renderExtent.height, 1);
+	})
+	.Write("RT_FirstHit_Color", RAY_TRACING_STORAGE_WRITE)
+	.Write("RT_FirstHit_Normals", RAY_TRACING_STORAGE_WRITE)
+	.Write("RT_FirstHit_BaseColor", RAY_TRACING_STORAGE_WRITE)
+	.Write("RT_SecondHit_Color", RAY_TRACING_STORAGE_WRITE)
+	.Read("LaptopDisplay", RAY_TRACING_SAMPLED_READ);
+
+	// Keeps the pipeline and sets 1-4 bound by the path trace
+	AddPass("Inventory Trace", [](VkCommandBuffer cmd) {
+		HellDescriptorSet& dynamicSetInventory = VulkanDescriptorManager::GetDynamicInventoryDescriptorSet(VulkanRenderer::GetCurrentFrameIndex());
+		cmd_BindRayTracingDescriptorSet(cmd, _raytracerPath.pipelineLayout, 0, dynamicSetInventory);
+
+		VkExtent2D renderExtent = VulkanDynamicResolutionManager::GetRenderExtent();
+		vkCmdTraceRaysKHR(cmd, &_raytracerPath.raygenShaderSbtEntry, &_raytracerPath.missShaderSbtEntry, &_raytracerPath.hitShaderSbtEntry, &_raytracerPath.callableShaderSbtEntry, renderExtent.width, renderExtent.height, 1);
+	})
+	.Write("RT_FirstHit_Color", RAY_TRACING_STORAGE_WRITE)
+	.Write("RT_FirstHit_Normals", RAY_TRACING_STORAGE_WRITE)
+	.Write("RT_FirstHit_BaseColor", RAY_TRACING_STORAGE_WRITE)
+	.Write("RT_SecondHit_Color", RAY_TRACING_STORAGE_WRITE)
+	.Read("LaptopDisplay", RAY_TRACING_SAMPLED_READ)
+	.SetCondition([]() { return GameData::inventoryOpen; });
+
+	// Raster GBuffer, culled on the GPU so recording costs the same however many instances there are
+	AddPass("GBuffer Cull", [](VkCommandBuffer cmd) {
+		glm::mat4 viewProjection = GameData::GetProjectionMatrix() * GameData::GetViewMatrix();
+		const std::vector<MeshInstance>& sceneInstances = Scene::GetSceneMeshInstanceData();
+		std::span<const MeshInstance> instances(sceneInstances.data(), std::min((size_t)g_sceneInstanceCount, sceneInstances.size()));
+		VulkanCullingManager::RecordCulling(cmd, VulkanRenderer::GetCurrentFrameData().buffers.sceneInstances, instances, viewProjection);
+	})
+	.SetCondition([]() { return _renderGBuffer; });
+
+	AddPass("GBuffer", [](VkCommandBuffer cmd) {
+		uint32_t frameIndex = VulkanRenderer::GetCurrentFrameIndex();
+		AllocatedImage* gBufferBaseColor = VulkanResourceManager::GetAllocatedImage("GBuffer_BaseColor");
+		AllocatedImage* gBufferNormal = VulkanResourceManager::GetAllocatedImage("GBuffer_Normal");
+		AllocatedImage* gBufferRma = VulkanResourceManager::GetAllocatedImage("GBuffer_RMA");
+		AllocatedImage* depthGBuffer = VulkanResourceManager::GetAllocatedImage("Depth_GBuffer");
+		VulkanPipeline* gBufferPipeline = VulkanPipelineManager::GetPipeline("GBuffer");
+		VkDescriptorSet descriptorSets[2] = {
+			VulkanDescriptorManager::GetDynamicDescriptorSet(frameIndex).handle,
+			VulkanDescriptorManager::GetStaticDescriptorSet().handle
+		};
 
-	// Mouse pick
-	cmd_BindRayTracingPipeline(commandBuffer, _raytracerMousePick.pipeline);
-	cmd_BindRayTracingDescriptorSet(commandBuffer, _raytracerMousePick.pipelineLayout, 0, dynamicSet);
-	cmd_BindRayTracingDescriptorSet(commandBuffer, _raytracerMousePick.pipelineLayout, 1, staticSet);
-	vkCmdTraceRaysKHR(commandBuffer, &_raytracerMousePick.raygenShaderSbtEntry, &_raytracerMousePick.missShaderSbtEntry, &_raytracerMousePick.hitShaderSbtEntry, &_raytracerMousePick.callableShaderSbtEntry, 1, 1, 1);
+		VkRenderingAttachmentInfo colorAttachments[3] = {};
+		AllocatedImage* colorTargets[3] = { gBufferBaseColor, gBufferNormal, gBufferRma };
+		for (int i = 0; i < 3; i++) {
+			colorAttachments[i].sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			colorAttachments[i].imageView = colorTargets[i]->GetImageView();
+			colorAttachments[i].imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			colorAttachments[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			colorAttachments[i].clearValue = { 0.0f, 0.0f, 0.0f, 0.0f };
+		}
 
-	// Laptop display rendering
-	{
+		VkRenderingAttachmentInfo depthAttachment{ VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
+		depthAttachment.imageView = depthGBuffer->GetImageView();
+		depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+		VkRenderingInfo gBufferRenderingInfo{ VK_STRUCTURE_TYPE_RENDERING_INFO };
+		gBufferRenderingInfo.renderArea = { 0, 0, (uint32_t)gBufferBaseColor->GetWidth(), (uint32_t)gBufferBaseColor->GetHeight() };
+		gBufferRenderingInfo.layerCount = 1;
+		gBufferRenderingInfo.colorAttachmentCount = 3;
+		gBufferRenderingInfo.pColorAttachments = colorAttachments;
+		gBufferRenderingInfo.pDepthAttachment = &depthAttachment;
+
+		VkBuffer vertexBuffer = GetGeometryVertexBuffer();
+		VkDeviceSize offset = 0;
+
+		vkCmdBeginRendering(cmd, &gBufferRenderingInfo);
+		cmd_SetViewportSize(cmd, gBufferBaseColor->GetWidth(), gBufferBaseColor->GetHeight());
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, gBufferPipeline->GetHandle());
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, gBufferPipeline->GetLayout(), 0, 2, descriptorSets, 0, nullptr);
+		vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer, &offset);
+		vkCmdBindIndexBuffer(cmd, GetGeometryIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+		VulkanCullingManager::RecordDraws(cmd);
+		vkCmdEndRendering(cmd);
+	})
+	.Write("GBuffer_BaseColor", COLOR_ATTACHMENT_WRITE)
+	.Write("GBuffer_Normal", COLOR_ATTACHMENT_WRITE)
+	.Write("GBuffer_RMA", COLOR_ATTACHMENT_WRITE)
+	.Write("Depth_GBuffer", DEPTH_ATTACHMENT_WRITE)
+	.SetCondition([]() { return _renderGBuffer; });
+
+	// The laptop screen is sampled by next frame's path trace
+	auto laptopHasBackground = []() { return AssetManager::GetTexture("OS_bg") != nullptr; };
+
+	AddPass("Laptop Background", [](VkCommandBuffer cmd) {
 		Texture* bg_texture = AssetManager::GetTexture("OS_bg");
-		if (bg_texture) {
-			bg_texture->insertImageBarrier(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-			laptopDisplayAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-			
-			VkImageBlit blitRegion{};
-			blitRegion.srcOffsets[1] = { (int32_t)bg_texture->_width, (int32_t)bg_texture->_height, 1 };
-			blitRegion.dstOffsets[1] = { (int32_t)laptopDisplayAllocatedImage->GetWidth(), (int32_t)laptopDisplayAllocatedImage->GetHeight(), 1 };
-			blitRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
-			blitRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
-			vkCmdBlitImage(commandBuffer, bg_texture->image._image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, laptopDisplayAllocatedImage->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, VK_FILTER_NEAREST);
-
-			bg_texture->insertImageBarrier(commandBuffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-
-			// Transition to ATTACHMENT_OPTIMAL for Rendering
-			laptopDisplayAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
-
-			VkRenderingAttachmentInfo laptopColorAttachment{ VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
-			laptopColorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-			laptopColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-			laptopColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			laptopColorAttachment.imageView = laptopDisplayAllocatedImage->GetImageView();
-
-			VkRenderingInfo laptopRenderingInfo{ VK_STRUCTURE_TYPE_RENDERING_INFO };
-			laptopRenderingInfo.renderArea = { 0, 0, (uint32_t)laptopDisplayAllocatedImage->GetWidth(), (uint32_t)laptopDisplayAllocatedImage->GetHeight() };
-			laptopRenderingInfo.layerCount = 1;
-			laptopRenderingInfo.colorAttachmentCount = 1;
-			laptopRenderingInfo.pColorAttachments = &laptopColorAttachment;
-
-			vkCmdBeginRendering(commandBuffer, &laptopRenderingInfo);
-			cmd_SetViewportSize(commandBuffer, laptopDisplayAllocatedImage->GetWidth(), laptopDisplayAllocatedImage->GetHeight());
-
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, textBlitterPipeline->GetHandle());
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, textBlitterPipeline->GetLayout(), 0, 1, &dynamicSet.handle, 0, nullptr);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, textBlitterPipeline->GetLayout(), 1, 1, &staticSet.handle, 0, nullptr);
-
-			//cmd_BindPipeline(commandBuffer, _pipelines.textBlitter);
-			//cmd_BindDescriptorSet(commandBuffer, _pipelines.textBlitter, 0, dynamicSet);
-			//cmd_BindDescriptorSet(commandBuffer, _pipelines.textBlitter, 1, staticSet);
-			for (int i = 0; i < RasterRenderer::instanceCount; i++) {
-				if (RasterRenderer::_UIToRender[i].destination == RasterRenderer::Destination::LAPTOP_DISPLAY)
-					RasterRenderer::DrawMesh(commandBuffer, i);
-			}
-			vkCmdEndRendering(commandBuffer);
+		AllocatedImage* laptopDisplay = VulkanResourceManager::GetAllocatedImage("LaptopDisplay");
 
-			laptopDisplayAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
-
-		}
-	}
+		bg_texture->insertImageBarrier(cmd, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 
-	// Composite Pass
-	{
-		compositeAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		VkImageBlit blitRegion{};
+		blitRegion.srcOffsets[1] = { (int32_t)bg_texture->_width, (int32_t)bg_texture->_height, 1 };
+		blitRegion.dstOffsets[1] = { (int32_t)laptopDisplay->GetWidth(), (int32_t)laptopDisplay->GetHeight(), 1 };
+		blitRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		blitRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		vkCmdBlitImage(cmd, bg_texture->image._image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, laptopDisplay->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, VK_FILTER_NEAREST);
+
+		bg_texture->insertImageBarrier(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	})
+	.Write("LaptopDisplay", TRANSFER_WRITE)
+	.SetCondition(laptopHasBackground);
+
+	AddPass("Laptop Display", [](VkCommandBuffer cmd) {
+		AllocatedImage* laptopDisplay = VulkanResourceManager::GetAllocatedImage("LaptopDisplay");
+
+		VkRenderingAttachmentInfo laptopColorAttachment{ VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
+		laptopColorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		laptopColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		laptopColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		laptopColorAttachment.imageView = laptopDisplay->GetImageView();
+
+		VkRenderingInfo laptopRenderingInfo{ VK_STRUCTURE_TYPE_RENDERING_INFO };
+		laptopRenderingInfo.renderArea = { 0, 0, (uint32_t)laptopDisplay->GetWidth(), (uint32_t)laptopDisplay->GetHeight() };
+		laptopRenderingInfo.layerCount = 1;
+		laptopRenderingInfo.colorAttachmentCount = 1;
+		laptopRenderingInfo.pColorAttachments = &laptopColorAttachment;
+		laptopRenderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+
+		VkCommandBuffer laptopUICommandBuffer = GetRecordedCommandBuffer(g_laptopUIRecording);
+		vkCmdBeginRendering(cmd, &laptopRenderingInfo);
+		vkCmdExecuteCommands(cmd, 1, &laptopUICommandBuffer);
+		vkCmdEndRendering(cmd);
+	})
+	.Write("LaptopDisplay", COLOR_ATTACHMENT_LOAD_WRITE)
+	.SetCondition(laptopHasBackground);
+
+	// CPU denoise, results land a few frames after the readback. Readbacks only happen on some frames,
+	// so the denoise manager transitions the path tracer targets itself rather than declaring them here.
+	AddPass("Denoise", [](VkCommandBuffer cmd) {
+		VulkanDenoiseManager::RecordUploads(cmd);
+		VulkanDenoiseManager::RecordReadbacks(cmd);
+	});
+
+	AddPass("Composite", [](VkCommandBuffer cmd) {
+		uint32_t frameIndex = VulkanRenderer::GetCurrentFrameIndex();
+		AllocatedImage* composite = VulkanResourceManager::GetAllocatedImage("Composite");
+		VulkanPipeline* compositePipeline = VulkanPipelineManager::GetPipeline("Composite");
+		VkDescriptorSet descriptorSets[3] = {
+			VulkanDescriptorManager::GetDynamicDescriptorSet(frameIndex).handle,
+			VulkanDescriptorManager::GetStaticDescriptorSet().handle,
+			VulkanDescriptorManager::GetSamplerDescriptorSet().handle
+		};
 
 		VkRenderingAttachmentInfo compositeAttachment{ VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
-		compositeAttachment.imageView = compositeAllocatedImage->GetImageView();
+		compositeAttachment.imageView = composite->GetImageView();
 		compositeAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 		compositeAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 		compositeAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		compositeAttachment.clearValue = { 0.2f, 1.0f, 0.0f, 0.0f };
 
 		VkRenderingInfo compositeRenderingInfo{ VK_STRUCTURE_TYPE_RENDERING_INFO };
-		compositeRenderingInfo.renderArea = { 0, 0, (uint32_t)compositeAllocatedImage->GetWidth(), (uint32_t)compositeAllocatedImage->GetHeight() };
+		compositeRenderingInfo.renderArea = { 0, 0, (uint32_t)composite->GetWidth(), (uint32_t)composite->GetHeight() };
 		compositeRenderingInfo.layerCount = 1;
 		compositeRenderingInfo.colorAttachmentCount = 1;
 		compositeRenderingInfo.pColorAttachments = &compositeAttachment;
 
-		vkCmdBeginRendering(commandBuffer, &compositeRenderingInfo);
-		cmd_SetViewportSize(commandBuffer, compositeAllocatedImage->GetWidth(), compositeAllocatedImage->GetHeight());
-
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline->GetHandle());
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline->GetLayout(), 0, 1, &dynamicSet.handle, 0, nullptr);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline->GetLayout(), 1, 1, &staticSet.handle, 0, nullptr);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline->GetLayout(), 2, 1, &samplerSet.handle, 0, nullptr);
-
-		//cmd_BindPipeline(commandBuffer, _pipelines.composite);
-		//cmd_BindDescriptorSet(commandBuffer, _pipelines.composite, 0, dynamicSet);
-		//cmd_BindDescriptorSet(commandBuffer, _pipelines.composite, 1, staticSet);
-		//cmd_BindDescriptorSet(commandBuffer, _pipelines.composite, 2, samplerSet);
-		AssetManager::GetMesh(AssetManager::GetModel("fullscreen_quad")->m_meshIndices[0])->draw(commandBuffer, 0);
-		vkCmdEndRendering(commandBuffer);
-
-		// Blit Composite to Present
-		compositeAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-		presentAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		vkCmdBeginRendering(cmd, &compositeRenderingInfo);
+		cmd_SetViewportSize(cmd, composite->GetWidth(), composite->GetHeight());
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline->GetHandle());
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline->GetLayout(), 0, 3, descriptorSets, 0, nullptr);
+		AssetManager::GetMesh(AssetManager::GetModel("fullscreen_quad")->m_meshIndices[0])->draw(cmd, 0);
+		vkCmdEndRendering(cmd);
+	})
+	.Read("RT_FirstHit_Color", FRAGMENT_SAMPLED_READ)
+	.Read("RT_FirstHit_Normals", FRAGMENT_SAMPLED_READ)
+	.Read("RT_FirstHit_BaseColor", FRAGMENT_SAMPLED_READ)
+	.Read("RT_SecondHit_Color", FRAGMENT_SAMPLED_READ)
+	.Read("Denoise_A", FRAGMENT_SAMPLED_READ)
+	.Write("Composite", COLOR_ATTACHMENT_WRITE);
+
+	AddPass("Composite Blit", [](VkCommandBuffer cmd) {
+		AllocatedImage* composite = VulkanResourceManager::GetAllocatedImage("Composite");
+		AllocatedImage* present = VulkanResourceManager::GetAllocatedImage("Present");
 
 		VkImageBlit blitRegion{};
-		blitRegion.srcOffsets[1] = { (int32_t)compositeAllocatedImage->GetWidth(), (int32_t)compositeAllocatedImage->GetHeight(), 1 };
-		blitRegion.dstOffsets[1] = { (int32_t)presentAllocatedImage->GetWidth(), (int32_t)presentAllocatedImage->GetHeight(), 1 };
+		blitRegion.srcOffsets[1] = { (int32_t)composite->GetWidth(), (int32_t)composite->GetHeight(), 1 };
+		blitRegion.dstOffsets[1] = { (int32_t)present->GetWidth(), (int32_t)present->GetHeight(), 1 };
 		blitRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
 		blitRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
-		vkCmdBlitImage(commandBuffer, compositeAllocatedImage->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, presentAllocatedImage->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, VK_FILTER_LINEAR);
-	}
+		vkCmdBlitImage(cmd, composite->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, present->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, VK_FILTER_LINEAR);
+	})
+	.Read("Composite", TRANSFER_READ)
+	.Write("Present", TRANSFER_WRITE);
 
-	// Main UI Pass
-	{
-		presentAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	AddPass("UI", [](VkCommandBuffer cmd) {
+		AllocatedImage* present = VulkanResourceManager::GetAllocatedImage("Present");
 
 		VkRenderingAttachmentInfo uiAttachment{ VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
 		uiAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 		uiAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
 		uiAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		uiAttachment.imageView = presentAllocatedImage->GetImageView();
+		uiAttachment.imageView = present->GetImageView();
 
 		VkRenderingInfo uiRenderingInfo{ VK_STRUCTURE_TYPE_RENDERING_INFO };
-		uiRenderingInfo.renderArea = { 0, 0, (uint32_t)presentAllocatedImage->GetWidth(), (uint32_t)presentAllocatedImage->GetHeight() };
+		uiRenderingInfo.renderArea = { 0, 0, (uint32_t)present->GetWidth(), (uint32_t)present->GetHeight() };
 		uiRenderingInfo.layerCount = 1;
 		uiRenderingInfo.colorAttachmentCount = 1;
 		uiRenderingInfo.pColorAttachments = &uiAttachment;
+		uiRenderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
 
-		vkCmdBeginRendering(commandBuffer, &uiRenderingInfo);
-		cmd_SetViewportSize(commandBuffer, presentAllocatedImage->GetWidth(), presentAllocatedImage->GetHeight());
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, textBlitterPipeline->GetHandle());
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, textBlitterPipeline->GetLayout(), 0, 1, &dynamicSet.handle, 0, nullptr);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, textBlitterPipeline->GetLayout(), 1, 1, &staticSet.handle, 0, nullptr);
-
-		for (int i = 0; i < RasterRenderer::instanceCount; i++) {
-			if (RasterRenderer::_UIToRender[i].destination == RasterRenderer::Destination::MAIN_UI)
-				RasterRenderer::DrawMesh(commandBuffer, i);
+		VkCommandBuffer uiCommandBuffers[2] = { GetRecordedCommandBuffer(g_mainUIRecording) };
+		uint32_t uiCommandBufferCount = 1;
+		if (g_debugLinesRecording.submitted) {
+			uiCommandBuffers[uiCommandBufferCount++] = GetRecordedCommandBuffer(g_debugLinesRecording);
 		}
 		RasterRenderer::ClearQueue();
 
-		if (_lineListMesh.m_vertexCount > 0 && _debugMode != DebugMode::NONE) {
-
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, linesPipeline->GetHandle());
-
-			glm::mat4 projection = glm::perspective(GameData::_cameraZoom, 1700.f / 900.f, 0.01f, 100.0f);
-			glm::mat4 view = GameData::GetPlayer().m_camera.GetViewMatrix();
-			projection[1][1] *= -1;
-			LineShaderPushConstants constants;
-			constants.transformation = projection * view;
-			vkCmdPushConstants(commandBuffer, linesPipeline->GetLayout(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(LineShaderPushConstants), &constants);
-			_lineListMesh.draw(commandBuffer, 0);
-		}
-		vkCmdEndRendering(commandBuffer);
-	}
+		vkCmdBeginRendering(cmd, &uiRenderingInfo);
+		vkCmdExecuteCommands(cmd, uiCommandBufferCount, uiCommandBuffers);
+		vkCmdEndRendering(cmd);
+	})
+	.Write("Present", COLOR_ATTACHMENT_LOAD_WRITE);
 
-	// Final Swapchain Blit
-	{
-		presentAllocatedImage->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	AddPass("Present Blit", [](VkCommandBuffer cmd) {
+		AllocatedImage* present = VulkanResourceManager::GetAllocatedImage("Present");
+		VkImage swapchainImage = GetSwapchainImages()[g_swapchainIndex];
 
+		// The swapchain image belongs to the presentation engine, not the graph
 		VkImageMemoryBarrier swapChainBarrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
 		swapChainBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		swapChainBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		swapChainBarrier.image = GetSwapchainImages()[swapchainIndex];
+		swapChainBarrier.image = swapchainImage;
 		swapChainBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 		swapChainBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &swapChainBarrier);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &swapChainBarrier);
 
 		VkImageBlit blitRegion{};
-		blitRegion.srcOffsets[1] = { (int32_t)presentAllocatedImage->GetWidth(), (int32_t)presentAllocatedImage->GetHeight(), 1 };
-		blitRegion.dstOffsets[1] = { (int32_t)currentWindowWidth, (int32_t)currentWindowHeight, 1 };
+		blitRegion.srcOffsets[1] = { (int32_t)present->GetWidth(), (int32_t)present->GetHeight(), 1 };
+		blitRegion.dstOffsets[1] = { (int32_t)GLFWIntegration::GetCurrentWindowWidth(), (int32_t)GLFWIntegration::GetCurrentWindowHeight(), 1 };
 		blitRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
 		blitRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
-		vkCmdBlitImage(commandBuffer, presentAllocatedImage->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, GetSwapchainImages()[swapchainIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, VK_FILTER_NEAREST);
+		vkCmdBlitImage(cmd, present->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, VK_FILTER_NEAREST);
 
 		swapChainBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 		swapChainBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 		swapChainBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		swapChainBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &swapChainBarrier);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &swapChainBarrier);
+	})
+	.Read("Present", TRANSFER_READ)
+	.SetCondition([]() { return !GLFWIntegration::IsHeadless(); });
+
+	AddPass("Present Readback", [](VkCommandBuffer cmd) {
+		AllocatedImage* present = VulkanResourceManager::GetAllocatedImage("Present");
+		int32_t width = present->GetWidth();
+		int32_t height = present->GetHeight();
+
+		if (!g_pendingScreenshotPath.empty()) {
+			std::string path = g_pendingScreenshotPath;
+			VulkanReadbackManager::RequestImageReadback(cmd, "Screenshot", *present, [path, width, height](const void* data, VkDeviceSize size, uint64_t frameNumber) {
+				AssetManager::SaveImageData(path, width, height, 4, const_cast<void*>(data));
+				std::cout << "Saved screenshot " << path << " (frame " << frameNumber << ")\n";
+			});
+			g_pendingScreenshotPath.clear();
+		}
+		if (FrameDumpDue()) {
+			std::erase_if(g_frameDumpJobs, [](std::future<void>& job) { return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+
+			std::string path = g_frameDumpDirectory + "/frame_" + std::to_string(VulkanRenderer::GetFrameNumber()) + ".png";
+			VulkanReadbackManager::RequestImageReadback(cmd, "FrameDump", *present, [path, width, height](const void* data, VkDeviceSize size, uint64_t frameNumber) {
+				// PNG encoding takes longer than a frame, so keep it off the render thread
+				const uint8_t* bytes = static_cast<const uint8_t*>(data);
+				std::vector<uint8_t> pixels(bytes, bytes + size);
+				g_frameDumpJobs.push_back(std::async(std::launch::async, [path, width, height, pixels = std::move(pixels)]() mutable {
+					Profiler::SetThreadName("Frame Dump");
+					PROFILE_SCOPE("Save Frame Dump");
+					AssetManager::SaveImageData(path, width, height, 4, pixels.data());
+				}));
+			});
+		}
+	})
+	.Read("Present", TRANSFER_READ)
+	.SetCondition([]() { return !g_pendingScreenshotPath.empty() || FrameDumpDue(); });
+}
+
+void VulkanBackEnd::DumpRenderGraph(const std::string& path) {
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "VulkanBackEnd::DumpRenderGraph() could not open '" << path << "'\n";
+		return;
 	}
+	file << VulkanRenderGraph::Dump();
+	std::cout << "Wrote render graph to " << path << "\n";
+}
 
-	if (!GameData::inventoryOpen) {
-		VulkanBuffer* gpuBuffer = VulkanResourceManager::GetBuffer(g_mousePickBufferGPU);
-		VulkanBuffer* cpuBuffer = VulkanResourceManager::GetBuffer(g_mousePickBufferCPU);
+void VulkanBackEnd::build_rt_command_buffers(int swapchainIndex) {
+	uint32_t frameIndex = VulkanRenderer::GetCurrentFrameIndex();
+
+	VkCommandBuffer commandBuffer = VulkanCommandManager::GetGraphicsCommandBuffer(frameIndex);
+
+	AllocatedImage* laptopDisplayAllocatedImage = VulkanResourceManager::GetAllocatedImage("LaptopDisplay");
+	AllocatedImage* presentAllocatedImage = VulkanResourceManager::GetAllocatedImage("Present");
 
-		VkBufferCopy pickCopy = { 0, 0, sizeof(uint32_t) * 2 };
-		vkCmdCopyBuffer(commandBuffer, gpuBuffer->GetBuffer(), cpuBuffer->GetBuffer(), 1, &pickCopy);
+	VulkanPipeline* compositePipeline = VulkanPipelineManager::GetPipeline("Composite");
+	VulkanPipeline* linesPipeline = VulkanPipelineManager::GetPipeline("Lines");
+	VulkanPipeline* textBlitterPipeline = VulkanPipelineManager::GetPipeline("TextBlitter");
+
+
+	if (!linesPipeline) return;
+	if (!compositePipeline) return;
+
+	VK_CHECK(vkResetCommandBuffer(commandBuffer, 0));
+	VkCommandBufferBeginInfo cmdBufInfo = vkinit::command_buffer_begin_info();
+	VK_CHECK(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+	VulkanTimestampManager::BeginFrame(commandBuffer, frameIndex);
+
+	HellDescriptorSet& dynamicSet = VulkanDescriptorManager::GetDynamicDescriptorSet(frameIndex);
+	HellDescriptorSet& staticSet = VulkanDescriptorManager::GetStaticDescriptorSet();
+
+	// Raster passes are recorded into secondary buffers on the job system while the ray tracing work is recorded below.
+	// Small draw lists aren't worth a thread, those are recorded inline when the primary reaches them.
+	// A job a culled pass never consumed last frame has to be settled before its inputs are overwritten.
+	for (SecondaryRecording* recording : { &g_laptopUIRecording, &g_mainUIRecording, &g_debugLinesRecording }) {
+		JobSystem::Reclaim(recording->job);
+		recording->submitted = false;
+	}
+	VulkanCommandManager::ResetSecondaryCommandPools(frameIndex);
+
+	constexpr uint32_t PARALLEL_RECORD_THRESHOLD = 64;
+
+	auto submitUIDraws = [&](SecondaryRecording& recording, uint32_t threadIndex, AllocatedImage* target, RasterRenderer::Destination destination) {
+		recording.frameIndex = frameIndex;
+		recording.threadIndex = threadIndex;
+		recording.format = target->GetFormat();
+		recording.target = target;
+		recording.pipeline = textBlitterPipeline;
+		recording.descriptorSets[0] = dynamicSet.handle;
+		recording.descriptorSets[1] = staticSet.handle;
+		recording.destination = destination;
+		recording.job.function = RecordUIDraws;
+		recording.job.userData = &recording;
+		recording.submitted = true;
+		JobSystem::Submit(recording.job, RasterRenderer::GetDrawBatches(destination).size() >= PARALLEL_RECORD_THRESHOLD);
+	};
+
+	// Consumed by the "Laptop Display" and "UI" passes, see BuildRenderGraph()
+	if (AssetManager::GetTexture("OS_bg")) {
+		submitUIDraws(g_laptopUIRecording, 0, laptopDisplayAllocatedImage, RasterRenderer::Destination::LAPTOP_DISPLAY);
+	}
+	submitUIDraws(g_mainUIRecording, 1, presentAllocatedImage, RasterRenderer::Destination::MAIN_UI);
+
+	if (_lineListVertexCount > 0 && _debugMode != DebugMode::NONE) {
+		glm::mat4 projection = glm::perspective(GameData::_cameraZoom, 1700.f / 900.f, 0.01f, 100.0f);
+		glm::mat4 view = GameData::GetPlayer().m_camera.GetViewMatrix();
+		projection[1][1] *= -1;
+
+		g_debugLinesRecording.frameIndex = frameIndex;
+		g_debugLinesRecording.threadIndex = 2;
+		g_debugLinesRecording.format = presentAllocatedImage->GetFormat();
+		g_debugLinesRecording.target = presentAllocatedImage;
+		g_debugLinesRecording.pipeline = linesPipeline;
+		g_debugLinesRecording.lineConstants.transformation = projection * view;
+		g_debugLinesRecording.job.function = RecordDebugLines;
+		g_debugLinesRecording.job.userData = &g_debugLinesRecording;
+		g_debugLinesRecording.submitted = true;
+		JobSystem::Submit(g_debugLinesRecording.job, _lineListVertexCount / 2 >= PARALLEL_RECORD_THRESHOLD);
 	}
 
+	g_swapchainIndex = swapchainIndex;
+	VulkanRenderGraph::Execute(commandBuffer);
+
 	VK_CHECK(vkEndCommandBuffer(commandBuffer));
 }
 
@@ -1432,12 +1718,42 @@ void VulkanBackEnd::AddDebugText() {
 	if (_debugMode == DebugMode::RAY) {
 		TextBlitter::AddDebugText("Cam pos: " + Util::Vec3ToString(GameData::GetPlayer().m_camera.m_viewPos));
 		TextBlitter::AddDebugText("Cam rot: " + Util::Vec3ToString(GameData::GetPlayer().m_camera.m_transform.rotation));
-		TextBlitter::AddDebugText("Rayhit BLAS index: " + std::to_string(Scene::_instanceIndex));
-		TextBlitter::AddDebugText("Rayhit triangle index: " + std::to_string(Scene::_primitiveIndex));
+		if (Scene::_instanceIndex < 0) {
+			TextBlitter::AddDebugText("Rayhit BLAS index: none");
+		}
+		else {
+			TextBlitter::AddDebugText("Rayhit BLAS index: " + std::to_string(Scene::_instanceIndex));
+			TextBlitter::AddDebugText("Rayhit triangle index: " + std::to_string(Scene::_primitiveIndex));
+		}
 	}	
 	else if (_debugMode == DebugMode::COLLISION) {
 		TextBlitter::AddDebugText("Collision world");
 	}
+	else if (_debugMode == DebugMode::GPU_TIMINGS) {
+		if (!VulkanTimestampManager::IsSupported()) {
+			TextBlitter::AddDebugText("GPU timestamps not supported");
+		}
+		VkExtent2D renderExtent = VulkanDynamicResolutionManager::GetRenderExtent();
+		VkExtent2D maxRenderExtent = VulkanDynamicResolutionManager::GetMaxRenderExtent();
+		TextBlitter::AddDebugText("Trace resolution: " + std::to_string(renderExtent.width) + "x" + std::to_string(renderExtent.height) + " of " + std::to_string(maxRenderExtent.width) + "x" + std::to_string(maxRenderExtent.height));
+		for (const char* scope : { "Path Trace", "Inventory Trace", "Laptop Display", "Composite", "UI", "Present Blit" }) {
+			FrameString recordName = VulkanTimestampManager::GetRecordName(scope);
+			if (!Profiler::GetRecord(recordName)) continue;
+			float average = Profiler::GetAverageRecordTime(recordName.c_str());
+			float p95 = Profiler::GetPercentileRecordTime(recordName.c_str(), 0.95f);
+			TextBlitter::AddDebugText(std::string(scope) + ": " + Util::FloatToString(average, 3) + "ms  p95 " + Util::FloatToString(p95, 3) + "ms");
+		}
+	}
+	else if (_debugMode == DebugMode::MEMORY) {
+		for (const std::string& line : VulkanMemoryManager::GetStatisticsText()) {
+			TextBlitter::AddDebugText(line);
+		}
+	}
+	else if (_debugMode == DebugMode::HEAP) {
+		for (const std::string& line : HeapProfiler::GetStatisticsText()) {
+			TextBlitter::AddDebugText(line);
+		}
+	}
 	else if (false) {
 		//return;
 		TextBlitter::AddDebugText("Inventory");
@@ -1458,19 +1774,20 @@ void VulkanBackEnd::get_required_lines() {
 		vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 		VmaAllocationCreateInfo vmaallocInfo = {};
 		vmaallocInfo.usage = VMA_MEMORY_USAGE_AUTO;
-		VK_CHECK(vmaCreateBuffer(GetAllocator(), &vertexBufferInfo, &vmaallocInfo, &_lineListMesh.m_vertexBufferOLD.m_buffer, &_lineListMesh.m_vertexBufferOLD.m_allocation, nullptr));
-		add_debug_name(_lineListMesh.m_vertexBufferOLD.m_buffer, "_lineListMesh._vertexBuffer");
+		VK_CHECK(vmaCreateBuffer(GetAllocator(), &vertexBufferInfo, &vmaallocInfo, &_lineListVertexBuffer.m_buffer, &_lineListVertexBuffer.m_allocation, nullptr));
+		VulkanMemoryManager::TrackAllocation(_lineListVertexBuffer.m_allocation, MemoryCategory::GEOMETRY);
+		add_debug_name(_lineListVertexBuffer.m_buffer, "_lineListMesh._vertexBuffer");
 		// Name the mesh
 		VkDebugUtilsObjectNameInfoEXT nameInfo = {};
 		nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
 		nameInfo.objectType = VK_OBJECT_TYPE_BUFFER;
-		nameInfo.objectHandle = (uint64_t)_lineListMesh.m_vertexBufferOLD.m_buffer;
+		nameInfo.objectHandle = (uint64_t)_lineListVertexBuffer.m_buffer;
 		nameInfo.pObjectName = "Line list mesh";
 		vkSetDebugUtilsObjectNameEXT(GetDevice(), &nameInfo);
 		runOnce = false;
 	}
 
-	std::vector<Vertex> vertices;
+	FrameVector<Vertex> vertices;
 
 	// Ray cast
 	if (_debugMode == DebugMode::RAY) {
@@ -1488,7 +1805,7 @@ void VulkanBackEnd::get_required_lines() {
 		vertices = Scene::GetCollisionLineVertices();
 	}
 
-	_lineListMesh.m_vertexCount = vertices.size();
+	_lineListVertexCount = (uint32_t)vertices.size();
 
 	if (vertices.size()) {
 		const size_t bufferSize = vertices.size() * sizeof(Vertex);
@@ -1501,6 +1818,7 @@ void VulkanBackEnd::get_required_lines() {
 		vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
 		AllocatedBufferOLD stagingBuffer;
 		VK_CHECK(vmaCreateBuffer(GetAllocator(), &stagingBufferInfo, &vmaallocInfo, &stagingBuffer.m_buffer, &stagingBuffer.m_allocation, nullptr));
+		VulkanMemoryManager::TrackAllocation(stagingBuffer.m_allocation, MemoryCategory::STAGING);
 		add_debug_name(stagingBuffer.m_buffer, "stagingBuffer");
 		void* data;
 		vmaMapMemory(GetAllocator(), stagingBuffer.m_allocation, &data);
@@ -1513,9 +1831,10 @@ void VulkanBackEnd::get_required_lines() {
 			copy.dstOffset = 0;
 			copy.srcOffset = 0;
 			copy.size = bufferSize;
-			vkCmdCopyBuffer(cmd, stagingBuffer.m_buffer, _lineListMesh.m_vertexBufferOLD.m_buffer, 1, &copy);
+			vkCmdCopyBuffer(cmd, stagingBuffer.m_buffer, _lineListVertexBuffer.m_buffer, 1, &copy);
 			});
 
+		VulkanMemoryManager::UntrackAllocation(stagingBuffer.m_allocation);
 		vmaDestroyBuffer(GetAllocator(), stagingBuffer.m_buffer, stagingBuffer.m_allocation);
 	}
 }
@@ -40,6 +40,9 @@ struct CameraData {
 	int32_t frameIndex;
 	int32_t inventoryOpen;
 	int32_t wallPaperALBIndex;
+	int32_t sampleCount;
+	int32_t denoiseEnabled;
+	glm::vec2 renderScale;
 };
 
 struct MeshPushConstants {
@@ -83,6 +86,10 @@ namespace VulkanBackEnd {
 	void RenderGameFrame();
 	void RenderLoadingFrame();
 	void ToggleFullscreen();
+	void SaveScreenshot(const std::string& path);
+	void DumpFramesToDisk(const std::string& directory, uint32_t interval); // Every 'interval' game frames, written on worker threads. 0 disables
+	void LogFrameStatistics();
+	void DumpRenderGraph(const std::string& path); // Passes, lifetimes, aliasing and the last frame's barriers
 	bool ProgramIsMinimized();
 	void LoadNextItem();
 	void AddLoadingText(std::string text);
@@ -98,6 +105,7 @@ namespace VulkanBackEnd {
 	void LoadLegacyShaders();
 	
 	void hotload_shaders();
+	void ReloadRaytracingPipelines();
 
 	void RecordAssetLoadingRenderCommands(VkCommandBuffer commandBuffer);
 	void PrepareSwapchainForPresent(VkCommandBuffer commandBuffer, uint32_t swapchainImageIndex);
@@ -147,10 +155,10 @@ namespace VulkanBackEnd {
 	void init_raytracing();
 	
 
-	inline MeshOLD _lineListMesh;
+	inline AllocatedBufferOLD _lineListVertexBuffer;
+	inline uint32_t _lineListVertexCount = 0;
 
 	inline HellRaytracer _raytracerPath;
-	inline HellRaytracer _raytracerMousePick;
 
 	inline bool _collisionEnabled = true;
 	inline bool _debugScene = false;
@@ -158,6 +166,7 @@ namespace VulkanBackEnd {
 
 	
 			void create_rt_buffers();
+			void BuildRenderGraph();
 			void build_rt_command_buffers(int swapchainIndex);
 			inline uint32_t _rtIndexCount;
 
@@ -170,7 +179,9 @@ namespace VulkanBackEnd {
 
 
 	void upload_meshes();
-	void upload_mesh(MeshOLD& mesh);
+	void upload_geometry();
+	VkBuffer GetGeometryVertexBuffer();
+	VkBuffer GetGeometryIndexBuffer();
 
 	void cleanup_raytracing();
 	void AddDebugText();
@@ -6,6 +6,7 @@
 #include "Util.h"
 #include "AssetManagement/AssetManager.h"
 #include "API/Vulkan/Managers/vk_resource_manager.h"
+#include "API/Vulkan/vk_backend.h"
 
 
 void MeshOLD::draw(VkCommandBuffer commandBuffer, uint32_t firstInstance)
@@ -13,15 +14,34 @@ void MeshOLD::draw(VkCommandBuffer commandBuffer, uint32_t firstInstance)
 	if (m_vertexCount <= 0)
 		return;
 
+	bind(commandBuffer);
+	drawInstances(commandBuffer, firstInstance, 1);
+}
+
+void MeshOLD::bind(VkCommandBuffer commandBuffer)
+{
+	if (m_vertexCount <= 0)
+		return;
+
+	// Every mesh lives in the shared geometry buffers, drawInstances() selects the range
+	VkBuffer vertexBuffer = VulkanBackEnd::GetGeometryVertexBuffer();
 	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+	if (m_indexCount > 0) {
+		vkCmdBindIndexBuffer(commandBuffer, VulkanBackEnd::GetGeometryIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	}
+}
+
+void MeshOLD::drawInstances(VkCommandBuffer commandBuffer, uint32_t firstInstance, uint32_t instanceCount)
+{
+	if (m_vertexCount <= 0)
+		return;
+
 	if (m_indexCount > 0) {
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBufferOLD.m_buffer, &offset);
-		vkCmdBindIndexBuffer(commandBuffer, m_indexBufferOLD.m_buffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_indexCount), 1, 0, 0, firstInstance);
+		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_indexCount), instanceCount, m_indexOffset, m_vertexOffset, firstInstance);
 	}
 	else {
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBufferOLD.m_buffer, &offset);
-		vkCmdDraw(commandBuffer, m_vertexCount, 1, 0, firstInstance);
+		vkCmdDraw(commandBuffer, m_vertexCount, instanceCount, m_vertexOffset, firstInstance);
 	}
 }
 
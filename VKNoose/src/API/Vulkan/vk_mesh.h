@@ -22,20 +22,22 @@ struct MeshOLD {
 	uint32_t m_indexOffset = 0;
 	uint32_t m_vertexCount = 0;
 	uint32_t m_indexCount = 0;
+	glm::vec3 m_aabbMin = glm::vec3(0);
+	glm::vec3 m_aabbMax = glm::vec3(0);
 
 	//uint64_t m_vertexBuffer = 0;
 	//uint64_t m_indexBuffer = 0;
 	//uint64_t m_transformBuffer = 0;
 
-	AllocatedBufferOLD m_vertexBufferOLD;
-	AllocatedBufferOLD m_indexBufferOLD;
-	AllocatedBufferOLD m_transformBufferOLD;
 	//VulkanAccelerationStructure m_accelerationStructure;
 	uint64_t m_vulkanAccelerationStructure = 0;
+	uint64_t m_meshBvhId = 0;
 	std::string m_name = "undefined";
 	bool m_uploadedToGPU = false;
 
 	void draw(VkCommandBuffer commandBuffer, uint32_t firstInstance);
+	void bind(VkCommandBuffer commandBuffer);
+	void drawInstances(VkCommandBuffer commandBuffer, uint32_t firstInstance, uint32_t instanceCount); // Expects bind() to have been called
 	uint64_t GetVulkanAccelerationStructureDeviceAddress();
 
 	int32_t GetBaseVertex() const  { return m_vertexOffset; }
@@ -1,6 +1,9 @@
 #include "vk_raytracing.h"
 #include "Renderer/Shader.h"
+#include "API/Vulkan/Managers/vk_memory_manager.h"
+#include "API/Vulkan/Managers/vk_pipeline_cache_manager.h"
 #include "API/Vulkan/Managers/vk_resource_manager.h"
+#include <chrono>
 
 void HellRaytracer::DestroyShaders(VkDevice device) {
 	vkDestroyShaderModule(device, rayGenShader, nullptr);
@@ -22,8 +25,11 @@ void HellRaytracer::Cleanup(VkDevice device, VmaAllocator allocator)
 	pipeline = VK_NULL_HANDLE;
 	pipelineLayout = VK_NULL_HANDLE;
 
+	VulkanMemoryManager::UntrackAllocation(raygenShaderBindingTable.m_allocation);
 	vmaDestroyBuffer(allocator, raygenShaderBindingTable.m_buffer, raygenShaderBindingTable.m_allocation);
+	VulkanMemoryManager::UntrackAllocation(missShaderBindingTable.m_allocation);
 	vmaDestroyBuffer(allocator, missShaderBindingTable.m_buffer, missShaderBindingTable.m_allocation);
+	VulkanMemoryManager::UntrackAllocation(hitShaderBindingTable.m_allocation);
 	vmaDestroyBuffer(allocator, hitShaderBindingTable.m_buffer, hitShaderBindingTable.m_allocation);
 
 	DestroyShaders(device);
@@ -81,7 +87,7 @@ void HellRaytracer::SetShaders(const std::string& rayGen, const std::vector<std:
 }
 
 
-void HellRaytracer::CreatePipeline(VkDevice device, std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, uint32_t maxRecursionDepth ) {
+void HellRaytracer::CreatePipeline(VkDevice device, std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, uint32_t maxRecursionDepth, const std::string& name) {
 
 	if (pipeline != VK_NULL_HANDLE) {
 		vkDestroyPipeline(device, pipeline, nullptr);
@@ -103,7 +109,12 @@ void HellRaytracer::CreatePipeline(VkDevice device, std::vector<VkDescriptorSetL
 	rayTracingPipelineCI.pGroups = shaderGroups.data();
 	rayTracingPipelineCI.maxPipelineRayRecursionDepth = maxRecursionDepth;
 	rayTracingPipelineCI.layout = pipelineLayout;
-	vkCreateRayTracingPipelinesKHR(device, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &rayTracingPipelineCI, nullptr, &pipeline);
+	rayTracingPipelineCI.pNext = VulkanPipelineCacheManager::BeginPipelineCreation(nullptr);
+
+	auto startTime = std::chrono::steady_clock::now();
+	VK_CHECK(vkCreateRayTracingPipelinesKHR(device, VK_NULL_HANDLE, VulkanPipelineCacheManager::GetPipelineCache(), 1, &rayTracingPipelineCI, nullptr, &pipeline));
+	float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	VulkanPipelineCacheManager::LogPipelineCreation(name, milliseconds);
 }
 
 uint64_t HellRaytracer::get_buffer_device_address(VkDevice device, VkBuffer buffer)
@@ -144,10 +155,12 @@ void HellRaytracer::CreateShaderBindingTable(VkDevice device, VmaAllocator alloc
 
 		// Cleanup old buffer if it exists (Crucial for hotloading)
 		if (buffer.m_buffer != VK_NULL_HANDLE) {
+			VulkanMemoryManager::UntrackAllocation(buffer.m_allocation);
 			vmaDestroyBuffer(allocator, buffer.m_buffer, buffer.m_allocation);
 		}
 
 		VK_CHECK(vmaCreateBuffer(allocator, &createInfo, &vmaallocInfo, &buffer.m_buffer, &buffer.m_allocation, nullptr));
+		VulkanMemoryManager::TrackAllocation(buffer.m_allocation, MemoryCategory::OTHER);
 
 		// Copy handles into the buffer
 		void* mappedData;
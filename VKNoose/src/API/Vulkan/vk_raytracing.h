@@ -25,7 +25,7 @@ struct HellRaytracer {
 
 	void SetShaders(const std::string& rayGen, const std::vector<std::string>& miss, const std::vector<std::string>& hit);
 
-	void CreatePipeline(VkDevice device, std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, uint32_t maxRecursionDepth);
+	void CreatePipeline(VkDevice device, std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, uint32_t maxRecursionDepth, const std::string& name = "Raytracer");
 	void Cleanup(VkDevice device, VmaAllocator allocator);
 	void DestroyShaders(VkDevice device);
 	void CreateShaderBindingTable(VkDevice device, VmaAllocator allocator, VkPhysicalDeviceRayTracingPipelinePropertiesKHR rayTracingPipelineProperties);
@@ -42,7 +42,9 @@ struct Texture {
 	int _height = 0;
 	int _channelCount = 0;
 	uint32_t _mipLevels = 1;
+	VkFormat _format = VK_FORMAT_R8G8B8A8_UNORM;
 	std::string _filename;
+	bool _atlasPage = false;	// Sprite UV rects point into it, texture defragmentation leaves it where it is
 
 	VkImageLayout _currentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;// VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	VkAccessFlags _currentAccessMask = VK_ACCESS_MEMORY_READ_BIT;// VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
@@ -12,6 +12,23 @@ namespace VulkanUtils {
         return VK_IMAGE_ASPECT_COLOR_BIT;
     }
 
+    inline uint32_t GetBytesPerPixel(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+            case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+            case VK_FORMAT_R16G16_SNORM:
+            case VK_FORMAT_R16G16_SFLOAT:
+            case VK_FORMAT_R32_SFLOAT:
+            case VK_FORMAT_D32_SFLOAT:          return 4;
+            case VK_FORMAT_R16G16B16A16_SFLOAT: return 8;
+            case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+            default:                            return 0;
+        }
+    }
+
     inline uint64_t GetBufferDeviceAddress(VkDevice device, VkBuffer buffer) {
         VkBufferDeviceAddressInfoKHR bufferDeviceAI{ VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
         bufferDeviceAI.buffer = buffer;
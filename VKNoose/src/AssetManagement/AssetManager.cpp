@@ -24,6 +24,7 @@
 #include <string>
 
 #include "API/Vulkan/Managers/vk_command_manager.h"
+#include "API/Vulkan/Managers/vk_memory_manager.h"
 #include "API/Vulkan/Renderer/vk_renderer.h"
 
 
@@ -47,11 +48,112 @@ namespace AssetManager {
 	uint32_t _indexOffset = 0;			// insert index for next mesh
 	std::string _loadLog;
 
+	// Replacement images for textures being moved by the current defragmentation pass
+	std::unordered_map<VmaAllocation, VkImage> g_movedTextureImages;
+
 	void BakeModels();
 	void FindAssetPaths();
+	void InitTextureDefragmentation();
+	Texture* GetTextureByAllocation(VmaAllocation allocation);
 
 	void AssetManager::Init() {
 		FindAssetPaths();
+		InitTextureDefragmentation();
+	}
+
+	// Textures are only reached through their image views, so they can move as long as the
+	// texture descriptors are rewritten afterwards, which RenderLoadingFrame() takes care of.
+	// Atlas pages are left in place.
+	void InitTextureDefragmentation() {
+		VulkanMemoryManager::DefragmentationHandler handler;
+
+		handler.beginMove = [](VmaAllocation srcAllocation, VmaAllocation dstAllocation, VkCommandBuffer cmd) {
+			Texture* texture = GetTextureByAllocation(srcAllocation);
+			if (!texture || texture->imageView == VK_NULL_HANDLE || texture->_atlasPage) return false;
+
+			VkImageCreateInfo createInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+			createInfo.imageType = VK_IMAGE_TYPE_2D;
+			createInfo.format = texture->_format;
+			createInfo.extent = { (uint32_t)texture->_width, (uint32_t)texture->_height, 1 };
+			createInfo.mipLevels = texture->_mipLevels;
+			createInfo.arrayLayers = 1;
+			createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			createInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			VkImage newImage = VK_NULL_HANDLE;
+			if (vkCreateImage(VulkanBackEnd::GetDevice(), &createInfo, nullptr, &newImage) != VK_SUCCESS) return false;
+			if (vmaBindImageMemory(VulkanBackEnd::GetAllocator(), dstAllocation, newImage) != VK_SUCCESS) {
+				vkDestroyImage(VulkanBackEnd::GetDevice(), newImage, nullptr);
+				return false;
+			}
+
+			VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture->_mipLevels, 0, 1 };
+
+			VkImageMemoryBarrier barriers[2] = {};
+			barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barriers[0].image = texture->image._image;
+			barriers[0].subresourceRange = range;
+			barriers[1] = barriers[0];
+			barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barriers[1].srcAccessMask = 0;
+			barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barriers[1].image = newImage;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+			std::vector<VkImageCopy> regions(texture->_mipLevels);
+			for (uint32_t mip = 0; mip < texture->_mipLevels; mip++) {
+				VkImageCopy& region = regions[mip];
+				region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+				region.dstSubresource = region.srcSubresource;
+				region.extent = { std::max(1u, createInfo.extent.width >> mip), std::max(1u, createInfo.extent.height >> mip), 1 };
+			}
+			vkCmdCopyImage(cmd, texture->image._image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+
+			VkImageMemoryBarrier toShaderRead = barriers[1];
+			toShaderRead.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			toShaderRead.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			toShaderRead.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			toShaderRead.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &toShaderRead);
+
+			g_movedTextureImages[srcAllocation] = newImage;
+			return true;
+		};
+
+		handler.endMove = [](VmaAllocation srcAllocation) {
+			auto it = g_movedTextureImages.find(srcAllocation);
+			if (it == g_movedTextureImages.end()) return;
+
+			Texture* texture = GetTextureByAllocation(srcAllocation);
+			vkDestroyImageView(VulkanBackEnd::GetDevice(), texture->imageView, nullptr);
+			vkDestroyImage(VulkanBackEnd::GetDevice(), texture->image._image, nullptr);
+			texture->image._image = it->second;
+
+			VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(texture->_format, texture->image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+			viewInfo.subresourceRange.levelCount = texture->_mipLevels;
+			vkCreateImageView(VulkanBackEnd::GetDevice(), &viewInfo, nullptr, &texture->imageView);
+
+			g_movedTextureImages.erase(it);
+		};
+
+		VulkanMemoryManager::SetDefragmentationHandler(MemoryCategory::TEXTURES, handler);
+	}
+
+	Texture* GetTextureByAllocation(VmaAllocation allocation) {
+		for (Texture& texture : _textures) {
+			if (texture.image._allocation == allocation) return &texture;
+		}
+		return nullptr;
 	}
 
 	bool LoadingComplete() {
@@ -399,8 +501,15 @@ int AssetManager::CreateMeshOLD(std::vector<Vertex>& vertices, std::vector<uint3
 	mesh.m_vertexOffset = _vertexOffset;
 	mesh.m_indexOffset = _indexOffset;
 
-	for (int i = 0; i < vertices.size(); i++)
+	if (vertices.size()) {
+		mesh.m_aabbMin = vertices[0].position;
+		mesh.m_aabbMax = vertices[0].position;
+	}
+	for (int i = 0; i < vertices.size(); i++) {
+		mesh.m_aabbMin = glm::min(mesh.m_aabbMin, vertices[i].position);
+		mesh.m_aabbMax = glm::max(mesh.m_aabbMax, vertices[i].position);
 		_verticesOLD.push_back(vertices[i]);
+	}
 	for (int i = 0; i < indices.size(); i++)
 		_indicesOLD.push_back(indices[i]);
 
@@ -508,6 +617,7 @@ bool AssetManager::load_image_from_file(const char* file, Texture& outTexture, V
 			dimg_allocinfo.usage = VMA_MEMORY_USAGE_AUTO;
 
 			vmaCreateImage(VulkanBackEnd::GetAllocator(), &createInfo, &dimg_allocinfo, &newImage._image, &newImage._allocation, nullptr);
+			VulkanMemoryManager::TrackAllocation(newImage._allocation, MemoryCategory::TEXTURES);
 
 			//transition image to transfer-receiver	
 			VulkanCommandManager::SubmitImmediate([&](VkCommandBuffer cmd)
@@ -617,9 +727,11 @@ bool AssetManager::load_image_from_file(const char* file, Texture& outTexture, V
 					vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 				});
 
+			VulkanMemoryManager::UntrackAllocation(stagingBuffer.m_allocation);
 			vmaDestroyBuffer(VulkanBackEnd::GetAllocator(), stagingBuffer.m_buffer, stagingBuffer.m_allocation);
 
 			outTexture.image = newImage;
+			outTexture._format = imageFormat;
 
 			// Image view  
 			VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(imageFormat, outTexture.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
@@ -687,6 +799,7 @@ bool AssetManager::load_image_from_file(const char* file, Texture& outTexture, V
 		dimg_allocinfo.usage = VMA_MEMORY_USAGE_AUTO;
 
 		vmaCreateImage(VulkanBackEnd::GetAllocator(), &createInfo, &dimg_allocinfo, &newImage._image, &newImage._allocation, nullptr);
+		VulkanMemoryManager::TrackAllocation(newImage._allocation, MemoryCategory::TEXTURES);
 
 		//transition image to transfer-receiver	
 		VulkanCommandManager::SubmitImmediate([&](VkCommandBuffer cmd)
@@ -796,9 +909,11 @@ bool AssetManager::load_image_from_file(const char* file, Texture& outTexture, V
 				vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 			});
 
+		VulkanMemoryManager::UntrackAllocation(stagingBuffer.m_allocation);
 		vmaDestroyBuffer(VulkanBackEnd::GetAllocator(), stagingBuffer.m_buffer, stagingBuffer.m_allocation);
 
 		outTexture.image = newImage;
+		outTexture._format = imageFormat;
 
 		// Image view  
 		VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(imageFormat, outTexture.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
@@ -866,13 +981,19 @@ void AssetManager::AddTexture(Texture& texture) {
 void AssetManager::LoadFont() {
 	// Get the width and height of each character, used for text blitting. Probably move this into TextBlitter::Init()
 	TextBlitter::_charExtents.clear();
+	TextBlitter::_charRegions.clear();
 	for (int i = 1; i <= 90; i++) {
 		std::string filepath = "res/textures/char_" + std::to_string(i) + ".png";
 		Texture texture;
-		AssetManager::load_image_from_file(filepath.c_str(), texture, VkFormat::VK_FORMAT_R8G8B8A8_UNORM, true); // NO MIPS = false
+		AssetManager::LoadAtlasSprite(filepath.c_str(), texture, VkFormat::VK_FORMAT_R8G8B8A8_UNORM);
 		AssetManager::AddTexture(texture);
 		TextBlitter::_charExtents.push_back({ AssetManager::GetTexture(i - 1)->_width, AssetManager::GetTexture(i - 1)->_height });
 	}
+	// Glyphs are needed by the loading screen, so their page is built right away
+	AssetManager::BuildPendingAtlasPages();
+	for (int i = 0; i < 90; i++) {
+		TextBlitter::_charRegions.push_back(AssetManager::GetAtlasRegion(i));
+	}
 }
 
 bool AssetManager::TextureExists(const std::string& filename) {
@@ -916,7 +1037,12 @@ bool AssetManager::LoadNextTexture() {
 				if (info.materialType == "ALB" || info.filename.substr(0, 2) == "OS") {
 					imageFormat = VK_FORMAT_R8G8B8A8_SRGB;
 				}
-				load_image_from_file(info.fullpath.c_str(), texture, imageFormat, false); // no mips
+				if (info.filename.substr(0, 3) == "OS_" && IsAtlasCandidate(info.fullpath)) {
+					LoadAtlasSprite(info.fullpath.c_str(), texture, imageFormat);
+				}
+				else {
+					load_image_from_file(info.fullpath.c_str(), texture, imageFormat, false); // no mips
+				}
 				AddTexture(texture);
 				VulkanBackEnd::AddLoadingText(info.fullpath);
 				return true;
@@ -924,6 +1050,7 @@ bool AssetManager::LoadNextTexture() {
 		}
 	}
 	// Everything is loaded
+	BuildPendingAtlasPages();
 	return false;
 }
 
@@ -106,7 +106,7 @@ namespace AssetManager  {
 	//std::vector<Vertex> GetMeshVertices(Mesh* mesh);
 	std::span<Vertex> GetMeshVerticesSpan(Mesh* mesh);
 	std::span<uint32_t> GetMeshIndicesSpan(Mesh* mesh);
-	//void CreateMeshBvhs();
+	void CreateMeshBvhs();
 	const std::string& GetMeshNameByMeshIndex(int index);
 
 	// Models
@@ -176,6 +176,14 @@ namespace AssetManager  {
 	int GetNumberOfTextures();
 	bool TextureExists(const std::string& name);
 
+	// UI atlas
+	bool IsAtlasCandidate(const std::string& filepath);
+	bool LoadAtlasSprite(const char* file, Texture& outTexture, VkFormat imageFormat);
+	void BuildPendingAtlasPages();
+	AtlasRegion GetAtlasRegion(int textureIndex);
+	VkImageView GetTextureImageView(int textureIndex); // Packed sprites resolve to their atlas page
+	int GetAtlasPageCount();
+
 	void SaveImageData(std::string, int width, int height, int channels, void* data);
 	void SaveImageDataF(std::string, int width, int height, int channels, void* data);
 	void SaveImageDataU8(std::string path, int width, int height, int channels, void* data);
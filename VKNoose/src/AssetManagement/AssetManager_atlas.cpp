@@ -0,0 +1,238 @@
+#include "AssetManager.h"
+#include "API/Vulkan/vk_initializers.h"
+#include "API/Vulkan/Managers/vk_command_manager.h"
+#include "API/Vulkan/Managers/vk_memory_manager.h"
+
+#include <stb_image.h>
+#include <algorithm>
+#include <unordered_map>
+
+namespace AssetManager {
+    // Glyphs and the laptop OS sprites are packed into a few shared pages instead of each getting its own image and descriptor.
+    // Their texture entries stay around for names and sizes, drawing goes through the page and a UV rect.
+    constexpr int ATLAS_MAX_SPRITE_SIZE = 512;
+    constexpr int ATLAS_MIN_PAGE_SIZE = 128;
+    constexpr int ATLAS_MAX_PAGE_SIZE = 2048;
+    constexpr int ATLAS_PADDING = 1;        // Gutter filled with the sprite's edge texels so linear filtering doesn't bleed
+
+    struct PendingSprite {
+        std::string name;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        int width = 0;
+        int height = 0;
+        int x = 0;
+        int y = 0;
+        std::vector<uint8_t> pixels;
+    };
+
+    std::vector<PendingSprite> g_pendingSprites;
+    std::unordered_map<int, AtlasRegion> g_atlasRegions;   // Keyed by the sprite's texture index
+    int g_atlasPageCount = 0;
+
+    size_t PackAtlasPage(std::vector<PendingSprite>& sprites, size_t first, size_t last, int pageSize);
+    void UploadAtlasPage(std::vector<PendingSprite>& sprites, size_t first, size_t last, int pageSize, VkFormat format);
+
+    bool IsAtlasCandidate(const std::string& filepath) {
+        int width, height, channelCount;
+        if (!stbi_info(filepath.c_str(), &width, &height, &channelCount)) {
+            return false;
+        }
+        return width <= ATLAS_MAX_SPRITE_SIZE && height <= ATLAS_MAX_SPRITE_SIZE;
+    }
+
+    bool LoadAtlasSprite(const char* file, Texture& outTexture, VkFormat imageFormat) {
+        stbi_uc* pixels = stbi_load(file, &outTexture._width, &outTexture._height, &outTexture._channelCount, STBI_rgb_alpha);
+        if (!pixels) {
+            std::cout << "Failed to load texture file " << file << std::endl;
+            return false;
+        }
+
+        std::string filepath = file;
+        std::string filename = filepath.substr(filepath.rfind("/") + 1);
+        outTexture._filename = filename.substr(0, filename.length() - 4);
+        outTexture._mipLevels = 1;
+        outTexture.image = {};
+        outTexture.imageView = VK_NULL_HANDLE;
+
+        PendingSprite& sprite = g_pendingSprites.emplace_back();
+        sprite.name = outTexture._filename;
+        sprite.format = imageFormat;
+        sprite.width = outTexture._width;
+        sprite.height = outTexture._height;
+        sprite.pixels.assign(pixels, pixels + (size_t)sprite.width * sprite.height * 4);
+        stbi_image_free(pixels);
+        return true;
+    }
+
+    void BuildPendingAtlasPages() {
+        if (g_pendingSprites.empty()) return;
+
+        // Formats never share a page, and the shelf packer wants the tallest sprites first
+        std::stable_sort(g_pendingSprites.begin(), g_pendingSprites.end(), [](const PendingSprite& a, const PendingSprite& b) {
+            if (a.format != b.format) return a.format < b.format;
+            return a.height > b.height;
+        });
+
+        size_t first = 0;
+        while (first < g_pendingSprites.size()) {
+            VkFormat format = g_pendingSprites[first].format;
+            size_t formatEnd = first;
+            while (formatEnd < g_pendingSprites.size() && g_pendingSprites[formatEnd].format == format) {
+                formatEnd++;
+            }
+
+            // Smallest page that takes the whole group, otherwise fill a max size page and spill the rest onto the next
+            int pageSize = ATLAS_MIN_PAGE_SIZE;
+            while (pageSize < ATLAS_MAX_PAGE_SIZE && PackAtlasPage(g_pendingSprites, first, formatEnd, pageSize) < formatEnd) {
+                pageSize *= 2;
+            }
+            size_t last = PackAtlasPage(g_pendingSprites, first, formatEnd, pageSize);
+
+            UploadAtlasPage(g_pendingSprites, first, last, pageSize, format);
+            first = last;
+        }
+        g_pendingSprites.clear();
+    }
+
+    AtlasRegion GetAtlasRegion(int textureIndex) {
+        auto it = g_atlasRegions.find(textureIndex);
+        if (it != g_atlasRegions.end()) {
+            return it->second;
+        }
+        AtlasRegion region;
+        region.textureIndex = textureIndex;
+        return region;
+    }
+
+    VkImageView GetTextureImageView(int textureIndex) {
+        return GetTexture(GetAtlasRegion(textureIndex).textureIndex)->imageView;
+    }
+
+    int GetAtlasPageCount() {
+        return g_atlasPageCount;
+    }
+
+    size_t PackAtlasPage(std::vector<PendingSprite>& sprites, size_t first, size_t last, int pageSize) {
+        int x = 0;
+        int y = 0;
+        int shelfHeight = 0;
+
+        for (size_t i = first; i < last; i++) {
+            PendingSprite& sprite = sprites[i];
+            int paddedWidth = sprite.width + ATLAS_PADDING * 2;
+            int paddedHeight = sprite.height + ATLAS_PADDING * 2;
+
+            if (x + paddedWidth > pageSize) {
+                x = 0;
+                y += shelfHeight;
+                shelfHeight = 0;
+            }
+            if (paddedWidth > pageSize || y + paddedHeight > pageSize) {
+                return i;
+            }
+
+            sprite.x = x + ATLAS_PADDING;
+            sprite.y = y + ATLAS_PADDING;
+            x += paddedWidth;
+            shelfHeight = std::max(shelfHeight, paddedHeight);
+        }
+        return last;
+    }
+
+    void UploadAtlasPage(std::vector<PendingSprite>& sprites, size_t first, size_t last, int pageSize, VkFormat format) {
+        if (first == last) return;
+
+        // Compose the page, extruding each sprite's border into its gutter
+        std::vector<uint8_t> pagePixels((size_t)pageSize * pageSize * 4, 0);
+        for (size_t i = first; i < last; i++) {
+            const PendingSprite& sprite = sprites[i];
+            for (int py = -ATLAS_PADDING; py < sprite.height + ATLAS_PADDING; py++) {
+                int sy = std::clamp(py, 0, sprite.height - 1);
+                for (int px = -ATLAS_PADDING; px < sprite.width + ATLAS_PADDING; px++) {
+                    int sx = std::clamp(px, 0, sprite.width - 1);
+                    const uint8_t* src = &sprite.pixels[((size_t)sy * sprite.width + sx) * 4];
+                    uint8_t* dst = &pagePixels[((size_t)(sprite.y + py) * pageSize + (sprite.x + px)) * 4];
+                    memcpy(dst, src, 4);
+                }
+            }
+        }
+
+        VkDeviceSize imageSize = pagePixels.size();
+        AllocatedBufferOLD stagingBuffer = VulkanBackEnd::create_buffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+
+        void* data;
+        vmaMapMemory(VulkanBackEnd::GetAllocator(), stagingBuffer.m_allocation, &data);
+        memcpy(data, pagePixels.data(), static_cast<size_t>(imageSize));
+        vmaUnmapMemory(VulkanBackEnd::GetAllocator(), stagingBuffer.m_allocation);
+
+        VkExtent3D imageExtent = { (uint32_t)pageSize, (uint32_t)pageSize, 1 };
+
+        VkImageCreateInfo createInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        createInfo.imageType = VK_IMAGE_TYPE_2D;
+        createInfo.format = format;
+        createInfo.extent = imageExtent;
+        createInfo.mipLevels = 1;
+        createInfo.arrayLayers = 1;
+        createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        createInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+
+        Texture page;
+        vmaCreateImage(VulkanBackEnd::GetAllocator(), &createInfo, &allocInfo, &page.image._image, &page.image._allocation, nullptr);
+        VulkanMemoryManager::TrackAllocation(page.image._allocation, MemoryCategory::TEXTURES);
+
+        VulkanCommandManager::SubmitImmediate([&](VkCommandBuffer cmd) {
+            VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.image = page.image._image;
+            barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkBufferImageCopy copyRegion = {};
+            copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            copyRegion.imageExtent = imageExtent;
+            vkCmdCopyBufferToImage(cmd, stagingBuffer.m_buffer, page.image._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        });
+
+        VulkanMemoryManager::UntrackAllocation(stagingBuffer.m_allocation);
+        vmaDestroyBuffer(VulkanBackEnd::GetAllocator(), stagingBuffer.m_buffer, stagingBuffer.m_allocation);
+
+        VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(format, page.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+        vkCreateImageView(VulkanBackEnd::GetDevice(), &viewInfo, nullptr, &page.imageView);
+
+        page._width = pageSize;
+        page._height = pageSize;
+        page._channelCount = 4;
+        page._mipLevels = 1;
+        page._format = format;
+        page._atlasPage = true;
+        page._filename = "UIAtlas_" + std::to_string(g_atlasPageCount++);
+        AddTexture(page);
+        int pageIndex = GetNumberOfTextures() - 1;
+
+        float texelSize = 1.0f / pageSize;
+        for (size_t i = first; i < last; i++) {
+            const PendingSprite& sprite = sprites[i];
+            AtlasRegion region;
+            region.textureIndex = pageIndex;
+            region.uvRect = glm::vec4(sprite.x, sprite.y, sprite.x + sprite.width, sprite.y + sprite.height) * texelSize;
+            g_atlasRegions[GetTextureIndex(sprite.name)] = region;
+        }
+
+        std::cout << "Packed " << (last - first) << " sprites into " << page._filename << " (" << pageSize << "x" << pageSize << ")\n";
+    }
+}
\ No newline at end of file
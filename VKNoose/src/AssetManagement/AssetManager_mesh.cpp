@@ -1,4 +1,7 @@
 #include "AssetManager.h"
+#include "Bvh/Cpu/CpuBvh.h"
+#include "Util.h"
+#include <chrono>
 #include <mutex>
 
 namespace AssetManager {
@@ -145,39 +148,30 @@ namespace AssetManager {
     }
 
 
-    //void CreateMeshBvhs() {
-    //    Timer timer("CreateMeshBVHs()");
-    //
-    //    for (Mesh& mesh : GetMeshes()) {
-    //        Timer timer("CreateMeshBVHs() " + mesh.GetName() + " " + std::to_string(mesh.indexCount));
-    //
-    //        std::vector<Vertex> vertices = GetMeshVertices(&mesh);
-    //
-    //        std::vector<uint32_t> indices(vertices.size());
-    //        for (uint32_t i = 0; i < indices.size(); i++) {
-    //            indices[i] = i;
-    //        }
-    //
-    //        std::span<Vertex> verticesSpan = GetMeshVerticesSpan(&mesh);
-    //        std::span<uint32_t> indicesSpan = GetMeshIndicesSpan(&mesh);
-    //
-    //        vertices.clear();
-    //        indices.clear();
-    //
-    //        vertices.reserve(verticesSpan.size());
-    //        indices.reserve(indicesSpan.size());
-    //
-    //        for (Vertex& vertex : verticesSpan) {
-    //            vertices.push_back(vertex);
-    //        }
-    //
-    //        for (uint32_t& index : indicesSpan) {
-    //            indices.push_back(index);
-    //        }
-    //
-    //        Bvh::Cpu::DestroyMeshBvh(mesh.meshBvhId);
-    //        mesh.meshBvhId = Bvh::Cpu::CreateMeshBvhFromVertexData(vertices, indices);
-    //    }
-    //    Bvh::Cpu::FlatternMeshBvhNodes();
-    //}
+    // CPU BVHs for every MeshOLD that doesn't have one yet, so ray queries can run without waiting on the GPU
+    void CreateMeshBvhs() {
+        std::vector<MeshOLD>& meshes = GetMeshList();
+        std::vector<Vertex>& vertices = GetVertices_TEMPORARY();
+        std::vector<uint32_t>& indices = GetIndices_TEMPORARY();
+
+        std::vector<MeshOLD*> pendingMeshes;
+        for (MeshOLD& mesh : meshes) {
+            if (mesh.m_meshBvhId == 0) {
+                pendingMeshes.push_back(&mesh);
+            }
+        }
+        if (pendingMeshes.empty()) return;
+
+        auto startTime = std::chrono::steady_clock::now();
+        Util::ParallelFor((uint32_t)pendingMeshes.size(), std::max(1u, std::thread::hardware_concurrency()), [&](uint32_t i) {
+            MeshOLD* mesh = pendingMeshes[i];
+            std::span<const Vertex> meshVertices(vertices.data() + mesh->m_vertexOffset, mesh->m_vertexCount);
+            std::span<const uint32_t> meshIndices(indices.data() + mesh->m_indexOffset, mesh->m_indexCount);
+            mesh->m_meshBvhId = Bvh::Cpu::CreateMeshBvhFromVertexData(meshVertices, meshIndices);
+        });
+        Bvh::Cpu::FlatternMeshBvhNodes();
+
+        std::chrono::duration<float, std::milli> duration = std::chrono::steady_clock::now() - startTime;
+        std::cout << "AssetManager::CreateMeshBvhs() built " << pendingMeshes.size() << " mesh BVHs in " << duration.count() << "ms\n";
+    }
 }
\ No newline at end of file
@@ -37,6 +37,10 @@ namespace BackEnd {
         return GLFWIntegration::GetWindowedMode();
     }
 
+    bool IsHeadless() {
+        return GLFWIntegration::IsHeadless();
+    }
+
     void BackEnd::SetWindowedMode(const WindowedMode& windowedMode) {
         GLFWIntegration::SetWindowedMode(windowedMode);
     }
@@ -21,4 +21,5 @@ namespace BackEnd {
     int GetFullScreenWidth();
     int GetFullScreenHeight();
     const WindowedMode& GetWindowedMode();
+    bool IsHeadless();
 }
\ No newline at end of file
@@ -28,6 +28,13 @@ namespace GLFWIntegration {
 
     bool Init(WindowedMode windowedMode) {
         glfwInit();
+
+        // GLFW is still initialized for its timer, but there is no monitor or window to query
+        if (windowedMode == WindowedMode::HEADLESS) {
+            g_windowedMode = windowedMode;
+            return true;
+        }
+
         g_monitor = glfwGetPrimaryMonitor();
         g_mode = glfwGetVideoMode(g_monitor);
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -68,6 +75,7 @@ namespace GLFWIntegration {
     }
 
     void SetWindowedMode(const WindowedMode& windowedMode) {
+        if (IsHeadless() || windowedMode == WindowedMode::HEADLESS) return;
         g_windowedMode = windowedMode;
 
         if (windowedMode == WindowedMode::WINDOWED) {
@@ -97,6 +105,7 @@ namespace GLFWIntegration {
     }
     
     void WaitUntilNotMinimized() {
+        if (IsHeadless()) return;
         do {
             glfwGetFramebufferSize(g_window, &g_currentWindowWidth, &g_currentWindowHeight);
             if (g_currentWindowWidth == 0 || g_currentWindowHeight == 0) {
@@ -138,10 +147,12 @@ namespace GLFWIntegration {
     }
 
     bool WindowIsOpen() {
+        if (IsHeadless()) return !g_forceCloseWindow;
         return !(glfwWindowShouldClose(g_window) || g_forceCloseWindow);
     }
 
     bool WindowIsMinimized() {
+        if (IsHeadless()) return false;
         int width = 0;
         int height = 0;
         glfwGetFramebufferSize(g_window, &width, &height);
@@ -156,6 +167,10 @@ namespace GLFWIntegration {
         return g_window;
     }
 
+    bool IsHeadless() {
+        return g_windowedMode == WindowedMode::HEADLESS;
+    }
+
     void framebuffer_size_callback(GLFWwindow* /*window*/, int /*width*/, int /*height*/) {
         // Nothing as of yet
     }
@@ -23,4 +23,5 @@ namespace GLFWIntegration {
 
     const WindowedMode& GetWindowedMode();
     void* GetWindowPointer();
+    bool IsHeadless();
 }
\ No newline at end of file
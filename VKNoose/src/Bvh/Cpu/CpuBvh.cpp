@@ -0,0 +1,782 @@
+#include "CpuBvh.h"
+#include "Hell/Containers/SlotMap.h"
+#include "Hell/Core/UniqueID.h"
+#include "Util.h"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cassert>
+#include <iostream>
+#include <mutex>
+
+namespace Bvh::Cpu {
+    constexpr int SAH_BIN_COUNT = 16;
+    constexpr uint32_t MIN_LEAF_SIZE = 2;
+    constexpr uint32_t MAX_LEAF_SIZE = 8;
+    constexpr int TRAVERSAL_STACK_SIZE = 256;
+
+    // A traversal holds at most three pending siblings per level plus the children it just pushed, so capping
+    // the binary tree depth here keeps every Node4 tree within TRAVERSAL_STACK_SIZE. Nodes that reach it become leaves.
+    constexpr uint32_t MAX_BUILD_DEPTH = (TRAVERSAL_STACK_SIZE - 1) / 3;
+
+    // Below this many primitives a build stays on the calling thread, above it the top of the tree is split
+    // on the calling thread and the subtrees underneath are built by workers. Builds that already run on a
+    // ParallelFor worker, one mesh each, always stay on their thread.
+    constexpr uint32_t PARALLEL_BUILD_MIN_PRIMITIVES = 16384;
+    constexpr uint32_t PARALLEL_BUILD_TASKS_PER_WORKER = 4;
+
+    struct Aabb {
+        glm::vec3 min = glm::vec3(FLT_MAX);
+        glm::vec3 max = glm::vec3(-FLT_MAX);
+
+        void Grow(const glm::vec3& p) {
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+        void Grow(const Aabb& other) {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+        float Area() const {
+            glm::vec3 e = max - min;
+            return (e.x < 0) ? 0.0f : (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+    };
+
+    // Four children tested at once with SSE. Leaves store a range of primitives, inner children a node index.
+    struct alignas(16) Node4 {
+        float boundsMin[3][4];
+        float boundsMax[3][4];
+        int32_t child[4];       // -1 for an empty slot
+        uint32_t primCount[4];  // 0 for inner nodes
+    };
+
+    struct Triangle {
+        glm::vec3 v0;
+        glm::vec3 e1;
+        glm::vec3 e2;
+        uint32_t primitiveIndex;
+    };
+
+    struct BuildNode {
+        Aabb bounds;
+        int left = -1;
+        int right = -1;
+        uint32_t first = 0;
+        uint32_t count = 0;
+        uint32_t depth = 0;
+    };
+
+    struct BuildInput {
+        const std::vector<Aabb>& primBounds;
+        std::vector<glm::vec3> centroids;
+    };
+
+    struct Tree {
+        std::vector<Node4> nodes;
+        std::vector<uint32_t> primOrder;
+        Aabb bounds;
+    };
+
+    // Before FlatternMeshBvhNodes() the nodes and triangles live in the mesh itself, afterwards in g_nodes and g_triangles
+    struct MeshBvh {
+        std::vector<Node4> nodes;
+        std::vector<Triangle> triangles;
+        Aabb bounds;
+        bool flattened = false;
+        uint32_t nodeOffset = 0;
+        uint32_t nodeCount = 0;
+        uint32_t triangleOffset = 0;
+        uint32_t triangleCount = 0;
+    };
+
+    struct InstanceData {
+        glm::mat4 objectToWorld = glm::mat4(1);
+        glm::mat4 worldToObject = glm::mat4(1);
+        uint64_t meshBvhId = 0;
+        int32_t rootNode = -1;  // Into g_nodes, -1 if the mesh BVH is missing, empty or not flattened yet
+        Aabb worldBounds;
+    };
+
+    struct SceneBvh {
+        std::vector<InstanceData> instances;
+        Tree tlas;
+    };
+
+    struct RayData {
+        __m128 origin[3];
+        __m128 invDir[3];
+        float tMin;
+    };
+
+    Hell::SlotMap<MeshBvh> g_meshBvhs;
+    Hell::SlotMap<SceneBvh> g_sceneBvhs;
+    std::vector<Node4> g_nodes;
+    std::vector<Triangle> g_triangles;
+    std::mutex g_meshBvhMutex;
+
+    void RefreshSceneInstances(SceneBvh& scene);
+
+    //////////////////
+    //              //
+    //     Build    //
+
+    // Binned SAH over nodes[rootIndex]. Splits until the SAH says a leaf is cheaper or MIN_LEAF_SIZE is reached,
+    // nodes holding deferBelow primitives or fewer are left unsplit and returned for a worker to finish.
+    std::vector<int> SplitNodes(const BuildInput& input, std::vector<uint32_t>& primOrder, std::vector<BuildNode>& nodes, int rootIndex, uint32_t deferBelow) {
+        std::vector<int> deferred;
+        std::vector<int> stack = { rootIndex };
+        while (!stack.empty()) {
+            int nodeIndex = stack.back();
+            stack.pop_back();
+
+            uint32_t first = nodes[nodeIndex].first;
+            uint32_t count = nodes[nodeIndex].count;
+
+            if (count <= deferBelow && nodeIndex != rootIndex) {
+                deferred.push_back(nodeIndex);
+                continue;
+            }
+
+            Aabb bounds;
+            Aabb centroidBounds;
+            for (uint32_t i = first; i < first + count; i++) {
+                bounds.Grow(input.primBounds[primOrder[i]]);
+                centroidBounds.Grow(input.centroids[primOrder[i]]);
+            }
+            nodes[nodeIndex].bounds = bounds;
+
+            if (count <= MIN_LEAF_SIZE || nodes[nodeIndex].depth >= MAX_BUILD_DEPTH) {
+                continue;
+            }
+
+            int bestAxis = -1;
+            int bestSplit = 0;
+            float bestCost = FLT_MAX;
+            glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+
+            for (int axis = 0; axis < 3; axis++) {
+                if (extent[axis] <= 0.0f) continue;
+
+                Aabb binBounds[SAH_BIN_COUNT];
+                uint32_t binCounts[SAH_BIN_COUNT] = {};
+                float scale = SAH_BIN_COUNT / extent[axis];
+                for (uint32_t i = first; i < first + count; i++) {
+                    int bin = std::min(SAH_BIN_COUNT - 1, (int)((input.centroids[primOrder[i]][axis] - centroidBounds.min[axis]) * scale));
+                    binCounts[bin]++;
+                    binBounds[bin].Grow(input.primBounds[primOrder[i]]);
+                }
+
+                float leftArea[SAH_BIN_COUNT - 1];
+                uint32_t leftCount[SAH_BIN_COUNT - 1];
+                Aabb running;
+                uint32_t runningCount = 0;
+                for (int i = 0; i < SAH_BIN_COUNT - 1; i++) {
+                    running.Grow(binBounds[i]);
+                    runningCount += binCounts[i];
+                    leftArea[i] = running.Area();
+                    leftCount[i] = runningCount;
+                }
+                running = Aabb();
+                runningCount = 0;
+                for (int i = SAH_BIN_COUNT - 1; i > 0; i--) {
+                    running.Grow(binBounds[i]);
+                    runningCount += binCounts[i];
+                    if (leftCount[i - 1] == 0 || runningCount == 0) continue;
+                    float cost = leftArea[i - 1] * leftCount[i - 1] + running.Area() * runningCount;
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = i;
+                    }
+                }
+            }
+
+            uint32_t mid = first + count / 2;
+            if (bestAxis != -1) {
+                if (bestCost >= bounds.Area() * count && count <= MAX_LEAF_SIZE) {
+                    continue;
+                }
+                float binMin = centroidBounds.min[bestAxis];
+                float scale = SAH_BIN_COUNT / extent[bestAxis];
+                auto split = std::partition(primOrder.begin() + first, primOrder.begin() + first + count, [&](uint32_t prim) {
+                    return std::min(SAH_BIN_COUNT - 1, (int)((input.centroids[prim][bestAxis] - binMin) * scale)) < bestSplit;
+                });
+                mid = (uint32_t)(split - primOrder.begin());
+            }
+            else if (count <= MAX_LEAF_SIZE) {
+                continue; // Every centroid is in the same spot
+            }
+
+            int left = (int)nodes.size();
+            uint32_t childDepth = nodes[nodeIndex].depth + 1;
+            nodes.emplace_back().first = first;
+            nodes.back().count = mid - first;
+            nodes.back().depth = childDepth;
+            nodes.emplace_back().first = mid;
+            nodes.back().count = first + count - mid;
+            nodes.back().depth = childDepth;
+            nodes[nodeIndex].left = left;
+            nodes[nodeIndex].right = left + 1;
+            stack.push_back(left);
+            stack.push_back(left + 1);
+        }
+        return deferred;
+    }
+
+    std::vector<BuildNode> BuildBinaryTree(const BuildInput& input, std::vector<uint32_t>& primOrder) {
+        std::vector<BuildNode> nodes;
+        nodes.reserve(primOrder.size() * 2);
+        nodes.emplace_back().count = (uint32_t)primOrder.size();
+
+        uint32_t workerCount = std::max(1u, std::thread::hardware_concurrency());
+        if (primOrder.size() < PARALLEL_BUILD_MIN_PRIMITIVES || workerCount == 1 || Util::IsParallelForWorker()) {
+            SplitNodes(input, primOrder, nodes, 0, 0);
+            return nodes;
+        }
+
+        // Split the top of the tree here until there are enough subtrees to keep every worker busy. They cover
+        // disjoint ranges of primOrder, so each worker partitions its own range into its own node list.
+        uint32_t deferBelow = std::max(PARALLEL_BUILD_MIN_PRIMITIVES / 4, (uint32_t)primOrder.size() / (workerCount * PARALLEL_BUILD_TASKS_PER_WORKER));
+        std::vector<int> deferred = SplitNodes(input, primOrder, nodes, 0, deferBelow);
+
+        std::vector<std::vector<BuildNode>> subtrees(deferred.size());
+        Util::ParallelFor((uint32_t)deferred.size(), workerCount, [&](uint32_t item) {
+            std::vector<BuildNode>& subtree = subtrees[item];
+            subtree.reserve(nodes[deferred[item]].count * 2);
+            subtree.push_back(nodes[deferred[item]]);
+            SplitNodes(input, primOrder, subtree, 0, 0);
+        });
+
+        // Stitch each subtree in place of the node it was built from, its root replaces that node and the rest are appended
+        for (size_t i = 0; i < deferred.size(); i++) {
+            std::vector<BuildNode>& subtree = subtrees[i];
+            int offset = (int)nodes.size() - 1;
+            for (BuildNode& node : subtree) {
+                if (node.left != -1) {
+                    node.left += offset;
+                    node.right += offset;
+                }
+            }
+            nodes[deferred[i]] = subtree[0];
+            nodes.insert(nodes.end(), subtree.begin() + 1, subtree.end());
+        }
+        return nodes;
+    }
+
+    // Pulls grandchildren up until each node has four children, opening the largest inner child first
+    int CollapseToNode4(const std::vector<BuildNode>& buildNodes, int buildIndex, std::vector<Node4>& nodes) {
+        int nodeIndex = (int)nodes.size();
+        nodes.emplace_back();
+
+        int children[4] = { buildIndex, -1, -1, -1 };
+        int childCount = 1;
+        while (childCount < 4) {
+            int best = -1;
+            float bestArea = -1.0f;
+            for (int i = 0; i < childCount; i++) {
+                const BuildNode& child = buildNodes[children[i]];
+                if (child.left != -1 && child.bounds.Area() > bestArea) {
+                    bestArea = child.bounds.Area();
+                    best = i;
+                }
+            }
+            if (best == -1) break;
+            const BuildNode& opened = buildNodes[children[best]];
+            children[best] = opened.left;
+            children[childCount++] = opened.right;
+        }
+
+        for (int i = 0; i < 4; i++) {
+            Node4& node = nodes[nodeIndex];
+            node.child[i] = -1;
+            node.primCount[i] = 0;
+            for (int axis = 0; axis < 3; axis++) {
+                node.boundsMin[axis][i] = FLT_MAX;
+                node.boundsMax[axis][i] = -FLT_MAX;
+            }
+            if (i >= childCount) continue;
+
+            const BuildNode& child = buildNodes[children[i]];
+            for (int axis = 0; axis < 3; axis++) {
+                node.boundsMin[axis][i] = child.bounds.min[axis];
+                node.boundsMax[axis][i] = child.bounds.max[axis];
+            }
+            if (child.left == -1) {
+                node.child[i] = (int32_t)child.first;
+                node.primCount[i] = child.count;
+            }
+            else {
+                int childNodeIndex = CollapseToNode4(buildNodes, children[i], nodes);
+                nodes[nodeIndex].child[i] = childNodeIndex;
+            }
+        }
+        return nodeIndex;
+    }
+
+    Tree BuildTree(const std::vector<Aabb>& primBounds) {
+        Tree tree;
+        if (primBounds.empty()) return tree;
+
+        BuildInput input = { primBounds };
+        input.centroids.resize(primBounds.size());
+        for (size_t i = 0; i < primBounds.size(); i++) {
+            input.centroids[i] = (primBounds[i].min + primBounds[i].max) * 0.5f;
+        }
+
+        tree.primOrder.resize(primBounds.size());
+        for (uint32_t i = 0; i < tree.primOrder.size(); i++) {
+            tree.primOrder[i] = i;
+        }
+        std::vector<BuildNode> buildNodes = BuildBinaryTree(input, tree.primOrder);
+        tree.bounds = buildNodes[0].bounds;
+        tree.nodes.reserve(buildNodes.size() / 2 + 1);
+        CollapseToNode4(buildNodes, 0, tree.nodes);
+        return tree;
+    }
+
+    //////////////////////
+    //                  //
+    //     Mesh BVH     //
+
+    uint64_t CreateMeshBvhFromVertexData(std::span<const Vertex> vertices, std::span<const uint32_t> indices) {
+        MeshBvh meshBvh;
+
+        uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+        std::vector<Triangle> triangles;
+        std::vector<Aabb> bounds;
+        triangles.reserve(triangleCount);
+        bounds.reserve(triangleCount);
+        for (uint32_t i = 0; i < triangleCount; i++) {
+            if (indices[3 * i] >= vertices.size() || indices[3 * i + 1] >= vertices.size() || indices[3 * i + 2] >= vertices.size()) {
+                std::cout << "Bvh::Cpu::CreateMeshBvhFromVertexData() skipped triangle " << i << " because it indexes past the " << vertices.size() << " vertices\n";
+                continue;
+            }
+            glm::vec3 p0 = vertices[indices[3 * i]].position;
+            glm::vec3 p1 = vertices[indices[3 * i + 1]].position;
+            glm::vec3 p2 = vertices[indices[3 * i + 2]].position;
+            triangles.push_back({ p0, p1 - p0, p2 - p0, i });
+            Aabb& triangleBounds = bounds.emplace_back();
+            triangleBounds.Grow(p0);
+            triangleBounds.Grow(p1);
+            triangleBounds.Grow(p2);
+        }
+
+        Tree tree = BuildTree(bounds);
+        meshBvh.nodes = std::move(tree.nodes);
+        meshBvh.bounds = tree.bounds;
+        meshBvh.triangles.reserve(triangles.size());
+        for (uint32_t prim : tree.primOrder) {
+            meshBvh.triangles.push_back(triangles[prim]);
+        }
+        meshBvh.nodeCount = (uint32_t)meshBvh.nodes.size();
+        meshBvh.triangleCount = (uint32_t)meshBvh.triangles.size();
+
+        std::lock_guard<std::mutex> lock(g_meshBvhMutex);
+        const uint64_t id = UniqueID::GetNextObjectId(ObjectType::CPU_MESH_BVH);
+        g_meshBvhs.emplace_with_id(id, std::move(meshBvh));
+        return id;
+    }
+
+    void DestroyMeshBvh(uint64_t meshBvhId) {
+        // Its nodes stay in g_nodes until the next FlatternMeshBvhNodes()
+        std::lock_guard<std::mutex> lock(g_meshBvhMutex);
+        g_meshBvhs.erase(meshBvhId);
+    }
+
+    uint32_t GetMeshBvhTriangleCount(uint64_t meshBvhId) {
+        const MeshBvh* meshBvh = g_meshBvhs.get(meshBvhId);
+        return meshBvh ? meshBvh->triangleCount : 0;
+    }
+
+    // Packs every mesh BVH into g_nodes and g_triangles, one after the other, so a query walks a single array per type.
+    // Child indices are rebased on the way in, inner children to g_nodes and leaves to g_triangles.
+    void FlatternMeshBvhNodes() {
+        std::lock_guard<std::mutex> lock(g_meshBvhMutex);
+
+        size_t nodeCount = 0;
+        size_t triangleCount = 0;
+        for (MeshBvh& meshBvh : g_meshBvhs) {
+            nodeCount += meshBvh.nodeCount;
+            triangleCount += meshBvh.triangleCount;
+        }
+
+        std::vector<Node4> nodes;
+        std::vector<Triangle> triangles;
+        nodes.reserve(nodeCount);
+        triangles.reserve(triangleCount);
+
+        for (MeshBvh& meshBvh : g_meshBvhs) {
+            const Node4* srcNodes = meshBvh.flattened ? g_nodes.data() + meshBvh.nodeOffset : meshBvh.nodes.data();
+            const Triangle* srcTriangles = meshBvh.flattened ? g_triangles.data() + meshBvh.triangleOffset : meshBvh.triangles.data();
+            int32_t srcNodeOffset = meshBvh.flattened ? (int32_t)meshBvh.nodeOffset : 0;
+            int32_t srcTriangleOffset = meshBvh.flattened ? (int32_t)meshBvh.triangleOffset : 0;
+            int32_t nodeOffset = (int32_t)nodes.size();
+            int32_t triangleOffset = (int32_t)triangles.size();
+
+            for (uint32_t i = 0; i < meshBvh.nodeCount; i++) {
+                Node4& node = nodes.emplace_back(srcNodes[i]);
+                for (int j = 0; j < 4; j++) {
+                    if (node.child[j] < 0) continue;
+                    node.child[j] += (node.primCount[j] > 0) ? (triangleOffset - srcTriangleOffset) : (nodeOffset - srcNodeOffset);
+                }
+            }
+            triangles.insert(triangles.end(), srcTriangles, srcTriangles + meshBvh.triangleCount);
+
+            meshBvh.nodeOffset = (uint32_t)nodeOffset;
+            meshBvh.triangleOffset = (uint32_t)triangleOffset;
+            meshBvh.flattened = true;
+            meshBvh.nodes = std::vector<Node4>();
+            meshBvh.triangles = std::vector<Triangle>();
+        }
+
+        g_nodes = std::move(nodes);
+        g_triangles = std::move(triangles);
+
+        for (SceneBvh& scene : g_sceneBvhs) {
+            RefreshSceneInstances(scene);
+        }
+    }
+
+    ///////////////////////
+    //                   //
+    //     Scene BVH     //
+
+    uint64_t CreateSceneBvh() {
+        const uint64_t id = UniqueID::GetNextObjectId(ObjectType::CPU_SCENE_BVH);
+        g_sceneBvhs.emplace_with_id(id);
+        return id;
+    }
+
+    void DestroySceneBvh(uint64_t sceneBvhId) {
+        g_sceneBvhs.erase(sceneBvhId);
+    }
+
+    void Cleanup() {
+        std::lock_guard<std::mutex> lock(g_meshBvhMutex);
+        g_meshBvhs.clear();
+        g_sceneBvhs.clear();
+        g_nodes = std::vector<Node4>();
+        g_triangles = std::vector<Triangle>();
+    }
+
+    // Resolves each instance's mesh BVH to its root in g_nodes and rebuilds the top level tree over their world bounds
+    void RefreshSceneInstances(SceneBvh& scene) {
+        std::vector<Aabb> instanceBounds;
+        std::vector<uint32_t> instanceIndices;
+        for (size_t i = 0; i < scene.instances.size(); i++) {
+            InstanceData& instance = scene.instances[i];
+            instance.rootNode = -1;
+            instance.worldBounds = Aabb();
+
+            const MeshBvh* meshBvh = g_meshBvhs.get(instance.meshBvhId);
+            if (!meshBvh || !meshBvh->flattened || meshBvh->nodeCount == 0) continue;
+
+            // Zero scale is how objects get hidden, and there is no inverse to trace with
+            if (glm::determinant(glm::mat3(instance.objectToWorld)) == 0.0f) continue;
+
+            instance.rootNode = (int32_t)meshBvh->nodeOffset;
+            for (int corner = 0; corner < 8; corner++) {
+                glm::vec3 p((corner & 1) ? meshBvh->bounds.max.x : meshBvh->bounds.min.x, (corner & 2) ? meshBvh->bounds.max.y : meshBvh->bounds.min.y, (corner & 4) ? meshBvh->bounds.max.z : meshBvh->bounds.min.z);
+                instance.worldBounds.Grow(glm::vec3(instance.objectToWorld * glm::vec4(p, 1.0f)));
+            }
+            instanceBounds.push_back(instance.worldBounds);
+            instanceIndices.push_back((uint32_t)i);
+        }
+        // Instances without a mesh BVH keep their index but are left out of the tree
+        scene.tlas = BuildTree(instanceBounds);
+        for (uint32_t& prim : scene.tlas.primOrder) {
+            prim = instanceIndices[prim];
+        }
+    }
+
+    void UpdateSceneBvh(uint64_t sceneBvhId, std::span<const PrimitiveInstance> instances) {
+        SceneBvh* scene = g_sceneBvhs.get(sceneBvhId);
+        if (!scene) {
+            std::cout << "Bvh::Cpu::UpdateSceneBvh() failed because scene BVH " << sceneBvhId << " does not exist\n";
+            return;
+        }
+
+        scene->instances.resize(instances.size());
+        for (size_t i = 0; i < instances.size(); i++) {
+            InstanceData& instance = scene->instances[i];
+            instance.objectToWorld = instances[i].worldTransform;
+            instance.worldToObject = glm::inverse(instances[i].worldTransform);
+            instance.meshBvhId = instances[i].meshBvhId;
+        }
+        RefreshSceneInstances(*scene);
+    }
+
+    //////////////////////
+    //                  //
+    //     Queries      //
+
+    RayData MakeRayData(const glm::vec3& origin, const glm::vec3& direction, float tMin) {
+        RayData ray;
+        for (int axis = 0; axis < 3; axis++) {
+            ray.origin[axis] = _mm_set1_ps(origin[axis]);
+            ray.invDir[axis] = _mm_set1_ps(1.0f / direction[axis]);
+        }
+        ray.tMin = tMin;
+        return ray;
+    }
+
+    inline int IntersectNode4(const Node4& node, const RayData& ray, float tMax, float* tNear) {
+        __m128 tMinV = _mm_set1_ps(ray.tMin);
+        __m128 tMaxV = _mm_set1_ps(tMax);
+        for (int axis = 0; axis < 3; axis++) {
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.boundsMin[axis]), ray.origin[axis]), ray.invDir[axis]);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.boundsMax[axis]), ray.origin[axis]), ray.invDir[axis]);
+            tMinV = _mm_max_ps(tMinV, _mm_min_ps(t0, t1));
+            tMaxV = _mm_min_ps(tMaxV, _mm_max_ps(t0, t1));
+        }
+        _mm_storeu_ps(tNear, tMinV);
+        return _mm_movemask_ps(_mm_cmple_ps(tMinV, tMaxV));
+    }
+
+    inline int OverlapNode4(const Node4& node, const __m128 center[3], float radiusSquared) {
+        __m128 zero = _mm_setzero_ps();
+        __m128 distanceSquared = zero;
+        for (int axis = 0; axis < 3; axis++) {
+            __m128 below = _mm_max_ps(_mm_sub_ps(_mm_load_ps(node.boundsMin[axis]), center[axis]), zero);
+            __m128 above = _mm_max_ps(_mm_sub_ps(center[axis], _mm_load_ps(node.boundsMax[axis])), zero);
+            __m128 d = _mm_add_ps(below, above);
+            distanceSquared = _mm_add_ps(distanceSquared, _mm_mul_ps(d, d));
+        }
+        return _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_set1_ps(radiusSquared)));
+    }
+
+    // leafFunc(first, count, tMax) tests a range of primitives and returns true to end the traversal early.
+    // Inner children are pushed furthest first so the nearest is visited next and shrinks tMax for the rest.
+    template<typename LeafFunc>
+    void TraverseRay(const Node4* nodes, int rootNode, const RayData& ray, float& tMax, LeafFunc&& leafFunc) {
+        int stack[TRAVERSAL_STACK_SIZE];
+        int stackSize = 0;
+        stack[stackSize++] = rootNode;
+
+        while (stackSize > 0) {
+            const Node4& node = nodes[stack[--stackSize]];
+            float tNear[4];
+            int mask = IntersectNode4(node, ray, tMax, tNear);
+
+            int innerChildren[4];
+            float innerDistances[4];
+            int innerCount = 0;
+
+            for (int i = 0; i < 4; i++) {
+                if (!(mask & (1 << i)) || node.child[i] < 0) continue;
+
+                if (node.primCount[i] > 0) {
+                    if (leafFunc((uint32_t)node.child[i], node.primCount[i], tMax)) return;
+                }
+                else {
+                    int slot = innerCount++;
+                    while (slot > 0 && innerDistances[slot - 1] < tNear[i]) {
+                        innerChildren[slot] = innerChildren[slot - 1];
+                        innerDistances[slot] = innerDistances[slot - 1];
+                        slot--;
+                    }
+                    innerChildren[slot] = node.child[i];
+                    innerDistances[slot] = tNear[i];
+                }
+            }
+            assert(stackSize + innerCount <= TRAVERSAL_STACK_SIZE);
+            for (int i = 0; i < innerCount; i++) {
+                stack[stackSize++] = innerChildren[i];
+            }
+        }
+    }
+
+    template<typename LeafFunc>
+    void TraverseSphere(const Node4* nodes, int rootNode, const glm::vec3& center, float radius, LeafFunc&& leafFunc) {
+        __m128 centerV[3] = { _mm_set1_ps(center.x), _mm_set1_ps(center.y), _mm_set1_ps(center.z) };
+        float radiusSquared = radius * radius;
+
+        int stack[TRAVERSAL_STACK_SIZE];
+        int stackSize = 0;
+        stack[stackSize++] = rootNode;
+
+        while (stackSize > 0) {
+            const Node4& node = nodes[stack[--stackSize]];
+            int mask = OverlapNode4(node, centerV, radiusSquared);
+
+            for (int i = 0; i < 4; i++) {
+                if (!(mask & (1 << i)) || node.child[i] < 0) continue;
+
+                if (node.primCount[i] > 0) {
+                    leafFunc((uint32_t)node.child[i], node.primCount[i]);
+                }
+                else {
+                    assert(stackSize < TRAVERSAL_STACK_SIZE);
+                    stack[stackSize++] = node.child[i];
+                }
+            }
+        }
+    }
+
+    // Moller-Trumbore. det > 0 is counter clockwise seen from the ray origin, which is the front face.
+    inline bool IntersectTriangle(const Triangle& tri, const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, uint32_t rayFlags, float& t, float& u, float& v, float& det) {
+        glm::vec3 p = glm::cross(direction, tri.e2);
+        det = glm::dot(tri.e1, p);
+
+        if (std::abs(det) < 1e-12f) return false;
+        if ((rayFlags & RAY_FLAG_CULL_FRONT_FACING) && det > 0.0f) return false;
+        if ((rayFlags & RAY_FLAG_CULL_BACK_FACING) && det < 0.0f) return false;
+
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - tri.v0;
+        u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) return false;
+
+        glm::vec3 q = glm::cross(s, tri.e1);
+        v = glm::dot(direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) return false;
+
+        t = glm::dot(tri.e2, q) * invDet;
+        return t >= tMin && t <= tMax;
+    }
+
+    bool IsFinite(const glm::vec3& v) {
+        return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+    }
+
+    // Both levels use the same unnormalized direction, so t means the same thing in world and object space
+    bool TraceRay(const SceneBvh& scene, const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, uint32_t rayFlags, RayHitInfo& hitInfo) {
+        if (scene.tlas.nodes.empty() || !IsFinite(origin) || !IsFinite(direction) || direction == glm::vec3(0)) return false;
+
+        bool anyHit = (rayFlags & RAY_FLAG_TERMINATE_ON_FIRST_HIT) != 0;
+        const Triangle* hitTriangle = nullptr;
+        float hitDet = 0;
+        RayData worldRay = MakeRayData(origin, direction, tMin);
+
+        TraverseRay(scene.tlas.nodes.data(), 0, worldRay, tMax, [&](uint32_t first, uint32_t count, float& tMax) {
+            for (uint32_t i = first; i < first + count; i++) {
+                uint32_t instanceIndex = scene.tlas.primOrder[i];
+                const InstanceData& instance = scene.instances[instanceIndex];
+                glm::vec3 objectOrigin = glm::vec3(instance.worldToObject * glm::vec4(origin, 1.0f));
+                glm::vec3 objectDirection = glm::mat3(instance.worldToObject) * direction;
+                RayData objectRay = MakeRayData(objectOrigin, objectDirection, tMin);
+
+                bool done = false;
+                TraverseRay(g_nodes.data(), instance.rootNode, objectRay, tMax, [&](uint32_t triFirst, uint32_t triCount, float& tMax) {
+                    for (uint32_t j = triFirst; j < triFirst + triCount; j++) {
+                        const Triangle& tri = g_triangles[j];
+                        float t, u, v, det;
+                        if (IntersectTriangle(tri, objectOrigin, objectDirection, tMin, tMax, rayFlags, t, u, v, det)) {
+                            tMax = t;
+                            hitInfo.distance = t;
+                            hitInfo.barycentrics = glm::vec2(u, v);
+                            hitInfo.instanceIndex = (int32_t)instanceIndex;
+                            hitInfo.primitiveIndex = (int32_t)tri.primitiveIndex;
+                            hitTriangle = &tri;
+                            hitDet = det;
+                            if (anyHit) {
+                                done = true;
+                                return true;
+                            }
+                        }
+                    }
+                    return false;
+                });
+                if (done) return true;
+            }
+            return false;
+        });
+
+        if (!hitTriangle) return false;
+
+        const InstanceData& instance = scene.instances[hitInfo.instanceIndex];
+        glm::mat3 normalMatrix = glm::transpose(glm::mat3(instance.worldToObject));
+        hitInfo.found = true;
+        hitInfo.hitPosition = origin + direction * hitInfo.distance;
+        hitInfo.normal = glm::normalize(normalMatrix * glm::cross(hitTriangle->e1, hitTriangle->e2));
+        hitInfo.frontFacing = hitDet > 0.0f;
+        return true;
+    }
+
+    RayHitInfo ClosestHit(uint64_t sceneBvhId, const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, uint32_t rayFlags) {
+        RayHitInfo hitInfo;
+        if (const SceneBvh* scene = g_sceneBvhs.get(sceneBvhId)) {
+            TraceRay(*scene, origin, direction, tMin, tMax, rayFlags, hitInfo);
+        }
+        return hitInfo;
+    }
+
+    bool AnyHit(uint64_t sceneBvhId, const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, uint32_t rayFlags) {
+        RayHitInfo hitInfo;
+        const SceneBvh* scene = g_sceneBvhs.get(sceneBvhId);
+        return scene && TraceRay(*scene, origin, direction, tMin, tMax, rayFlags | RAY_FLAG_TERMINATE_ON_FIRST_HIT, hitInfo);
+    }
+
+    bool SegmentIntersectsScene(uint64_t sceneBvhId, const glm::vec3& start, const glm::vec3& end, uint32_t rayFlags) {
+        return AnyHit(sceneBvhId, start, end - start, 0.0f, 1.0f, rayFlags);
+    }
+
+    // Christer Ericson, Real-Time Collision Detection 5.1.5
+    glm::vec3 ClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+        glm::vec3 ab = b - a;
+        glm::vec3 ac = c - a;
+        glm::vec3 ap = p - a;
+        float d1 = glm::dot(ab, ap);
+        float d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp);
+        float d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3) return b;
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp);
+        float d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6) return c;
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+        float denom = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denom) + ac * (vc * denom);
+    }
+
+    // The mesh level is walked in object space with a radius grown by the largest stretch of the inverse transform
+    // (bounded by its Frobenius norm), so non uniform scale can only let extra triangles through to the exact world space test.
+    std::vector<SphereHitInfo> SphereOverlaps(uint64_t sceneBvhId, const glm::vec3& center, float radius) {
+        std::vector<SphereHitInfo> hits;
+        const SceneBvh* scene = g_sceneBvhs.get(sceneBvhId);
+        if (!scene || scene->tlas.nodes.empty() || !IsFinite(center) || !(radius >= 0.0f)) return hits;
+
+        TraverseSphere(scene->tlas.nodes.data(), 0, center, radius, [&](uint32_t first, uint32_t count) {
+            for (uint32_t i = first; i < first + count; i++) {
+                uint32_t instanceIndex = scene->tlas.primOrder[i];
+                const InstanceData& instance = scene->instances[instanceIndex];
+                glm::mat3 linear = glm::mat3(instance.worldToObject);
+                float stretch = std::sqrt(glm::dot(linear[0], linear[0]) + glm::dot(linear[1], linear[1]) + glm::dot(linear[2], linear[2]));
+                glm::vec3 objectCenter = glm::vec3(instance.worldToObject * glm::vec4(center, 1.0f));
+
+                TraverseSphere(g_nodes.data(), instance.rootNode, objectCenter, radius * stretch, [&](uint32_t triFirst, uint32_t triCount) {
+                    for (uint32_t j = triFirst; j < triFirst + triCount; j++) {
+                        const Triangle& tri = g_triangles[j];
+                        glm::vec3 a = glm::vec3(instance.objectToWorld * glm::vec4(tri.v0, 1.0f));
+                        glm::vec3 b = glm::vec3(instance.objectToWorld * glm::vec4(tri.v0 + tri.e1, 1.0f));
+                        glm::vec3 c = glm::vec3(instance.objectToWorld * glm::vec4(tri.v0 + tri.e2, 1.0f));
+                        glm::vec3 closestPoint = ClosestPointOnTriangle(center, a, b, c);
+                        float distance = glm::distance(center, closestPoint);
+                        if (distance <= radius) {
+                            hits.push_back({ (int32_t)instanceIndex, (int32_t)tri.primitiveIndex, closestPoint, distance });
+                        }
+                    }
+                });
+            }
+        });
+        return hits;
+    }
+}
\ No newline at end of file
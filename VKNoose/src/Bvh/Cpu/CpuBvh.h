@@ -0,0 +1,74 @@
+#pragma once
+#include "Hell/Types.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// CPU side bounding volume hierarchies for ray queries that can't wait on a GPU readback (picking, interaction, line of sight).
+// Mirrors the GPU layout: one BVH per mesh like a BLAS, and scene BVHs over transformed instances of them like a TLAS.
+//
+// Mesh BVHs can be created from several threads at once. Queries only read, so any number can run in parallel,
+// but not while meshes or scenes are being created, updated, flattened or destroyed.
+namespace Bvh::Cpu {
+
+    enum RayFlags : uint32_t {
+        RAY_FLAG_NONE = 0,
+        RAY_FLAG_TERMINATE_ON_FIRST_HIT = 1 << 0,
+        RAY_FLAG_CULL_FRONT_FACING = 1 << 1,    // Counter clockwise is the front, like VK_GEOMETRY_INSTANCE_TRIANGLE_FRONT_COUNTERCLOCKWISE_BIT_KHR
+        RAY_FLAG_CULL_BACK_FACING = 1 << 2
+    };
+
+    struct PrimitiveInstance {
+        glm::mat4 worldTransform = glm::mat4(1);
+        uint64_t meshBvhId = 0;
+    };
+
+    struct RayHitInfo {
+        bool found = false;
+        float distance = 0;                     // In units of the ray direction, which is never normalized
+        glm::vec2 barycentrics = glm::vec2(0);  // Weights of the second and third vertex, like the hit attributes on the GPU
+        glm::vec3 hitPosition = glm::vec3(0);
+        glm::vec3 normal = glm::vec3(0);        // World space face normal, facing the front side
+        bool frontFacing = false;
+        int32_t instanceIndex = -1;             // Index into the instances given to UpdateSceneBvh
+        int32_t primitiveIndex = -1;            // Triangle within the mesh, gl_PrimitiveID
+    };
+
+    struct SphereHitInfo {
+        int32_t instanceIndex = -1;
+        int32_t primitiveIndex = -1;
+        glm::vec3 closestPoint = glm::vec3(0);
+        float distance = 0;
+    };
+
+    // Mesh BVHs. New ones can't be queried until FlatternMeshBvhNodes() has packed them in with the rest.
+    uint64_t CreateMeshBvhFromVertexData(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+    void DestroyMeshBvh(uint64_t meshBvhId);
+    void FlatternMeshBvhNodes();
+    uint32_t GetMeshBvhTriangleCount(uint64_t meshBvhId);
+
+    // Scene BVHs. Rebuilt from scratch by every update, instances with an unknown or empty mesh BVH are never hit.
+    uint64_t CreateSceneBvh();
+    void UpdateSceneBvh(uint64_t sceneBvhId, std::span<const PrimitiveInstance> instances);
+    void DestroySceneBvh(uint64_t sceneBvhId);
+    void Cleanup();
+
+    // Queries
+    RayHitInfo ClosestHit(uint64_t sceneBvhId, const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, uint32_t rayFlags = RAY_FLAG_NONE);
+    bool AnyHit(uint64_t sceneBvhId, const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, uint32_t rayFlags = RAY_FLAG_NONE);
+    bool SegmentIntersectsScene(uint64_t sceneBvhId, const glm::vec3& start, const glm::vec3& end, uint32_t rayFlags = RAY_FLAG_NONE);
+    std::vector<SphereHitInfo> SphereOverlaps(uint64_t sceneBvhId, const glm::vec3& center, float radius);
+
+    // Microbenchmark, builds BVHs for the given geometry and times builds, rays, segments and sphere queries against it
+    struct BenchmarkMesh {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    struct BenchmarkInstance {
+        glm::mat4 worldTransform = glm::mat4(1);
+        uint32_t meshIndex = 0;
+    };
+
+    void RunBenchmark(const std::vector<BenchmarkMesh>& meshes, const std::vector<BenchmarkInstance>& instances, uint32_t rayCount);
+}
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "CpuBvh.h"
+#include "Util.h"
+
+#include <cfloat>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace Bvh::Cpu {
+    constexpr uint32_t BENCHMARK_UPDATE_ITERATIONS = 100;
+    constexpr uint32_t BENCHMARK_VALIDATION_RAYS = 1000;
+    constexpr float BENCHMARK_SPHERE_RADIUS = 0.25f;
+
+    struct BenchmarkRay {
+        glm::vec3 origin;
+        glm::vec3 direction;
+    };
+
+    struct Stopwatch {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        float ElapsedMs() const {
+            return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    // Every triangle of every instance in world space, tested one by one
+    RayHitInfo BruteForceClosestHit(const std::vector<BenchmarkMesh>& meshes, const std::vector<BenchmarkInstance>& instances, const BenchmarkRay& ray) {
+        RayHitInfo best;
+        float tMax = FLT_MAX;
+        for (size_t i = 0; i < instances.size(); i++) {
+            const BenchmarkMesh& mesh = meshes[instances[i].meshIndex];
+            const glm::mat4& m = instances[i].worldTransform;
+            for (size_t j = 0; j + 2 < mesh.indices.size(); j += 3) {
+                glm::vec3 a = glm::vec3(m * glm::vec4(mesh.vertices[mesh.indices[j]].position, 1.0f));
+                glm::vec3 b = glm::vec3(m * glm::vec4(mesh.vertices[mesh.indices[j + 1]].position, 1.0f));
+                glm::vec3 c = glm::vec3(m * glm::vec4(mesh.vertices[mesh.indices[j + 2]].position, 1.0f));
+                glm::vec3 e1 = b - a;
+                glm::vec3 e2 = c - a;
+                glm::vec3 p = glm::cross(ray.direction, e2);
+                float det = glm::dot(e1, p);
+                if (std::abs(det) < 1e-12f) continue;
+                float invDet = 1.0f / det;
+                glm::vec3 s = ray.origin - a;
+                float u = glm::dot(s, p) * invDet;
+                glm::vec3 q = glm::cross(s, e1);
+                float v = glm::dot(ray.direction, q) * invDet;
+                float t = glm::dot(e2, q) * invDet;
+                if (u < 0.0f || v < 0.0f || u + v > 1.0f || t < 0.0f || t > tMax) continue;
+                tMax = t;
+                best.found = true;
+                best.distance = t;
+                best.instanceIndex = (int32_t)i;
+                best.primitiveIndex = (int32_t)(j / 3);
+            }
+        }
+        return best;
+    }
+
+    void RunBenchmark(const std::vector<BenchmarkMesh>& meshes, const std::vector<BenchmarkInstance>& instances, uint32_t rayCount) {
+        rayCount = std::max(rayCount, 2u);
+        uint32_t workerCount = std::max(1u, std::thread::hardware_concurrency());
+        uint64_t triangleCount = 0;
+        for (const BenchmarkMesh& mesh : meshes) {
+            triangleCount += mesh.indices.size() / 3;
+        }
+        std::cout << "[CPU BVH] Benchmarking " << meshes.size() << " meshes (" << triangleCount << " triangles), " << instances.size() << " instances, " << workerCount << " threads\n";
+
+        // Mesh BVHs, built the way AssetManager::CreateMeshBvhs() builds them at load
+        std::vector<uint64_t> meshBvhIds(meshes.size());
+        Stopwatch buildTimer;
+        Util::ParallelFor((uint32_t)meshes.size(), workerCount, [&](uint32_t i) {
+            meshBvhIds[i] = CreateMeshBvhFromVertexData(meshes[i].vertices, meshes[i].indices);
+        });
+        float buildMs = buildTimer.ElapsedMs();
+
+        Stopwatch flattenTimer;
+        FlatternMeshBvhNodes();
+        float flattenMs = flattenTimer.ElapsedMs();
+        std::cout << "[CPU BVH] Mesh BVH build " << buildMs << "ms (" << (triangleCount / 1000.0f) / std::max(buildMs, 0.001f) << "M triangles/s), flatten " << flattenMs << "ms\n";
+
+        // Scene BVH, rebuilt every frame in game
+        std::vector<PrimitiveInstance> primitiveInstances(instances.size());
+        glm::vec3 sceneMin = glm::vec3(FLT_MAX);
+        glm::vec3 sceneMax = glm::vec3(-FLT_MAX);
+        for (size_t i = 0; i < instances.size(); i++) {
+            primitiveInstances[i].worldTransform = instances[i].worldTransform;
+            primitiveInstances[i].meshBvhId = meshBvhIds[instances[i].meshIndex];
+            for (const Vertex& vertex : meshes[instances[i].meshIndex].vertices) {
+                glm::vec3 p = glm::vec3(instances[i].worldTransform * glm::vec4(vertex.position, 1.0f));
+                sceneMin = glm::min(sceneMin, p);
+                sceneMax = glm::max(sceneMax, p);
+            }
+        }
+        uint64_t sceneBvhId = CreateSceneBvh();
+        Stopwatch updateTimer;
+        for (uint32_t i = 0; i < BENCHMARK_UPDATE_ITERATIONS; i++) {
+            UpdateSceneBvh(sceneBvhId, primitiveInstances);
+        }
+        std::cout << "[CPU BVH] Scene BVH update " << updateTimer.ElapsedMs() / BENCHMARK_UPDATE_ITERATIONS << "ms\n";
+
+        if (instances.empty() || triangleCount == 0) {
+            std::cout << "[CPU BVH] Nothing to trace against\n";
+            DestroySceneBvh(sceneBvhId);
+            for (uint64_t id : meshBvhIds) {
+                DestroyMeshBvh(id);
+            }
+            FlatternMeshBvhNodes();
+            return;
+        }
+
+        // Rays start anywhere inside the scene bounds and head in any direction, a fixed seed keeps runs comparable
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<BenchmarkRay> rays(rayCount);
+        for (BenchmarkRay& ray : rays) {
+            ray.origin = glm::mix(sceneMin, sceneMax, glm::vec3(unit(rng), unit(rng), unit(rng)));
+            float z = unit(rng) * 2.0f - 1.0f;
+            float phi = unit(rng) * 6.28318530718f;
+            float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+            ray.direction = glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+        }
+
+        uint32_t hitCount = 0;
+        Stopwatch singleTimer;
+        for (const BenchmarkRay& ray : rays) {
+            hitCount += ClosestHit(sceneBvhId, ray.origin, ray.direction, 0.0f, FLT_MAX).found ? 1 : 0;
+        }
+        float singleMs = singleTimer.ElapsedMs();
+
+        uint32_t chunkCount = workerCount * 16;
+        Stopwatch parallelTimer;
+        Util::ParallelFor(chunkCount, workerCount, [&](uint32_t chunk) {
+            for (size_t i = chunk; i < rays.size(); i += chunkCount) {
+                ClosestHit(sceneBvhId, rays[i].origin, rays[i].direction, 0.0f, FLT_MAX);
+            }
+        });
+        float parallelMs = parallelTimer.ElapsedMs();
+        std::cout << "[CPU BVH] Closest hit " << rayCount / 1000.0f / std::max(singleMs, 0.001f) << "M rays/s on 1 thread, " << rayCount / 1000.0f / std::max(parallelMs, 0.001f) << "M rays/s on " << workerCount << " (" << hitCount * 100.0f / std::max(rayCount, 1u) << "% hit)\n";
+
+        // Segments between two random ray origins, like a line of sight check
+        uint32_t blockedCount = 0;
+        Stopwatch segmentTimer;
+        for (size_t i = 0; i + 1 < rays.size(); i += 2) {
+            blockedCount += SegmentIntersectsScene(sceneBvhId, rays[i].origin, rays[i + 1].origin) ? 1 : 0;
+        }
+        float segmentMs = segmentTimer.ElapsedMs();
+        std::cout << "[CPU BVH] Segment " << (rayCount / 2) / 1000.0f / std::max(segmentMs, 0.001f) << "M segments/s on 1 thread (" << blockedCount * 200.0f / std::max(rayCount, 1u) << "% blocked)\n";
+
+        uint32_t sphereCount = std::max(1u, rayCount / 10);
+        size_t overlapCount = 0;
+        Stopwatch sphereTimer;
+        for (uint32_t i = 0; i < sphereCount; i++) {
+            overlapCount += SphereOverlaps(sceneBvhId, rays[i % rays.size()].origin, BENCHMARK_SPHERE_RADIUS).size();
+        }
+        float sphereMs = sphereTimer.ElapsedMs();
+        std::cout << "[CPU BVH] Sphere overlap (radius " << BENCHMARK_SPHERE_RADIUS << ") " << sphereMs * 1000.0f / sphereCount << "us per query, " << (float)overlapCount / sphereCount << " triangles each\n";
+
+        // Speed means nothing if the answers are wrong
+        uint32_t validationCount = std::min(rayCount, BENCHMARK_VALIDATION_RAYS);
+        uint32_t mismatchCount = 0;
+        for (uint32_t i = 0; i < validationCount; i++) {
+            RayHitInfo expected = BruteForceClosestHit(meshes, instances, rays[i]);
+            RayHitInfo actual = ClosestHit(sceneBvhId, rays[i].origin, rays[i].direction, 0.0f, FLT_MAX);
+            if (expected.found != actual.found || (expected.found && std::abs(expected.distance - actual.distance) > 1e-3f * std::max(1.0f, expected.distance))) {
+                mismatchCount++;
+            }
+        }
+        std::cout << "[CPU BVH] " << mismatchCount << " of " << validationCount << " rays disagree with brute force\n";
+
+        DestroySceneBvh(sceneBvhId);
+        for (uint64_t id : meshBvhIds) {
+            DestroyMeshBvh(id);
+        }
+        FlatternMeshBvhNodes();
+    }
+}
\ No newline at end of file
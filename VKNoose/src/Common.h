@@ -24,7 +24,7 @@
 #define UNDEFINED_STRING "UNDEFINED_STRING"
 
 enum class InventoryViewMode { SCROLL, EXAMINE };
-enum class DebugMode { NONE, RAY, COLLISION, DEBUG_MODE_COUNT };
+enum class DebugMode { NONE, RAY, COLLISION, GPU_TIMINGS, MEMORY, HEAP, DEBUG_MODE_COUNT };
 enum class OpenState { NONE, CLOSED, CLOSING, OPEN, OPENING };
 enum class OpenAxis { NONE, TRANSLATE_X, TRANSLATE_Y, TRANSLATE_Z, ROTATION_POS_X, ROTATION_POS_Y, ROTATION_POS_Z, ROTATION_NEG_X, ROTATION_NEG_Y, ROTATION_NEG_Z};
 enum class InteractType { NONE, TEXT, QUESTION, PICKUP, CALLBACK_ONLY};
@@ -100,7 +100,7 @@ struct MeshInstance {
 	int normalIndex;
 	int rmaIndex;
 	int materialType; // 0 standard, 1 mirror, 2 glass 
-	int dummy1;
+	int meshIndex;    // Into AssetManager::GetMeshList(), the GBuffer cull shader reads the mesh's bounds and draw range with it
 	int dummy2;
 };
 
@@ -147,6 +147,13 @@ struct GPUObjectData2D {
 	int yClipMax;	
 	int dummy0;
 	int dummy2;
+	glm::vec4 uvRect = glm::vec4(0, 0, 1, 1);
+};
+
+// Where a texture lives once packed into a UI atlas page. Unpacked textures map to themselves with the full UV range.
+struct AtlasRegion {
+	int textureIndex = -1;
+	glm::vec4 uvRect = glm::vec4(0, 0, 1, 1); // xy = min, zw = max
 };
 
 /*
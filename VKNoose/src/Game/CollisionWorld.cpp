@@ -0,0 +1,263 @@
+#include "CollisionWorld.h"
+#include <algorithm>
+#include <cfloat>
+#include <unordered_map>
+
+namespace CollisionWorld {
+
+	constexpr float CELL_SIZE = 1.0f;
+	constexpr int MAX_SLIDE_ITERATIONS = 3;
+	constexpr float SKIN_WIDTH = 0.001f;    // Stop this far short of a wall so the next sweep doesn't start touching it
+
+	struct Segment {
+		glm::vec2 begin = glm::vec2(0);
+		glm::vec2 end = glm::vec2(0);
+		uint32_t queryStamp = 0;
+		bool alive = false;
+	};
+
+	struct DynamicShape {
+		std::vector<uint32_t> segmentIndices;
+	};
+
+	struct CircleHit {
+		float t = FLT_MAX;
+		glm::vec2 normal = glm::vec2(0);
+	};
+
+	std::vector<Segment> _segments;
+	std::vector<uint32_t> _freeSegments;
+	std::vector<DynamicShape> _dynamicShapes;
+	std::unordered_map<uint64_t, std::vector<uint32_t>> _cells;
+	uint32_t _queryStamp = 0;
+
+	glm::ivec2 CellCoord(glm::vec2 position) {
+		return glm::ivec2((int)std::floor(position.x / CELL_SIZE), (int)std::floor(position.y / CELL_SIZE));
+	}
+
+	uint64_t CellKey(int x, int z) {
+		return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+	}
+
+	// Segments go in every cell their bounds touch, walls are axis aligned so that is rarely more than the cells they cross
+	template<typename Func>
+	void ForEachCell(glm::vec2 min, glm::vec2 max, Func&& func) {
+		glm::ivec2 cellMin = CellCoord(min);
+		glm::ivec2 cellMax = CellCoord(max);
+		for (int x = cellMin.x; x <= cellMax.x; x++) {
+			for (int z = cellMin.y; z <= cellMax.y; z++) {
+				func(CellKey(x, z));
+			}
+		}
+	}
+
+	uint32_t InsertSegment(glm::vec2 begin, glm::vec2 end) {
+		uint32_t segmentIndex;
+		if (!_freeSegments.empty()) {
+			segmentIndex = _freeSegments.back();
+			_freeSegments.pop_back();
+		}
+		else {
+			segmentIndex = (uint32_t)_segments.size();
+			_segments.emplace_back();
+		}
+		Segment& segment = _segments[segmentIndex];
+		segment.begin = begin;
+		segment.end = end;
+		segment.queryStamp = 0;
+		segment.alive = true;
+		ForEachCell(glm::min(begin, end), glm::max(begin, end), [&](uint64_t key) {
+			_cells[key].push_back(segmentIndex);
+		});
+		return segmentIndex;
+	}
+
+	void RemoveSegment(uint32_t segmentIndex) {
+		Segment& segment = _segments[segmentIndex];
+		ForEachCell(glm::min(segment.begin, segment.end), glm::max(segment.begin, segment.end), [&](uint64_t key) {
+			auto it = _cells.find(key);
+			if (it == _cells.end()) {
+				return;
+			}
+			std::vector<uint32_t>& cell = it->second;
+			auto found = std::find(cell.begin(), cell.end(), segmentIndex);
+			if (found != cell.end()) {
+				*found = cell.back();
+				cell.pop_back();
+			}
+		});
+		segment.alive = false;
+		_freeSegments.push_back(segmentIndex);
+	}
+
+	// Calls func once for every segment in the cells overlapping the box, even if it spans several of them
+	template<typename Func>
+	void QuerySegments(glm::vec2 min, glm::vec2 max, Func&& func) {
+		_queryStamp++;
+		ForEachCell(min, max, [&](uint64_t key) {
+			auto it = _cells.find(key);
+			if (it == _cells.end()) {
+				return;
+			}
+			for (uint32_t segmentIndex : it->second) {
+				Segment& segment = _segments[segmentIndex];
+				if (segment.queryStamp != _queryStamp) {
+					segment.queryStamp = _queryStamp;
+					func(segment);
+				}
+			}
+		});
+	}
+
+	glm::vec2 ClosestPointOnSegment(glm::vec2 point, const Segment& segment) {
+		glm::vec2 edge = segment.end - segment.begin;
+		float lengthSquared = glm::dot(edge, edge);
+		if (lengthSquared == 0.0f) {
+			return segment.begin;
+		}
+		float t = std::clamp(glm::dot(point - segment.begin, edge) / lengthSquared, 0.0f, 1.0f);
+		return segment.begin + edge * t;
+	}
+
+	// First t in [0, 1] where origin + displacement * t enters the circle
+	void SweepAgainstPoint(glm::vec2 origin, glm::vec2 displacement, glm::vec2 center, float radius, CircleHit& hit) {
+		glm::vec2 m = origin - center;
+		float a = glm::dot(displacement, displacement);
+		float b = glm::dot(m, displacement);
+		float c = glm::dot(m, m) - radius * radius;
+		if (a == 0.0f || b >= 0.0f) {
+			return;
+		}
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f) {
+			return;
+		}
+		float t = (-b - std::sqrt(discriminant)) / a;
+		if (t >= 0.0f && t <= 1.0f && t < hit.t) {
+			hit.t = t;
+			hit.normal = glm::normalize(origin + displacement * t - center);
+		}
+	}
+
+	// A circle sweeping into a segment is a point sweeping into the segment grown by the radius: two sides and two round caps
+	void SweepAgainstSegment(glm::vec2 origin, glm::vec2 displacement, float radius, const Segment& segment, CircleHit& hit) {
+		glm::vec2 closestPoint = ClosestPointOnSegment(origin, segment);
+		glm::vec2 offset = origin - closestPoint;
+		float distanceSquared = glm::dot(offset, offset);
+		if (distanceSquared < radius * radius) {
+			// Already touching, block only movement further in and leave the overlap to ResolveCircleOverlaps()
+			if (distanceSquared > 0.0f && glm::dot(displacement, offset) < 0.0f) {
+				hit.t = 0.0f;
+				hit.normal = offset / std::sqrt(distanceSquared);
+			}
+			return;
+		}
+		glm::vec2 edge = segment.end - segment.begin;
+		float length = glm::length(edge);
+		if (length > 0.0f) {
+			glm::vec2 direction = edge / length;
+			glm::vec2 normal = glm::vec2(-direction.y, direction.x);
+			if (glm::dot(origin - segment.begin, normal) < 0.0f) {
+				normal = -normal;
+			}
+			float approachSpeed = -glm::dot(displacement, normal);
+			if (approachSpeed > 0.0f) {
+				float t = (glm::dot(origin - segment.begin, normal) - radius) / approachSpeed;
+				float along = glm::dot(origin + displacement * t - segment.begin, direction);
+				if (t >= 0.0f && t <= 1.0f && t < hit.t && along >= 0.0f && along <= length) {
+					hit.t = t;
+					hit.normal = normal;
+				}
+			}
+		}
+		SweepAgainstPoint(origin, displacement, segment.begin, radius, hit);
+		SweepAgainstPoint(origin, displacement, segment.end, radius, hit);
+	}
+
+	void Clear() {
+		_segments.clear();
+		_freeSegments.clear();
+		_dynamicShapes.clear();
+		_cells.clear();
+	}
+
+	void AddStaticSegment(glm::vec3 begin, glm::vec3 end) {
+		InsertSegment(glm::vec2(begin.x, begin.z), glm::vec2(end.x, end.z));
+	}
+
+	uint32_t CreateDynamicShape() {
+		_dynamicShapes.emplace_back();
+		return (uint32_t)_dynamicShapes.size() - 1;
+	}
+
+	void SetDynamicShape(uint32_t shapeIndex, std::span<const glm::vec3> lineVertices) {
+		if (shapeIndex >= _dynamicShapes.size()) {
+			return;
+		}
+		DynamicShape& shape = _dynamicShapes[shapeIndex];
+		for (uint32_t segmentIndex : shape.segmentIndices) {
+			RemoveSegment(segmentIndex);
+		}
+		shape.segmentIndices.clear();
+		for (size_t i = 0; i + 1 < lineVertices.size(); i += 2) {
+			glm::vec2 begin = glm::vec2(lineVertices[i].x, lineVertices[i].z);
+			glm::vec2 end = glm::vec2(lineVertices[i + 1].x, lineVertices[i + 1].z);
+			shape.segmentIndices.push_back(InsertSegment(begin, end));
+		}
+	}
+
+	glm::vec3 SweepCircle(glm::vec3 from, glm::vec3 to, float radius) {
+		glm::vec2 position = glm::vec2(from.x, from.z);
+		glm::vec2 displacement = glm::vec2(to.x - from.x, to.z - from.z);
+
+		for (int i = 0; i < MAX_SLIDE_ITERATIONS; i++) {
+			if (glm::dot(displacement, displacement) == 0.0f) {
+				break;
+			}
+			glm::vec2 target = position + displacement;
+			CircleHit hit;
+			QuerySegments(glm::min(position, target) - glm::vec2(radius), glm::max(position, target) + glm::vec2(radius), [&](const Segment& segment) {
+				SweepAgainstSegment(position, displacement, radius, segment, hit);
+			});
+			if (hit.t == FLT_MAX) {
+				position = target;
+				break;
+			}
+			// Move up to the wall, then slide along it with what's left
+			float distance = glm::length(displacement);
+			float t = std::max(0.0f, hit.t - SKIN_WIDTH / distance);
+			position += displacement * t;
+			glm::vec2 remaining = displacement * (1.0f - t);
+			displacement = remaining - hit.normal * std::min(0.0f, glm::dot(remaining, hit.normal));
+		}
+		return glm::vec3(position.x, to.y, position.y);
+	}
+
+	glm::vec3 ResolveCircleOverlaps(glm::vec3 position, float radius) {
+		glm::vec2 center = glm::vec2(position.x, position.z);
+		QuerySegments(center - glm::vec2(radius), center + glm::vec2(radius), [&](const Segment& segment) {
+			glm::vec2 offset = center - ClosestPointOnSegment(center, segment);
+			float distance = glm::length(offset);
+			if (distance < radius && distance > 0.0f) {
+				center += offset / distance * (radius - distance);
+			}
+		});
+		return glm::vec3(center.x, position.y, center.y);
+	}
+
+	FrameVector<Vertex> GetLineVertices() {
+		FrameVector<Vertex> vertices;
+		vertices.reserve(GetSegmentCount() * 2);
+		for (const Segment& segment : _segments) {
+			if (segment.alive) {
+				vertices.push_back(Vertex(glm::vec3(segment.begin.x, 0, segment.begin.y)));
+				vertices.push_back(Vertex(glm::vec3(segment.end.x, 0, segment.end.y)));
+			}
+		}
+		return vertices;
+	}
+
+	uint32_t GetSegmentCount() {
+		return (uint32_t)(_segments.size() - _freeSegments.size());
+	}
+}
\ No newline at end of file
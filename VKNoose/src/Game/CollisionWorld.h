@@ -0,0 +1,28 @@
+#pragma once
+#include "Hell/Types.h"
+#include "Hell/Core/FrameArena.h"
+#include <span>
+#include <vector>
+
+// 2D collision world on the XZ plane. Line segments are bucketed into a uniform grid, hashed by cell,
+// so a query only ever looks at the cells it overlaps no matter how big the level gets.
+// Static segments (walls) are added once. Dynamic shapes (doors, furniture) are reinserted only when they change.
+namespace CollisionWorld {
+
+	void Clear();
+	void AddStaticSegment(glm::vec3 begin, glm::vec3 end);
+
+	// Dynamic shapes, each is a set of segments given as line list vertices
+	uint32_t CreateDynamicShape();
+	void SetDynamicShape(uint32_t shapeIndex, std::span<const glm::vec3> lineVertices);
+
+	// Moves a circle from -> to, stopping at the first segment it touches and sliding along it with whatever movement is left.
+	// Returns where the circle ends up, y is left untouched.
+	glm::vec3 SweepCircle(glm::vec3 from, glm::vec3 to, float radius);
+
+	// Pushes a circle out of any segment it overlaps, for when something moved into it rather than the other way round
+	glm::vec3 ResolveCircleOverlaps(glm::vec3 position, float radius);
+
+	FrameVector<Vertex> GetLineVertices();
+	uint32_t GetSegmentCount();
+}
\ No newline at end of file
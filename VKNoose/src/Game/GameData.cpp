@@ -3,6 +3,7 @@
 #include "AssetManagement/AssetManager.h"
 #include "Scene.h"
 #include "Laptop.h"
+#include "../Profiler.h"
 
 namespace GameData {
 	std::vector<std::string> _inventory;
@@ -25,6 +26,7 @@ void GameData::Init() {
 }
 
 void GameData::Update() {
+	PROFILE_SCOPE("Game Update");
 
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float accumulator = 0;
@@ -64,12 +66,13 @@ void GameData::Update() {
 	}
 
 	if (!GameData::inventoryOpen) {
+		glm::vec3 previousPosition = GameData::GetPlayer().m_position;
 		GameData::GetPlayer().UpdateMovement(_deltaTime);
 
-		std::vector collisionLines = Scene::GetCollisionLineVertices();
+		Scene::UpdateCollisionWorld();
 
 		if (VulkanBackEnd::_collisionEnabled) {
-			GameData::GetPlayer().EvaluateCollsions(collisionLines);
+			GameData::GetPlayer().EvaluateCollsions(previousPosition);
 		}
 		GameData::GetPlayer().UpdateMouselook(_deltaTime);
 	}
@@ -149,6 +152,10 @@ void GameData::Update() {
 		}
 	}
 
+	// Every transform is final for the frame now, so the pick matches what is about to be rendered
+	Scene::UpdateWorldTransforms();
+	Scene::UpdateSceneBvh();
+	Scene::UpdateMousePick();
 }
 
 void GameData::AddInventoryItem(std::string itemName) {
@@ -1,6 +1,7 @@
 #pragma once
 #include "GameObject.h"
 #include "Scene.h"
+#include "../Util.h"
 #include "Callbacks.hpp"
 
 GameObject::GameObject() {
@@ -9,6 +10,7 @@ GameObject::GameObject() {
 void GameObject::SetModelMatrixTransformOverride(glm::mat4 model) {
 	_overrideTransformWithMatrix = true;
 	_modelMatrixTransformOverride = model;
+	MarkTransformDirty();
 }
 
 void GameObject::SetOpenAxis(OpenAxis openAxis) {
@@ -17,34 +19,42 @@ void GameObject::SetOpenAxis(OpenAxis openAxis) {
 
 void GameObject::SetPosition(float x, float y, float z) {
 	_transform.position = glm::vec3(x, y, z);
+	MarkTransformDirty();
 }
 
 void GameObject::SetPosition(glm::vec3 position) {
 	_transform.position = position;
+	MarkTransformDirty();
 }
 
 void GameObject::SetPositionX(float position) {
 	_transform.position.x = position;
+	MarkTransformDirty();
 }
 
 void GameObject::SetPositionY(float position) {
 	_transform.position.y = position;
+	MarkTransformDirty();
 }
 
 void GameObject::SetPositionZ(float position) {
 	_transform.position.z = position;
+	MarkTransformDirty();
 }
 
 void GameObject::SetRotationX(float rotation) {
 	_transform.rotation.x = rotation;
+	MarkTransformDirty();
 }
 
 void GameObject::SetRotationY(float rotation) {
 	_transform.rotation.y = rotation;
+	MarkTransformDirty();
 }
 
 void GameObject::SetRotationZ(float rotation) {
 	_transform.rotation.z = rotation;
+	MarkTransformDirty();
 }
 
 float GameObject::GetRotationX() {
@@ -72,32 +82,38 @@ glm::mat4 GameObject::GetRotationMatrix() {
 
 void GameObject::SetScale(glm::vec3 scale) {
 	_transform.scale = glm::vec3(scale);
+	MarkTransformDirty();
 }
 
 void GameObject::SetScale(float scale) {
 	_transform.scale = glm::vec3(scale);
+	MarkTransformDirty();
 }
 void GameObject::SetScaleX(float scale) {
 	_transform.scale.x = scale;
+	MarkTransformDirty();
 }
 
 glm::mat4 GameObject::GetModelMatrix() {
+	// Scene objects read the cached world matrix, anything else (inventory objects) works it out on the spot
+	int index = Scene::GetGameObjectIndex(this);
+	if (index != -1) {
+		return Scene::GetWorldMatrix(index);
+	}
+	GameObject* parent = _collected ? nullptr : Scene::GetGameObjectByName(_parentName);
+	if (parent) {
+		return parent->GetModelMatrix() * GetLocalMatrix();
+	}
+	return GetLocalMatrix();
+}
+
+glm::mat4 GameObject::GetLocalMatrix() {
 	// If this is an item that has been collected, move if way below the world.
 	if (_collected) {
 		Transform t;
 		t.position.y = -100;
 		return t.to_mat4();
 	}
-
-	GameObject* parent = Scene::GetGameObjectByName(_parentName);
-	if (parent) {
-		if (_overrideTransformWithMatrix) {
-			return parent->GetModelMatrix() * _modelMatrixTransformOverride;
-		}
-		else {
-			return parent->GetModelMatrix() * _transform.to_mat4();
-		}
-	}
 	if (_overrideTransformWithMatrix) {
 		return _modelMatrixTransformOverride;
 	}
@@ -106,12 +122,45 @@ glm::mat4 GameObject::GetModelMatrix() {
 	}
 }
 
+bool GameObject::TransformIsDirty() {
+	return _transformDirty;
+}
+
+void GameObject::ClearTransformDirty() {
+	_transformDirty = false;
+}
+
+void GameObject::MarkTransformDirty() {
+	_transformDirty = true;
+	if (Scene::GetGameObjectIndex(this) != -1) {
+		Scene::_worldTransformsOutOfDate = true;
+	}
+}
+
+bool GameObject::InstanceDataIsDirty() {
+	return _instanceDataDirty;
+}
+
+void GameObject::ClearInstanceDataDirty() {
+	_instanceDataDirty = false;
+}
+
+void GameObject::MarkInstanceDataDirty() {
+	_instanceDataDirty = true;
+	if (Scene::GetGameObjectIndex(this) != -1) {
+		Scene::_meshInstancesOutOfDate = true;
+	}
+}
+
 std::string GameObject::GetName() {
 	return _name;
 }
 
 void GameObject::SetName(std::string name) {
 	_name = name;
+	if (Scene::GetGameObjectIndex(this) != -1) {
+		Scene::_transformHierarchyChanged = true;
+	}
 }
 
 /*void GameObject::SetInteractText(std::string text) {
@@ -120,6 +169,13 @@ void GameObject::SetName(std::string name) {
 
 void GameObject::SetParentName(std::string name) {
 	_parentName = name;
+	if (Scene::GetGameObjectIndex(this) != -1) {
+		Scene::_transformHierarchyChanged = true;
+	}
+}
+
+std::string GameObject::GetParentName() {
+	return _parentName;
 }
 
 void GameObject::SetScriptName(std::string name) {
@@ -188,6 +244,9 @@ void GameObject::Interact() {
 }
 
 void GameObject::Update(float deltaTime) {
+	if (_openState == OpenState::OPENING || _openState == OpenState::CLOSING) {
+		MarkTransformDirty();
+	}
 	// Open/Close if applicable
 	if (_openState != OpenState::NONE) {
 		// Rotation
@@ -335,6 +394,11 @@ void GameObject::SetOpenState(OpenState openState, float speed, float min, float
 void GameObject::SetModel(const std::string& name)
 {
 	_model = AssetManager::GetModel(name);
+	MarkInstanceDataDirty();
+	if (Scene::GetGameObjectIndex(this) != -1) {
+		Scene::_meshInstanceLayoutChanged = true;
+		Scene::_sceneBvhOutOfDate = true;
+	}
 
 	if (_model) {
 		_meshMaterialIndices.resize(_model->m_meshIndices.size());
@@ -347,17 +411,11 @@ void GameObject::SetModel(const std::string& name)
 }
 
 VkTransformMatrixKHR GameObject::GetVkTransformMatrixKHR() {
-	VkTransformMatrixKHR transformMatrix = {
-	1.0f, 0.0f, 0.0f, 0.0f,
-	0.0f, 1.0f, 0.0f, 0.0f,
-	0.0f, 0.0f, 1.0f, 0.0f };
-	glm::mat4 modelMatrix = glm::transpose(GetModelMatrix());
-	for (int x = 0; x < 3; x++) {
-		for (int y = 0; y < 4; y++) {
-			transformMatrix.matrix[x][y] = modelMatrix[x][y];
-		}
+	int index = Scene::GetGameObjectIndex(this);
+	if (index != -1) {
+		return Scene::GetWorldVkTransformMatrix(index);
 	}
-	return transformMatrix;
+	return Util::GetVkTransformMatrixKHR(GetModelMatrix());
 }
 
 void GameObject::SetMeshMaterial(const char* name, int meshIndex) {
@@ -372,6 +430,7 @@ void GameObject::SetMeshMaterial(const char* name, int meshIndex) {
 	}
 	// Get the material index via the material name
 	int materialIndex = AssetManager::GetMaterialIndex(name);
+	MarkInstanceDataDirty();
 	// Set material for single mesh
 	if (meshIndex != -1) {
 		_meshMaterialIndices[meshIndex] = materialIndex;
@@ -397,6 +456,7 @@ void GameObject::PickUp() {
 	GameData::AddInventoryItem(GetName());
 	Audio::PlayAudio("ItemPickUp.wav", 0.5f);
 	_collected = true;
+	MarkTransformDirty();
 	std::cout << "Picked up \"" << GetName() << "\"\n";
 	std::cout << "_collected \"" << _collected << "\"\n";
 	//std::cout << "Picked up \"" << _transform.position.x << " " <<_transform.position.y << " " << _transform.position.z << " " << "\"\n";
@@ -404,6 +464,7 @@ void GameObject::PickUp() {
 
 void GameObject::SetCollectedState(bool value) {
 	_collected = value;
+	MarkTransformDirty();
 }
 
 void GameObject::SetInteract(InteractType type, std::string text, std::function<void(void)> callback) {
@@ -468,6 +529,7 @@ OpenState& GameObject::GetOpenState() {
 
 void GameObject::SetMaterialType(MaterialType materialType, int meshIndex)
 {
+	MarkInstanceDataDirty();
 	if (meshIndex == -1) {
 		for (int i = 0; i < _meshMaterialTypes.size(); i++) {
 			_meshMaterialTypes[i] = materialType;
@@ -484,6 +546,7 @@ void GameObject::SetMaterialType(MaterialType materialType, int meshIndex)
 void GameObject::SetTransform(Transform& transform)
 {
 	_transform = transform;
+	MarkTransformDirty();
 }
 
 void GameObject::SetInteractToAffectAnotherObject(std::string objectName)
@@ -496,6 +559,7 @@ void GameObject::SetMeshMaterialByMeshName(std::string meshName, std::string mat
 		for(int i = 0; i < _model->m_meshNames.size(); i++) {
 			if (_model->m_meshNames[i] == meshName) {
 				_meshMaterialIndices[i] = AssetManager::GetMaterialIndex(materialName);
+				MarkInstanceDataDirty();
 			}
 		}
 	}
@@ -40,6 +40,8 @@ private:
 	bool _collected = false; // if this were an item
 	BoundingBox _boundingBox;
 	bool _collisionEnabled = true;
+	bool _transformDirty = true;
+	bool _instanceDataDirty = true;
 	InteractType _interactType = InteractType::NONE;
 	MaterialType _materialType = MaterialType::DEFAULT;
 		
@@ -53,6 +55,12 @@ private:
 public:
 	GameObject();
 	glm::mat4 GetModelMatrix();
+	glm::mat4 GetLocalMatrix();
+	bool TransformIsDirty();
+	void ClearTransformDirty();
+	bool InstanceDataIsDirty();
+	void ClearInstanceDataDirty();
+	std::string GetParentName();
 	std::string GetName();
 	void SetModelMatrixTransformOverride(glm::mat4 model);
 	void SetOpenAxis(OpenAxis openAxis);
@@ -105,4 +113,8 @@ public:
 	void SetTransform(Transform& transform);
 	void SetInteractToAffectAnotherObject(std::string objectName);
 	void SetMeshMaterialByMeshName(std::string meshName, std::string materialName);
+
+private:
+	void MarkTransformDirty();
+	void MarkInstanceDataDirty();
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "../Audio/Audio.h"
 #include "../Input/Input.h"
 #include "../Util.h"
+#include "CollisionWorld.h"
 
 
 
@@ -64,10 +65,9 @@ void Player::UpdateMovement(float deltaTime)
 	else
 	{
 		if (m_moving && m_footstepAudioTimer == 0) {
-			int random_number = std::rand() % 4 + 1;
-			//std::string file = "player_step_" + std::to_string(random_number) + ".wav"; 
-			std::string file = "pl_dirt" + std::to_string(random_number) + ".wav";
-			Audio::PlayAudio(file.c_str(), 0.5f);
+			static const char* footstepFiles[] = { "pl_dirt1.wav", "pl_dirt2.wav", "pl_dirt3.wav", "pl_dirt4.wav" };
+			int random_number = std::rand() % 4;
+			Audio::PlayAudio(footstepFiles[random_number], 0.5f);
 			
 		}
 		float timerIncrement = IsCrouching() ? deltaTime * 0.75f : deltaTime;
@@ -123,27 +123,13 @@ bool Player::IsCrouching()
 	return _crouching;
 }
 
-void Player::EvaluateCollsions(std::vector<Vertex>& lines) {
-
-	for (int i = 0; i < lines.size(); i += 2) {
-
-		glm::vec3 lineStart = lines[i].position;
-		glm::vec3 lineEnd = lines[i+1].position;
-		float radius = 0.125f;// m_radius;
-		glm::vec3 playerPos = m_position;
-		playerPos.y = 0;
-
-		glm::vec3 closestPointOnLine = Util::ClosestPointOnLine(playerPos, lineStart, lineEnd);
-
-		glm::vec3 dir = glm::normalize(closestPointOnLine - playerPos);
-		float distToLine = glm::length(closestPointOnLine - playerPos);
-		float correctionFactor = radius - distToLine;
-
-		if (glm::length(closestPointOnLine - playerPos) < radius) {
-			m_position -= dir * correctionFactor;
-			m_position.y = 0;
-			//_collisionFound = true;
-			//return true;
-		}
+// Swept, so a long frame (deltaTime is clamped at 0.25s) can't step through a wall in one go
+void Player::EvaluateCollsions(glm::vec3 previousPosition) {
+	float radius = 0.125f;// m_radius;
+	glm::vec3 targetPosition = m_position;
+	m_position = CollisionWorld::SweepCircle(previousPosition, targetPosition, radius);
+	m_position = CollisionWorld::ResolveCircleOverlaps(m_position, radius);
+	if (m_position != targetPosition) {
+		m_position.y = 0;
 	}
 }
\ No newline at end of file
@@ -9,7 +9,7 @@ public:
 	void UpdateMovement(float deltaTime);
 	void UpdateMouselook(float deltaTime);
 	void UpdateCamera(float deltaTime, bool inventoryOpen);
-	void EvaluateCollsions(std::vector<Vertex>& lines);
+	void EvaluateCollsions(glm::vec3 previousPosition);
 	bool IsCrouching();
 
 public:
@@ -1,8 +1,12 @@
 #include "Scene.h"
 #include "AssetManagement/AssetManager.h"
+#include "Bvh/Cpu/CpuBvh.h"
+#include "CollisionWorld.h"
 #include "../Audio/Audio.h"
 #include "House/wall.h"
 #include "Callbacks.hpp"
+#include <unordered_map>
+#include <xmmintrin.h>
 
 namespace Scene {
 	std::vector<GameObject> _gameObjects;
@@ -20,10 +24,49 @@ struct CollsionLine {
 	glm::vec3 end;
 };
 
+enum class ColliderType { DOOR, DOOR_FRAME, BOUNDING_BOX };
+
+// What a game object's collision lines were last built from, so they are only rebuilt when it moves
+struct GameObjectCollider {
+	ColliderType type = ColliderType::BOUNDING_BOX;
+	uint32_t shapeIndex = 0;
+	glm::vec3 position = glm::vec3(0);
+	glm::vec3 rotation = glm::vec3(0);
+	BoundingBox box;
+	bool collisionEnabled = false;
+	bool inserted = false;
+};
+
+namespace Scene {
+	std::vector<GameObjectCollider> _gameObjectColliders;
+	bool _collisionWorldDirty = true;
+
+	// World transform cache, indexed like _gameObjects
+	std::vector<int32_t> _transformParents;             // -1 for roots
+	std::vector<uint32_t> _transformOrder;              // Every parent comes before its children
+	std::vector<int32_t> _composeParents;               // _transformParents, except collected items which ignore their parent
+	std::vector<glm::mat4> _localMatrices;
+	std::vector<glm::mat4> _worldMatrices;
+	std::vector<VkTransformMatrixKHR> _worldVkTransforms;
+	std::vector<uint8_t> _worldMatrixChanged;
+	std::vector<uint32_t> _composeIndices;
+
+	// Persistent scene instance data
+	std::vector<MeshInstance> _sceneMeshInstances;
+	std::vector<uint64_t> _sceneMeshInstanceDirtyBits;
+	std::vector<uint32_t> _gameObjectFirstInstance;     // Slot of each game object's first mesh
+	std::vector<uint8_t> _worldMatrixChangedSinceInstanceUpdate;
+	uint32_t _firstWallInstance = 0;
+	bool _instancesDebugScene = false;
+}
+
 void Scene::Init()
 {
 	_gameObjects.clear();
 	_gameObjects.reserve(1000);
+	_collisionWorldDirty = true;
+	_meshInstanceLayoutChanged = true;
+	_sceneBvhOutOfDate = true;
 	_lights.clear();
 
 	Light& light = _lights.emplace_back(Light());
@@ -906,9 +949,155 @@ GameObject* Scene::GetGameObjectByIndex(int index) {
 		return nullptr;
 }
 
-std::vector<LightRenderInfo> Scene::GetLightRenderInfo()
+int Scene::GetGameObjectIndex(const GameObject* gameObject) {
+	if (_gameObjects.empty() || std::less<const GameObject*>()(gameObject, _gameObjects.data()) || !std::less<const GameObject*>()(gameObject, _gameObjects.data() + _gameObjects.size()))
+		return -1;
+	return (int)(gameObject - _gameObjects.data());
+}
+
+// Parents are resolved by name once here rather than on every GetModelMatrix() call, then sorted by depth so a single
+// pass in _transformOrder always sees a parent's world matrix before its children need it
+static void RebuildTransformHierarchy() {
+	using namespace Scene;
+	uint32_t count = (uint32_t)_gameObjects.size();
+	std::unordered_map<std::string, int32_t> indicesByName;
+	for (uint32_t i = 0; i < count; i++) {
+		indicesByName.emplace(_gameObjects[i].GetName(), (int32_t)i);
+	}
+	_transformParents.assign(count, -1);
+	for (uint32_t i = 0; i < count; i++) {
+		std::string parentName = _gameObjects[i].GetParentName();
+		if (parentName == "undefined")
+			continue;
+		auto it = indicesByName.find(parentName);
+		if (it == indicesByName.end()) {
+			std::cout << "Scene::RebuildTransformHierarchy() failed, no parent with name \"" << parentName << "\" for \"" << _gameObjects[i].GetName() << "\"\n";
+			continue;
+		}
+		_transformParents[i] = it->second;
+	}
+
+	// Depth of every object, a loop in the parents is broken by making the object that closes it a root
+	std::vector<int32_t> depths(count, -1);
+	std::vector<uint32_t> chain;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t current = i;
+		while (depths[current] == -1) {
+			depths[current] = -2;
+			chain.push_back(current);
+			int32_t parent = _transformParents[current];
+			if (parent < 0)
+				break;
+			if (depths[parent] == -2) {
+				std::cout << "Scene::RebuildTransformHierarchy() found a parent loop at \"" << _gameObjects[current].GetName() << "\"\n";
+				_transformParents[current] = -1;
+				break;
+			}
+			current = parent;
+		}
+		for (auto it = chain.rbegin(); it != chain.rend(); it++) {
+			int32_t parent = _transformParents[*it];
+			depths[*it] = (parent < 0) ? 0 : depths[parent] + 1;
+		}
+		chain.clear();
+	}
+	_transformOrder.resize(count);
+	for (uint32_t i = 0; i < count; i++) {
+		_transformOrder[i] = i;
+	}
+	std::stable_sort(_transformOrder.begin(), _transformOrder.end(), [&](uint32_t a, uint32_t b) {
+		return depths[a] < depths[b];
+	});
+
+	_composeParents.assign(count, -1);
+	_worldMatrixChangedSinceInstanceUpdate.assign(count, 1);
+	_localMatrices.resize(count);
+	_worldMatrices.resize(count);
+	_worldVkTransforms.resize(count);
+	_worldMatrixChanged.assign(count, 0);
+	_transformHierarchyChanged = false;
+}
+
+// world = parent world * local for each index in turn, a column at a time with SSE. The indices are in
+// _transformOrder order, so a parent changed in the same batch is always written before its children read it.
+static void ComposeWorldMatrices(const std::vector<uint32_t>& indices) {
+	using namespace Scene;
+	for (uint32_t index : indices) {
+		int32_t parent = _composeParents[index];
+		if (parent < 0) {
+			_worldMatrices[index] = _localMatrices[index];
+			continue;
+		}
+		const float* a = &_worldMatrices[parent][0][0];
+		const float* b = &_localMatrices[index][0][0];
+		float* result = &_worldMatrices[index][0][0];
+		__m128 a0 = _mm_loadu_ps(a + 0);
+		__m128 a1 = _mm_loadu_ps(a + 4);
+		__m128 a2 = _mm_loadu_ps(a + 8);
+		__m128 a3 = _mm_loadu_ps(a + 12);
+		for (int column = 0; column < 4; column++) {
+			const float* bColumn = b + column * 4;
+			__m128 r = _mm_mul_ps(a0, _mm_set1_ps(bColumn[0]));
+			r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(bColumn[1])));
+			r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(bColumn[2])));
+			r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(bColumn[3])));
+			_mm_storeu_ps(result + column * 4, r);
+		}
+	}
+}
+
+void Scene::UpdateWorldTransforms() {
+	bool rebuilt = false;
+	if (_transformHierarchyChanged || _transformParents.size() != _gameObjects.size()) {
+		RebuildTransformHierarchy();
+		rebuilt = true;
+	}
+	_worldTransformsOutOfDate = false;
+
+	// Anything dirty gets a new local matrix, anything under it in the tree needs a new world matrix too
+	_composeIndices.clear();
+	for (uint32_t index : _transformOrder) {
+		GameObject& gameObject = _gameObjects[index];
+		int32_t parent = _transformParents[index];
+		bool dirty = gameObject.TransformIsDirty();
+		bool changed = rebuilt || dirty || (parent >= 0 && _worldMatrixChanged[parent]);
+		_worldMatrixChanged[index] = changed;
+		if (!changed)
+			continue;
+		if (dirty || rebuilt) {
+			_localMatrices[index] = gameObject.GetLocalMatrix();
+			_composeParents[index] = gameObject.IsCollected() ? -1 : parent;
+			gameObject.ClearTransformDirty();
+		}
+		_composeIndices.push_back(index);
+	}
+	ComposeWorldMatrices(_composeIndices);
+	for (uint32_t index : _composeIndices) {
+		_worldVkTransforms[index] = Util::GetVkTransformMatrixKHR(_worldMatrices[index]);
+		_worldMatrixChangedSinceInstanceUpdate[index] = 1;
+	}
+	if (!_composeIndices.empty()) {
+		_meshInstancesOutOfDate = true;
+		_sceneBvhOutOfDate = true;
+	}
+}
+
+const glm::mat4& Scene::GetWorldMatrix(int gameObjectIndex) {
+	if (_worldTransformsOutOfDate || _transformHierarchyChanged || _worldMatrices.size() != _gameObjects.size())
+		UpdateWorldTransforms();
+	return _worldMatrices[gameObjectIndex];
+}
+
+const VkTransformMatrixKHR& Scene::GetWorldVkTransformMatrix(int gameObjectIndex) {
+	if (_worldTransformsOutOfDate || _transformHierarchyChanged || _worldVkTransforms.size() != _gameObjects.size())
+		UpdateWorldTransforms();
+	return _worldVkTransforms[gameObjectIndex];
+}
+
+FrameVector<LightRenderInfo> Scene::GetLightRenderInfo()
 {
-	std::vector<LightRenderInfo> data;
+	FrameVector<LightRenderInfo> data;
+	data.reserve(_lights.size());
 	for (int i = 0; i < _lights.size(); i++) {
 		data.push_back(LightRenderInfo());
 		data[i].position = glm::vec4(_lights[i].position, 0);
@@ -917,9 +1106,10 @@ std::vector<LightRenderInfo> Scene::GetLightRenderInfo()
 	return data;
 }
 
-std::vector<LightRenderInfo> Scene::GetLightRenderInfoInventory()
+FrameVector<LightRenderInfo> Scene::GetLightRenderInfoInventory()
 {
-	std::vector<LightRenderInfo> data;
+	FrameVector<LightRenderInfo> data;
+	data.reserve(2);
 
 	LightRenderInfo light0;
 	light0.position = glm::vec4(0.5, 0.2, 1, 0);
@@ -1144,48 +1334,125 @@ std::vector<GameObject>& Scene::GetGameObjects() {
 	return _gameObjects;
 }
 
-std::vector<MeshInstance> Scene::GetSceneMeshInstances(bool debugScene)
-{
-	std::vector<MeshInstance> instances;
+static void MarkSceneMeshInstanceDirty(uint32_t slot) {
+	Scene::_sceneMeshInstanceDirtyBits[slot >> 6] |= 1ull << (slot & 63);
+}
 
-	for (GameObject& gameObject : _gameObjects) {
-		for (int i = 0; i < gameObject._model->m_meshIndices.size(); i++) {
-			int meshIndex = gameObject._model->m_meshIndices[i];
-			MeshOLD* mesh = AssetManager::GetMesh(meshIndex);
-			MeshInstance instance;
-			instance.worldMatrix = gameObject.GetModelMatrix();
-			instance.basecolorIndex = gameObject.GetMaterial(i)->_basecolor;
-			instance.normalIndex = gameObject.GetMaterial(i)->_normal;
-			instance.rmaIndex = gameObject.GetMaterial(i)->_rma;
-			instance.vertexOffset = mesh->m_vertexOffset;
-			instance.indexOffset = mesh->m_indexOffset;
-			instance.materialType = (int)gameObject._meshMaterialTypes[i];
-			instances.push_back(instance);
-		}
+static void WriteGameObjectMeshInstances(uint32_t gameObjectIndex) {
+	using namespace Scene;
+	GameObject& gameObject = _gameObjects[gameObjectIndex];
+	const glm::mat4& worldMatrix = _worldMatrices[gameObjectIndex];
+	uint32_t firstSlot = _gameObjectFirstInstance[gameObjectIndex];
+	for (int i = 0; i < gameObject._model->m_meshIndices.size(); i++) {
+		int meshIndex = gameObject._model->m_meshIndices[i];
+		MeshOLD* mesh = AssetManager::GetMesh(meshIndex);
+		Material* material = gameObject.GetMaterial(i);
+		MeshInstance& instance = _sceneMeshInstances[firstSlot + i];
+		instance = MeshInstance();
+		instance.worldMatrix = worldMatrix;
+		instance.basecolorIndex = material->_basecolor;
+		instance.normalIndex = material->_normal;
+		instance.rmaIndex = material->_rma;
+		instance.vertexOffset = mesh->m_vertexOffset;
+		instance.indexOffset = mesh->m_indexOffset;
+		instance.meshIndex = meshIndex;
+		instance.materialType = (int)gameObject._meshMaterialTypes[i];
+		MarkSceneMeshInstanceDirty(firstSlot + i);
 	}
-	for (Wall& wall : _walls) {
+	gameObject.ClearInstanceDataDirty();
+	_worldMatrixChangedSinceInstanceUpdate[gameObjectIndex] = 0;
+}
+
+static void WriteWallMeshInstances(bool debugScene) {
+	using namespace Scene;
+	for (uint32_t i = 0; i < _walls.size(); i++) {
+		Wall& wall = _walls[i];
 		MeshOLD* mesh = AssetManager::GetMesh(wall._meshIndex);
 		Material* material = wall._material;
 		if (!debugScene && material != AssetManager::GetMaterial("BathroomWall")) {
 			material = AssetManager::GetMaterial("WallPaper");
 		}
-		MeshInstance instance;
+		MeshInstance& instance = _sceneMeshInstances[_firstWallInstance + i];
+		instance = MeshInstance();
 		instance.worldMatrix = glm::mat4(1);
 		instance.basecolorIndex = material->_basecolor;
 		instance.normalIndex = material->_normal;
 		instance.rmaIndex = material->_rma;
 		instance.vertexOffset = mesh->m_vertexOffset;
 		instance.indexOffset = mesh->m_indexOffset;
+		instance.meshIndex = wall._meshIndex;
 		instance.materialType = (int)MaterialType::DEFAULT;
-		instances.push_back(instance);
+		MarkSceneMeshInstanceDirty(_firstWallInstance + i);
 	}
-	return instances;
+	_instancesDebugScene = debugScene;
 }
 
+void Scene::UpdateSceneMeshInstances(bool debugScene) {
+	if (_worldTransformsOutOfDate || _transformHierarchyChanged || _worldMatrices.size() != _gameObjects.size())
+		UpdateWorldTransforms();
+
+	// Slots are handed out again only when objects are added or swap models, everything gets rewritten then
+	if (_meshInstanceLayoutChanged || _gameObjectFirstInstance.size() != _gameObjects.size()) {
+		_gameObjectFirstInstance.resize(_gameObjects.size());
+		uint32_t slotCount = 0;
+		for (uint32_t i = 0; i < _gameObjects.size(); i++) {
+			_gameObjectFirstInstance[i] = slotCount;
+			slotCount += (uint32_t)_gameObjects[i]._model->m_meshIndices.size();
+		}
+		_firstWallInstance = slotCount;
+		slotCount += (uint32_t)_walls.size();
+		_sceneMeshInstances.resize(slotCount);
+		_sceneMeshInstanceDirtyBits.assign((slotCount + 63) / 64, 0);
+		for (uint32_t i = 0; i < _gameObjects.size(); i++) {
+			WriteGameObjectMeshInstances(i);
+		}
+		WriteWallMeshInstances(debugScene);
+		_meshInstanceLayoutChanged = false;
+		_meshInstancesOutOfDate = false;
+		return;
+	}
 
-std::vector<MeshInstance> Scene::GetInventoryMeshInstances(bool debugScene)
+	if (_meshInstancesOutOfDate) {
+		for (uint32_t i = 0; i < _gameObjects.size(); i++) {
+			if (_worldMatrixChangedSinceInstanceUpdate[i] || _gameObjects[i].InstanceDataIsDirty()) {
+				WriteGameObjectMeshInstances(i);
+			}
+		}
+		_meshInstancesOutOfDate = false;
+	}
+	if (debugScene != _instancesDebugScene) {
+		WriteWallMeshInstances(debugScene);
+	}
+}
+
+const std::vector<MeshInstance>& Scene::GetSceneMeshInstanceData() {
+	return _sceneMeshInstances;
+}
+
+std::vector<uint64_t>& Scene::GetSceneMeshInstanceDirtyBits() {
+	return _sceneMeshInstanceDirtyBits;
+}
+
+// One instance per mesh of every game object, then one per wall. Lets the per frame vectors reserve exactly once
+static size_t CountMeshInstances(const std::vector<GameObject>& gameObjects, const std::vector<Wall>& walls) {
+	size_t count = walls.size();
+	for (const GameObject& gameObject : gameObjects) {
+		count += gameObject._model->m_meshIndices.size();
+	}
+	return count;
+}
+
+const std::vector<MeshInstance>& Scene::GetSceneMeshInstances(bool debugScene)
+{
+	UpdateSceneMeshInstances(debugScene);
+	return _sceneMeshInstances;
+}
+
+
+FrameVector<MeshInstance> Scene::GetInventoryMeshInstances(bool debugScene)
 {
-	std::vector<MeshInstance> instances;
+	FrameVector<MeshInstance> instances;
+	instances.reserve(CountMeshInstances(_inventoryGameObjects, _inventoryWalls));
 
 	for (GameObject& gameObject : _inventoryGameObjects) {
 		for (int i = 0; i < gameObject._model->m_meshIndices.size(); i++) {
@@ -1198,6 +1465,7 @@ std::vector<MeshInstance> Scene::GetInventoryMeshInstances(bool debugScene)
 			instance.rmaIndex = gameObject.GetMaterial(i)->_rma;
 			instance.vertexOffset = mesh->m_vertexOffset;
 			instance.indexOffset = mesh->m_indexOffset;
+			instance.meshIndex = meshIndex;
 			instance.materialType = (int)gameObject._meshMaterialTypes[i];
 			instances.push_back(instance);
 		}
@@ -1215,6 +1483,7 @@ std::vector<MeshInstance> Scene::GetInventoryMeshInstances(bool debugScene)
 		instance.rmaIndex = material->_rma;
 		instance.vertexOffset = mesh->m_vertexOffset;
 		instance.indexOffset = mesh->m_indexOffset;
+		instance.meshIndex = wall._meshIndex;
 		instance.materialType = (int)MaterialType::DEFAULT;
 		instances.push_back(instance);
 	}
@@ -1222,10 +1491,11 @@ std::vector<MeshInstance> Scene::GetInventoryMeshInstances(bool debugScene)
 	return instances;
 }
 
-std::vector<VkAccelerationStructureInstanceKHR> Scene::GetMeshInstancesForInventoryAccelerationStructure()
+FrameVector<VkAccelerationStructureInstanceKHR> Scene::GetMeshInstancesForInventoryAccelerationStructure()
 {
 	int instanceCustomIndex = 0;
-	std::vector<VkAccelerationStructureInstanceKHR> instances;
+	FrameVector<VkAccelerationStructureInstanceKHR> instances;
+	instances.reserve(CountMeshInstances(_inventoryGameObjects, _inventoryWalls));
 
 	for (GameObject& gameObject : _inventoryGameObjects) {
 		for (auto meshIndex : gameObject._model->m_meshIndices) {
@@ -1253,15 +1523,18 @@ std::vector<VkAccelerationStructureInstanceKHR> Scene::GetMeshInstancesForInvent
 	return instances;
 }
 
-std::vector<VkAccelerationStructureInstanceKHR> Scene::GetMeshInstancesForSceneAccelerationStructure() {
+FrameVector<VkAccelerationStructureInstanceKHR> Scene::GetMeshInstancesForSceneAccelerationStructure() {
 	int instanceCustomIndex = 0;
-	std::vector<VkAccelerationStructureInstanceKHR> instances;
+	FrameVector<VkAccelerationStructureInstanceKHR> instances;
+	instances.reserve(CountMeshInstances(_gameObjects, _walls));
 
-	for (GameObject& gameObject : _gameObjects) {
+	for (int i = 0; i < _gameObjects.size(); i++) {
+		GameObject& gameObject = _gameObjects[i];
+		const VkTransformMatrixKHR& transform = GetWorldVkTransformMatrix(i);
 		for (auto meshIndex : gameObject._model->m_meshIndices) {
 			MeshOLD* mesh = AssetManager::GetMesh(meshIndex);
 			VkAccelerationStructureInstanceKHR& instance = instances.emplace_back(VkAccelerationStructureInstanceKHR());
-			instance.transform = gameObject.GetVkTransformMatrixKHR();
+			instance.transform = transform;
 			instance.instanceCustomIndex = instanceCustomIndex++;
 			instance.mask = 0xFF;
 			instance.instanceShaderBindingTableRecordOffset = 0;
@@ -1282,6 +1555,44 @@ std::vector<VkAccelerationStructureInstanceKHR> Scene::GetMeshInstancesForSceneA
 	return instances;
 }
 
+// Same instance order as GetMeshInstancesForSceneAccelerationStructure(), so an instance index means the same on the CPU and GPU
+// Skipped when no world matrix and no mesh layout changed since the last update, the refit inverts every instance's transform.
+void Scene::UpdateSceneBvh() {
+	if (_worldTransformsOutOfDate || _transformHierarchyChanged || _worldMatrices.size() != _gameObjects.size())
+		UpdateWorldTransforms();
+	if (_sceneBvhId != 0 && !_sceneBvhOutOfDate)
+		return;
+	_sceneBvhOutOfDate = false;
+
+	if (_sceneBvhId == 0) {
+		_sceneBvhId = Bvh::Cpu::CreateSceneBvh();
+	}
+
+	FrameVector<Bvh::Cpu::PrimitiveInstance> instances;
+	instances.reserve(CountMeshInstances(_gameObjects, _walls));
+	for (int i = 0; i < _gameObjects.size(); i++) {
+		const glm::mat4& worldMatrix = GetWorldMatrix(i);
+		for (auto meshIndex : _gameObjects[i]._model->m_meshIndices) {
+			Bvh::Cpu::PrimitiveInstance& instance = instances.emplace_back();
+			instance.worldTransform = worldMatrix;
+			instance.meshBvhId = AssetManager::GetMesh(meshIndex)->m_meshBvhId;
+		}
+	}
+	for (Wall& wall : _walls) {
+		Bvh::Cpu::PrimitiveInstance& instance = instances.emplace_back();
+		instance.meshBvhId = AssetManager::GetMesh(wall._meshIndex)->m_meshBvhId;
+	}
+	Bvh::Cpu::UpdateSceneBvh(_sceneBvhId, instances);
+}
+
+Bvh::Cpu::RayHitInfo Scene::CastRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) {
+	return Bvh::Cpu::ClosestHit(_sceneBvhId, origin, glm::normalize(direction), 0.0f, maxDistance);
+}
+
+bool Scene::HasLineOfSight(const glm::vec3& from, const glm::vec3& to) {
+	return !Bvh::Cpu::SegmentIntersectsScene(_sceneBvhId, from, to);
+}
+
 std::vector<MeshOLD*> Scene::GetSceneMeshes(bool debugScene)
 {
 	std::vector<MeshOLD*> meshes;
@@ -1296,6 +1607,22 @@ std::vector<MeshOLD*> Scene::GetSceneMeshes(bool debugScene)
 	return meshes;
 }
 
+// What the 1x1 mouse pick trace used to do: a ray through the center of the screen that skips front faces,
+// resolved against the transforms this frame will be rendered with
+void Scene::UpdateMousePick() {
+	if (GameData::inventoryOpen)
+		return;
+
+	glm::mat4 viewInverse = glm::inverse(GameData::GetViewMatrix());
+	glm::mat4 projInverse = glm::inverse(GameData::GetProjectionMatrix());
+	glm::vec4 target = projInverse * glm::vec4(0, 0, 1, 1);
+	glm::vec3 origin = glm::vec3(viewInverse * glm::vec4(0, 0, 0, 1));
+	glm::vec3 direction = glm::vec3(viewInverse * glm::vec4(glm::normalize(glm::vec3(target) / target.w), 0));
+
+	Bvh::Cpu::RayHitInfo hit = Bvh::Cpu::ClosestHit(_sceneBvhId, origin, direction, 0.001f, 10000.0f, Bvh::Cpu::RAY_FLAG_CULL_FRONT_FACING);
+	StoreMousePickResult(hit.instanceIndex, hit.primitiveIndex);
+}
+
 void Scene::StoreMousePickResult(int instanceIndex, int primitiveIndex)
 {
 	if (GameData::inventoryOpen)
@@ -1313,7 +1640,8 @@ void Scene::StoreMousePickResult(int instanceIndex, int primitiveIndex)
 		MeshOLD* mesh = nullptr;
 		void* parent = nullptr;
 	};
-	std::vector<MeshHitInfo> infos;
+	FrameVector<MeshHitInfo> infos;
+	infos.reserve(CountMeshInstances(_gameObjects, _walls));
 
 	for (GameObject& gameObject : _gameObjects) {
 		for (auto meshIndex : gameObject._model->m_meshIndices) {
@@ -1351,9 +1679,10 @@ void Scene::StoreMousePickResult(int instanceIndex, int primitiveIndex)
 			Vertex v0 = AssetManager::GetVertex(index0 + vertexOffset);
 			Vertex v1 = AssetManager::GetVertex(index1 + vertexOffset);
 			Vertex v2 = AssetManager::GetVertex(index2 + vertexOffset);
-			v0.position = gameObject.GetModelMatrix() * glm::vec4(v0.position, 1.0);
-			v1.position = gameObject.GetModelMatrix() * glm::vec4(v1.position, 1.0);
-			v2.position = gameObject.GetModelMatrix() * glm::vec4(v2.position, 1.0);
+			const glm::mat4& worldMatrix = GetWorldMatrix(GetGameObjectIndex(&gameObject));
+			v0.position = worldMatrix * glm::vec4(v0.position, 1.0);
+			v1.position = worldMatrix * glm::vec4(v1.position, 1.0);
+			v2.position = worldMatrix * glm::vec4(v2.position, 1.0);
 			_hitTriangleVertices.push_back(v0);
 			_hitTriangleVertices.push_back(v1);
 			_hitTriangleVertices.push_back(v2);
@@ -1379,71 +1708,95 @@ void Scene::StoreMousePickResult(int instanceIndex, int primitiveIndex)
 	}
 }
 
-std::vector<Vertex> Scene::GetCollisionLineVertices() {
+FrameVector<Vertex> Scene::GetCollisionLineVertices() {
+	return CollisionWorld::GetLineVertices();
+}
 
-	std::vector<Vertex> vertices;
-	for (Wall& wall : _walls) {
-		if (wall._begin.y < 1) {
-			vertices.push_back(Vertex(wall._begin));
-			vertices.push_back(Vertex(wall._end));
-		}
+// Line list of a game object's collision footprint, in the same space as the walls
+static void GetGameObjectCollisionLines(GameObject& gameObject, ColliderType type, FrameVector<glm::vec3>& lines) {
+	glm::mat4 rotationMatrix = gameObject.GetRotationMatrix();
+	glm::vec3 position = gameObject.GetPosition();
+
+	if (type == ColliderType::DOOR) {
+		const float doorWidth = -0.794f;
+		const float doorDepth = -0.0379f;
+		// Front
+		glm::vec3 pos0 = position;
+		glm::vec3 pos1 = position + Util::Translate(rotationMatrix, glm::vec3(0.0, 0, doorWidth));
+		// Back
+		glm::vec3 pos2 = position + Util::Translate(rotationMatrix, glm::vec3(doorDepth, 0, 0));
+		glm::vec3 pos3 = position + Util::Translate(rotationMatrix, glm::vec3(doorDepth, 0, doorWidth));
+		lines.insert(lines.end(), { pos0, pos1, pos2, pos3, pos0, pos2, pos1, pos3 });
 	}
-	for (GameObject& gameObject : _gameObjects) {
+	else if (type == ColliderType::DOOR_FRAME) {
+		// Front
+		glm::vec3 pos0 = position + Util::Translate(rotationMatrix, glm::vec3(-0.05, 0, -0.45));
+		glm::vec3 pos1 = position + Util::Translate(rotationMatrix, glm::vec3(0.05, 0, -0.45));
+		// Back
+		glm::vec3 pos2 = position + Util::Translate(rotationMatrix, glm::vec3(-0.05, 0, +0.45));
+		glm::vec3 pos3 = position + Util::Translate(rotationMatrix, glm::vec3(0.05, 0, +0.45));
+		lines.insert(lines.end(), { pos0, pos1, pos2, pos3 });
+	}
+	else if (type == ColliderType::BOUNDING_BOX && gameObject.HasCollisionsEnabled()) {
+		BoundingBox box = gameObject.GetBoundingBox();
+		// Front
+		glm::vec3 pos0 = position + Util::Translate(rotationMatrix, glm::vec3(box.xLow, 0, box.zLow));
+		glm::vec3 pos1 = position + Util::Translate(rotationMatrix, glm::vec3(box.xHigh, 0, box.zLow));
+		// Back
+		glm::vec3 pos2 = position + Util::Translate(rotationMatrix, glm::vec3(box.xLow, 0, box.zHigh));
+		glm::vec3 pos3 = position + Util::Translate(rotationMatrix, glm::vec3(box.xHigh, 0, box.zHigh));
+		lines.insert(lines.end(), { pos0, pos1, pos2, pos3, pos0, pos2, pos1, pos3 });
+	}
+}
 
-		if (gameObject.GetName() == "Door") {
-			glm::mat4 rotationMatrix = gameObject.GetRotationMatrix();
-			const float doorWidth = -0.794f;
-			const float doorDepth = -0.0379f;
-			// Front
-			glm::vec3 pos0 = gameObject.GetPosition();
-			glm::vec3 pos1 = gameObject.GetPosition() + Util::Translate(rotationMatrix, glm::vec3(0.0, 0, doorWidth));
-			// Back
-			glm::vec3 pos2 = gameObject.GetPosition() + Util::Translate(rotationMatrix, glm::vec3(doorDepth, 0, 0));
-			glm::vec3 pos3 = gameObject.GetPosition() + Util::Translate(rotationMatrix, glm::vec3(doorDepth, 0, doorWidth));
-			vertices.push_back(Vertex(pos0));
-			vertices.push_back(Vertex(pos1));
-			vertices.push_back(Vertex(pos2));
-			vertices.push_back(Vertex(pos3));
-			vertices.push_back(Vertex(pos0));
-			vertices.push_back(Vertex(pos2));
-			vertices.push_back(Vertex(pos1));
-			vertices.push_back(Vertex(pos3));
+// Walls go in once per Init(), game objects only when their transform, bounds or collision flag changed since last frame
+void Scene::UpdateCollisionWorld() {
+	if (_collisionWorldDirty) {
+		CollisionWorld::Clear();
+		_gameObjectColliders.clear();
+		for (Wall& wall : _walls) {
+			if (wall._begin.y < 1) {
+				CollisionWorld::AddStaticSegment(wall._begin, wall._end);
+			}
 		}
+		_collisionWorldDirty = false;
+	}
 
-		else if (gameObject.GetName() == "DoorFrame") {
-			glm::mat4 rotationMatrix = gameObject.GetRotationMatrix();
-			// Front
-			glm::vec3 pos0 = gameObject.GetPosition() +Util::Translate(rotationMatrix, glm::vec3(-0.05, 0, -0.45));
-			glm::vec3 pos1 = gameObject.GetPosition() + Util::Translate(rotationMatrix, glm::vec3(0.05, 0, -0.45));
-			// Back
-			glm::vec3 pos2 = gameObject.GetPosition() + Util::Translate(rotationMatrix, glm::vec3(-0.05, 0, +0.45));
-			glm::vec3 pos3 = gameObject.GetPosition() + Util::Translate(rotationMatrix, glm::vec3(0.05, 0, +0.45));
-			vertices.push_back(Vertex(pos0));
-			vertices.push_back(Vertex(pos1));
-			vertices.push_back(Vertex(pos2));
-			vertices.push_back(Vertex(pos3));
+	FrameVector<glm::vec3> lines;
+	for (size_t i = 0; i < _gameObjects.size(); i++) {
+		GameObject& gameObject = _gameObjects[i];
+		if (i == _gameObjectColliders.size()) {
+			// Objects never change what they are, so the name is only looked at the first time
+			GameObjectCollider& collider = _gameObjectColliders.emplace_back();
+			collider.shapeIndex = CollisionWorld::CreateDynamicShape();
+			if (gameObject.GetName() == "Door") {
+				collider.type = ColliderType::DOOR;
+			}
+			else if (gameObject.GetName() == "DoorFrame") {
+				collider.type = ColliderType::DOOR_FRAME;
+			}
+			else {
+				collider.type = ColliderType::BOUNDING_BOX;
+			}
 		}
-
-		else if (gameObject.HasCollisionsEnabled()) {
-			glm::mat4 rotationMatrix = gameObject.GetRotationMatrix();
-			BoundingBox box = gameObject.GetBoundingBox();
-			// Front
-			glm::vec3 pos0 = gameObject.GetPosition() + Util::Translate(rotationMatrix, glm::vec3(box.xLow, 0, box.zLow));
-			glm::vec3 pos1 = gameObject.GetPosition() + Util::Translate(rotationMatrix, glm::vec3(box.xHigh, 0, box.zLow));
-			// Back
-			glm::vec3 pos2 = gameObject.GetPosition() + Util::Translate(rotationMatrix, glm::vec3(box.xLow, 0, box.zHigh));
-			glm::vec3 pos3 = gameObject.GetPosition() + Util::Translate(rotationMatrix, glm::vec3(box.xHigh, 0, box.zHigh));
-			vertices.push_back(Vertex(pos0));
-			vertices.push_back(Vertex(pos1));
-			vertices.push_back(Vertex(pos2));
-			vertices.push_back(Vertex(pos3));
-			vertices.push_back(Vertex(pos0));
-			vertices.push_back(Vertex(pos2));
-			vertices.push_back(Vertex(pos1));
-			vertices.push_back(Vertex(pos3));
+		GameObjectCollider& collider = _gameObjectColliders[i];
+		glm::vec3 position = gameObject.GetPosition();
+		glm::vec3 rotation = glm::vec3(gameObject.GetRotationX(), gameObject.GetRotationY(), gameObject.GetRotationZ());
+		BoundingBox box = gameObject.GetBoundingBox();
+		bool collisionEnabled = gameObject.HasCollisionsEnabled();
+		if (collider.inserted && collider.position == position && collider.rotation == rotation && collider.collisionEnabled == collisionEnabled &&
+			collider.box.xLow == box.xLow && collider.box.xHigh == box.xHigh && collider.box.zLow == box.zLow && collider.box.zHigh == box.zHigh) {
+			continue;
 		}
+		collider.position = position;
+		collider.rotation = rotation;
+		collider.box = box;
+		collider.collisionEnabled = collisionEnabled;
+		collider.inserted = true;
+		lines.clear();
+		GetGameObjectCollisionLines(gameObject, collider.type, lines);
+		CollisionWorld::SetDynamicShape(collider.shapeIndex, lines);
 	}
-	return vertices;
 }
 
 void Scene::SetLightState(int index, Light::State state)
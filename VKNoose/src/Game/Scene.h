@@ -2,6 +2,8 @@
 #include "GameObject.h"
 #include "../Common.h"
 #include "API/Vulkan/vk_types.h"
+#include "Bvh/Cpu/CpuBvh.h"
+#include "Hell/Core/FrameArena.h"
 
 struct RenderItem {
 	uint64_t _deviceAddress;
@@ -33,27 +35,54 @@ namespace Scene {
 	void Update(float deltaTime);
 	std::vector<GameObject>& GetGameObjects();
 	//std::vector<RenderItem> GetRenderItems(bool debugScene);
-	std::vector<MeshInstance> GetSceneMeshInstances(bool debugScene);
-	std::vector<MeshInstance> GetInventoryMeshInstances(bool debugScene);
+	const std::vector<MeshInstance>& GetSceneMeshInstances(bool debugScene);
+	FrameVector<MeshInstance> GetInventoryMeshInstances(bool debugScene);
 
 	void UpdateInventoryScene(float deltaTime);
-	std::vector<VkAccelerationStructureInstanceKHR> GetMeshInstancesForSceneAccelerationStructure();
-	std::vector<VkAccelerationStructureInstanceKHR> GetMeshInstancesForInventoryAccelerationStructure();
+	FrameVector<VkAccelerationStructureInstanceKHR> GetMeshInstancesForSceneAccelerationStructure();
+	FrameVector<VkAccelerationStructureInstanceKHR> GetMeshInstancesForInventoryAccelerationStructure();
 	std::vector<MeshOLD*> GetSceneMeshes(bool debugScene);
 
+	// CPU ray queries against the scene as of the last UpdateSceneBvh(), no GPU round trip
+	void UpdateSceneBvh();
+	void UpdateMousePick();
+	Bvh::Cpu::RayHitInfo CastRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+	bool HasLineOfSight(const glm::vec3& from, const glm::vec3& to);
+
 	void StoreMousePickResult(int instanceIndex, int primitiveIndex);
 	GameObject* GetGameObjectByName(std::string);
 	GameObject* GetGameObjectByIndex(int index);
-	std::vector< LightRenderInfo> GetLightRenderInfo();
-	std::vector< LightRenderInfo> GetLightRenderInfoInventory();
+	FrameVector<LightRenderInfo> GetLightRenderInfo();
+	FrameVector<LightRenderInfo> GetLightRenderInfoInventory();
 	int GetGameObjectCount();
-	std::vector<Vertex> GetCollisionLineVertices();
+	// World matrices of _gameObjects, cached in contiguous arrays indexed like it. Only objects whose transform changed,
+	// and their children, are recomputed. The getters bring the cache up to date first if anything moved.
+	void UpdateWorldTransforms();
+	const glm::mat4& GetWorldMatrix(int gameObjectIndex);
+	const VkTransformMatrixKHR& GetWorldVkTransformMatrix(int gameObjectIndex);
+	int GetGameObjectIndex(const GameObject* gameObject);
+
+	// Persistent instance data for the scene buffer: one slot per mesh of every game object, then one per wall, in TLAS order.
+	// A slot is only rewritten when its object moved or changed material, and every rewrite sets its bit in the dirty bits,
+	// which whoever uploads the slots clears once it has them.
+	void UpdateSceneMeshInstances(bool debugScene);
+	const std::vector<MeshInstance>& GetSceneMeshInstanceData();
+	std::vector<uint64_t>& GetSceneMeshInstanceDirtyBits();
+
+	void UpdateCollisionWorld();
+	FrameVector<Vertex> GetCollisionLineVertices();
 	void SetLightState(int index, Light::State state);
 
-	inline uint32_t _instanceIndex = 0;
-	inline uint32_t _primitiveIndex = 0;
+	inline int32_t _instanceIndex = -1;   // -1 when the mouse pick ray missed
+	inline int32_t _primitiveIndex = -1;
 	inline uint32_t _rayhitGameObjectIndex = 0;
 	inline std::vector<Vertex> _hitTriangleVertices;
 	inline std::string _hitModelName;
 	inline GameObject* _hoveredGameObject = nullptr;
+	inline uint64_t _sceneBvhId = 0;
+	inline bool _worldTransformsOutOfDate = true;
+	inline bool _transformHierarchyChanged = true;
+	inline bool _meshInstancesOutOfDate = true;
+	inline bool _meshInstanceLayoutChanged = true;
+	inline bool _sceneBvhOutOfDate = true;       // A world matrix or the instance layout changed since the last UpdateSceneBvh()
 }
@@ -8,3 +8,9 @@ constexpr unsigned int FRAME_OVERLAP = 2;
 #define LAPTOP_DISPLAY_WIDTH 640
 #define LAPTOP_DISPLAY_HEIGHT 430
 
+// Path tracer output formats, see VulkanRenderer::CreateRenderTargets()
+#define RT_PACKING_FULL         0   // RGBA32F for every target
+#define RT_PACKING_RGBA16F      1   // RGBA16F radiance, octahedral RG16 snorm normals, sRGB encoded RGBA8 base color
+#define RT_PACKING_R11G11B10    2   // Same, with R11G11B10 radiance
+#define RT_TARGET_PACKING RT_PACKING_RGBA16F
+
@@ -0,0 +1,116 @@
+#include "FrameArena.h"
+#include "Hell/Constants.h"
+#include "Logging.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    struct Block {
+        uint8_t* data = nullptr;
+        size_t capacity = 0;
+        size_t used = 0;
+    };
+
+    struct Arena {
+        std::vector<Block> blocks;
+    };
+
+    Arena g_arenas[FRAME_OVERLAP];
+    uint32_t g_currentArena = 0;
+    size_t g_bytesPerFrame = 4 * 1024 * 1024;
+
+    Block CreateBlock(size_t capacity) {
+        Block block;
+        block.data = static_cast<uint8_t*>(std::malloc(capacity));
+        block.capacity = block.data ? capacity : 0;
+        return block;
+    }
+
+    void FreeBlocks(Arena& arena) {
+        for (Block& block : arena.blocks) {
+            std::free(block.data);
+        }
+        arena.blocks.clear();
+    }
+
+    void* AllocateFromBlock(Block& block, size_t size, size_t alignment) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+        uintptr_t address = (base + block.used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        if (address + size > base + block.capacity) {
+            return nullptr;
+        }
+        block.used = address + size - base;
+        return reinterpret_cast<void*>(address);
+    }
+}
+
+namespace FrameArena {
+    void Init(size_t bytesPerFrame) {
+        Cleanup();
+        g_bytesPerFrame = bytesPerFrame;
+        for (Arena& arena : g_arenas) {
+            arena.blocks.reserve(8);
+            arena.blocks.push_back(CreateBlock(g_bytesPerFrame));
+        }
+        g_currentArena = 0;
+    }
+
+    void Cleanup() {
+        for (Arena& arena : g_arenas) {
+            FreeBlocks(arena);
+        }
+    }
+
+    void Reset(uint32_t frameIndex) {
+        g_currentArena = frameIndex % FRAME_OVERLAP;
+        Arena& arena = g_arenas[g_currentArena];
+
+        // Last time round this arena overflowed, replace the chain with one block big enough for all of it
+        if (arena.blocks.size() > 1) {
+            size_t capacity = 0;
+            for (const Block& block : arena.blocks) {
+                capacity += block.capacity;
+            }
+            FreeBlocks(arena);
+            arena.blocks.push_back(CreateBlock(capacity));
+        }
+        for (Block& block : arena.blocks) {
+            block.used = 0;
+        }
+    }
+
+    void* Allocate(size_t size, size_t alignment) {
+        Arena& arena = g_arenas[g_currentArena];
+        if (!arena.blocks.empty()) {
+            if (void* memory = AllocateFromBlock(arena.blocks.back(), size, alignment)) {
+                return memory;
+            }
+        }
+        size_t previousCapacity = arena.blocks.empty() ? g_bytesPerFrame : arena.blocks.back().capacity;
+        arena.blocks.push_back(CreateBlock(std::max(previousCapacity, size + alignment)));
+        Logging::Warning() << "FrameArena: frame arena " << g_currentArena << " overflowed, chained another " << arena.blocks.back().capacity << " bytes";
+
+        void* memory = AllocateFromBlock(arena.blocks.back(), size, alignment);
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+
+    size_t GetBytesUsed() {
+        size_t bytesUsed = 0;
+        for (const Block& block : g_arenas[g_currentArena].blocks) {
+            bytesUsed += block.used;
+        }
+        return bytesUsed;
+    }
+
+    size_t GetCapacity() {
+        size_t capacity = 0;
+        for (const Block& block : g_arenas[g_currentArena].blocks) {
+            capacity += block.capacity;
+        }
+        return capacity;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bump allocator for data that only has to live for the frame it was made in. There is one arena per frame in flight,
+// VulkanRenderer::IncrementFrame() resets the one the next frame will use, so anything allocated here is still valid
+// until the frame after next starts. Deallocation is a no-op. Main thread only.
+//
+// An arena that runs out chains another block, then grows to the total on its next reset, so once the high water mark
+// is reached a frame allocates nothing from the heap at all.
+namespace FrameArena {
+    void Init(size_t bytesPerFrame);
+    void Cleanup();
+    void Reset(uint32_t frameIndex);
+    void* Allocate(size_t size, size_t alignment);
+    size_t GetBytesUsed();
+    size_t GetCapacity();
+}
+
+template<typename T>
+struct FrameAllocator {
+    using value_type = T;
+
+    FrameAllocator() = default;
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(FrameArena::Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const FrameAllocator<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const FrameAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+using FrameString = std::basic_string<char, std::char_traits<char>, FrameAllocator<char>>;
\ No newline at end of file
@@ -0,0 +1,532 @@
+#include "HeapProfiler.h"
+#include "Logging.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <Windows.h>
+    #include <DbgHelp.h>
+    #include <malloc.h>
+    #pragma comment(lib, "dbghelp.lib")
+#else
+    #include <execinfo.h>
+#endif
+
+namespace {
+    constexpr uint32_t MAX_THREADS = 64;            // Threads past this share the last slot
+    constexpr uint32_t MAX_SCOPES = 128;
+    constexpr uint32_t MAX_SCOPE_DEPTH = 64;
+    constexpr uint32_t MAX_CALL_SITES = 1024;
+    constexpr uint32_t MAX_CALL_STACK_DEPTH = 16;
+    constexpr uint32_t MAX_FRAME_HISTORY = 1 << 16;
+    constexpr const char* NO_SCOPE = "(no scope)";
+
+    struct ScopeCounter {
+        std::atomic<const char*> name { nullptr };
+        std::atomic<uint64_t> allocations { 0 };
+        std::atomic<uint64_t> bytes { 0 };
+    };
+
+    // Running totals for one thread, only ever written by that thread unless it overflowed into the shared last slot
+    struct ThreadCounters {
+        std::atomic<uint64_t> allocations { 0 };
+        std::atomic<uint64_t> bytes { 0 };
+        std::atomic<uint64_t> frees { 0 };
+        ScopeCounter scopes[MAX_SCOPES];
+    };
+
+    struct CallSite {
+        uint64_t hash = 0;
+        void* frames[MAX_CALL_STACK_DEPTH] = {};
+        uint32_t frameCount = 0;
+        const char* scope = nullptr;
+        uint64_t sampledAllocations = 0;
+        uint64_t sampledBytes = 0;
+    };
+
+    // Merged across threads on the main thread in EndFrame()
+    struct ScopeSummary {
+        const char* name = nullptr;
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+        uint64_t frameAllocations = 0;
+        uint64_t frameBytes = 0;
+        uint64_t peakFrameAllocations = 0;
+        uint64_t peakFrameBytes = 0;
+    };
+
+    std::atomic<bool> g_enabled { false };
+    std::atomic<uint32_t> g_callSiteSampleRate { 0 };
+    std::atomic<uint32_t> g_threadCount { 0 };
+    ThreadCounters g_threadCounters[MAX_THREADS];
+
+    std::atomic_flag g_callSiteLock = ATOMIC_FLAG_INIT;
+    CallSite g_callSites[MAX_CALL_SITES];
+    uint32_t g_callSiteCount = 0;
+    uint64_t g_droppedCallSiteSamples = 0;
+
+    ScopeSummary g_scopeSummaries[MAX_SCOPES];
+    uint32_t g_scopeSummaryCount = 0;
+    HeapProfiler::FrameTotals g_previousTotals;
+    HeapProfiler::FrameTotals g_lastFrameTotals;
+    HeapProfiler::FrameTotals g_peakFrameTotals;
+    HeapProfiler::FrameTotals g_summedFrameTotals;
+    uint64_t g_frameCount = 0;
+    std::vector<HeapProfiler::FrameTotals> g_frameHistory;  // Reserved by Enable(), never grows past that
+
+    // Trivially constructible so touching them from operator new never allocates
+    thread_local ThreadCounters* t_counters = nullptr;
+    thread_local const char* t_scopeStack[MAX_SCOPE_DEPTH];
+    thread_local uint32_t t_scopeDepth = 0;
+    thread_local uint32_t t_allocationsSinceSample = 0;
+    thread_local bool t_insideHook = false;
+}
+
+namespace HeapProfiler {
+    ThreadCounters& GetThreadCounters() {
+        if (!t_counters) {
+            uint32_t threadIndex = g_threadCount.fetch_add(1, std::memory_order_relaxed);
+            t_counters = &g_threadCounters[std::min(threadIndex, MAX_THREADS - 1)];
+        }
+        return *t_counters;
+    }
+
+    ScopeCounter* FindScopeCounter(ThreadCounters& counters, const char* name) {
+        uint32_t start = (uint32_t)(((uintptr_t)name >> 3) % MAX_SCOPES);
+        for (uint32_t probe = 0; probe < MAX_SCOPES; probe++) {
+            ScopeCounter& scope = counters.scopes[(start + probe) % MAX_SCOPES];
+            const char* current = scope.name.load(std::memory_order_acquire);
+            if (current == nullptr && scope.name.compare_exchange_strong(current, name, std::memory_order_acq_rel)) {
+                return &scope;
+            }
+            if (current == name) {
+                return &scope;
+            }
+        }
+        return nullptr;
+    }
+
+    const char* GetActiveScope() {
+        if (t_scopeDepth == 0) {
+            return NO_SCOPE;
+        }
+        return t_scopeStack[std::min(t_scopeDepth, MAX_SCOPE_DEPTH) - 1];
+    }
+
+    uint32_t CaptureCallStack(void** frames) {
+#if defined(_WIN32)
+        return CaptureStackBackTrace(1, MAX_CALL_STACK_DEPTH, frames, nullptr);
+#else
+        return (uint32_t)backtrace(frames, MAX_CALL_STACK_DEPTH);
+#endif
+    }
+
+    void RecordCallSite(const char* scope, size_t size) {
+        CallSite sample;
+        sample.frameCount = CaptureCallStack(sample.frames);
+        sample.hash = 14695981039346656037ull;
+        for (uint32_t i = 0; i < sample.frameCount; i++) {
+            sample.hash = (sample.hash ^ (uint64_t)(uintptr_t)sample.frames[i]) * 1099511628211ull;
+        }
+
+        while (g_callSiteLock.test_and_set(std::memory_order_acquire)) {}
+        uint32_t start = (uint32_t)(sample.hash % MAX_CALL_SITES);
+        CallSite* callSite = nullptr;
+        for (uint32_t probe = 0; probe < MAX_CALL_SITES; probe++) {
+            CallSite& candidate = g_callSites[(start + probe) % MAX_CALL_SITES];
+            if (candidate.frameCount == 0) {
+                candidate = sample;
+                g_callSiteCount++;
+                callSite = &candidate;
+                break;
+            }
+            if (candidate.hash == sample.hash && candidate.scope == scope) {
+                callSite = &candidate;
+                break;
+            }
+        }
+        if (callSite) {
+            callSite->scope = scope;
+            callSite->sampledAllocations++;
+            callSite->sampledBytes += size;
+        }
+        else {
+            g_droppedCallSiteSamples++;
+        }
+        g_callSiteLock.clear(std::memory_order_release);
+    }
+
+    void RecordAllocation(size_t size) {
+        if (t_insideHook) {
+            return;
+        }
+        t_insideHook = true;
+        ThreadCounters& counters = GetThreadCounters();
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        counters.bytes.fetch_add(size, std::memory_order_relaxed);
+
+        const char* scope = GetActiveScope();
+        if (ScopeCounter* scopeCounter = FindScopeCounter(counters, scope)) {
+            scopeCounter->allocations.fetch_add(1, std::memory_order_relaxed);
+            scopeCounter->bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+
+        uint32_t sampleRate = g_callSiteSampleRate.load(std::memory_order_relaxed);
+        if (sampleRate && ++t_allocationsSinceSample >= sampleRate) {
+            t_allocationsSinceSample = 0;
+            RecordCallSite(scope, size);
+        }
+        t_insideHook = false;
+    }
+
+    void RecordFree() {
+        if (t_insideHook) {
+            return;
+        }
+        GetThreadCounters().frees.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void* Allocate(size_t size) {
+        void* memory = std::malloc(size ? size : 1);
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+        if (g_enabled.load(std::memory_order_relaxed)) {
+            RecordAllocation(size);
+        }
+        return memory;
+    }
+
+    void* AllocateAligned(size_t size, size_t alignment) {
+#if defined(_WIN32)
+        void* memory = _aligned_malloc(size ? size : 1, alignment);
+#else
+        void* memory = std::aligned_alloc(alignment, (std::max(size, (size_t)1) + alignment - 1) / alignment * alignment);
+#endif
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+        if (g_enabled.load(std::memory_order_relaxed)) {
+            RecordAllocation(size);
+        }
+        return memory;
+    }
+
+    void Free(void* memory) {
+        if (!memory) {
+            return;
+        }
+        if (g_enabled.load(std::memory_order_relaxed)) {
+            RecordFree();
+        }
+        std::free(memory);
+    }
+
+    void FreeAligned(void* memory) {
+        if (!memory) {
+            return;
+        }
+        if (g_enabled.load(std::memory_order_relaxed)) {
+            RecordFree();
+        }
+#if defined(_WIN32)
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+
+    void Enable(uint32_t callSiteSampleRate) {
+        g_frameHistory.reserve(MAX_FRAME_HISTORY);
+        g_callSiteSampleRate.store(callSiteSampleRate, std::memory_order_relaxed);
+        g_enabled.store(true, std::memory_order_relaxed);
+    }
+
+    void Disable() {
+        g_enabled.store(false, std::memory_order_relaxed);
+    }
+
+    bool IsEnabled() {
+        return g_enabled.load(std::memory_order_relaxed);
+    }
+
+    void PushScope(const char* name) {
+        if (t_scopeDepth < MAX_SCOPE_DEPTH) {
+            t_scopeStack[t_scopeDepth] = name;
+        }
+        t_scopeDepth++;
+    }
+
+    void PopScope() {
+        if (t_scopeDepth > 0) {
+            t_scopeDepth--;
+        }
+    }
+
+    ScopeSummary* FindScopeSummary(const char* name) {
+        for (uint32_t i = 0; i < g_scopeSummaryCount; i++) {
+            if (g_scopeSummaries[i].name == name || std::strcmp(g_scopeSummaries[i].name, name) == 0) {
+                return &g_scopeSummaries[i];
+            }
+        }
+        if (g_scopeSummaryCount == MAX_SCOPES) {
+            return nullptr;
+        }
+        ScopeSummary& summary = g_scopeSummaries[g_scopeSummaryCount++];
+        summary.name = name;
+        return &summary;
+    }
+
+    void EndFrame() {
+        if (!IsEnabled()) {
+            return;
+        }
+        // Counts are cumulative, a frame is the difference from the last time round. Nothing here may allocate.
+        FrameTotals totals;
+        uint64_t scopeAllocations[MAX_SCOPES] = {};
+        uint64_t scopeBytes[MAX_SCOPES] = {};
+        uint32_t threadCount = std::min(g_threadCount.load(std::memory_order_relaxed), MAX_THREADS);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            ThreadCounters& counters = g_threadCounters[i];
+            totals.allocations += counters.allocations.load(std::memory_order_relaxed);
+            totals.bytes += counters.bytes.load(std::memory_order_relaxed);
+            totals.frees += counters.frees.load(std::memory_order_relaxed);
+            for (ScopeCounter& scope : counters.scopes) {
+                const char* name = scope.name.load(std::memory_order_acquire);
+                if (!name) {
+                    continue;
+                }
+                if (ScopeSummary* summary = FindScopeSummary(name)) {
+                    uint32_t summaryIndex = (uint32_t)(summary - g_scopeSummaries);
+                    scopeAllocations[summaryIndex] += scope.allocations.load(std::memory_order_relaxed);
+                    scopeBytes[summaryIndex] += scope.bytes.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        g_lastFrameTotals.allocations = totals.allocations - g_previousTotals.allocations;
+        g_lastFrameTotals.bytes = totals.bytes - g_previousTotals.bytes;
+        g_lastFrameTotals.frees = totals.frees - g_previousTotals.frees;
+        g_previousTotals = totals;
+
+        g_peakFrameTotals.allocations = std::max(g_peakFrameTotals.allocations, g_lastFrameTotals.allocations);
+        g_peakFrameTotals.bytes = std::max(g_peakFrameTotals.bytes, g_lastFrameTotals.bytes);
+        g_peakFrameTotals.frees = std::max(g_peakFrameTotals.frees, g_lastFrameTotals.frees);
+        g_summedFrameTotals.allocations += g_lastFrameTotals.allocations;
+        g_summedFrameTotals.bytes += g_lastFrameTotals.bytes;
+        g_summedFrameTotals.frees += g_lastFrameTotals.frees;
+        g_frameCount++;
+        if (g_frameHistory.size() < g_frameHistory.capacity()) {
+            g_frameHistory.push_back(g_lastFrameTotals);
+        }
+
+        for (uint32_t i = 0; i < g_scopeSummaryCount; i++) {
+            ScopeSummary& summary = g_scopeSummaries[i];
+            summary.frameAllocations = scopeAllocations[i] - summary.allocations;
+            summary.frameBytes = scopeBytes[i] - summary.bytes;
+            summary.allocations = scopeAllocations[i];
+            summary.bytes = scopeBytes[i];
+            summary.peakFrameAllocations = std::max(summary.peakFrameAllocations, summary.frameAllocations);
+            summary.peakFrameBytes = std::max(summary.peakFrameBytes, summary.frameBytes);
+        }
+    }
+
+    FrameTotals GetLastFrameTotals() {
+        return g_lastFrameTotals;
+    }
+
+    FrameTotals GetAverageFrameTotals() {
+        FrameTotals average;
+        if (g_frameCount > 0) {
+            average.allocations = g_summedFrameTotals.allocations / g_frameCount;
+            average.bytes = g_summedFrameTotals.bytes / g_frameCount;
+            average.frees = g_summedFrameTotals.frees / g_frameCount;
+        }
+        return average;
+    }
+
+    FrameTotals GetPeakFrameTotals() {
+        return g_peakFrameTotals;
+    }
+
+    std::string ToKilobytes(uint64_t bytes) {
+        return std::to_string((bytes + 1023) / 1024) + "KB";
+    }
+
+    std::vector<std::string> GetStatisticsText() {
+        std::vector<std::string> lines;
+        if (!IsEnabled()) {
+            lines.push_back("Heap profiler off, run with --heap-profile <path>");
+            return lines;
+        }
+        lines.push_back("Heap last frame: " + std::to_string(g_lastFrameTotals.allocations) + " allocs, " + ToKilobytes(g_lastFrameTotals.bytes) + ", " + std::to_string(g_lastFrameTotals.frees) + " frees");
+        lines.push_back("Heap peak frame: " + std::to_string(g_peakFrameTotals.allocations) + " allocs, " + ToKilobytes(g_peakFrameTotals.bytes));
+
+        uint32_t order[MAX_SCOPES];
+        for (uint32_t i = 0; i < g_scopeSummaryCount; i++) {
+            order[i] = i;
+        }
+        std::sort(order, order + g_scopeSummaryCount, [](uint32_t a, uint32_t b) {
+            return g_scopeSummaries[a].frameAllocations > g_scopeSummaries[b].frameAllocations;
+        });
+        for (uint32_t i = 0; i < std::min(g_scopeSummaryCount, 8u); i++) {
+            const ScopeSummary& summary = g_scopeSummaries[order[i]];
+            if (summary.frameAllocations == 0) {
+                break;
+            }
+            lines.push_back("  " + std::string(summary.name) + ": " + std::to_string(summary.frameAllocations) + " allocs, " + ToKilobytes(summary.frameBytes));
+        }
+
+        uint32_t sampleRate = g_callSiteSampleRate.load(std::memory_order_relaxed);
+        if (sampleRate) {
+            lines.push_back("Call sites: " + std::to_string(g_callSiteCount) + ", sampling 1 in " + std::to_string(sampleRate));
+        }
+        return lines;
+    }
+
+    // Symbol names of a captured stack, minus the frames inside this file
+    std::vector<std::string> DescribeCallStack(void* const* frames, uint32_t frameCount) {
+        std::vector<std::string> descriptions;
+#if defined(_WIN32)
+        HANDLE process = GetCurrentProcess();
+        for (uint32_t i = 0; i < frameCount; i++) {
+            DWORD64 address = (DWORD64)(uintptr_t)frames[i];
+            char symbolBuffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME] = {};
+            SYMBOL_INFO* symbol = (SYMBOL_INFO*)symbolBuffer;
+            symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+            symbol->MaxNameLen = MAX_SYM_NAME;
+            DWORD64 displacement = 0;
+            std::string description;
+            if (SymFromAddr(process, address, &displacement, symbol)) {
+                description = symbol->Name;
+            }
+            else {
+                char hex[32];
+                snprintf(hex, sizeof(hex), "0x%llx", (unsigned long long)address);
+                description = hex;
+            }
+            IMAGEHLP_LINE64 line = {};
+            line.SizeOfStruct = sizeof(IMAGEHLP_LINE64);
+            DWORD lineDisplacement = 0;
+            if (SymGetLineFromAddr64(process, address, &lineDisplacement, &line)) {
+                description += " " + std::string(line.FileName) + ":" + std::to_string(line.LineNumber);
+            }
+            descriptions.push_back(description);
+        }
+#else
+        char** symbols = backtrace_symbols(frames, (int)frameCount);
+        for (uint32_t i = 0; symbols && i < frameCount; i++) {
+            descriptions.push_back(symbols[i]);
+        }
+        std::free(symbols);
+#endif
+        // Inlining decides how many of our own frames are on top, so cut after the last one by name rather than by count
+        auto lastInternal = std::find_if(descriptions.rbegin(), descriptions.rend(), [](const std::string& description) {
+            return description.find("HeapProfiler") != std::string::npos || description.find("operator new") != std::string::npos ||
+                description.find("_Znw") != std::string::npos || description.find("_Zna") != std::string::npos;
+        });
+        descriptions.erase(descriptions.begin(), lastInternal.base());
+        return descriptions;
+    }
+
+    bool DumpToJson(const std::string& path) {
+        // Keep the dump's own allocations out of the counts
+        t_insideHook = true;
+
+        nlohmann::json json;
+        json["frames"] = g_frameCount;
+        json["callSiteSampleRate"] = g_callSiteSampleRate.load(std::memory_order_relaxed);
+        FrameTotals average = GetAverageFrameTotals();
+        json["perFrame"]["average"] = { { "allocations", average.allocations }, { "bytes", average.bytes }, { "frees", average.frees } };
+        json["perFrame"]["peak"] = { { "allocations", g_peakFrameTotals.allocations }, { "bytes", g_peakFrameTotals.bytes }, { "frees", g_peakFrameTotals.frees } };
+
+        nlohmann::json& history = json["frameHistory"] = nlohmann::json::array();
+        for (const FrameTotals& frame : g_frameHistory) {
+            history.push_back({ frame.allocations, frame.bytes, frame.frees });
+        }
+
+        nlohmann::json& scopes = json["scopes"] = nlohmann::json::array();
+        for (uint32_t i = 0; i < g_scopeSummaryCount; i++) {
+            const ScopeSummary& summary = g_scopeSummaries[i];
+            scopes.push_back({
+                { "name", summary.name },
+                { "allocations", summary.allocations },
+                { "bytes", summary.bytes },
+                { "peakFrameAllocations", summary.peakFrameAllocations },
+                { "peakFrameBytes", summary.peakFrameBytes }
+            });
+        }
+
+        while (g_callSiteLock.test_and_set(std::memory_order_acquire)) {}
+        std::vector<const CallSite*> callSites;
+        for (const CallSite& callSite : g_callSites) {
+            if (callSite.frameCount) {
+                callSites.push_back(&callSite);
+            }
+        }
+        std::sort(callSites.begin(), callSites.end(), [](const CallSite* a, const CallSite* b) {
+            return a->sampledAllocations > b->sampledAllocations;
+        });
+#if defined(_WIN32)
+        SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES);
+        SymInitialize(GetCurrentProcess(), nullptr, TRUE);
+#endif
+        nlohmann::json& callSitesJson = json["callSites"] = nlohmann::json::array();
+        for (const CallSite* callSite : callSites) {
+            callSitesJson.push_back({
+                { "scope", callSite->scope },
+                { "sampledAllocations", callSite->sampledAllocations },
+                { "sampledBytes", callSite->sampledBytes },
+                { "stack", DescribeCallStack(callSite->frames, callSite->frameCount) }
+            });
+        }
+#if defined(_WIN32)
+        SymCleanup(GetCurrentProcess());
+#endif
+        json["droppedCallSiteSamples"] = g_droppedCallSiteSamples;
+        g_callSiteLock.clear(std::memory_order_release);
+
+        std::ofstream file(path);
+        bool written = false;
+        if (file) {
+            file << json.dump(2);
+            written = file.good();
+        }
+        if (!written) {
+            Logging::Error() << "HeapProfiler::DumpToJson() failed to write " << path << "\n";
+        }
+        t_insideHook = false;
+        return written;
+    }
+}
+
+// Everything the program news goes through here, counted only while the profiler is enabled
+void* operator new(size_t size) { return HeapProfiler::Allocate(size); }
+void* operator new[](size_t size) { return HeapProfiler::Allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { try { return HeapProfiler::Allocate(size); } catch (...) { return nullptr; } }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { try { return HeapProfiler::Allocate(size); } catch (...) { return nullptr; } }
+void* operator new(size_t size, std::align_val_t alignment) { return HeapProfiler::AllocateAligned(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return HeapProfiler::AllocateAligned(size, (size_t)alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { try { return HeapProfiler::AllocateAligned(size, (size_t)alignment); } catch (...) { return nullptr; } }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { try { return HeapProfiler::AllocateAligned(size, (size_t)alignment); } catch (...) { return nullptr; } }
+
+void operator delete(void* memory) noexcept { HeapProfiler::Free(memory); }
+void operator delete[](void* memory) noexcept { HeapProfiler::Free(memory); }
+void operator delete(void* memory, size_t) noexcept { HeapProfiler::Free(memory); }
+void operator delete[](void* memory, size_t) noexcept { HeapProfiler::Free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { HeapProfiler::Free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { HeapProfiler::Free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { HeapProfiler::FreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { HeapProfiler::FreeAligned(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { HeapProfiler::FreeAligned(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { HeapProfiler::FreeAligned(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { HeapProfiler::FreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { HeapProfiler::FreeAligned(memory); }
\ No newline at end of file
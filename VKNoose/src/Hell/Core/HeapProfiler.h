@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Opt-in heap instrumentation. HeapProfiler.cpp replaces global operator new/delete, while disabled they cost a flag check
+// on top of malloc. Once enabled every thread counts its own allocations, attributed to the innermost Profiler scope open
+// on that thread, and every nth allocation can record its call stack. Call EndFrame() once a frame on the main thread
+// to turn the running counts into per frame totals.
+namespace HeapProfiler {
+    struct FrameTotals {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+        uint64_t frees = 0;
+    };
+
+    // A callSiteSampleRate of n captures the call stack of every nth allocation on each thread, 0 captures none
+    void Enable(uint32_t callSiteSampleRate = 0);
+    void Disable();
+    bool IsEnabled();
+
+    // Called by Profiler, names are expected to outlive the profiler (string literals)
+    void PushScope(const char* name);
+    void PopScope();
+
+    void EndFrame();
+    FrameTotals GetLastFrameTotals();
+    FrameTotals GetAverageFrameTotals();
+    FrameTotals GetPeakFrameTotals();
+    std::vector<std::string> GetStatisticsText();
+    bool DumpToJson(const std::string& path);
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr uint32_t MAX_QUEUED_JOBS = 64;
+
+    std::vector<std::thread> g_workers;
+    std::mutex g_queueMutex;
+    std::condition_variable g_queueCondition;
+    JobSystem::Job* g_queue[MAX_QUEUED_JOBS] = {};
+    uint32_t g_queueHead = 0;
+    uint32_t g_queueCount = 0;
+    bool g_shutdown = false;
+
+    // Whoever moves the job from queued to running owns it, the loser skips it
+    bool TryRun(JobSystem::Job& job, uint32_t expectedState) {
+        if (!job.state.compare_exchange_strong(expectedState, JobSystem::JOB_RUNNING)) {
+            return false;
+        }
+        job.function(job.userData);
+        job.state.store(JobSystem::JOB_DONE);
+        job.state.notify_all();
+        return true;
+    }
+
+    // A job stolen by Wait() leaves its entry behind, drop it so stale entries can't fill the queue
+    void RemoveFromQueue(JobSystem::Job& job) {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < g_queueCount; i++) {
+            JobSystem::Job* queued = g_queue[(g_queueHead + i) % MAX_QUEUED_JOBS];
+            if (queued != &job) {
+                g_queue[(g_queueHead + kept) % MAX_QUEUED_JOBS] = queued;
+                kept++;
+            }
+        }
+        g_queueCount = kept;
+    }
+
+    void WorkerLoop() {
+        Profiler::SetThreadName("Job Worker");
+        while (true) {
+            JobSystem::Job* job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(g_queueMutex);
+                g_queueCondition.wait(lock, [] { return g_shutdown || g_queueCount > 0; });
+                if (g_queueCount == 0) return;
+                job = g_queue[g_queueHead];
+                g_queueHead = (g_queueHead + 1) % MAX_QUEUED_JOBS;
+                g_queueCount--;
+            }
+            TryRun(*job, JobSystem::JOB_QUEUED);
+        }
+    }
+}
+
+namespace JobSystem {
+    void Init(uint32_t workerCount) {
+        Cleanup();
+        g_shutdown = false;
+        g_workers.reserve(workerCount);
+        for (uint32_t i = 0; i < workerCount; i++) {
+            g_workers.emplace_back(WorkerLoop);
+        }
+    }
+
+    void Cleanup() {
+        // Jobs still queued are run by the workers before they exit
+        {
+            std::lock_guard<std::mutex> lock(g_queueMutex);
+            g_shutdown = true;
+        }
+        g_queueCondition.notify_all();
+        for (std::thread& worker : g_workers) {
+            worker.join();
+        }
+        g_workers.clear();
+    }
+
+    void Submit(Job& job, bool async) {
+        if (!async || g_workers.empty()) {
+            job.state.store(JOB_DEFERRED);
+            return;
+        }
+        job.state.store(JOB_QUEUED);
+        {
+            std::lock_guard<std::mutex> lock(g_queueMutex);
+            if (g_queueCount < MAX_QUEUED_JOBS) {
+                g_queue[(g_queueHead + g_queueCount) % MAX_QUEUED_JOBS] = &job;
+                g_queueCount++;
+            }
+            else {
+                job.state.store(JOB_DEFERRED);
+                return;
+            }
+        }
+        g_queueCondition.notify_one();
+    }
+
+    void Wait(Job& job) {
+        if (TryRun(job, JOB_DEFERRED)) {
+            return;
+        }
+        if (TryRun(job, JOB_QUEUED)) {
+            RemoveFromQueue(job);
+            return;
+        }
+        // A worker has it, or it was never submitted
+        uint32_t state = job.state.load();
+        while (state == JOB_RUNNING) {
+            job.state.wait(state);
+            state = job.state.load();
+        }
+    }
+
+    void Reclaim(Job& job) {
+        uint32_t deferred = JOB_DEFERRED;
+        if (job.state.compare_exchange_strong(deferred, JOB_IDLE)) {
+            return;
+        }
+        Wait(job);
+    }
+
+    bool IsPending(const Job& job) {
+        uint32_t state = job.state.load();
+        return state == JOB_DEFERRED || state == JOB_QUEUED || state == JOB_RUNNING;
+    }
+
+    uint32_t GetWorkerCount() {
+        return (uint32_t)g_workers.size();
+    }
+}
\ No newline at end of file
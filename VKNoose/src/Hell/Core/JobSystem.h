@@ -0,0 +1,34 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// A fixed set of worker threads that live for the whole run, for per frame work that used to go through std::async.
+// Jobs are owned by the caller and reused frame after frame, submitting one takes a lock but never allocates.
+// A job that is waited on before a worker has picked it up runs on the waiting thread instead.
+namespace JobSystem {
+    enum JobState : uint32_t {
+        JOB_IDLE = 0,
+        JOB_DEFERRED,   // Runs on whoever calls Wait()
+        JOB_QUEUED,
+        JOB_RUNNING,
+        JOB_DONE
+    };
+
+    struct Job {
+        void (*function)(void* userData) = nullptr;
+        void* userData = nullptr;
+        std::atomic<uint32_t> state = JOB_IDLE;
+    };
+
+    void Init(uint32_t workerCount);
+    void Cleanup();
+
+    // The job must be idle or done. With async false it isn't queued at all and runs inside Wait()
+    void Submit(Job& job, bool async = true);
+    void Wait(Job& job);
+
+    // Call before touching a job's data again. Waits out a queued or running job, a deferred one nobody waited on is dropped
+    void Reclaim(Job& job);
+    bool IsPending(const Job& job);
+    uint32_t GetWorkerCount();
+}
\ No newline at end of file
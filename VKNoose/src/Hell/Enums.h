@@ -8,5 +8,8 @@ enum class ObjectType : uint16_t {
 
     VK_ACCELERATION_STRUCTURE,
     VK_DESCRIPTOR_SET,
-    VK_BUFFER
+    VK_BUFFER,
+
+    CPU_MESH_BVH,
+    CPU_SCENE_BVH
 };
\ No newline at end of file
@@ -23,6 +23,7 @@ void Input::Update() {
 
     glfwPollEvents();
     GLFWwindow* window = VulkanBackEnd::GetWindow();
+    if (!window) return;
 
     // Wheel
     _mouseWheelUp = false;
@@ -131,5 +132,7 @@ void Input::ForceSetStoredMousePosition(int x, int y) {
 void Input::SetMousePos(int x, int y) {
     _mouseX = x;
     _mouseY = y;
-    glfwSetCursorPos(VulkanBackEnd::GetWindow(), x, y);
+    if (GLFWwindow* window = VulkanBackEnd::GetWindow()) {
+        glfwSetCursorPos(window, x, y);
+    }
 }
\ No newline at end of file
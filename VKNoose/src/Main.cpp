@@ -1,15 +1,191 @@
 #include "API/Vulkan/vk_backend.h"
+#include "API/Vulkan/Managers/vk_denoise_manager.h"
 #include "BackEnd/BackEnd.h"
 #include <iostream>
 #define NOMINMAX
 #include "Windows.h"
 #include "AssetManagement/AssetManager.h"
 
+#include "Hell/Core/FrameArena.h"
+#include "Hell/Core/HeapProfiler.h"
+#include "Hell/Core/JobSystem.h"
 #include "Hell/Core/Logging.h"
+#include "Profiler.h"
+#include "Renderer/ReferencePathTracer.h"
+#include "Bvh/Cpu/CpuBvh.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <thread>
 
 void LazyKeyPresses();
 
-int main() {
+// Command line:
+//   --headless             no window or swapchain, for automated perf runs
+//   --frames <n>           exit after n game frames, defaults to 1000 when headless
+//   --dump-frames <dir>    write the Present image to disk
+//   --dump-interval <n>    only dump every nth frame, defaults to 1
+//   --dump-render-graph <path>  write the compiled render graph and last frame's barriers on exit
+//   --reference-capture <path>  save the scene and camera of the first game frame for the CPU path tracer
+//   --reference-render <path>   path trace a captured scene on the CPU and exit, no Vulkan device is created
+//   --reference-output <dir>    where --reference-render writes its images, defaults to "reference"
+//   --bvh-benchmark <path>      time the CPU BVH against a captured scene and exit, no Vulkan device is created
+//   --heap-profile <path>       count heap allocations per game frame and write them to a JSON file on exit
+//   --heap-sample-rate <n>      with --heap-profile, record the call stack of every nth allocation, defaults to 0 (off)
+//   --profile-trace <path>      record every profiler scope from the first game frame on and write a Chrome trace on exit
+//   --profile-trace-gpu         with --profile-trace, add a lane for the GPU timestamp scopes
+//   --profile-window <n>        how many samples the profiler averages over, defaults to 120
+struct LaunchOptions {
+    bool headless = false;
+    uint32_t frameLimit = 0;
+    std::string dumpDirectory = "";
+    uint32_t dumpInterval = 1;
+    std::string renderGraphDumpPath = "";
+    std::string referenceCapturePath = "";
+    std::string referenceRenderPath = "";
+    std::string referenceOutputDirectory = "reference";
+    std::string bvhBenchmarkPath = "";
+    std::string heapProfilePath = "";
+    uint32_t heapSampleRate = 0;
+    std::string profileTracePath = "";
+    bool profileTraceGpu = false;
+    uint32_t profileWindow = PROFILER_SAMPLE_WINDOW;
+};
+
+// Leaves value untouched when the whole string isn't a number that fits
+void ParseUint32(const char* argument, const char* text, uint32_t& value) {
+    uint32_t parsed = 0;
+    const char* end = text + strlen(text);
+    std::from_chars_result result = std::from_chars(text, end, parsed);
+    if (result.ec != std::errc() || result.ptr != end) {
+        std::cout << "Ignoring invalid value '" << text << "' for " << argument << "\n";
+        return;
+    }
+    value = parsed;
+}
+
+LaunchOptions ParseLaunchOptions(int argc, char* argv[]) {
+    LaunchOptions options;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = (i + 1 < argc);
+        if (strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            ParseUint32(argv[i], argv[i + 1], options.frameLimit);
+            i++;
+        }
+        else if (strcmp(argv[i], "--dump-frames") == 0 && hasValue) {
+            options.dumpDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dump-interval") == 0 && hasValue) {
+            ParseUint32(argv[i], argv[i + 1], options.dumpInterval);
+            options.dumpInterval = std::max(1u, options.dumpInterval);
+            i++;
+        }
+        else if (strcmp(argv[i], "--dump-render-graph") == 0 && hasValue) {
+            options.renderGraphDumpPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--reference-capture") == 0 && hasValue) {
+            options.referenceCapturePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--reference-render") == 0 && hasValue) {
+            options.referenceRenderPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--reference-output") == 0 && hasValue) {
+            options.referenceOutputDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--bvh-benchmark") == 0 && hasValue) {
+            options.bvhBenchmarkPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--heap-profile") == 0 && hasValue) {
+            options.heapProfilePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--heap-sample-rate") == 0 && hasValue) {
+            ParseUint32(argv[i], argv[i + 1], options.heapSampleRate);
+            i++;
+        }
+        else if (strcmp(argv[i], "--profile-trace") == 0 && hasValue) {
+            options.profileTracePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile-trace-gpu") == 0) {
+            options.profileTraceGpu = true;
+        }
+        else if (strcmp(argv[i], "--profile-window") == 0 && hasValue) {
+            ParseUint32(argv[i], argv[i + 1], options.profileWindow);
+            i++;
+        }
+        else {
+            std::cout << "Ignoring unknown argument '" << argv[i] << "'\n";
+        }
+    }
+    if (options.headless && options.frameLimit == 0) {
+        options.frameLimit = 1000;
+    }
+    return options;
+}
+
+int RenderReferenceImages(const LaunchOptions& options) {
+    ReferencePathTracer::SceneSnapshot snapshot;
+    if (!ReferencePathTracer::LoadSnapshot(options.referenceRenderPath, snapshot)) {
+        return 1;
+    }
+    ReferencePathTracer::RenderTargets targets = ReferencePathTracer::Render(snapshot, ReferencePathTracer::Settings());
+    return ReferencePathTracer::WriteImages(targets, options.referenceOutputDirectory) ? 0 : 1;
+}
+
+int RunBvhBenchmark(const LaunchOptions& options) {
+    ReferencePathTracer::SceneSnapshot snapshot;
+    if (!ReferencePathTracer::LoadSnapshot(options.bvhBenchmarkPath, snapshot)) {
+        return 1;
+    }
+    // Snapshot meshes index into one shared vertex buffer, so each one gets its own copy of the vertex range it uses
+    std::vector<Bvh::Cpu::BenchmarkMesh> meshes(snapshot.meshIndexCounts.size());
+    std::vector<bool> meshFilled(snapshot.meshIndexCounts.size(), false);
+    std::vector<Bvh::Cpu::BenchmarkInstance> instances;
+    for (const MeshInstance& instance : snapshot.instances) {
+        if (instance.meshIndex < 0 || (size_t)instance.meshIndex >= meshes.size()) {
+            continue;
+        }
+        if (!meshFilled[instance.meshIndex]) {
+            uint32_t indexCount = snapshot.meshIndexCounts[instance.meshIndex];
+            if ((size_t)instance.indexOffset + indexCount > snapshot.indices.size()) {
+                continue;
+            }
+            Bvh::Cpu::BenchmarkMesh& mesh = meshes[instance.meshIndex];
+            mesh.indices.assign(snapshot.indices.begin() + instance.indexOffset, snapshot.indices.begin() + instance.indexOffset + indexCount);
+            uint32_t vertexCount = 0;
+            for (uint32_t index : mesh.indices) {
+                vertexCount = std::max(vertexCount, index + 1);
+            }
+            if ((size_t)instance.vertexOffset + vertexCount > snapshot.vertices.size()) {
+                mesh.indices.clear();
+                continue;
+            }
+            mesh.vertices.assign(snapshot.vertices.begin() + instance.vertexOffset, snapshot.vertices.begin() + instance.vertexOffset + vertexCount);
+            meshFilled[instance.meshIndex] = true;
+        }
+        Bvh::Cpu::BenchmarkInstance& benchmarkInstance = instances.emplace_back();
+        benchmarkInstance.worldTransform = instance.worldMatrix;
+        benchmarkInstance.meshIndex = instance.meshIndex;
+    }
+    Bvh::Cpu::RunBenchmark(meshes, instances, 1000000);
+    Bvh::Cpu::Cleanup();
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    LaunchOptions options = ParseLaunchOptions(argc, argv);
+
+    // Util::ParallelFor runs on the job system, the CPU only modes get a worker per hardware thread
+    if (!options.referenceRenderPath.empty() || !options.bvhBenchmarkPath.empty()) {
+        JobSystem::Init(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        int result = !options.referenceRenderPath.empty() ? RenderReferenceImages(options) : RunBvhBenchmark(options);
+        JobSystem::Cleanup();
+        return result;
+    }
 
     Logging::EnableLevel(Logging::Level::INIT);
     Logging::EnableLevel(Logging::Level::DEBUG);
@@ -20,10 +196,27 @@ int main() {
     Logging::EnableLevel(Logging::Level::FUNCTION);
 
     // Init
-    BackEnd::Init(WindowedMode::WINDOWED);
+    Profiler::SetThreadName("Main");
+    Profiler::SetSampleWindow(options.profileWindow);
+    FrameArena::Init(4 * 1024 * 1024);
+
+    // Up to three secondary command buffers are recorded in parallel each frame, and loading builds mesh BVHs with Util::ParallelFor
+    JobSystem::Init(std::clamp(std::thread::hardware_concurrency(), 2u, 4u) - 1);
+    if (!BackEnd::Init(options.headless ? WindowedMode::HEADLESS : WindowedMode::WINDOWED)) {
+        std::cout << "BackEnd::Init() failed\n";
+        JobSystem::Cleanup();
+        return 1;
+    }
+
     AssetManager::Init();
     GameData::Init();
 
+    if (!options.dumpDirectory.empty()) {
+        VulkanBackEnd::DumpFramesToDisk(options.dumpDirectory, options.dumpInterval);
+    }
+    uint32_t gameFrameCount = 0;
+    bool traceCaptureStarted = false;
+
     // Main loop
     while (BackEnd::WindowHasNotBeenForceClosed()) {
         BackEnd::Update();
@@ -42,14 +235,48 @@ int main() {
         }
 
         else {
+            // Loading allocates plenty by design, only game frames are counted
+            if (!options.heapProfilePath.empty() && !HeapProfiler::IsEnabled()) {
+                HeapProfiler::Enable(options.heapSampleRate);
+            }
+            if (!options.profileTracePath.empty() && !traceCaptureStarted) {
+                Profiler::BeginTraceCapture(options.profileTraceGpu);
+                traceCaptureStarted = true;
+            }
+            PROFILE_SCOPE("Frame");
             GameData::Update();
             Audio::Update();
             VulkanBackEnd::RenderGameFrame();
+            HeapProfiler::EndFrame();
+
+            if (!options.referenceCapturePath.empty()) {
+                ReferencePathTracer::SaveSnapshot(ReferencePathTracer::CaptureScene(VulkanBackEnd::_debugScene), options.referenceCapturePath);
+                options.referenceCapturePath.clear();
+            }
+            if (options.frameLimit > 0 && ++gameFrameCount >= options.frameLimit) {
+                BackEnd::ForceCloseWindow();
+            }
         }
+        Profiler::EndFrame();
+    }
+
+    if (options.frameLimit > 0) {
+        VulkanBackEnd::LogFrameStatistics();
+    }
+    if (!options.renderGraphDumpPath.empty()) {
+        VulkanBackEnd::DumpRenderGraph(options.renderGraphDumpPath);
+    }
+    if (!options.heapProfilePath.empty()) {
+        HeapProfiler::DumpToJson(options.heapProfilePath);
+    }
+    if (!options.profileTracePath.empty()) {
+        Profiler::WriteTrace(options.profileTracePath);
     }
 
     // Cleanup
     VulkanBackEnd::Cleanup();
+    JobSystem::Cleanup();
+    FrameArena::Cleanup();
 	return 0;
 }
 
@@ -101,6 +328,7 @@ void LazyKeyPresses() {
         }
         debugModeIndex;
         VulkanBackEnd::_debugMode = (DebugMode)debugModeIndex;
+        TextBlitter::ResetDebugText();
     }
     if (Input::KeyPressed(HELL_KEY_R)) {
         TextBlitter::ResetBlitter();
@@ -112,4 +340,12 @@ void LazyKeyPresses() {
     if (Input::KeyPressed(HELL_KEY_F)) {
         VulkanBackEnd::ToggleFullscreen();
     }
+    if (Input::KeyPressed(HELL_KEY_N)) {
+        Audio::PlayAudio("RE_bleep.wav", 0.5f);
+        VulkanDenoiseManager::Toggle();
+    }
+    if (Input::KeyPressed(HELL_KEY_F12)) {
+        VulkanBackEnd::SaveScreenshot("screenshot_" + std::to_string((int)glfwGetTime()) + ".png");
+        Audio::PlayAudio("RE_bleep.wav", 0.5f);
+    }
 }
\ No newline at end of file
@@ -1,64 +1,380 @@
 #include "Profiler.h"
-#include <iostream>
+#include "Hell/Core/HeapProfiler.h"
+#include "Hell/Core/Logging.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <unordered_map>
 
 std::vector<ProfilerRecord> Profiler::s_profilerRecords;
 
-Profiler::Profiler(const char* name, bool log_to_console_on_desctruction)
+namespace {
+    constexpr uint32_t MAX_THREADS = 64;
+    constexpr uint32_t RING_CAPACITY = 1 << 14;     // Events per thread, a power of two
+    constexpr uint32_t MAX_OPEN_SCOPES = 64;
+    constexpr uint32_t MAX_TRACE_EVENTS = 1 << 20;
+    constexpr uint32_t GPU_TRACE_THREAD_ID = 0xFFFFFFFF;
+
+    enum ThreadStatus : uint32_t { FREE, ACTIVE, EXITED };
+
+    struct Event {
+        uint64_t time;
+        uint64_t scopeId;
+        const char* name;   // nullptr on end events
+    };
+
+    struct OpenScope {
+        uint64_t scopeId;
+        const char* name;
+        uint64_t beginTime;
+    };
+
+    // Single producer, single consumer. The owning thread writes events, the main thread reads them in EndFrame().
+    // A slot is handed to a new thread once the last one has exited and everything it wrote has been drained.
+    struct ThreadState {
+        std::atomic<uint32_t> status { FREE };
+        std::atomic<uint32_t> threadId { 0 };
+        std::atomic<const char*> name { nullptr };
+        std::atomic<uint64_t> writeIndex { 0 };
+        std::atomic<uint64_t> readIndex { 0 };
+        std::atomic<uint64_t> droppedEvents { 0 };
+        Event* events = nullptr;
+
+        // Main thread only
+        OpenScope openScopes[MAX_OPEN_SCOPES];
+        uint32_t openScopeCount = 0;
+    };
+
+    struct ThreadHandle {
+        ThreadState* state = nullptr;
+        bool noSlotLeft = false;
+        uint32_t recordedDepth = 0;     // Begin events written whose end isn't yet
+
+        ~ThreadHandle() {
+            if (state) {
+                state->status.store(EXITED, std::memory_order_release);
+            }
+        }
+    };
+
+    struct TraceEvent {
+        const char* name;
+        uint32_t threadId;
+        uint64_t beginTime;
+        uint64_t duration;
+    };
+
+    struct TraceThread {
+        uint32_t threadId;
+        const char* name;
+    };
+
+    ThreadState g_threads[MAX_THREADS];
+    std::atomic<uint32_t> g_nextThreadId { 1 };
+    thread_local ThreadHandle t_thread;
+
+    uint32_t g_sampleWindow = PROFILER_SAMPLE_WINDOW;
+    std::unordered_map<uint64_t, uint32_t> g_recordIndices;
+    std::deque<std::string> g_internedNames;
+    std::unordered_map<std::string_view, const char*> g_internedNameLookup;
+
+    bool g_traceCapturing = false;
+    bool g_traceIncludesGpu = false;
+    uint64_t g_traceBeginTime = 0;
+    uint64_t g_droppedTraceEvents = 0;
+    std::vector<TraceEvent> g_traceEvents;
+    std::vector<TraceThread> g_traceThreads;
+
+    ThreadState* GetThreadState() {
+        if (t_thread.state || t_thread.noSlotLeft) {
+            return t_thread.state;
+        }
+        for (ThreadState& state : g_threads) {
+            uint32_t expected = FREE;
+            if (state.status.compare_exchange_strong(expected, ACTIVE, std::memory_order_acq_rel)) {
+                if (!state.events) {
+                    state.events = new Event[RING_CAPACITY];
+                }
+                state.threadId.store(g_nextThreadId.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+                t_thread.state = &state;
+                return &state;
+            }
+        }
+        t_thread.noSlotLeft = true;
+        return nullptr;
+    }
+
+    ProfilerRecord& GetOrCreateRecord(uint64_t scopeId, std::string_view name) {
+        auto it = g_recordIndices.find(scopeId);
+        if (it != g_recordIndices.end()) {
+            return Profiler::s_profilerRecords[it->second];
+        }
+        g_recordIndices[scopeId] = (uint32_t)Profiler::s_profilerRecords.size();
+        ProfilerRecord& record = Profiler::s_profilerRecords.emplace_back();
+        record.m_name = name;
+        record.m_id = scopeId;
+        record.m_samples.reserve(g_sampleWindow);
+        return record;
+    }
+
+    ProfilerRecord* FindRecord(std::string_view name) {
+        auto it = g_recordIndices.find(Profiler::GetScopeId(name));
+        return (it != g_recordIndices.end()) ? &Profiler::s_profilerRecords[it->second] : nullptr;
+    }
+
+    void AddSample(ProfilerRecord& record, float time) {
+        // Replace the oldest sample once the window is full
+        if (record.m_samples.size() < g_sampleWindow) {
+            record.m_samples.push_back(time);
+            record.m_count++;
+        }
+        else {
+            record.m_total -= record.m_samples[record.m_nextSampleIndex];
+            record.m_samples[record.m_nextSampleIndex] = time;
+        }
+        record.m_nextSampleIndex = (record.m_nextSampleIndex + 1) % g_sampleWindow;
+        record.m_lastTime = time;
+        record.m_total += time;
+        record.m_averageTime = record.m_total / record.m_count;
+    }
+
+    void AddTraceEvent(const char* name, uint32_t threadId, uint64_t beginTime, uint64_t duration) {
+        if (g_traceEvents.size() == g_traceEvents.capacity()) {
+            g_droppedTraceEvents++;
+            return;
+        }
+        g_traceEvents.push_back({ name, threadId, beginTime, duration });
+    }
+
+    void AddTraceThread(uint32_t threadId, const char* name) {
+        for (TraceThread& thread : g_traceThreads) {
+            if (thread.threadId == threadId) {
+                if (name) {
+                    thread.name = name;
+                }
+                return;
+            }
+        }
+        g_traceThreads.push_back({ threadId, name });
+    }
+
+    void DrainThread(ThreadState& state) {
+        uint64_t readIndex = state.readIndex.load(std::memory_order_relaxed);
+        uint64_t writeIndex = state.writeIndex.load(std::memory_order_acquire);
+        uint32_t threadId = state.threadId.load(std::memory_order_relaxed);
+        if (g_traceCapturing && readIndex != writeIndex) {
+            AddTraceThread(threadId, state.name.load(std::memory_order_relaxed));
+        }
+
+        for (; readIndex != writeIndex; readIndex++) {
+            const Event& event = state.events[readIndex & (RING_CAPACITY - 1)];
+            if (event.name) {
+                // Producers never record deeper than this, see RecordBegin()
+                state.openScopes[state.openScopeCount++] = { event.scopeId, event.name, event.time };
+                continue;
+            }
+            if (state.openScopeCount == 0) {
+                continue;
+            }
+            const OpenScope& scope = state.openScopes[--state.openScopeCount];
+            uint64_t duration = event.time - scope.beginTime;
+            AddSample(GetOrCreateRecord(scope.scopeId, scope.name), (float)((double)duration / 1000000.0));
+            if (g_traceCapturing && scope.beginTime >= g_traceBeginTime) {
+                AddTraceEvent(scope.name, threadId, scope.beginTime, duration);
+            }
+        }
+        state.readIndex.store(readIndex, std::memory_order_release);
+
+        // Everything the exited thread wrote is in, the slot can go to the next thread that starts
+        uint32_t expected = EXITED;
+        if (state.status.load(std::memory_order_acquire) == EXITED && readIndex == state.writeIndex.load(std::memory_order_acquire)) {
+            state.openScopeCount = 0;
+            state.name.store(nullptr, std::memory_order_relaxed);
+            state.status.compare_exchange_strong(expected, FREE, std::memory_order_acq_rel);
+        }
+    }
+
+    void WriteJsonString(std::ofstream& file, const char* text) {
+        file << '"';
+        for (const char* c = text ? text : ""; *c; c++) {
+            if (*c == '"' || *c == '\\') {
+                file << '\\';
+            }
+            file << *c;
+        }
+        file << '"';
+    }
+}
+
+Profiler::Profiler(uint64_t scopeId, const char* name)
 {
-    m_startTime = std::chrono::steady_clock::now();
-    m_name = name;
-    m_log_to_console_on_desctruction = log_to_console_on_desctruction;
+    HeapProfiler::PushScope(name);
+    m_recorded = false;
+
+    ThreadState* state = GetThreadState();
+    if (!state) {
+        return;
+    }
+    // Keep room for the end event of every open scope, so an end is never the one that gets dropped
+    uint64_t writeIndex = state->writeIndex.load(std::memory_order_relaxed);
+    uint64_t readIndex = state->readIndex.load(std::memory_order_acquire);
+    uint64_t freeEvents = RING_CAPACITY - (writeIndex - readIndex);
+    if (t_thread.recordedDepth >= MAX_OPEN_SCOPES || freeEvents < t_thread.recordedDepth + 2) {
+        state->droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    state->events[writeIndex & (RING_CAPACITY - 1)] = { GetTimeNanoseconds(), scopeId, name };
+    state->writeIndex.store(writeIndex + 1, std::memory_order_release);
+    t_thread.recordedDepth++;
+    m_recorded = true;
 }
 
-Profiler::~Profiler() 
+Profiler::~Profiler()
 {
-    //glFinish();
-    std::chrono::duration<float> duration = std::chrono::steady_clock::now() - m_startTime;
-    float time = duration.count() * 1000.0f;
-
-    std::string spacing;
-    for (int i = 0; i < (40 - std::string(m_name).length()); i++)
-        spacing += " ";
- 
-    if (m_log_to_console_on_desctruction)
-        std::cout << m_name << ": " << spacing << time << "ms\n";
-
-    // First check if a profiler record with this same name already exists
-    for (auto& record : s_profilerRecords)
-    {
-        // If so then add the new data to it
-        if (record.m_name == m_name) {
-            record.m_lastTime = time;
-            record.m_total += time;
-            record.m_count++;
-            record.m_averageTime = record.m_total / record.m_count;
-
-            // Reset every 1000 frames
-            if (record.m_count > 60) {
-                record.m_lastTime = time;
-                record.m_total = time;
-                record.m_count = 1;
-                record.m_averageTime = record.m_total / record.m_count;
-                //std::cout << "reste\n";
-            }
+    if (m_recorded) {
+        uint64_t time = GetTimeNanoseconds();
+        ThreadState* state = t_thread.state;
+        uint64_t writeIndex = state->writeIndex.load(std::memory_order_relaxed);
+        state->events[writeIndex & (RING_CAPACITY - 1)] = { time, 0, nullptr };
+        state->writeIndex.store(writeIndex + 1, std::memory_order_release);
+        t_thread.recordedDepth--;
+    }
+    HeapProfiler::PopScope();
+}
 
-            return;
+uint64_t Profiler::GetTimeNanoseconds()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+    if (ThreadState* state = GetThreadState()) {
+        state->name.store(name, std::memory_order_relaxed);
+    }
+}
+
+void Profiler::EndFrame()
+{
+    for (ThreadState& state : g_threads) {
+        if (state.status.load(std::memory_order_acquire) != FREE) {
+            DrainThread(state);
         }
     }
-    // If not then create one
-    ProfilerRecord record;
-    record.m_name = m_name;
-    record.m_lastTime = time;
-    record.m_total += time;
-    record.m_count++;
-    record.m_averageTime = record.m_total / record.m_count;
-    s_profilerRecords.push_back(record);
 }
 
-float Profiler::GetAverageRecordTime(const char* name) 
+void Profiler::SetSampleWindow(uint32_t sampleCount)
 {
-    for (auto& record : s_profilerRecords)
-        if (record.m_name == name)
-            return record.m_averageTime;
-    return 0;
+    g_sampleWindow = std::max(1u, sampleCount);
+    for (ProfilerRecord& record : s_profilerRecords) {
+        record.m_samples.clear();
+        record.m_samples.reserve(g_sampleWindow);
+        record.m_nextSampleIndex = 0;
+        record.m_total = 0;
+        record.m_count = 0;
+    }
+}
+
+uint32_t Profiler::GetSampleWindow()
+{
+    return g_sampleWindow;
+}
+
+void Profiler::AddRecordTime(std::string_view name, float time)
+{
+    AddSample(GetOrCreateRecord(GetScopeId(name), name), time);
+}
+
+ProfilerRecord* Profiler::GetRecord(std::string_view name)
+{
+    return FindRecord(name);
+}
+
+float Profiler::GetAverageRecordTime(const char* name)
+{
+    ProfilerRecord* record = FindRecord(name);
+    return record ? record->m_averageTime : 0;
+}
+
+float Profiler::GetPercentileRecordTime(const char* name, float percentile)
+{
+    ProfilerRecord* record = GetRecord(name);
+    if (!record || record->m_samples.empty())
+        return 0;
+
+    std::vector<float> sorted = record->m_samples;
+    std::sort(sorted.begin(), sorted.end());
+    percentile = std::clamp(percentile, 0.0f, 1.0f);
+    size_t index = (size_t)(percentile * (sorted.size() - 1) + 0.5f);
+    return sorted[index];
+}
+
+void Profiler::BeginTraceCapture(bool includeGpu)
+{
+    g_traceEvents.clear();
+    g_traceEvents.reserve(MAX_TRACE_EVENTS);
+    g_traceThreads.clear();
+    g_droppedTraceEvents = 0;
+    g_traceBeginTime = GetTimeNanoseconds();
+    g_traceIncludesGpu = includeGpu;
+    g_traceCapturing = true;
+    if (includeGpu) {
+        AddTraceThread(GPU_TRACE_THREAD_ID, "GPU");
+    }
+}
+
+bool Profiler::IsCapturingGpuTrace()
+{
+    return g_traceCapturing && g_traceIncludesGpu;
+}
+
+void Profiler::AddGpuTraceEvent(std::string_view name, uint64_t startNanoseconds, uint64_t durationNanoseconds)
+{
+    if (!IsCapturingGpuTrace() || startNanoseconds < g_traceBeginTime) {
+        return;
+    }
+    // GPU scope names aren't literals, keep one copy of each for the trace to point at
+    auto it = g_internedNameLookup.find(name);
+    if (it == g_internedNameLookup.end()) {
+        const std::string& interned = g_internedNames.emplace_back(name);
+        it = g_internedNameLookup.emplace(interned, interned.c_str()).first;
+    }
+    AddTraceEvent(it->second, GPU_TRACE_THREAD_ID, startNanoseconds, durationNanoseconds);
+}
+
+bool Profiler::WriteTrace(const std::string& path)
+{
+    // Pick up whatever the threads recorded since the last frame ended
+    EndFrame();
+
+    std::ofstream file(path);
+    if (!file) {
+        Logging::Error() << "Profiler::WriteTrace() failed to open " << path << "\n";
+        return false;
+    }
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const TraceThread& thread : g_traceThreads) {
+        file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.threadId << ",\"args\":{\"name\":";
+        WriteJsonString(file, thread.name ? thread.name : "Unnamed thread");
+        file << "}}";
+        first = false;
+    }
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    for (const TraceEvent& event : g_traceEvents) {
+        file << (first ? "" : ",\n") << "{\"name\":";
+        WriteJsonString(file, event.name);
+        file << ",\"cat\":\"" << (event.threadId == GPU_TRACE_THREAD_ID ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadId;
+        file << ",\"ts\":" << (double)(event.beginTime - g_traceBeginTime) / 1000.0 << ",\"dur\":" << (double)event.duration / 1000.0 << "}";
+        first = false;
+    }
+    file << "\n]}\n";
+
+    if (g_droppedTraceEvents) {
+        Logging::Warning() << "Profiler::WriteTrace() dropped " << g_droppedTraceEvents << " events past the " << MAX_TRACE_EVENTS << " event limit\n";
+    }
+    return file.good();
 }
\ No newline at end of file
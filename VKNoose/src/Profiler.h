@@ -1,30 +1,71 @@
 #pragma once
-#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
+#define PROFILER_SAMPLE_WINDOW 120  // Default rolling window, change it with Profiler::SetSampleWindow()
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing block. The name must be a string literal, its id is hashed at compile time.
+#define PROFILE_SCOPE(name) Profiler PROFILER_CONCAT(profilerScope, __LINE__)(std::integral_constant<uint64_t, Profiler::GetScopeId(name)>::value, name)
+
 struct ProfilerRecord {
     std::string m_name;
+    uint64_t m_id = 0;
     float m_lastTime = 0;
     float m_total = 0;
     float m_count = 0;
     float m_averageTime = 0;
+    std::vector<float> m_samples;   // Rolling window of the last Profiler::GetSampleWindow() samples
+    int m_nextSampleIndex = 0;
 };
 
+// Scopes push begin and end events into a ring buffer owned by their thread, so recording one takes no locks and
+// never allocates. Profiler::EndFrame() drains every ring on the main thread, pairs the events back up into nested
+// scopes, and turns them into rolling records and, while a capture is running, Chrome trace events.
 struct Profiler
 {
     // methods
-    Profiler(const char* name, bool log_to_console_on_desctruction = false);
+    Profiler(uint64_t scopeId, const char* name);
     ~Profiler();
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
 
     // member variables
-    std::chrono::time_point<std::chrono::steady_clock> m_startTime;// , m_endTime;
-    //std::chrono::duration<float> m_duration;
-    const char* m_name;
-    bool m_log_to_console_on_desctruction;
+    bool m_recorded;    // False if the ring was full, the end event is skipped too
 
     // static varibles
     static std::vector<ProfilerRecord> s_profilerRecords;
 
     // static functions
+    static constexpr uint64_t GetScopeId(std::string_view name) {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : name) {
+            hash = (hash ^ (uint8_t)c) * 1099511628211ull;
+        }
+        return hash;
+    }
+    static uint64_t GetTimeNanoseconds();
+
+    // Any thread. Names show up as trace lanes and must outlive the thread (string literals)
+    static void SetThreadName(const char* name);
+
+    // Main thread only
+    static void EndFrame();
+    static void SetSampleWindow(uint32_t sampleCount);
+    static uint32_t GetSampleWindow();
+    static void AddRecordTime(std::string_view name, float time);
+    static ProfilerRecord* GetRecord(std::string_view name);
     static float GetAverageRecordTime(const char* name);
+    static float GetPercentileRecordTime(const char* name, float percentile);
+
+    // Chrome trace export, open the file in chrome://tracing or ui.perfetto.dev
+    static void BeginTraceCapture(bool includeGpu);
+    static bool IsCapturingGpuTrace();
+    static void AddGpuTraceEvent(std::string_view name, uint64_t startNanoseconds, uint64_t durationNanoseconds);
+    static bool WriteTrace(const std::string& path);
 };
\ No newline at end of file
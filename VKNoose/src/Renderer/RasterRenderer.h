@@ -12,11 +12,23 @@ namespace RasterRenderer {
 		Destination destination = Destination::MAIN_UI;
 	};
 
+	// A run of queued instances that share a mesh, drawn with a single instanced call
+	struct UIDrawBatch {
+		int meshIndex = -1;
+		uint32_t firstInstance = 0;
+		uint32_t instanceCount = 0;
+	};
+
 	inline GPUObjectData2D _instanceData2D[MAX_RENDER_OBJECTS_2D] = {};
-	inline std::vector<UIInfo> _UIToRender;
+	inline GPUObjectData2D _sortedInstanceData2D[MAX_RENDER_OBJECTS_2D] = {};
+	inline UIInfo _UIToRender[MAX_RENDER_OBJECTS_2D] = {};
+	inline std::vector<UIDrawBatch> _drawBatches[2]; // Indexed by Destination
 	inline int instanceCount = 0;
 
-	inline void SubmitUI(int meshIndex, int textureIndex, int colorIndex, glm::mat4 modelMatrix, Destination destination, int xClipMin, int xClipMax, int yClipMin, int yClipMax) {
+	inline void SubmitUI(int meshIndex, int textureIndex, int colorIndex, glm::mat4 modelMatrix, Destination destination, int xClipMin, int xClipMax, int yClipMin, int yClipMax, glm::vec4 uvRect = glm::vec4(0, 0, 1, 1)) {
+		if (instanceCount >= MAX_RENDER_OBJECTS_2D)
+			return;
+
 		int instanceIndex = instanceCount;
 		_instanceData2D[instanceIndex].modelMatrix = modelMatrix;
 		_instanceData2D[instanceIndex].index_basecolor = textureIndex;
@@ -25,22 +37,59 @@ namespace RasterRenderer {
 		_instanceData2D[instanceIndex].xClipMax = xClipMax;
 		_instanceData2D[instanceIndex].yClipMin = yClipMin;
 		_instanceData2D[instanceIndex].yClipMax = yClipMax;
+		_instanceData2D[instanceIndex].uvRect = uvRect;
 
 		UIInfo info;
 		info.meshIndex = meshIndex;
 		info.destination = destination;
 
-		_UIToRender.push_back(info);
+		_UIToRender[instanceCount] = info;
 		instanceCount++;
 	}
 
-	inline void DrawMesh(VkCommandBuffer commandbuffer, int index) {
-		MeshOLD* mesh = AssetManager::GetMesh(_UIToRender[index].meshIndex);
-		mesh->draw(commandbuffer, index);
+	// Groups the queue by destination and merges neighbouring instances that share a mesh. Submission order is kept
+	// within each destination so overlapping quads still layer correctly. Upload _sortedInstanceData2D afterwards.
+	inline void BuildDrawBatches() {
+		uint32_t sortedCount = 0;
+		for (Destination destination : { Destination::MAIN_UI, Destination::LAPTOP_DISPLAY }) {
+			std::vector<UIDrawBatch>& batches = _drawBatches[(int)destination];
+			batches.clear();
+			for (int i = 0; i < instanceCount; i++) {
+				const UIInfo& info = _UIToRender[i];
+				if (info.destination != destination)
+					continue;
+
+				_sortedInstanceData2D[sortedCount] = _instanceData2D[i];
+				if (!batches.empty() && batches.back().meshIndex == info.meshIndex) {
+					batches.back().instanceCount++;
+				}
+				else {
+					batches.push_back({ info.meshIndex, sortedCount, 1 });
+				}
+				sortedCount++;
+			}
+		}
+	}
+
+	inline const std::vector<UIDrawBatch>& GetDrawBatches(Destination destination) {
+		return _drawBatches[(int)destination];
+	}
+
+	inline void DrawBatches(VkCommandBuffer commandbuffer, Destination destination) {
+		MeshOLD* boundMesh = nullptr;
+		for (const UIDrawBatch& batch : _drawBatches[(int)destination]) {
+			MeshOLD* mesh = AssetManager::GetMesh(batch.meshIndex);
+			if (mesh != boundMesh) {
+				mesh->bind(commandbuffer);
+				boundMesh = mesh;
+			}
+			mesh->drawInstances(commandbuffer, batch.firstInstance, batch.instanceCount);
+		}
 	}
 
 	inline void ClearQueue() {
-		_UIToRender.clear();
+		_drawBatches[(int)Destination::MAIN_UI].clear();
+		_drawBatches[(int)Destination::LAPTOP_DISPLAY].clear();
 		instanceCount = 0;
 	}
 
@@ -84,7 +133,7 @@ namespace RasterRenderer {
 		transform.position.y = ndcY * -1;
 		transform.scale = glm::vec3(width, height * -1, 1);
 		int meshIndex = AssetManager::GetModel("blitter_quad")->m_meshIndices[0];
-		int textureIndex = AssetManager::GetTextureIndex(textureName);
-		SubmitUI(meshIndex, textureIndex, 0, transform.to_mat4(), destination, xClipMin, xClipMax, yClipMin, yClipMax);
+		AtlasRegion region = AssetManager::GetAtlasRegion(AssetManager::GetTextureIndex(textureName));
+		SubmitUI(meshIndex, region.textureIndex, 0, transform.to_mat4(), destination, xClipMin, xClipMax, yClipMin, yClipMax, region.uvRect);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,884 @@
+#include "ReferencePathTracer.h"
+#include "AssetManagement/AssetManager.h"
+#include "Bvh/Cpu/CpuBvh.h"
+#include "Game/GameData.h"
+#include "Game/Scene.h"
+#include "Util.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+
+namespace ReferencePathTracer {
+
+	constexpr uint32_t SNAPSHOT_MAGIC = 0x5450524E; // "NRPT"
+	constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+	// A mirror or glass surface facing another one bounces forever on the GPU too, this just stops it hanging the CPU
+	constexpr int MAX_FIRST_BOUNCE_ITERATIONS = 64;
+
+	constexpr float PI = 3.14159265359f;
+
+	// raycommon.glsl
+	constexpr int HIT_TYPE_UNDEFINED = 0;
+	constexpr int HIT_TYPE_SOLID = 1;
+	constexpr int HIT_TYPE_TRANSULUCENT = 2;
+	constexpr int HIT_TYPE_MIRROR = 3;
+	constexpr int HIT_TYPE_GLASS = 4;
+	constexpr int HIT_TYPE_MISS = 5;
+
+	//////////////////////////
+	//                      //
+	//     Acceleration     //
+
+	// One Bvh::Cpu mesh BVH per mesh, shared by every instance of it like the BLAS, and a scene BVH over the instances
+	struct SceneAccel {
+		std::vector<uint64_t> meshBvhIds;       // Indexed by MeshInstance::meshIndex, 0 when no instance uses the mesh
+		uint64_t sceneBvhId = 0;
+		std::vector<glm::mat3> normalMatrices;  // Indexed like SceneSnapshot::instances, gl_InstanceCustomIndexEXT
+	};
+
+	// Expects a snapshot that passed ValidateSnapshot(), the mesh ranges aren't checked again here
+	SceneAccel BuildSceneAccel(const SceneSnapshot& snapshot, uint32_t workerCount) {
+		SceneAccel scene;
+		scene.meshBvhIds.resize(snapshot.meshIndexCounts.size(), 0);
+
+		std::vector<int> meshInstance(snapshot.meshIndexCounts.size(), -1);
+		std::vector<uint32_t> meshesToBuild;
+		for (int i = 0; i < (int)snapshot.instances.size(); i++) {
+			int meshIndex = snapshot.instances[i].meshIndex;
+			if (meshIndex < 0 || meshIndex >= (int)meshInstance.size() || meshInstance[meshIndex] != -1) continue;
+			meshInstance[meshIndex] = i;
+			meshesToBuild.push_back(meshIndex);
+		}
+		Util::ParallelFor((uint32_t)meshesToBuild.size(), workerCount, [&](uint32_t item) {
+			uint32_t meshIndex = meshesToBuild[item];
+			const MeshInstance& instance = snapshot.instances[meshInstance[meshIndex]];
+			std::span<const Vertex> vertices(snapshot.vertices.data() + instance.vertexOffset, snapshot.vertices.size() - instance.vertexOffset);
+			std::span<const uint32_t> indices(snapshot.indices.data() + instance.indexOffset, snapshot.meshIndexCounts[meshIndex]);
+			scene.meshBvhIds[meshIndex] = Bvh::Cpu::CreateMeshBvhFromVertexData(vertices, indices);
+		});
+		Bvh::Cpu::FlatternMeshBvhNodes();
+
+		std::vector<Bvh::Cpu::PrimitiveInstance> instances(snapshot.instances.size());
+		scene.normalMatrices.resize(snapshot.instances.size());
+		for (size_t i = 0; i < snapshot.instances.size(); i++) {
+			const MeshInstance& instance = snapshot.instances[i];
+			bool validMesh = instance.meshIndex >= 0 && instance.meshIndex < (int)scene.meshBvhIds.size();
+			instances[i].worldTransform = instance.worldMatrix;
+			instances[i].meshBvhId = validMesh ? scene.meshBvhIds[instance.meshIndex] : 0;
+			scene.normalMatrices[i] = glm::transpose(glm::mat3(glm::inverse(instance.worldMatrix)));
+		}
+		scene.sceneBvhId = Bvh::Cpu::CreateSceneBvh();
+		Bvh::Cpu::UpdateSceneBvh(scene.sceneBvhId, instances);
+		return scene;
+	}
+
+	void DestroySceneAccel(SceneAccel& scene) {
+		Bvh::Cpu::DestroySceneBvh(scene.sceneBvhId);
+		for (uint64_t meshBvhId : scene.meshBvhIds) {
+			Bvh::Cpu::DestroyMeshBvh(meshBvhId);
+		}
+		Bvh::Cpu::FlatternMeshBvhNodes();
+	}
+
+	//////////////////////
+	//                  //
+	//     Textures     //
+
+	float SrgbByteToLinear(int i) {
+		static float table[256] = {};
+		static bool initialized = [] {
+			for (int j = 0; j < 256; j++) {
+				float c = j / 255.0f;
+				table[j] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return true;
+		}();
+		return table[i];
+	}
+
+	// Callers check the pixel count first, so this only sees textures with width and height above zero
+	glm::vec4 FetchTexel(const TextureData& texture, int x, int y) {
+		x = ((x % texture.width) + texture.width) % texture.width;
+		y = ((y % texture.height) + texture.height) % texture.height;
+		const uint8_t* p = &texture.pixels[((size_t)y * texture.width + x) * 4];
+		if (texture.srgb) {
+			return glm::vec4(SrgbByteToLinear(p[0]), SrgbByteToLinear(p[1]), SrgbByteToLinear(p[2]), p[3] / 255.0f);
+		}
+		return glm::vec4(p[0], p[1], p[2], p[3]) / 255.0f;
+	}
+
+	// g_samplers[0]: bilinear, repeat. Ray tracing stages have no derivatives so the GPU reads mip 0 as well.
+	glm::vec4 SampleTexture(const SceneSnapshot& snapshot, int textureIndex, glm::vec2 uv) {
+		if (textureIndex < 0 || textureIndex >= (int)snapshot.textures.size()) {
+			return glm::vec4(0, 0, 0, 1);
+		}
+		const TextureData& texture = snapshot.textures[textureIndex];
+		if (texture.width <= 0 || texture.height <= 0 || texture.pixels.size() < (size_t)texture.width * texture.height * 4) {
+			return glm::vec4(0, 0, 0, 1);
+		}
+		float x = uv.x * texture.width - 0.5f;
+		float y = uv.y * texture.height - 0.5f;
+		float x0 = std::floor(x);
+		float y0 = std::floor(y);
+		float fx = x - x0;
+		float fy = y - y0;
+		int ix = (int)x0;
+		int iy = (int)y0;
+		glm::vec4 top = glm::mix(FetchTexel(texture, ix, iy), FetchTexel(texture, ix + 1, iy), fx);
+		glm::vec4 bottom = glm::mix(FetchTexel(texture, ix, iy + 1), FetchTexel(texture, ix + 1, iy + 1), fx);
+		return glm::mix(top, bottom, fy);
+	}
+
+	////////////////////////
+	//                    //
+	//     raycommon      //
+
+	glm::mat3 GetNormalSpace(const glm::vec3& normal) {
+		glm::vec3 someVec = glm::vec3(1.0f, 0.0f, 0.0f);
+		float dd = glm::dot(someVec, normal);
+		glm::vec3 tangent = glm::vec3(0.0f, 1.0f, 0.0f);
+		if (1.0f - std::abs(dd) > 1e-6f) {
+			tangent = glm::normalize(glm::cross(someVec, normal));
+		}
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+		return glm::mat3(tangent, bitangent, normal);
+	}
+
+	float Random(const glm::vec2& co) {
+		return glm::fract(std::sin(glm::dot(co, glm::vec2(12.9898f, 78.233f))) * 43758.5453f);
+	}
+
+	glm::vec3 RandomDirInCone2(const glm::vec3& hitpos, const glm::vec3& lightPos, float randomSeed, float lightSize) {
+		glm::vec3 lightVector = glm::normalize(lightPos - hitpos);
+		glm::vec2 rng;
+		rng.x = Random(glm::vec2(hitpos.x * randomSeed, hitpos.y * -randomSeed));
+		rng.y = Random(glm::vec2(hitpos.y * randomSeed, hitpos.x * -randomSeed));
+		glm::vec3 lightTangent = glm::normalize(glm::cross(lightVector, glm::vec3(0.0f, 1.0f, 0.0f)));
+		glm::vec3 lightBitangent = glm::normalize(glm::cross(lightTangent, lightVector));
+		float pointRadius = lightSize * std::sqrt(rng.x);
+		float pointAngle = rng.y * 2.0f * PI;
+		glm::vec2 diskPoint = glm::vec2(pointRadius * std::cos(pointAngle), pointRadius * std::sin(pointAngle));
+		return glm::normalize(lightVector + diskPoint.x * lightTangent + diskPoint.y * lightBitangent);
+	}
+
+	glm::vec3 RandomPcg3d(glm::uvec3 v) {
+		v = v * 1664525u + 1013904223u;
+		v.x += v.y * v.z; v.y += v.z * v.x; v.z += v.x * v.y;
+		v ^= v >> 16u;
+		v.x += v.y * v.z; v.y += v.z * v.x; v.z += v.x * v.y;
+		return glm::vec3(v) * (1.0f / float(0xffffffffu));
+	}
+
+	glm::vec3 FresnelSchlick(float cosTheta, const glm::vec3& f0) {
+		return f0 + (1.0f - f0) * std::pow(1.0f - cosTheta, 5.0f);
+	}
+
+	float D_GGX(float NoH, float roughness) {
+		float alpha = roughness * roughness;
+		float alpha2 = alpha * alpha;
+		float b = (NoH * NoH * (alpha2 - 1.0f) + 1.0f);
+		return alpha2 / (PI * b * b);
+	}
+
+	float G1_GGX_Schlick(float NdotV, float roughness) {
+		float r = 0.5f + 0.5f * roughness; // Disney remapping
+		float k = (r * r) / 2.0f;
+		return NdotV / (NdotV * (1.0f - k) + k);
+	}
+
+	float G_Smith(float NoV, float NoL, float roughness) {
+		return G1_GGX_Schlick(NoL, roughness) * G1_GGX_Schlick(NoV, roughness);
+	}
+
+	glm::vec3 MicrofacetBRDF(const glm::vec3& L, const glm::vec3& V, const glm::vec3& N, const glm::vec3& baseColor, float metallicness, float fresnelReflect, float roughness, glm::vec3& specularContribution) {
+		glm::vec3 H = glm::normalize(V + L);
+		float NoV = glm::clamp(glm::dot(N, V), 0.0f, 1.0f);
+		float NoL = glm::clamp(glm::dot(N, L), 0.0f, 1.0f);
+		float NoH = glm::clamp(glm::dot(N, H), 0.0f, 1.0f);
+		float VoH = glm::clamp(glm::dot(V, H), 0.0f, 1.0f);
+
+		glm::vec3 f0 = glm::mix(glm::vec3(0.16f * (fresnelReflect * fresnelReflect)), baseColor, metallicness);
+		glm::vec3 F = FresnelSchlick(VoH, f0);
+		float D = D_GGX(NoH, roughness);
+		float G = G_Smith(NoV, NoL, roughness);
+		glm::vec3 spec = (D * G * F) / std::max(4.0f * NoV * NoL, 0.001f);
+
+		glm::vec3 notSpec = (glm::vec3(1.0f) - F) * (1.0f - metallicness);
+		glm::vec3 diff = notSpec * baseColor / PI;
+
+		specularContribution = spec;
+		return diff + spec;
+	}
+
+	glm::vec3 SampleMicrofacetBRDF(const glm::vec3& V, const glm::vec3& N, const glm::vec3& baseColor, float metallicness, float fresnelReflect, float roughness, const glm::vec3& random, glm::vec3& nextFactor) {
+		glm::vec3 f0 = glm::mix(glm::vec3(0.16f * (fresnelReflect * fresnelReflect)), baseColor, metallicness);
+
+		if (random.z > 0.5f) {
+			float theta = std::asin(std::sqrt(random.y));
+			float phi = 2.0f * PI * random.x;
+			glm::vec3 localDiffuseDir = glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+			glm::vec3 L = GetNormalSpace(N) * localDiffuseDir;
+
+			glm::vec3 H = glm::normalize(V + L);
+			float VoH = glm::clamp(glm::dot(V, H), 0.0f, 1.0f);
+			glm::vec3 F = FresnelSchlick(VoH, f0);
+			glm::vec3 notSpec = (glm::vec3(1.0f) - F) * (1.0f - metallicness);
+
+			nextFactor = notSpec * baseColor * 2.0f;
+			return L;
+		}
+		else {
+			float a = roughness * roughness;
+			float theta = std::acos(std::sqrt((1.0f - random.y) / (1.0f + (a * a - 1.0f) * random.y)));
+			float phi = 2.0f * PI * random.x;
+			glm::vec3 localH = glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+			glm::vec3 H = GetNormalSpace(N) * localH;
+			glm::vec3 L = glm::reflect(-V, H);
+
+			float NoV = glm::clamp(glm::dot(N, V), 0.0f, 1.0f);
+			float NoL = glm::clamp(glm::dot(N, L), 0.0f, 1.0f);
+			float NoH = glm::clamp(glm::dot(N, H), 0.0f, 1.0f);
+			float VoH = glm::clamp(glm::dot(V, H), 0.0f, 1.0f);
+
+			glm::vec3 F = FresnelSchlick(VoH, f0);
+			float G = G_Smith(NoV, NoL, roughness);
+			nextFactor = F * G * VoH / std::max((NoH * NoV), 0.001f) * 2.0f;
+			return L;
+		}
+	}
+
+	glm::vec3 Tonemap_ACES(const glm::vec3& x) {
+		const float a = 2.51f;
+		const float b = 0.03f;
+		const float c = 2.43f;
+		const float d = 0.59f;
+		const float e = 0.14f;
+		return (x * (a * x + b)) / (x * (c * x + d) + e);
+	}
+
+	glm::vec3 ColorTemperatureToRGB(float temperature) {
+		glm::mat3 m = (temperature <= 6500.0f)
+			? glm::mat3(glm::vec3(0.0f, -2902.1955373783176f, -8257.7997278925690f),
+				glm::vec3(0.0f, 1669.5803561666639f, 2575.2827530017594f),
+				glm::vec3(1.0f, 1.3302673723350029f, 1.8993753891711275f))
+			: glm::mat3(glm::vec3(1745.0425298314172f, 1216.6168361476490f, -8257.7997278925690f),
+				glm::vec3(-2666.3474220535695f, -2173.1012343082230f, 2575.2827530017594f),
+				glm::vec3(0.55995389139931482f, 0.70381203140554553f, 1.8993753891711275f));
+		glm::vec3 rgb = glm::clamp(m[0] / (glm::vec3(glm::clamp(temperature, 1000.0f, 40000.0f)) + m[1]) + m[2], glm::vec3(0.0f), glm::vec3(1.0f));
+		return glm::mix(rgb, glm::vec3(1.0f), glm::smoothstep(1000.0f, 0.0f, temperature));
+	}
+
+	float CalculateDoomFactor(const glm::vec3& fragPos, const glm::vec3& camPos, float fallOff) {
+		float distanceFromCamera = glm::distance(fragPos, camPos);
+		float doomFactor = 1.0f;
+		if (distanceFromCamera > fallOff) {
+			distanceFromCamera -= fallOff;
+			distanceFromCamera *= 0.13f * 1.2f;
+			doomFactor = glm::clamp(1.0f - distanceFromCamera, 0.1f, 1.0f);
+		}
+		return doomFactor;
+	}
+
+	glm::vec2 OctEncode(glm::vec3 n) {
+		n /= std::max(std::abs(n.x) + std::abs(n.y) + std::abs(n.z), 1e-6f);
+		if (n.z < 0.0f) {
+			glm::vec2 wrapped = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+			n.x = wrapped.x;
+			n.y = wrapped.y;
+		}
+		return glm::vec2(n.x, n.y);
+	}
+
+	glm::vec3 LinearToSrgb(glm::vec3 color) {
+		color = glm::clamp(color, 0.0f, 1.0f);
+		return glm::mix(color * 12.92f, 1.055f * glm::pow(color, glm::vec3(1.0f / 2.4f)) - 0.055f, glm::step(glm::vec3(0.0031308f), color));
+	}
+
+	glm::vec3 SrgbToLinear(const glm::vec3& color) {
+		return glm::mix(color / 12.92f, glm::pow((color + 0.055f) / 1.055f, glm::vec3(2.4f)), glm::step(glm::vec3(0.04045f), color));
+	}
+
+	glm::vec3 Filmic(const glm::vec3& x) {
+		glm::vec3 X = glm::max(glm::vec3(0.0f), x - 0.004f);
+		glm::vec3 result = (X * (6.2f * X + 0.5f)) / (X * (6.2f * X + 1.7f) + 0.06f);
+		return glm::pow(result, glm::vec3(2.2f));
+	}
+
+	/////////////////////////
+	//                     //
+	//     Ray tracing     //
+
+	struct RayPayload {
+		int hitType = HIT_TYPE_UNDEFINED;
+		glm::vec3 color = glm::vec3(0);
+		glm::vec3 normal = glm::vec3(0);
+		glm::vec3 nextFactor = glm::vec3(0);
+		glm::vec3 nextRayOrigin = glm::vec3(0);
+		glm::vec3 nextRayDirection = glm::vec3(0);
+		uint32_t seed = 0;
+		int bounce = 0;
+		int writeToImageStore = 1;
+		glm::vec3 vertexNormal = glm::vec3(0);
+		float meshIndex = 0;
+		float alpha = 1.0f;
+	};
+
+	struct TraceContext {
+		const SceneSnapshot& snapshot;
+		const SceneAccel& scene;
+		glm::mat4 viewInverse;
+		glm::mat4 projInverse;
+		glm::uvec2 launchId;
+	};
+
+	LightRenderInfo GetLight(const SceneSnapshot& snapshot, size_t index) {
+		return (index < snapshot.lights.size()) ? snapshot.lights[index] : LightRenderInfo{ glm::vec4(0), glm::vec4(0) };
+	}
+
+	glm::vec3 CalculatePBR(const TraceContext& ctx, RayPayload& payload, const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float hitT, const glm::vec3& baseColor, const glm::vec3& normal, float roughness, float metallic, const glm::vec3& worldPos, const glm::vec3& camPos, const LightRenderInfo& light, int materialType) {
+		float fresnelReflect = 0.8f;
+		glm::vec3 lightPos = glm::vec3(light.position);
+		glm::vec3 viewDir = glm::normalize(camPos - worldPos);
+		float lightRadiance = 20.0f;
+		glm::vec3 lightDir = glm::normalize(lightPos - worldPos);
+		float lightDist = std::max(glm::length(lightPos - worldPos), 0.1f);
+		float lightAttenuation = glm::clamp(1.0f / (lightDist * lightDist), 0.0f, 1.0f);
+		float irradiance = std::max(glm::dot(lightDir, normal), 0.0f) * lightAttenuation * lightRadiance;
+
+		glm::vec3 radiance = glm::vec3(0.0f);
+		glm::vec3 specularContribution = glm::vec3(0.0f);
+		if (irradiance > 0.0f) {
+			glm::vec3 brdf = MicrofacetBRDF(lightDir, viewDir, normal, baseColor, metallic, fresnelReflect, roughness, specularContribution);
+			radiance += brdf * irradiance * glm::vec3(light.color);
+		}
+		if (payload.bounce > 0) {
+			radiance = glm::clamp(radiance, 0.0f, 0.1275f);
+		}
+		glm::vec3 finalColor = radiance * CalculateDoomFactor(worldPos, camPos, 1.0f);
+
+		glm::vec3 random = RandomPcg3d(glm::uvec3(ctx.launchId.x, ctx.launchId.y, payload.bounce + payload.seed * 6341));
+		glm::vec3 nextFactor = glm::vec3(0.0f);
+		SampleMicrofacetBRDF(viewDir, normal, baseColor, metallic, fresnelReflect, roughness, random, nextFactor);
+		payload.nextFactor = nextFactor;
+
+		// The shader loops over 4 shadow rays but feeds each the same random.x, so they all trace the same direction
+		glm::vec3 origin = rayOrigin + rayDirection * hitT;
+		glm::vec3 lightVector = RandomDirInCone2(origin, lightPos, random.x, 0.05f);
+		bool isShadowed = Bvh::Cpu::AnyHit(ctx.scene.sceneBvhId, worldPos, lightVector, 0.001f, glm::distance(lightPos, origin), Bvh::Cpu::RAY_FLAG_CULL_FRONT_FACING);
+		float shadowFactor = isShadowed ? 1.0f : 0.0f;
+
+		payload.color *= glm::vec3(1.0f - shadowFactor);
+		finalColor *= glm::vec3(1.0f - shadowFactor);
+
+		// Glass (refraction)
+		if (materialType == 2 && !isShadowed) {
+			finalColor = specularContribution * glm::vec3(light.color) * glm::vec3(0.5f);
+			payload.color = finalColor;
+		}
+		// LAPTOP_DISPLAY
+		if (materialType == 3) {
+			finalColor = glm::mix(finalColor, baseColor + specularContribution, 0.85f);
+			payload.color = baseColor * 0.99f;
+		}
+		return finalColor;
+	}
+
+	void ClosestHit(const TraceContext& ctx, RayPayload& payload, const glm::vec3& rayOrigin, const glm::vec3& rayDirection, const Bvh::Cpu::RayHitInfo& hit) {
+		const SceneSnapshot& snapshot = ctx.snapshot;
+		const MeshInstance& meshInstance = snapshot.instances[hit.instanceIndex];
+		const glm::mat3& normalMatrix = ctx.scene.normalMatrices[hit.instanceIndex];
+		payload.meshIndex = (float)hit.instanceIndex;
+
+		int materialType = meshInstance.materialType;
+		glm::vec3 barycentrics = glm::vec3(1.0f - hit.barycentrics.x - hit.barycentrics.y, hit.barycentrics.x, hit.barycentrics.y);
+
+		const Vertex& v0 = snapshot.vertices[snapshot.indices[3 * hit.primitiveIndex + meshInstance.indexOffset] + meshInstance.vertexOffset];
+		const Vertex& v1 = snapshot.vertices[snapshot.indices[3 * hit.primitiveIndex + 1 + meshInstance.indexOffset] + meshInstance.vertexOffset];
+		const Vertex& v2 = snapshot.vertices[snapshot.indices[3 * hit.primitiveIndex + 2 + meshInstance.indexOffset] + meshInstance.vertexOffset];
+
+		// There's no laptop render texture on the CPU, so the laptop display (materialType 3) shows its base color texture
+		glm::vec2 texCoord = v0.uv * barycentrics.x + v1.uv * barycentrics.y + v2.uv * barycentrics.z;
+		glm::vec4 baseColor = SampleTexture(snapshot, meshInstance.basecolorIndex, texCoord);
+		glm::vec3 rma = glm::vec3(SampleTexture(snapshot, meshInstance.rmaIndex, texCoord));
+		glm::vec3 normalMap = glm::vec3(SampleTexture(snapshot, meshInstance.normalIndex, texCoord));
+
+		// Normal
+		glm::vec3 vnormal = glm::normalize(v0.normal * barycentrics.x + v1.normal * barycentrics.y + v2.normal * barycentrics.z);
+		glm::vec3 normal = glm::normalize(normalMatrix * vnormal);
+		glm::vec3 geonrm = glm::normalize(glm::cross(v1.position - v0.position, v2.position - v0.position));
+		geonrm = glm::normalize(normalMatrix * geonrm);
+		glm::vec3 tangent = glm::normalize(v0.tangent * barycentrics.x + v1.tangent * barycentrics.y + v2.tangent * barycentrics.z);
+		tangent = glm::normalize(normalMatrix * tangent);
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+
+		glm::vec4 modelSpaceHitPos = glm::vec4(v0.position * barycentrics.x + v1.position * barycentrics.y + v2.position * barycentrics.z, 1.0f);
+		glm::vec3 worldPos = glm::vec3(meshInstance.worldMatrix * modelSpaceHitPos);
+
+		// Adjusting normal
+		const glm::vec3 V = -rayDirection;
+		if (glm::dot(geonrm, V) < 0) {
+			geonrm = -geonrm;
+		}
+		if (glm::dot(geonrm, normal) < 0) {
+			normal = -normal;
+			tangent = -tangent;
+			bitangent = -bitangent;
+		}
+		glm::mat3 tbn = glm::mat3(glm::normalize(bitangent), glm::normalize(tangent), glm::normalize(normal));
+		payload.vertexNormal = normal;
+
+		if (materialType != 1) {
+			normal = glm::normalize(tbn * glm::normalize(normalMap * 2.0f - 1.0f));
+		}
+
+		float roughness = rma.r;
+		float metallic = rma.g;
+		glm::vec3 camPos = snapshot.viewPos;
+
+		payload.color = glm::vec3(0);
+		payload.normal = normal;
+		payload.nextRayOrigin = worldPos;
+		payload.nextFactor = glm::vec3(0);
+		payload.alpha = 1.0f;
+
+		// Bedroom light
+		LightRenderInfo light0 = GetLight(snapshot, 0);
+		light0.color *= glm::vec4(1, 0.95f, 0.95f, 1);
+		light0.color *= 0.75f * 0.5f;
+		glm::vec3 directLighting = CalculatePBR(ctx, payload, rayOrigin, rayDirection, hit.distance, glm::vec3(baseColor), normal, roughness, metallic, worldPos, camPos, light0, materialType);
+
+		// Bathroom light
+		LightRenderInfo light1 = GetLight(snapshot, 1);
+		light1.color *= glm::vec4(1, 0.8f, 0.8f, 1);
+		light1.color *= glm::vec4(1, 0.0f, 0.0f, 1);
+		light1.color *= 0.5f * 0.5f;
+		directLighting += CalculatePBR(ctx, payload, rayOrigin, rayDirection, hit.distance, glm::vec3(baseColor), normal, roughness, metallic, worldPos, camPos, light1, materialType);
+
+		if (baseColor.a < 0.99f) {
+			payload.hitType = HIT_TYPE_TRANSULUCENT;
+			payload.nextRayDirection = rayDirection;
+			payload.nextRayOrigin = worldPos + (rayDirection * 0.001f);
+			payload.alpha = baseColor.a;
+		}
+		else if (materialType == 1) {
+			payload.hitType = HIT_TYPE_MIRROR;
+			payload.nextRayDirection = glm::reflect(rayDirection, normal);
+			payload.nextFactor = glm::vec3(1);
+			payload.color = glm::vec3(0);
+		}
+		else if (materialType == 2) {
+			payload.hitType = HIT_TYPE_GLASS;
+			float ratio = 1.00f / 1.52f;
+			glm::vec3 I = glm::normalize(worldPos - camPos);
+			payload.nextRayDirection = glm::refract(I, glm::normalize(normal), ratio);
+			payload.nextFactor = glm::vec3(1);
+		}
+		else {
+			payload.hitType = HIT_TYPE_SOLID;
+			payload.color = directLighting;
+		}
+
+		// Disable output of walls to the final image if in inventory
+		if (payload.bounce == 0 && snapshot.wallPaperALBIndex >= 0 && meshInstance.basecolorIndex == snapshot.wallPaperALBIndex) {
+			payload.writeToImageStore = 0;
+		}
+	}
+
+	void Miss(RayPayload& payload) {
+		payload.hitType = HIT_TYPE_MISS;
+		payload.color = glm::vec3(0);
+		payload.normal = glm::vec3(0);
+		payload.nextRayOrigin = glm::vec3(0);
+		payload.nextFactor = glm::vec3(0);
+		payload.nextRayDirection = glm::vec3(0);
+	}
+
+	void TraceRayEXT(const TraceContext& ctx, RayPayload& payload, glm::vec3 origin, float tMin, glm::vec3 direction, float tMax) {
+		Bvh::Cpu::RayHitInfo hit = Bvh::Cpu::ClosestHit(ctx.scene.sceneBvhId, origin, direction, tMin, tMax);
+		if (hit.found) {
+			ClosestHit(ctx, payload, origin, direction, hit);
+		}
+		else {
+			Miss(payload);
+		}
+	}
+
+	// path_raygen.rgen for a single pixel
+	void RayGen(TraceContext& ctx, const Settings& settings, RenderTargets& targets) {
+		const SceneSnapshot& snapshot = ctx.snapshot;
+		glm::uvec2 pixel = ctx.launchId;
+		const glm::vec2 pixelCenter = glm::vec2(pixel) + glm::vec2(0.5f);
+		const glm::vec2 inUV = pixelCenter / glm::vec2(settings.width, settings.height);
+		glm::vec2 d = inUV * 2.0f - 1.0f;
+
+		glm::vec4 origin = ctx.viewInverse * glm::vec4(0, 0, 0, 1);
+		glm::vec4 target = ctx.projInverse * glm::vec4(d.x, d.y, 1, 1);
+		float tmin = 0.001f;
+		float tmax = 10000.0f;
+
+		RayPayload payload;
+		glm::vec3 firstBounce = glm::vec3(0.0f);
+		glm::vec3 secondBounce = glm::vec3(0.0f);
+		glm::vec3 finalNormal = glm::vec3(0);
+		glm::vec3 baseColor = glm::vec3(0);
+		uint32_t seed = snapshot.frameIndex;
+
+		for (int i = 0; i < snapshot.sampleCount; i++) {
+			seed += i;
+
+			payload = RayPayload();
+			payload.seed = seed;
+
+			glm::vec3 transparentAccumulation = glm::vec3(0);
+			glm::vec4 direction = ctx.viewInverse * glm::vec4(glm::normalize(glm::vec3(target) / target.w), 0);
+
+			payload.nextRayOrigin = glm::vec3(origin);
+			payload.nextRayDirection = glm::normalize(glm::vec3(direction));
+			payload.nextFactor = glm::vec3(1.0f);
+
+			glm::vec3 contribution = glm::vec3(1.0f);
+
+			// First bounce, translucent, mirror and glass hits continue along the next ray
+			for (int j = 0; j < MAX_FIRST_BOUNCE_ITERATIONS; j++) {
+				payload.bounce = 0;
+				TraceRayEXT(ctx, payload, payload.nextRayOrigin, tmin, payload.nextRayDirection, tmax);
+
+				firstBounce = payload.color;
+				contribution *= payload.nextFactor;
+				finalNormal = payload.normal;
+
+				if (payload.hitType == HIT_TYPE_TRANSULUCENT) {
+					transparentAccumulation += payload.color * payload.alpha;
+				}
+				else if (payload.hitType != HIT_TYPE_MIRROR && payload.hitType != HIT_TYPE_GLASS) {
+					break;
+				}
+			}
+
+			firstBounce += transparentAccumulation;
+			baseColor = contribution;
+
+			// Second bounce, cosine weighted around the first hit normal
+			glm::vec3 random = RandomPcg3d(glm::uvec3(pixel.x, pixel.y, i + payload.seed * 6341));
+			float theta = std::asin(std::sqrt(random.y));
+			float phi = 2.0f * PI * random.x;
+			glm::vec3 localDiffuseDir = glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+			glm::vec3 indirectRayOrigin = payload.nextRayOrigin;
+			glm::vec3 indirectRayDirection = GetNormalSpace(finalNormal) * localDiffuseDir;
+
+			payload.bounce = 1;
+			TraceRayEXT(ctx, payload, indirectRayOrigin, tmin, indirectRayDirection, tmax);
+			secondBounce = payload.color;
+		}
+
+		// Matches the shader, which divides the last sample's second hit by the sample count
+		secondBounce = secondBounce / (float)snapshot.sampleCount;
+
+		size_t index = (size_t)pixel.y * targets.width + pixel.x;
+		if (payload.writeToImageStore == 1) {
+			targets.firstHitColor[index] = glm::vec4(firstBounce, 0);
+			targets.firstHitNormals[index] = glm::vec4(OctEncode(finalNormal), 0, 0);
+			targets.firstHitBaseColor[index] = glm::vec4(LinearToSrgb(baseColor), 0);
+			targets.secondHitColor[index] = glm::vec4(secondBounce, 0);
+		}
+	}
+
+	RenderTargets Render(const SceneSnapshot& snapshot, const Settings& settings) {
+		auto startTime = std::chrono::steady_clock::now();
+		uint32_t workerCount = (settings.threadCount > 0) ? (uint32_t)settings.threadCount : std::max(1u, std::thread::hardware_concurrency());
+
+		SceneAccel scene = BuildSceneAccel(snapshot, workerCount);
+		std::chrono::duration<float> buildDuration = std::chrono::steady_clock::now() - startTime;
+
+		RenderTargets targets;
+		targets.width = settings.width;
+		targets.height = settings.height;
+		size_t pixelCount = (size_t)settings.width * settings.height;
+		targets.firstHitColor.resize(pixelCount, glm::vec4(0));
+		targets.firstHitNormals.resize(pixelCount, glm::vec4(0));
+		targets.firstHitBaseColor.resize(pixelCount, glm::vec4(0));
+		targets.secondHitColor.resize(pixelCount, glm::vec4(0));
+
+		glm::mat4 viewInverse = glm::inverse(snapshot.view);
+		glm::mat4 projInverse = glm::inverse(snapshot.proj);
+
+		int tileSize = std::max(1, settings.tileSize);
+		int tilesX = (settings.width + tileSize - 1) / tileSize;
+		int tilesY = (settings.height + tileSize - 1) / tileSize;
+
+		// Each worker pulls the next tile, so expensive tiles (glass, mirrors) don't hold the rest up
+		Util::ParallelFor((uint32_t)(tilesX * tilesY), workerCount, [&](uint32_t tile) {
+			int x0 = (tile % tilesX) * tileSize;
+			int y0 = (tile / tilesX) * tileSize;
+			TraceContext ctx = { snapshot, scene, viewInverse, projInverse, glm::uvec2(0) };
+			for (int y = y0; y < std::min(y0 + tileSize, settings.height); y++) {
+				for (int x = x0; x < std::min(x0 + tileSize, settings.width); x++) {
+					ctx.launchId = glm::uvec2(x, y);
+					RayGen(ctx, settings, targets);
+				}
+			}
+		});
+		DestroySceneAccel(scene);
+
+		std::chrono::duration<float> totalDuration = std::chrono::steady_clock::now() - startTime;
+		std::cout << "[Reference Path Tracer] Rendered " << settings.width << "x" << settings.height << " at " << snapshot.sampleCount << "spp on " << workerCount << " threads in " << totalDuration.count() * 1000.0f << "ms (BVH build " << buildDuration.count() * 1000.0f << "ms)\n";
+		return targets;
+	}
+
+	std::vector<glm::vec3> Composite(const RenderTargets& targets) {
+		std::vector<glm::vec3> output(targets.firstHitColor.size());
+		for (size_t i = 0; i < output.size(); i++) {
+			glm::vec3 firstHitColor = glm::vec3(targets.firstHitColor[i]);
+			glm::vec3 secondHitColor = glm::vec3(targets.secondHitColor[i]);
+			glm::vec3 firstHitBaseColor = SrgbToLinear(glm::vec3(targets.firstHitBaseColor[i]));
+
+			glm::vec3 finalColor = glm::mix(firstHitColor, secondHitColor * firstHitBaseColor, 0.8f);
+
+			// Tonemap
+			finalColor = glm::pow(glm::max(finalColor, glm::vec3(0.0f)), glm::vec3(1.0f / 2.2f));
+			finalColor = Tonemap_ACES(finalColor);
+
+			// Brightness and contrast
+			finalColor = finalColor * 1.25f;
+			finalColor = finalColor + glm::vec3(-0.08f);
+
+			// Temperature
+			finalColor = glm::mix(finalColor, finalColor * ColorTemperatureToRGB(225.0f), 1.75f);
+
+			// Filmic tonemapping
+			finalColor = glm::mix(finalColor, Filmic(finalColor), 0.75f);
+			output[i] = finalColor;
+		}
+		return output;
+	}
+
+	bool WriteImage(const std::string& path, int width, int height, const std::vector<glm::vec3>& pixels) {
+		std::vector<uint8_t> data(pixels.size() * 4);
+		for (size_t i = 0; i < pixels.size(); i++) {
+			glm::vec3 c = glm::clamp(pixels[i], 0.0f, 1.0f);
+			data[i * 4 + 0] = (uint8_t)(c.r * 255.0f + 0.5f);
+			data[i * 4 + 1] = (uint8_t)(c.g * 255.0f + 0.5f);
+			data[i * 4 + 2] = (uint8_t)(c.b * 255.0f + 0.5f);
+			data[i * 4 + 3] = 255;
+		}
+		AssetManager::SaveImageData(path, width, height, 4, data.data());
+		return std::filesystem::exists(path);
+	}
+
+	bool WriteImages(const RenderTargets& targets, const std::string& directory) {
+		std::filesystem::create_directories(directory);
+
+		auto toRgb = [](const std::vector<glm::vec4>& target, glm::vec3 scale, glm::vec3 bias) {
+			std::vector<glm::vec3> pixels(target.size());
+			for (size_t i = 0; i < target.size(); i++) {
+				pixels[i] = glm::vec3(target[i]) * scale + bias;
+			}
+			return pixels;
+		};
+		// Octahedral normals are in [-1, 1], the z channel is unused
+		bool success = true;
+		success &= WriteImage(directory + "/first_hit_color.png", targets.width, targets.height, toRgb(targets.firstHitColor, glm::vec3(1), glm::vec3(0)));
+		success &= WriteImage(directory + "/first_hit_normals.png", targets.width, targets.height, toRgb(targets.firstHitNormals, glm::vec3(0.5f, 0.5f, 0.0f), glm::vec3(0.5f, 0.5f, 0.0f)));
+		success &= WriteImage(directory + "/first_hit_base_color.png", targets.width, targets.height, toRgb(targets.firstHitBaseColor, glm::vec3(1), glm::vec3(0)));
+		success &= WriteImage(directory + "/second_hit_color.png", targets.width, targets.height, toRgb(targets.secondHitColor, glm::vec3(1), glm::vec3(0)));
+		success &= WriteImage(directory + "/composite.png", targets.width, targets.height, Composite(targets));
+
+		if (!success) {
+			std::cout << "[Reference Path Tracer] Failed to write images to " << directory << "\n";
+		}
+		return success;
+	}
+
+	//////////////////////
+	//                  //
+	//     Snapshot     //
+
+	SceneSnapshot CaptureScene(bool debugScene) {
+		SceneSnapshot snapshot;
+		snapshot.proj = GameData::GetProjectionMatrix();
+		snapshot.view = GameData::GetViewMatrix();
+		snapshot.viewPos = GameData::GetCameraPosition();
+		snapshot.frameIndex = 0; // Fixed so captures of the same view render identically
+		snapshot.sampleCount = 4;
+		snapshot.vertices = AssetManager::GetVertices_TEMPORARY();
+		snapshot.indices = AssetManager::GetIndices_TEMPORARY();
+		for (MeshOLD& mesh : AssetManager::GetMeshList()) {
+			snapshot.meshIndexCounts.push_back(mesh.m_indexCount);
+		}
+		snapshot.instances = Scene::GetSceneMeshInstances(debugScene);
+		FrameVector<LightRenderInfo> lights = Scene::GetLightRenderInfo();
+		snapshot.lights.assign(lights.begin(), lights.end());
+
+		// Pixels aren't kept after upload, so reload the source image of every texture the instances use
+		std::unordered_map<std::string, FileInfoOLD> sourceFiles;
+		for (const auto& entry : std::filesystem::directory_iterator("res/textures/")) {
+			FileInfoOLD info = Util::GetFileInfo(entry);
+			if (info.filetype == "png" || info.filetype == "tga" || info.filetype == "jpg") {
+				sourceFiles[info.filename] = info;
+			}
+		}
+		snapshot.textures.resize(AssetManager::GetNumberOfTextures());
+		for (const MeshInstance& instance : snapshot.instances) {
+			for (int textureIndex : { instance.basecolorIndex, instance.normalIndex, instance.rmaIndex }) {
+				if (textureIndex < 0 || textureIndex >= (int)snapshot.textures.size() || !snapshot.textures[textureIndex].pixels.empty()) continue;
+
+				auto it = sourceFiles.find(AssetManager::GetTexture(textureIndex)->_filename);
+				if (it == sourceFiles.end()) continue;
+
+				TextureData& texture = snapshot.textures[textureIndex];
+				int channelCount = 0;
+				stbi_uc* pixels = stbi_load(it->second.fullpath.c_str(), &texture.width, &texture.height, &channelCount, STBI_rgb_alpha);
+				if (!pixels) {
+					std::cout << "[Reference Path Tracer] Failed to load " << it->second.fullpath << "\n";
+					continue;
+				}
+				texture.srgb = (it->second.materialType == "ALB" || it->second.filename.substr(0, 2) == "OS");
+				texture.pixels.assign(pixels, pixels + (size_t)texture.width * texture.height * 4);
+				stbi_image_free(pixels);
+			}
+		}
+		return snapshot;
+	}
+
+	template<typename T>
+	void WriteVector(std::ofstream& file, const std::vector<T>& data) {
+		uint64_t count = data.size();
+		file.write((const char*)&count, sizeof(count));
+		file.write((const char*)data.data(), sizeof(T) * count);
+	}
+
+	uint64_t BytesRemaining(std::ifstream& file) {
+		std::streampos position = file.tellg();
+		file.seekg(0, std::ios::end);
+		std::streampos end = file.tellg();
+		file.seekg(position);
+		return (position < 0 || end < position) ? 0 : (uint64_t)(end - position);
+	}
+
+	// The count comes straight from the file, a corrupt one must not turn into a huge allocation
+	template<typename T>
+	bool ReadVector(std::ifstream& file, std::vector<T>& data) {
+		uint64_t count = 0;
+		file.read((char*)&count, sizeof(count));
+		if (!file || count > BytesRemaining(file) / sizeof(T)) return false;
+		data.resize(count);
+		file.read((char*)data.data(), sizeof(T) * count);
+		return (bool)file;
+	}
+
+	bool SaveSnapshot(const SceneSnapshot& snapshot, const std::string& path) {
+		std::ofstream file(path, std::ios::binary);
+		if (!file) {
+			std::cout << "[Reference Path Tracer] Failed to open " << path << " for writing\n";
+			return false;
+		}
+		file.write((const char*)&SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+		file.write((const char*)&SNAPSHOT_VERSION, sizeof(SNAPSHOT_VERSION));
+		file.write((const char*)&snapshot.proj, sizeof(snapshot.proj));
+		file.write((const char*)&snapshot.view, sizeof(snapshot.view));
+		file.write((const char*)&snapshot.viewPos, sizeof(snapshot.viewPos));
+		file.write((const char*)&snapshot.frameIndex, sizeof(snapshot.frameIndex));
+		file.write((const char*)&snapshot.sampleCount, sizeof(snapshot.sampleCount));
+		file.write((const char*)&snapshot.wallPaperALBIndex, sizeof(snapshot.wallPaperALBIndex));
+		WriteVector(file, snapshot.vertices);
+		WriteVector(file, snapshot.indices);
+		WriteVector(file, snapshot.meshIndexCounts);
+		WriteVector(file, snapshot.instances);
+		WriteVector(file, snapshot.lights);
+
+		uint64_t textureCount = snapshot.textures.size();
+		file.write((const char*)&textureCount, sizeof(textureCount));
+		for (const TextureData& texture : snapshot.textures) {
+			uint32_t srgb = texture.srgb ? 1 : 0;
+			file.write((const char*)&texture.width, sizeof(texture.width));
+			file.write((const char*)&texture.height, sizeof(texture.height));
+			file.write((const char*)&srgb, sizeof(srgb));
+			WriteVector(file, texture.pixels);
+		}
+		return (bool)file;
+	}
+
+	// Every instance's index range, and every vertex those indices reach, has to lie inside the shared buffers.
+	// Instances with an out of range meshIndex are skipped everywhere, so only the mesh data is checked.
+	bool ValidateSnapshot(const SceneSnapshot& snapshot) {
+		for (const MeshInstance& instance : snapshot.instances) {
+			if (instance.meshIndex < 0 || (size_t)instance.meshIndex >= snapshot.meshIndexCounts.size()) continue;
+
+			uint32_t indexCount = snapshot.meshIndexCounts[instance.meshIndex];
+			if (instance.indexOffset < 0 || instance.vertexOffset < 0 || (size_t)instance.indexOffset + indexCount > snapshot.indices.size()) {
+				return false;
+			}
+			for (uint32_t i = 0; i < indexCount; i++) {
+				if ((size_t)instance.vertexOffset + snapshot.indices[instance.indexOffset + i] >= snapshot.vertices.size()) {
+					return false;
+				}
+			}
+		}
+		for (const TextureData& texture : snapshot.textures) {
+			if (texture.width < 0 || texture.height < 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool LoadSnapshot(const std::string& path, SceneSnapshot& snapshot) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			std::cout << "[Reference Path Tracer] Failed to open " << path << "\n";
+			return false;
+		}
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		file.read((char*)&magic, sizeof(magic));
+		file.read((char*)&version, sizeof(version));
+		if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION) {
+			std::cout << "[Reference Path Tracer] " << path << " is not a version " << SNAPSHOT_VERSION << " scene snapshot\n";
+			return false;
+		}
+		file.read((char*)&snapshot.proj, sizeof(snapshot.proj));
+		file.read((char*)&snapshot.view, sizeof(snapshot.view));
+		file.read((char*)&snapshot.viewPos, sizeof(snapshot.viewPos));
+		file.read((char*)&snapshot.frameIndex, sizeof(snapshot.frameIndex));
+		file.read((char*)&snapshot.sampleCount, sizeof(snapshot.sampleCount));
+		file.read((char*)&snapshot.wallPaperALBIndex, sizeof(snapshot.wallPaperALBIndex));
+
+		bool success = ReadVector(file, snapshot.vertices) &&
+			ReadVector(file, snapshot.indices) &&
+			ReadVector(file, snapshot.meshIndexCounts) &&
+			ReadVector(file, snapshot.instances) &&
+			ReadVector(file, snapshot.lights);
+
+		uint64_t textureCount = 0;
+		file.read((char*)&textureCount, sizeof(textureCount));
+		constexpr uint64_t minTextureBytes = sizeof(TextureData::width) + sizeof(TextureData::height) + sizeof(uint32_t) + sizeof(uint64_t);
+		success &= file && textureCount <= BytesRemaining(file) / minTextureBytes;
+		snapshot.textures.resize(success ? textureCount : 0);
+		for (TextureData& texture : snapshot.textures) {
+			uint32_t srgb = 0;
+			file.read((char*)&texture.width, sizeof(texture.width));
+			file.read((char*)&texture.height, sizeof(texture.height));
+			file.read((char*)&srgb, sizeof(srgb));
+			texture.srgb = (srgb != 0);
+			success &= ReadVector(file, texture.pixels);
+		}
+
+		if (!success || !file) {
+			std::cout << "[Reference Path Tracer] " << path << " is truncated\n";
+			return false;
+		}
+		if (!ValidateSnapshot(snapshot)) {
+			std::cout << "[Reference Path Tracer] " << path << " has mesh or texture data out of range\n";
+			return false;
+		}
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include "Hell/Types.h"
+#include "Common.h"
+#include <string>
+#include <vector>
+
+// CPU port of path_raygen.rgen / path_closesthit.rchit. Renders a captured scene into the same four
+// targets the GPU writes, so shader changes can be checked against golden images without an RT capable GPU.
+namespace ReferencePathTracer {
+
+	struct TextureData {
+		int width = 0;
+		int height = 0;
+		bool srgb = false;              // ALB and OS_ textures are uploaded as VK_FORMAT_R8G8B8A8_SRGB
+		std::vector<uint8_t> pixels;    // RGBA8, empty if no instance references the texture
+	};
+
+	// Everything the ray tracing shaders read for a frame
+	struct SceneSnapshot {
+		glm::mat4 proj = glm::mat4(1);
+		glm::mat4 view = glm::mat4(1);
+		glm::vec3 viewPos = glm::vec3(0);
+		int32_t frameIndex = 0;
+		int32_t sampleCount = 4;
+		int32_t wallPaperALBIndex = -1;
+		std::vector<Vertex> vertices;           // g_vertices
+		std::vector<uint32_t> indices;          // g_indices
+		std::vector<uint32_t> meshIndexCounts;  // Indexed by MeshInstance::meshIndex
+		std::vector<MeshInstance> instances;
+		std::vector<LightRenderInfo> lights;
+		std::vector<TextureData> textures;      // Indexed like g_textures
+	};
+
+	struct Settings {
+		int width = 512;
+		int height = 288;
+		int tileSize = 16;
+		int threadCount = 0;                    // 0 uses every hardware thread
+	};
+
+	// Same contents as RT_FirstHit_Color, RT_FirstHit_Normals (octahedral), RT_FirstHit_BaseColor (sRGB encoded) and RT_SecondHit_Color
+	struct RenderTargets {
+		int width = 0;
+		int height = 0;
+		std::vector<glm::vec4> firstHitColor;
+		std::vector<glm::vec4> firstHitNormals;
+		std::vector<glm::vec4> firstHitBaseColor;
+		std::vector<glm::vec4> secondHitColor;
+	};
+
+	SceneSnapshot CaptureScene(bool debugScene);
+	bool SaveSnapshot(const SceneSnapshot& snapshot, const std::string& path);
+	bool LoadSnapshot(const std::string& path, SceneSnapshot& snapshot);
+
+	RenderTargets Render(const SceneSnapshot& snapshot, const Settings& settings);
+
+	// Applies vk_composite.frag, without the denoiser or dynamic resolution
+	std::vector<glm::vec3> Composite(const RenderTargets& targets);
+
+	// Writes first_hit_color.png, first_hit_normals.png, first_hit_base_color.png, second_hit_color.png and composite.png
+	bool WriteImages(const RenderTargets& targets, const std::string& directory);
+}
\ No newline at end of file
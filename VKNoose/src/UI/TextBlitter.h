@@ -4,6 +4,7 @@
 namespace TextBlitter {
 
 	inline std::vector<Extent2Di> _charExtents;
+	inline std::vector<AtlasRegion> _charRegions;
 	inline std::vector<GPUObjectData2D> _objectData;
 
 	inline std::string _debugTextToBilt = "";
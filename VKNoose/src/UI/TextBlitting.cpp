@@ -3,6 +3,8 @@
 #include "../Audio/Audio.h"
 #include "../Game/Scene.h"
 
+#include <unordered_map>
+
 namespace TextBlitter {
 
 	int _xMargin = 16;
@@ -36,6 +38,51 @@ namespace TextBlitter {
 	};
 	std::vector<BlitXY> blitXYs;
 
+	struct TextLayoutKey {
+		std::string text;
+		float x = 0;
+		float y = 0;
+		float scale = 1.0f;
+		int charLimit = 0;
+		int clipMax = 0;
+		bool centered = false;
+		float renderTargetWidth = 0;
+		float renderTargetHeight = 0;
+
+		bool operator==(const TextLayoutKey& other) const = default;
+	};
+
+	struct TextLayoutKeyHash {
+		size_t operator()(const TextLayoutKey& key) const {
+			size_t hash = std::hash<std::string>()(key.text);
+			auto combine = [&hash](size_t value) { hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2); };
+			combine(std::hash<float>()(key.x));
+			combine(std::hash<float>()(key.y));
+			combine(std::hash<float>()(key.scale));
+			combine(std::hash<int>()(key.charLimit));
+			combine(std::hash<int>()(key.clipMax));
+			combine(std::hash<bool>()(key.centered));
+			combine(std::hash<float>()(key.renderTargetWidth));
+			combine(std::hash<float>()(key.renderTargetHeight));
+			return hash;
+		}
+	};
+
+	struct TextLayout {
+		std::vector<GPUObjectData2D> quads;
+		bool usedThisFrame = false;
+	};
+
+	// Laid out strings are kept for as long as they keep being drawn, so unchanged text costs a lookup instead of a rebuild
+	std::unordered_map<TextLayoutKey, TextLayout, TextLayoutKeyHash> _layoutCache;
+	int _glyphLookup[256];
+	bool _glyphLookupBuilt = false;
+
+	int GetGlyphIndex(char character);
+	bool ParseColorTag(const std::string& text, int& i, int& color);
+	void BuildTextLayout(const TextLayoutKey& key, std::vector<GPUObjectData2D>& quads);
+	void AppendTextLayout(const TextLayoutKey& key);
+
 	void TextBlitter::Type(std::string text, float coolDownTimer, float delayTimer) {
 		ResetBlitter();
 		_textToBilt = text;
@@ -88,9 +135,7 @@ namespace TextBlitter {
 
 		_charCursorIndex = (int)_textTime;
 
-		float xcursor = _xMargin;
 		float ycursor = _yMargin;
-		int color = 0; // 0 for white, 1 for green
 
 	
 
@@ -151,86 +196,99 @@ namespace TextBlitter {
 			}
 		}
 
+		for (auto& [key, layout] : _layoutCache) {
+			layout.usedThisFrame = false;
+		}
+
+		// Type blitting
 		if (_delayTimer <= 0) {
-			// Type blitting
-			for (int i = 0; i < _textToBilt.length() && i < _charCursorIndex; i++)
-			{
-				char character = _textToBilt[i];
-				if (_textToBilt[i] == '[' &&
-					_textToBilt[(size_t)i + 1] == 'w' &&
-					_textToBilt[(size_t)i + 2] == ']') {
-					i += 2;
-					color = 0;
-					continue;
-				}
-				if (_textToBilt[i] == '[' &&
-					_textToBilt[(size_t)i + 1] == 'g' &&
-					_textToBilt[(size_t)i + 2] == ']') {
-					i += 2;
-					color = 1;
-					continue;
-				}
-				if (character == ' ') {
-					xcursor += _spaceWidth;
-					continue;
-				}
-				if (character == '\n') {
-					xcursor = _xMargin;
-					ycursor -= _lineHeight;
-					continue;
-				}
+			TextLayoutKey key;
+			key.text = _textToBilt;
+			key.x = _xMargin;
+			key.y = ycursor;
+			key.charLimit = std::min(_charCursorIndex, (int)_textToBilt.length());
+			key.clipMax = 1000; // 512 x 288 didn't work. she was clipper prematurely. this is a hack to fix a bug mate.
+			key.renderTargetWidth = renderTargetWidth;
+			key.renderTargetHeight = renderTargetHeight;
+			AppendTextLayout(key);
+		}
 
-				//std::cout << i << ": " << color << "\n";
+		// Debug text
+		{
+			TextLayoutKey key;
+			key.text = _debugTextToBilt;
+			key.x = _xDebugMargin;
+			key.y = renderTargetHeight - _lineHeight;
+			key.charLimit = (int)_debugTextToBilt.length();
+			key.clipMax = 1000;
+			key.renderTargetWidth = renderTargetWidth;
+			key.renderTargetHeight = renderTargetHeight;
+			AppendTextLayout(key);
+		}
 
-				size_t charPos = _charSheet.find(character);
+		// BlitXY
+		for (auto& blitXY : blitXYs) {
+			TextLayoutKey key;
+			key.text = blitXY.text;
+			key.x = blitXY.x;
+			key.y = blitXY.y;
+			key.scale = blitXY.scale;
+			key.centered = blitXY.centered;
+			key.charLimit = (int)blitXY.text.length();
+			key.clipMax = 99999;
+			key.renderTargetWidth = renderTargetWidth;
+			key.renderTargetHeight = renderTargetHeight;
+			AppendTextLayout(key);
+		}
+		blitXYs.clear();
 
-				float texWidth = _charExtents[charPos].width;
-				float texWHeight = _charExtents[charPos].height;
+		// Anything not drawn this frame is dropped, which keeps the cache to what's on screen
+		std::erase_if(_layoutCache, [](const auto& entry) { return !entry.second.usedThisFrame; });
+	}
 
-				float width = (1.0f / renderTargetWidth) * texWidth;
-				float height = (1.0f / renderTargetHeight) * texWHeight;
-				float cursor_X = ((xcursor + (texWidth / 2.0f)) / renderTargetWidth) * 2 - 1;
-				float cursor_Y = ((ycursor + (texWHeight / 2.0f)) / renderTargetHeight) * 2 - 1;
+	void AppendTextLayout(const TextLayoutKey& key) {
+		if (key.text.empty()) return;
 
-				Transform transform;
-				transform.position.x = cursor_X;
-				transform.position.y = cursor_Y * -1;
-				transform.scale = glm::vec3(width, height * -1, 1);
+		auto it = _layoutCache.find(key);
+		if (it == _layoutCache.end()) {
+			it = _layoutCache.emplace(key, TextLayout()).first;
+			BuildTextLayout(key, it->second.quads);
+		}
+		it->second.usedThisFrame = true;
+		_objectData.insert(_objectData.end(), it->second.quads.begin(), it->second.quads.end());
+	}
 
-				GPUObjectData2D data;
-				data.modelMatrix = transform.to_mat4();
-				data.index_basecolor = charPos;
-				data.index_color = color;
-				data.xClipMin = 0;
-				data.xClipMax = 1000;
-				data.yClipMin = 0;
-				data.yClipMax = 1000; // 512 x 288 didn't work. she was clipper prematurely. this is a hack to fix a bug mate.
-				_objectData.push_back(data);
+	void BuildTextLayout(const TextLayoutKey& key, std::vector<GPUObjectData2D>& quads) {
+		float lineStartX = key.x;
+		int color = 0; // 0 for white, 1 for green
 
-				xcursor += texWidth + _charSpacing;
+		// Find center (NOTE THIS DOES NOT WORK FOR MULTI LINE)
+		if (key.centered) {
+			float xcursor = 0;
+			for (int i = 0; i < (int)key.text.length(); i++) {
+				char character = key.text[i];
+				if (ParseColorTag(key.text, i, color)) {
+					continue;
+				}
+				if (character == ' ') {
+					xcursor += _spaceWidth;
+				}
+				else if (character == '\n') {
+					xcursor = key.x;
+				}
+				else if (int glyph = GetGlyphIndex(character); glyph != -1) {
+					xcursor += _charExtents[glyph].width + _charSpacing;
+				}
 			}
+			lineStartX = (int)(key.x - (xcursor / 2));
+			color = 0;
 		}
 
-		// Debug text
-		float yDebugMargin = renderTargetHeight - _lineHeight;
-		color = 0;
-		xcursor = _xDebugMargin;
-		ycursor = yDebugMargin;
-		for (int i = 0; i < _debugTextToBilt.length(); i++)
-		{
-			char character = _debugTextToBilt[i];
-			if (_debugTextToBilt[i] == '[' &&
-				_debugTextToBilt[(size_t)i + 1] == 'w' &&
-				_debugTextToBilt[(size_t)i + 2] == ']') {
-				i += 2;
-				color = 0;
-				continue;
-			}
-			if (_debugTextToBilt[i] == '[' &&
-				_debugTextToBilt[(size_t)i + 1] == 'g' &&
-				_debugTextToBilt[(size_t)i + 2] == ']') {
-				i += 2;
-				color = 1;
+		float xcursor = lineStartX;
+		float ycursor = key.y;
+		for (int i = 0; i < key.charLimit; i++) {
+			char character = key.text[i];
+			if (ParseColorTag(key.text, i, color)) {
 				continue;
 			}
 			if (character == ' ') {
@@ -238,141 +296,70 @@ namespace TextBlitter {
 				continue;
 			}
 			if (character == '\n') {
-				xcursor = _xDebugMargin;
+				xcursor = lineStartX;
 				ycursor -= _lineHeight;
 				continue;
 			}
-			size_t charPos = _charSheet.find(character);
-
-			if (charPos == std::string::npos) {
-				//std::cout << character << " was not found in _charSheet\n";
+			int glyph = GetGlyphIndex(character);
+			if (glyph == -1) {
 				continue;
 			}
 
-			float texWidth = _charExtents[charPos].width;
-			float texWHeight = _charExtents[charPos].height;
+			float texWidth = _charExtents[glyph].width;
+			float texHeight = _charExtents[glyph].height;
 
-			float width = (1.0f / renderTargetWidth) * texWidth;
-			float height = (1.0f / renderTargetHeight) * texWHeight;
-			float cursor_X = ((xcursor + (texWidth / 2.0f)) / renderTargetWidth) * 2 - 1;
-			float cursor_Y = ((ycursor + (texWHeight / 2.0f)) / renderTargetHeight) * 2 - 1;
+			float width = (1.0f / key.renderTargetWidth) * texWidth * key.scale;
+			float height = (1.0f / key.renderTargetHeight) * texHeight * key.scale;
+			float cursor_X = ((xcursor + (texWidth / 2.0f)) / key.renderTargetWidth) * 2 - 1;
+			float cursor_Y = ((ycursor + (texHeight / 2.0f)) / key.renderTargetHeight) * 2 - 1;
 
 			Transform transform;
 			transform.position.x = cursor_X;
 			transform.position.y = cursor_Y * -1;
 			transform.scale = glm::vec3(width, height * -1, 1);
 
-			GPUObjectData2D data;
+			GPUObjectData2D& data = quads.emplace_back();
 			data.modelMatrix = transform.to_mat4();
-			data.index_basecolor = charPos;
+			data.index_basecolor = _charRegions[glyph].textureIndex;
+			data.uvRect = _charRegions[glyph].uvRect;
 			data.index_color = color;
 			data.xClipMin = 0;
-			data.xClipMax = 1000;
+			data.xClipMax = key.clipMax;
 			data.yClipMin = 0;
-			data.yClipMax = 1000; // 512 x 288 didn't work. she was clipper prematurely. this is a hack to fix a bug mate.
-			_objectData.push_back(data);
+			data.yClipMax = key.clipMax;
 
 			xcursor += texWidth + _charSpacing;
 		}
+	}
 
-		// BlitXY
-		for (auto& blitXY : blitXYs) {
-
-			// Find center (NOTE THIS DOES NOT WORK FOR MULTI LINE)
-			if (blitXY.centered) {
-				xcursor = 0;
-				for (int i = 0; i < blitXY.text.length(); i++) {
-					char character = blitXY.text[i];
-					if (blitXY.text[i] == '[' &&
-						blitXY.text[(size_t)i + 1] == 'w' &&
-						blitXY.text[(size_t)i + 2] == ']') {
-						i += 2;
-						color = 0;
-						continue;
-					}
-					if (blitXY.text[i] == '[' &&
-						blitXY.text[(size_t)i + 1] == 'g' &&
-						blitXY.text[(size_t)i + 2] == ']') {
-						i += 2;
-						color = 1;
-						continue;
-					}
-					if (character == ' ') {
-						xcursor += _spaceWidth;
-						continue;
-					}
-					if (character == '\n') {
-						xcursor = blitXY.x;
-						ycursor -= _lineHeight;
-						continue;
-					}
-					size_t charPos = _charSheet.find(character);
-					float texWidth = _charExtents[charPos].width;
-					xcursor += texWidth + _charSpacing;
-				}
-				blitXY.x -= (xcursor / 2);
-			}
-
+	bool ParseColorTag(const std::string& text, int& i, int& color) {
+		if (text[i] != '[' || i + 2 >= (int)text.length() || text[i + 2] != ']') {
+			return false;
+		}
+		if (text[i + 1] == 'w') {
 			color = 0;
-			xcursor = blitXY.x;
-			ycursor = blitXY.y;
-
-			// Blit
-			for (int i = 0; i < blitXY.text.length(); i++)
-			{
-				char character = blitXY.text[i];
-				if (blitXY.text[i] == '[' &&
-					blitXY.text[(size_t)i + 1] == 'w' &&
-					blitXY.text[(size_t)i + 2] == ']') {
-					i += 2;
-					color = 0;
-					continue;
-				}
-				if (blitXY.text[i] == '[' &&
-					blitXY.text[(size_t)i + 1] == 'g' &&
-					blitXY.text[(size_t)i + 2] == ']') {
-					i += 2;
-					color = 1;
-					continue;
-				}
-				if (character == ' ') {
-					xcursor += _spaceWidth;
-					continue;
-				}
-				if (character == '\n') {
-					xcursor = blitXY.x;
-					ycursor -= _lineHeight;
-					continue;
-				}
-				size_t charPos = _charSheet.find(character);
-
-				float texWidth = _charExtents[charPos].width;
-				float texWHeight = _charExtents[charPos].height;
-
-				float width = (1.0f / renderTargetWidth) * texWidth * blitXY.scale;
-				float height = (1.0f / renderTargetHeight) * texWHeight * blitXY.scale;
-				float cursor_X = ((xcursor + (texWidth / 2.0f)) / renderTargetWidth) * 2 - 1;
-				float cursor_Y = ((ycursor + (texWHeight / 2.0f)) / renderTargetHeight) * 2 - 1;
-
-				Transform transform;
-				transform.position.x = cursor_X;
-				transform.position.y = cursor_Y * -1;
-				transform.scale = glm::vec3(width, height * -1, 1);
-
-				GPUObjectData2D data;
-				data.modelMatrix = transform.to_mat4();
-				data.index_basecolor = charPos;
-				data.index_color = color;
-				data.xClipMin = 0;
-				data.xClipMax = 99999;
-				data.yClipMin = 0;
-				data.yClipMax = 99999; // 512 x 288 didn't work. she was clipper prematurely. this is a hack to fix a bug mate.
-				_objectData.push_back(data);
-
-				xcursor += texWidth + _charSpacing;
+		}
+		else if (text[i + 1] == 'g') {
+			color = 1;
+		}
+		else {
+			return false;
+		}
+		i += 2;
+		return true;
+	}
+
+	int GetGlyphIndex(char character) {
+		// 256 entry table in place of _charSheet.find(), the reverse fill keeps the first occurrence like find() did
+		if (!_glyphLookupBuilt) {
+			std::fill(std::begin(_glyphLookup), std::end(_glyphLookup), -1);
+			for (int i = (int)_charSheet.length() - 1; i >= 0; i--) {
+				_glyphLookup[(uint8_t)_charSheet[i]] = i;
 			}
+			_glyphLookupBuilt = true;
 		}
-		blitXYs.clear();
+		int glyph = _glyphLookup[(uint8_t)character];
+		return (glyph < (int)_charExtents.size()) ? glyph : -1;
 	}
 
 	void TextBlitter::BlitAtPosition(std::string text, int x, int y, bool centered, float scale)
@@ -5,9 +5,14 @@
 #include <vector>
 #include <algorithm>
 #include "Common.h"
+#include "Profiler.h"
+#include "Hell/Core/JobSystem.h"
 #include <sstream>
 #include <iomanip> // setprecision
 #include <filesystem>
+#include <atomic>
+#include <deque>
+#include <thread>
 
 namespace Util {
 	// File
@@ -63,6 +68,69 @@ namespace Util {
 		return LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (HI - LO)));
 	}
 
+	inline thread_local bool g_parallelForWorker = false;
+
+	// True on a ParallelFor worker, where a nested ParallelFor runs on the calling thread
+	inline bool IsParallelForWorker() {
+		return g_parallelForWorker;
+	}
+
+	// Jobs have to outlive their submission, a worker can still hold one it lost to Wait(), so each thread keeps its helpers around
+	inline std::deque<JobSystem::Job>& GetParallelForJobs(uint32_t count) {
+		thread_local std::deque<JobSystem::Job> jobs;
+		while (jobs.size() < count) {
+			jobs.emplace_back();
+		}
+		return jobs;
+	}
+
+	// Runs func(i) for every i below count, each worker pulls the next index as soon as it is done with one.
+	// The workers are the JobSystem's plus the calling thread, without an initialized JobSystem it all runs serially.
+	// Called from inside another ParallelFor it runs serially too, the JobSystem workers are already busy with the outer one.
+	template<typename Func>
+	void ParallelFor(uint32_t count, uint32_t workerCount, Func&& func) {
+		workerCount = std::max(1u, std::min({ workerCount, count, JobSystem::GetWorkerCount() + 1 }));
+		if (workerCount == 1 || g_parallelForWorker) {
+			for (uint32_t item = 0; item < count; item++) {
+				func(item);
+			}
+			return;
+		}
+		struct Range {
+			std::atomic<uint32_t> nextItem = 0;
+			uint32_t count = 0;
+			std::remove_reference_t<Func>* func = nullptr;
+		};
+		Range range;
+		range.count = count;
+		range.func = &func;
+		auto work = [](void* userData) {
+			Range& range = *(Range*)userData;
+			bool wasWorker = g_parallelForWorker;
+			g_parallelForWorker = true;
+			{
+				PROFILE_SCOPE("Parallel For");
+				for (uint32_t item = range.nextItem++; item < range.count; item = range.nextItem++) {
+					(*range.func)(item);
+				}
+			}
+			g_parallelForWorker = wasWorker;
+		};
+
+		// The caller is one of the workers, the others are jobs that Wait() runs here if no worker got to them
+		std::deque<JobSystem::Job>& helpers = GetParallelForJobs(workerCount - 1);
+		for (uint32_t i = 0; i < workerCount - 1; i++) {
+			JobSystem::Job& helper = helpers[i];
+			helper.function = work;
+			helper.userData = &range;
+			JobSystem::Submit(helper);
+		}
+		work(&range);
+		for (uint32_t i = 0; i < workerCount - 1; i++) {
+			JobSystem::Wait(helpers[i]);
+		}
+	}
+
 	inline glm::vec3 NormalFromTriangle(glm::vec3 pos0, glm::vec3 pos1, glm::vec3 pos2)
 	{
 		return glm::normalize(glm::cross(pos1 - pos0, pos2 - pos0));
@@ -133,6 +201,17 @@ namespace Util {
 
 		0.0f, 0.0f, 1.0f, 0.0f };
 	}
+
+	// Top three rows of the matrix, row major
+	inline VkTransformMatrixKHR GetVkTransformMatrixKHR(const glm::mat4& matrix) {
+		VkTransformMatrixKHR transformMatrix;
+		for (int row = 0; row < 3; row++) {
+			for (int column = 0; column < 4; column++) {
+				transformMatrix.matrix[row][column] = matrix[column][row];
+			}
+		}
+		return transformMatrix;
+	}
 	inline void SetTangentsFromVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
 		if (vertices.size() > 0) {
 			for (int i = 0; i < indices.size(); i += 3) {
@@ -2,5 +2,6 @@
 
 enum class WindowedMode {
     WINDOWED,
-    FULLSCREEN
+    FULLSCREEN,
+    HEADLESS    // No window, surface or swapchain. Frames render into the Present image only
 };
\ No newline at end of file